@@ -1,5 +1,7 @@
 SRS_UTEST=NO
 SRS_VALGRIND=NO
+SRS_GPERF=NO
+SRS_TCMALLOC=NO
 
 function show_help() {
     cat << END
@@ -11,6 +13,8 @@ Features:
 
 Performance:
   --valgrind=on|off         Whether build with valgrind support.
+  --gperf=on|off            Whether build with gperftools, for the CPU and heap profiling API.
+  --tcmalloc=on|off         Whether link tcmalloc of gperftools, which returns the free memory to OS by rate.
   
 END
 }
@@ -25,6 +29,14 @@ function parse_user_option() {
         --with-valgrind)                SRS_VALGRIND=YES            ;;
         --without-valgrind)             SRS_VALGRIND=NO             ;;
         --valgrind)                     SRS_VALGRIND=$(switch2value $value) ;;
+
+        --with-gperf)                   SRS_GPERF=YES               ;;
+        --without-gperf)                SRS_GPERF=NO                ;;
+        --gperf)                        SRS_GPERF=$(switch2value $value) ;;
+
+        --with-tcmalloc)                SRS_TCMALLOC=YES            ;;
+        --without-tcmalloc)             SRS_TCMALLOC=NO             ;;
+        --tcmalloc)                     SRS_TCMALLOC=$(switch2value $value) ;;
     *)
         echo "$0: error: invalid option \"$option\""
         exit 1
@@ -0,0 +1,92 @@
+// The benchmark of SrsBloomFilter, to report the false positive rate and memory per million rules, and the
+// lookup of SrsDomainMatcher for the clean hosts, with and without the filter.
+//      make && ../../output/bloom_filter_bench 5000000
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <srs_core.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_bloom_filter.hpp>
+#include <srs_app_domain_matcher.hpp>
+
+// @global log and context.
+ISrsLog* _srs_log = NULL;
+ISrsContext* _srs_context = NULL;
+
+static uint32_t random_hash()
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+// Generate a domain like the phishing database, with 2~4 labels.
+static std::string random_domain(int i)
+{
+    static const char* tlds[] = {"com", "net", "org", "io", "co.uk", "xyz", "info", "cn"};
+
+    char buf[128];
+    int labels = 1 + i % 3;
+    int n = 0;
+    for (int j = 0; j < labels; j++) {
+        n += snprintf(buf + n, sizeof(buf) - n, "%x%c", (unsigned)(rand() % 0xfffffff), (j + 1 < labels) ? '.' : '-');
+    }
+    snprintf(buf + n, sizeof(buf) - n, "login%d.%s", i % 1000, tlds[i % 8]);
+    return buf;
+}
+
+static void lookup(SrsDomainMatcher& matcher, std::vector<std::string>& hosts, int nn_lookups, const char* name)
+{
+    int nn_matched = 0;
+    srs_utime_t starttime = srs_get_monotonic_time();
+    for (int i = 0; i < nn_lookups; i++) {
+        nn_matched += matcher.match(hosts[i % hosts.size()]) ? 1 : 0;
+    }
+    srs_utime_t elapsed = srs_get_monotonic_time() - starttime;
+    printf("lookup %s: count=%d, matched=%d, memory=%dMB, bloom=%dMB, avg=%.1fns\n", name, nn_lookups, nn_matched,
+        (int)(matcher.memory() / 1024 / 1024), (int)(matcher.bloom_memory() / 1024 / 1024), elapsed * 1000.0 / nn_lookups);
+}
+
+int main(int argc, char** argv)
+{
+    int nn_rules = argc > 1 ? ::atoi(argv[1]) : 5000000;
+    int nn_lookups = argc > 2 ? ::atoi(argv[2]) : 10000000;
+    srand(0);
+
+    // The false positive rate of filter, for the keys which are not in it.
+    int bits[] = {8, 10, 12, 16, 20};
+    for (int i = 0; i < (int)(sizeof(bits) / sizeof(bits[0])); i++) {
+        SrsBloomFilter filter;
+        filter.initialize(nn_rules, bits[i]);
+        for (int j = 0; j < nn_rules; j++) {
+            filter.add(random_hash());
+        }
+
+        int nn_positives = 0;
+        srs_utime_t starttime = srs_get_monotonic_time();
+        for (int j = 0; j < nn_lookups; j++) {
+            nn_positives += filter.contains(random_hash()) ? 1 : 0;
+        }
+        srs_utime_t elapsed = srs_get_monotonic_time() - starttime;
+        printf("filter: bits=%d, keys=%d, memory=%.2fMB per million, false positive=%.3f%%, avg=%.1fns\n", bits[i],
+            nn_rules, filter.memory() * 1000000.0 / nn_rules / 1024 / 1024, nn_positives * 100.0 / nn_lookups,
+            elapsed * 1000.0 / nn_lookups);
+    }
+
+    SrsDomainMatcher matcher;
+    for (int i = 0; i < nn_rules; i++) {
+        matcher.add(random_domain(i), SrsDomainRuleSuffix);
+    }
+
+    // Nearly all traffic is clean, so the hosts are not in rules.
+    std::vector<std::string> hosts;
+    for (int i = 0; i < 100000; i++) {
+        hosts.push_back("www.cdn." + random_domain(i) + ".example");
+    }
+
+    lookup(matcher, hosts, nn_lookups, "without filter");
+    matcher.compile();
+    lookup(matcher, hosts, nn_lookups, "with filter");
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+// The benchmark of SrsDomainMatcher, to check the lookup is sub-microsecond for millions of rules,
+// for example, the phishing database.
+//      make && ../../output/domain_matcher_bench 5000000
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <srs_core.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_domain_matcher.hpp>
+
+// @global log and context.
+ISrsLog* _srs_log = NULL;
+ISrsContext* _srs_context = NULL;
+
+// Generate a domain like the phishing database, with 2~4 labels.
+static std::string random_domain(int i)
+{
+    static const char* tlds[] = {"com", "net", "org", "io", "co.uk", "xyz", "info", "cn"};
+
+    char buf[128];
+    int labels = 1 + i % 3;
+    int n = 0;
+    for (int j = 0; j < labels; j++) {
+        n += snprintf(buf + n, sizeof(buf) - n, "%x%c", (unsigned)(rand() % 0xfffffff), (j + 1 < labels) ? '.' : '-');
+    }
+    snprintf(buf + n, sizeof(buf) - n, "login%d.%s", i % 1000, tlds[i % 8]);
+    return buf;
+}
+
+int main(int argc, char** argv)
+{
+    int nn_rules = argc > 1 ? ::atoi(argv[1]) : 5000000;
+    int nn_lookups = argc > 2 ? ::atoi(argv[2]) : 10000000;
+    srand(0);
+
+    std::vector<std::string> domains;
+    domains.reserve(nn_rules);
+    for (int i = 0; i < nn_rules; i++) {
+        domains.push_back(random_domain(i));
+    }
+
+    SrsDomainMatcher matcher;
+    srs_utime_t starttime = srs_get_monotonic_time();
+    for (int i = 0; i < nn_rules; i++) {
+        matcher.add(domains[i], SrsDomainRuleSuffix);
+    }
+    srs_utime_t elapsed = srs_get_monotonic_time() - starttime;
+    printf("build: rules=%d, elapsed=%dms, memory=%dMB\n", matcher.size(), srsu2msi(elapsed),
+        (int)(matcher.memory() / 1024 / 1024));
+
+    // The hosts to lookup, half are subdomains of rules, half are not in rules.
+    std::vector<std::string> hosts;
+    for (int i = 0; i < 100000; i++) {
+        if (i % 2) {
+            hosts.push_back("www.cdn." + domains[rand() % nn_rules]);
+        } else {
+            hosts.push_back("www.cdn." + random_domain(i) + ".example");
+        }
+    }
+
+    int nn_matched = 0;
+    starttime = srs_get_monotonic_time();
+    for (int i = 0; i < nn_lookups; i++) {
+        nn_matched += matcher.match(hosts[i % hosts.size()]) ? 1 : 0;
+    }
+    elapsed = srs_get_monotonic_time() - starttime;
+    printf("lookup: count=%d, matched=%d, elapsed=%dms, avg=%.1fns\n", nn_lookups, nn_matched, srsu2msi(elapsed),
+        elapsed * 1000.0 / nn_lookups);
+
+    return 0;
+}
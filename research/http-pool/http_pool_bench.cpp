@@ -0,0 +1,183 @@
+// The benchmark of the object pools and arena of transaction, to report the heap allocations per request, when
+// parse the request and response, read the response body and write the access log, as the proxy does.
+//      make && ../../output/http_pool_bench 100000
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <new>
+#include <srs_core.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_pool.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_app_access_log.hpp>
+
+// The number of heap allocations, by the operator new.
+static uint64_t nn_allocs = 0;
+
+void* operator new(size_t size)
+{
+    nn_allocs++;
+    void* p = ::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    ::free(p);
+}
+
+class MockNullLog : public ISrsLog
+{
+public:
+    virtual srs_error_t initialize() { return srs_success; }
+    virtual void reopen() {}
+    virtual void verbose(const char*, SrsContextId, const char*, const char*, int, const char*, ...) {}
+    virtual void info(const char*, SrsContextId, const char*, const char*, int, const char*, ...) {}
+    virtual void trace(const char*, SrsContextId, const char*, const char*, int, const char*, ...) {}
+    virtual void warn(const char*, SrsContextId, const char*, const char*, int, const char*, ...) {}
+    virtual void error(const char*, SrsContextId, const char*, const char*, int, const char*, ...) {}
+};
+
+class MockNullContext : public ISrsContext
+{
+private:
+    SrsContextId id_;
+public:
+    virtual SrsContextId generate_id() { return id_; }
+    virtual const SrsContextId& get_id() { return id_; }
+    virtual const SrsContextId& set_id(const SrsContextId& v) { return id_; }
+    virtual void set_client_fd(const int fd) {}
+    virtual void set_server_fd(const int fd) {}
+    virtual int get_client_fd() { return -1; }
+    virtual int get_server_fd() { return -1; }
+};
+
+// @global log and context.
+ISrsLog* _srs_log = new MockNullLog();
+ISrsContext* _srs_context = new MockNullContext();
+
+// Read the message from memory, as the socket.
+class MockStringReader : public ISrsReader
+{
+public:
+    std::string data;
+    size_t pos;
+public:
+    MockStringReader(std::string v) : data(v), pos(0) {}
+    virtual srs_error_t read(void* buf, size_t size, ssize_t* nread) {
+        if (pos >= data.size()) {
+            return srs_error_new(ERROR_SOCKET_READ, "eof");
+        }
+        size_t n = srs_min(size, data.size() - pos);
+        memcpy(buf, data.data() + pos, n);
+        pos += n;
+        if (nread) {
+            *nread = n;
+        }
+        return srs_success;
+    }
+};
+
+// The requests of a keep-alive connection.
+#define NN_KEEPALIVE_REQUESTS 100
+
+// Run the transactions, return the allocations of each one.
+// @remark The parsers and arena are created for each connection, which are not counted.
+static double transact(int nn_requests, bool pooled, srs_utime_t& elapsed)
+{
+    SrsObjectPool::set_enabled(pooled);
+
+    SrsArena* arena = NULL;
+    SrsHttpParser* parser = NULL;
+    SrsHttpParser* server_parser = NULL;
+
+    MockStringReader client("GET http://www.example.com/news/index.html?id=100 HTTP/1.1\r\nHost: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0\r\nAccept: text/html\r\nAccept-Encoding: gzip\r\nConnection: keep-alive\r\n\r\n");
+    MockStringReader server("HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 16384\r\n"
+        "Cache-Control: max-age=60\r\nConnection: keep-alive\r\n\r\n" + std::string(16384, 'x'));
+
+    std::string body;
+    uint64_t allocs = 0;
+    elapsed = 0;
+    for (int i = 0; i < nn_requests; i++) {
+        if (i % NN_KEEPALIVE_REQUESTS == 0) {
+            srs_freep(parser);
+            srs_freep(server_parser);
+            srs_freep(arena);
+            arena = new SrsArena();
+            parser = new SrsHttpParser();
+            server_parser = new SrsHttpParser();
+            parser->initialize(HTTP_REQUEST);
+            if (pooled) {
+                parser->set_arena(arena);
+                server_parser->set_arena(arena);
+            }
+        }
+
+        uint64_t starts = nn_allocs;
+        srs_utime_t starttime = srs_get_monotonic_time();
+        if (pooled) {
+            arena->reset();
+        }
+        client.pos = server.pos = 0;
+
+        ISrsHttpMessage* req = NULL;
+        srs_error_t err = parser->parse_message(&client, &req);
+        srs_assert(err == srs_success);
+
+        server_parser->initialize(HTTP_RESPONSE);
+        ISrsHttpMessage* resp = NULL;
+        err = server_parser->parse_message(&server, &resp);
+        srs_assert(err == srs_success);
+
+        for (int finish = 0; !finish; ) {
+            body = "";
+            err = ((SrsHttpMessage*)resp)->body_read_part(body, 4096, finish);
+            srs_assert(err == srs_success);
+        }
+
+        SrsAccessLogInfo* log_info = new SrsAccessLogInfo();
+        log_info->domain = ((SrsHttpMessage*)req)->get_dest_domain();
+        log_info->status_code = ((SrsHttpMessage*)resp)->status_code();
+        srs_freep(log_info);
+
+        srs_freep(resp);
+        srs_freep(req);
+
+        elapsed += srs_get_monotonic_time() - starttime;
+        allocs += nn_allocs - starts;
+    }
+
+    srs_freep(parser);
+    srs_freep(server_parser);
+    srs_freep(arena);
+
+    return (double)allocs / nn_requests;
+}
+
+int main(int argc, char** argv)
+{
+    int nn_requests = argc > 1 ? ::atoi(argv[1]) : 100000;
+
+    srs_utime_t elapsed = 0;
+    double allocs = transact(nn_requests, false, elapsed);
+    printf("before: requests=%d, allocs=%.1f/req, avg=%.1fus\n", nn_requests, allocs, elapsed * 1.0 / nn_requests);
+
+    allocs = transact(nn_requests, true, elapsed);
+    printf("after: requests=%d, allocs=%.1f/req, avg=%.1fus\n", nn_requests, allocs, elapsed * 1.0 / nn_requests);
+
+    std::vector<SrsObjectPool*>& all = SrsObjectPool::pools();
+    for (int i = 0; i < (int)all.size(); i++) {
+        SrsObjectPool* pool = all.at(i);
+        printf("pool %s: size=%d, used=%d, cached=%d, allocs=%d, reuses=%d\n", pool->name().c_str(), (int)pool->size(),
+            pool->used(), pool->cached(), (int)pool->nn_allocs(), (int)pool->nn_reuses());
+    }
+    printf("arena: resets=%d, blocks=%d\n", (int)SrsArena::nn_resets(), (int)SrsArena::nn_blocks());
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+#
+# Train the URL classifier by sklearn, and export the model as text for SrsUrlClassifier, for example:
+#       python3 export_model.py urls.csv url_category.txt
+#       ./objs/policy_compiler -m url_category.txt -o conf/url_category.model
+# The csv is url,category per line, the url is the host and path, such as www.example.com/news/a.html
+#
+import sys
+import csv
+import numpy as np
+from scipy.sparse import csr_matrix
+from sklearn.feature_extraction.text import TfidfTransformer
+from sklearn.linear_model import LogisticRegression
+
+NGRAM = (3, 5)
+BUCKETS = 262144
+THRESHOLD = 0.5
+
+
+def fnv1a(s):
+    h = 2166136261
+    for c in s.encode('utf-8'):
+        h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def ngrams(url):
+    # Same as SrsUrlClassifier::score, only the first 256 bytes are scored.
+    url = url.lower()[:256]
+    return [url[i:i + n] for n in range(NGRAM[0], NGRAM[1] + 1) for i in range(len(url) - n + 1)]
+
+
+def main():
+    urls, labels = [], []
+    with open(sys.argv[1]) as f:
+        for row in csv.reader(f):
+            urls.append(row[0])
+            labels.append(row[1])
+
+    # Hash by FNV-1a rather than murmur of HashingVectorizer, to match the proxy.
+    rows, cols, vals = [], [], []
+    for r, url in enumerate(urls):
+        for b in [fnv1a(g) & (BUCKETS - 1) for g in ngrams(url)]:
+            rows.append(r)
+            cols.append(b)
+            vals.append(1.0)
+
+    tf = csr_matrix((vals, (rows, cols)), shape=(len(urls), BUCKETS))
+    tfidf = TfidfTransformer(norm='l2', smooth_idf=True, sublinear_tf=False)
+    x = tfidf.fit_transform(tf)
+
+    clf = LogisticRegression(max_iter=1000)
+    clf.fit(x, labels)
+
+    # The binary classifier has one row of coef, expand to two classes.
+    coef, bias = clf.coef_, clf.intercept_
+    if len(clf.classes_) == 2:
+        coef = np.vstack([-coef[0] / 2, coef[0] / 2])
+        bias = np.array([-bias[0] / 2, bias[0] / 2])
+
+    used = set(tf.nonzero()[1])
+    with open(sys.argv[2], 'w') as f:
+        f.write('ngram %d %d\n' % NGRAM)
+        f.write('buckets %d\n' % BUCKETS)
+        f.write('threshold %g\n' % THRESHOLD)
+        f.write('classes %s\n' % ' '.join(clf.classes_))
+        f.write('bias %s\n' % ' '.join('%g' % v for v in bias))
+        f.write('idf_default %g\n' % (np.log((1 + len(urls)) / 1.0) + 1))
+        for b in sorted(used):
+            f.write('idf %d %g\n' % (b, tfidf.idf_[b]))
+            f.write('weight %d %s\n' % (b, ' '.join('%g' % v for v in coef[:, b])))
+
+
+if __name__ == '__main__':
+    main()
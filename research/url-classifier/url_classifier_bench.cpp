@@ -0,0 +1,124 @@
+// The benchmark of SrsUrlClassifier, to check the URL is scored in microseconds by a real size model.
+//      make && ../../output/url_classifier_bench 16 262144
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <srs_core.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_file.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_url_classifier.hpp>
+
+// @global log and context.
+ISrsLog* _srs_log = NULL;
+ISrsContext* _srs_context = NULL;
+
+static std::string random_word()
+{
+    static const char* words[] = {"news", "sports", "shop", "game", "video", "login", "finance", "travel", "music",
+        "blog", "cdn", "static", "api", "mail", "wiki", "img"};
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s%x", words[rand() % 16], (unsigned)(rand() % 0xfff));
+    return buf;
+}
+
+static std::string random_url()
+{
+    std::string url = "www." + random_word() + ".com";
+    for (int i = 0; i < 3; i++) {
+        url += "/" + random_word();
+    }
+    return url + ".html";
+}
+
+// Write a dense model with random weights, as the model trained by sklearn.
+static srs_error_t write_model(std::string path, int nn_classes, int nn_buckets)
+{
+    srs_error_t err = srs_success;
+
+    SrsFileWriter writer;
+    if ((err = writer.open(path)) != srs_success) {
+        return err;
+    }
+
+    char buf[64];
+    std::string text = "ngram 3 5\nbuckets " + srs_int2str(nn_buckets) + "\nthreshold 0.3\nclasses";
+    for (int c = 0; c < nn_classes; c++) {
+        text += " c" + srs_int2str(c);
+    }
+    text += "\nbias";
+    for (int c = 0; c < nn_classes; c++) {
+        text += " 0";
+    }
+    text += "\nidf_default 10\n";
+
+    for (int i = 0; i < nn_buckets; i++) {
+        snprintf(buf, sizeof(buf), "idf %d %.3f\nweight %d", i, 1 + (rand() % 1000) / 100.0, i);
+        text += buf;
+        for (int c = 0; c < nn_classes; c++) {
+            snprintf(buf, sizeof(buf), " %.3f", (rand() % 2000 - 1000) / 1000.0);
+            text += buf;
+        }
+        text += "\n";
+    }
+
+    return writer.write((void*)text.data(), text.size(), NULL);
+}
+
+int main(int argc, char** argv)
+{
+    int nn_classes = argc > 1 ? ::atoi(argv[1]) : 16;
+    int nn_buckets = argc > 2 ? ::atoi(argv[2]) : 262144;
+    int nn_lookups = argc > 3 ? ::atoi(argv[3]) : 1000000;
+    srand(0);
+
+    std::string text = "/tmp/url_classifier_bench.txt";
+    std::string path = "/tmp/url_classifier_bench.model";
+    srs_error_t err = write_model(text, nn_classes, nn_buckets);
+    if (err != srs_success) {
+        printf("write model failed, %s\n", srs_error_desc(err).c_str());
+        return -1;
+    }
+
+    srs_utime_t starttime = srs_get_monotonic_time();
+    SrsUrlClassifier compiled;
+    if ((err = compiled.load_text(text)) != srs_success || (err = compiled.save(path)) != srs_success) {
+        printf("compile model failed, %s\n", srs_error_desc(err).c_str());
+        return -1;
+    }
+    srs_utime_t elapsed = srs_get_monotonic_time() - starttime;
+
+    SrsUrlClassifier classifier;
+    starttime = srs_get_monotonic_time();
+    if ((err = classifier.load(path)) != srs_success) {
+        printf("load model failed, %s\n", srs_error_desc(err).c_str());
+        return -1;
+    }
+    printf("model: classes=%d, buckets=%d, memory=%dKB, compile=%dms, load=%dus\n", classifier.classes(), nn_buckets,
+        (int)(classifier.memory() / 1024), srsu2msi(elapsed), (int)(srs_get_monotonic_time() - starttime));
+
+    std::vector<std::string> urls;
+    for (int i = 0; i < 100000; i++) {
+        urls.push_back(random_url());
+    }
+
+    int nn_known = 0;
+    size_t nn_bytes = 0;
+    starttime = srs_get_monotonic_time();
+    for (int i = 0; i < nn_lookups; i++) {
+        const std::string& url = urls[i % urls.size()];
+        nn_known += classifier.classify(url).empty() ? 0 : 1;
+        nn_bytes += url.length();
+    }
+    elapsed = srs_get_monotonic_time() - starttime;
+    printf("classify: count=%d, known=%d, elapsed=%dms, avg=%.1fns, url=%dB\n", nn_lookups, nn_known,
+        srsu2msi(elapsed), elapsed * 1000.0 / nn_lookups, (int)(nn_bytes / nn_lookups));
+
+    ::unlink(text.c_str());
+    ::unlink(path.c_str());
+    return 0;
+}
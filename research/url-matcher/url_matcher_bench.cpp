@@ -0,0 +1,82 @@
+// The benchmark of SrsUrlMatcher, to check the lookup cost is not related to the number of rules.
+//      make && ../../output/url_matcher_bench 10000
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <srs_core.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_url_matcher.hpp>
+
+// @global log and context.
+ISrsLog* _srs_log = NULL;
+ISrsContext* _srs_context = NULL;
+
+static std::string random_word()
+{
+    static const char* words[] = {"ads", "api", "static", "track", "v1", "v2", "user", "img", "cdn", "banner",
+        "pixel", "login", "download", "video", "js", "css"};
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s%x", words[rand() % 16], (unsigned)(rand() % 0xfff));
+    return buf;
+}
+
+// Generate a rule of prefix, exact, substring or glob.
+static std::string random_rule(int i)
+{
+    switch (i % 4) {
+        case 0: return "/" + random_word() + "/" + random_word() + "/";
+        case 1: return "=/" + random_word() + "/" + random_word() + ".js";
+        case 2: return "~" + random_word() + "=";
+        default: return "=/" + random_word() + "/*/" + random_word();
+    }
+}
+
+static std::string random_url()
+{
+    std::string url;
+    for (int i = 0; i < 4; i++) {
+        url += "/" + random_word();
+    }
+    return url + ".js?" + random_word() + "=1&" + random_word() + "=2";
+}
+
+int main(int argc, char** argv)
+{
+    int nn_rules = argc > 1 ? ::atoi(argv[1]) : 10000;
+    int nn_lookups = argc > 2 ? ::atoi(argv[2]) : 1000000;
+    srand(0);
+
+    SrsUrlMatcher matcher;
+    srs_utime_t starttime = srs_get_monotonic_time();
+    for (int i = 0; i < nn_rules; i++) {
+        srs_error_t err = matcher.add(random_rule(i));
+        srs_freep(err);
+    }
+    matcher.compile();
+    srs_utime_t elapsed = srs_get_monotonic_time() - starttime;
+    printf("build: rules=%d, states=%d, elapsed=%dms, memory=%dKB\n", matcher.size(), matcher.states(),
+        srsu2msi(elapsed), (int)(matcher.memory() / 1024));
+
+    std::vector<std::string> urls;
+    for (int i = 0; i < 100000; i++) {
+        urls.push_back(random_url());
+    }
+
+    int nn_matched = 0;
+    size_t nn_bytes = 0;
+    starttime = srs_get_monotonic_time();
+    for (int i = 0; i < nn_lookups; i++) {
+        const std::string& url = urls[i % urls.size()];
+        nn_matched += matcher.match(url) ? 1 : 0;
+        nn_bytes += url.length();
+    }
+    elapsed = srs_get_monotonic_time() - starttime;
+    printf("lookup: count=%d, matched=%d, elapsed=%dms, avg=%.1fns, url=%dB\n", nn_lookups, nn_matched,
+        srsu2msi(elapsed), elapsed * 1000.0 / nn_lookups, (int)(nn_bytes / nn_lookups));
+
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include <srs_app_access_log.hpp>
 #include <srs_kernel_log.hpp>
 
+SRS_IMPLEMENT_POOL(SrsAccessLogInfo);
+
 SrsAccessLog::SrsAccessLog()
 {
     init();
@@ -21,7 +23,11 @@ void SrsAccessLog::write_access_log(SrsAccessLogInfo* info)
     std::string tmp;
     tmp.append(info->client_ip);tmp.append("\t");
     tmp.append(info->domain);tmp.append("\t");
-    tmp.append(std::to_string(info->status_code));tmp.append("\r\n");
+    tmp.append(std::to_string(info->status_code));
+    if (!info->category.empty()) {
+        tmp.append("\t");tmp.append(info->category);
+    }
+    tmp.append("\r\n");
     write((void*)tmp.c_str(), tmp.size(), NULL);
     srs_trace("write finish");
 }
\ No newline at end of file
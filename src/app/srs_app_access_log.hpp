@@ -8,14 +8,18 @@
 #define SRS_APP_ACCESS_LOG_HPP
 
 #include <srs_kernel_file.hpp>
+#include <srs_kernel_pool.hpp>
 #include <string>
 using std::string;
 class SrsAccessLogInfo
 {
+    SRS_DECLARE_POOL();
 public:
     string domain;
     string client_ip;
     int status_code;
+    // The category of URL, which is the last field, omitted if not categorized.
+    string category;
 };
 
 class SrsAccessLog : public SrsFileWriter
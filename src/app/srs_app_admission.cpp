@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_admission.hpp>
+#include <srs_app_config.hpp>
+#include <srs_app_threads.hpp>
+#include <srs_app_policy.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_protocol_json.hpp>
+
+using namespace std;
+
+extern SrsConfig* _srs_config;
+
+SrsAdmission* _srs_admission = NULL;
+
+const char* srs_admission_level_name(SrsAdmissionLevel level)
+{
+    switch (level) {
+        case SrsAdmissionLevelHigh: return "high";
+        case SrsAdmissionLevelCritical: return "critical";
+        case SrsAdmissionLevelDying: return "dying";
+        default: return "normal";
+    }
+}
+
+SrsAdmission::SrsAdmission()
+{
+    connections_ = 0;
+    nn_exceed_ = 0;
+    nn_deny_client_ = 0;
+    nn_reject_connect_ = 0;
+    nn_fallback_tunnel_ = 0;
+    nn_pause_ = 0;
+    paused_ = 0;
+    pause_starttime_ = 0;
+}
+
+SrsAdmission::~SrsAdmission()
+{
+}
+
+SrsAdmissionLevel SrsAdmission::level()
+{
+    if (!_srs_circuit_breaker) {
+        return SrsAdmissionLevelNormal;
+    }
+
+    if (_srs_circuit_breaker->hybrid_dying_water_level()) {
+        return SrsAdmissionLevelDying;
+    }
+    if (_srs_circuit_breaker->hybrid_critical_water_level()) {
+        return SrsAdmissionLevelCritical;
+    }
+    if (_srs_circuit_breaker->hybrid_high_water_level()) {
+        return SrsAdmissionLevelHigh;
+    }
+    return SrsAdmissionLevelNormal;
+}
+
+srs_error_t SrsAdmission::on_accept(int connections)
+{
+    int max_connections = _srs_config->get_max_connections();
+    if (connections >= max_connections) {
+        nn_exceed_++;
+        return srs_error_new(ERROR_EXCEED_CONNECTIONS, "exceed max=%d, cur=%d", max_connections, connections);
+    }
+
+    return srs_success;
+}
+
+void SrsAdmission::on_connection_start()
+{
+    connections_++;
+}
+
+void SrsAdmission::on_connection_stop()
+{
+    connections_--;
+}
+
+int SrsAdmission::connections()
+{
+    return connections_;
+}
+
+bool SrsAdmission::should_deny_client(const string& ip)
+{
+    SrsPolicyGuard policy;
+    if (!policy->match_client_ip_list(ip)) {
+        return false;
+    }
+
+    nn_deny_client_++;
+    return true;
+}
+
+bool SrsAdmission::should_pause_accept()
+{
+    bool pause = level() >= SrsAdmissionLevelDying;
+
+    if (pause && !pause_starttime_) {
+        nn_pause_++;
+        pause_starttime_ = srs_get_system_time();
+        srs_warn("admission: pause accepting for water level is dying");
+    } else if (!pause && pause_starttime_) {
+        srs_utime_t elapsed = srs_get_system_time() - pause_starttime_;
+        paused_ += elapsed;
+        pause_starttime_ = 0;
+        srs_trace("admission: resume accepting, paused=%dms", srsu2msi(elapsed));
+    }
+
+    return pause;
+}
+
+bool SrsAdmission::should_reject_connect()
+{
+    if (level() < SrsAdmissionLevelCritical) {
+        return false;
+    }
+
+    nn_reject_connect_++;
+    return true;
+}
+
+bool SrsAdmission::should_fallback_tunnel()
+{
+    if (level() < SrsAdmissionLevelHigh) {
+        return false;
+    }
+
+    nn_fallback_tunnel_++;
+    return true;
+}
+
+void SrsAdmission::dumps(SrsJsonObject* obj)
+{
+    srs_utime_t paused = paused_;
+    if (pause_starttime_) {
+        paused += srs_get_system_time() - pause_starttime_;
+    }
+
+    obj->set("level", SrsJsonAny::str(srs_admission_level_name(level())));
+    obj->set("max_connections", SrsJsonAny::integer(_srs_config->get_max_connections()));
+    obj->set("connections", SrsJsonAny::integer(connections_));
+    obj->set("exceed", SrsJsonAny::integer(nn_exceed_));
+    obj->set("deny_client", SrsJsonAny::integer(nn_deny_client_));
+    obj->set("reject_connect", SrsJsonAny::integer(nn_reject_connect_));
+    obj->set("fallback_tunnel", SrsJsonAny::integer(nn_fallback_tunnel_));
+    obj->set("pause", SrsJsonAny::integer(nn_pause_));
+    obj->set("paused", SrsJsonAny::integer(srsu2ms(paused)));
+    obj->set("pausing", SrsJsonAny::boolean(pause_starttime_ != 0));
+}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_ADMISSION_HPP
+#define SRS_APP_ADMISSION_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+
+class SrsJsonObject;
+
+// The load level of server, graded by the water level of SrsCircuitBreaker.
+enum SrsAdmissionLevel
+{
+    SrsAdmissionLevelNormal = 0,
+    // Stop decrypting new sessions, tunnel them instead, because MITM is much more expensive.
+    SrsAdmissionLevelHigh,
+    // Reject new CONNECT with 503, so the client fails fast rather than times out.
+    SrsAdmissionLevelCritical,
+    // Stop accepting on proxy listener, the clients wait in the backlog of kernel.
+    SrsAdmissionLevelDying,
+};
+
+extern const char* srs_admission_level_name(SrsAdmissionLevel level);
+
+// The admission control for proxy connections, which enforces the max_connections, and sheds load
+// gradually when the water level of circuit breaker rises.
+// @remark The API connections are not limited, so we can still query the metrics when overloaded.
+class SrsAdmission
+{
+private:
+    // The number of live proxy connections, the API connections are excluded.
+    int connections_;
+    // The number of connections dropped for exceed max_connections.
+    uint64_t nn_exceed_;
+    // The number of connections dropped for the client ip is denied by policy.
+    uint64_t nn_deny_client_;
+    // The number of CONNECT rejected with 503.
+    uint64_t nn_reject_connect_;
+    // The number of sessions tunneled rather than decrypted.
+    uint64_t nn_fallback_tunnel_;
+    // The number of times the proxy listener paused, and the total paused time.
+    uint64_t nn_pause_;
+    srs_utime_t paused_;
+    // The start time of current pause, 0 if not paused.
+    srs_utime_t pause_starttime_;
+public:
+    SrsAdmission();
+    virtual ~SrsAdmission();
+public:
+    // Get the current load level, from the circuit breaker.
+    virtual SrsAdmissionLevel level();
+    // Check the connection limitation before creating the connection.
+    // @param connections The number of live proxy connections.
+    virtual srs_error_t on_accept(int connections);
+    // Count the proxy connection when it's created and freed.
+    virtual void on_connection_start();
+    virtual void on_connection_stop();
+    virtual int connections();
+    // Whether drop the connection for the client ip is denied by policy.
+    virtual bool should_deny_client(const std::string& ip);
+    // Whether the proxy listener should stop accepting, update the stat of pause.
+    virtual bool should_pause_accept();
+    // Whether reject the new CONNECT with 503.
+    virtual bool should_reject_connect();
+    // Whether tunnel the new session, which should be decrypted otherwise.
+    virtual bool should_fallback_tunnel();
+public:
+    virtual void dumps(SrsJsonObject* obj);
+};
+
+extern SrsAdmission* _srs_admission;
+
+#endif
@@ -0,0 +1,288 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_async_io.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+using namespace std;
+
+SrsAsyncFileTask::SrsAsyncFileTask()
+{
+    fd = -1;
+    write = false;
+    offset = 0;
+    buf = NULL;
+    size = 0;
+    nn_done = 0;
+    error = 0;
+    elapsed = 0;
+
+    starttime_ = 0;
+    done_ = false;
+    detached_ = false;
+    cond_ = NULL;
+}
+
+SrsAsyncFileTask::~SrsAsyncFileTask()
+{
+    if (cond_) {
+        srs_cond_destroy(cond_);
+    }
+}
+
+bool SrsAsyncFileTask::success()
+{
+    return error == 0 && nn_done == (ssize_t)size;
+}
+
+void SrsAsyncFileTask::on_done()
+{
+}
+
+SrsAsyncFileIo::SrsAsyncFileIo()
+{
+    trd_ = new SrsSTCoroutine("aio", this);
+    pthread_mutex_init(&lock_, NULL);
+    pthread_cond_init(&cond_, NULL);
+    quit_ = false;
+    pipe_[0] = pipe_[1] = -1;
+    notify_ = NULL;
+    max_pending_ = 0;
+    nn_pending_ = 0;
+}
+
+SrsAsyncFileIo::~SrsAsyncFileIo()
+{
+    pthread_mutex_lock(&lock_);
+    quit_ = true;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&lock_);
+
+    for (int i = 0; i < (int)threads_.size(); i++) {
+        pthread_join(threads_.at(i), NULL);
+    }
+    srs_freep(trd_);
+
+    // The posted tasks are not done, which are freed here, without on_done.
+    for (deque<SrsAsyncFileTask*>::iterator it = tasks_.begin(); it != tasks_.end(); ++it) {
+        SrsAsyncFileTask* task = *it;
+        srs_freep(task);
+    }
+    for (int i = 0; i < (int)done_.size(); i++) {
+        SrsAsyncFileTask* task = done_.at(i);
+        srs_freep(task);
+    }
+
+    srs_close_stfd(notify_);
+    if (pipe_[1] >= 0) {
+        ::close(pipe_[1]);
+    }
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&lock_);
+}
+
+srs_error_t SrsAsyncFileIo::initialize(int nn_threads, int max_pending)
+{
+    srs_error_t err = srs_success;
+
+    max_pending_ = max_pending;
+
+    if (::pipe(pipe_) < 0) {
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "create pipe");
+    }
+
+    // The thread never blocks on notify, because the ST thread drains all done tasks for each wakeup.
+    ::fcntl(pipe_[1], F_SETFL, ::fcntl(pipe_[1], F_GETFL) | O_NONBLOCK);
+    ::fcntl(pipe_[1], F_SETFD, FD_CLOEXEC);
+    ::fcntl(pipe_[0], F_SETFD, FD_CLOEXEC);
+
+    if ((notify_ = srs_netfd_open(pipe_[0])) == NULL) {
+        ::close(pipe_[0]);
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "open pipe fd=%d", pipe_[0]);
+    }
+
+    if ((err = trd_->start()) != srs_success) {
+        return srs_error_wrap(err, "start aio");
+    }
+
+    for (int i = 0; i < nn_threads; i++) {
+        pthread_t trd;
+        if (pthread_create(&trd, NULL, SrsAsyncFileIo::run, this) != 0) {
+            return srs_error_new(ERROR_THREAD_CREATE, "create aio thread #%d", i);
+        }
+        threads_.push_back(trd);
+    }
+
+    srs_trace("aio threads=%d, max pending=%d", nn_threads, max_pending);
+
+    return err;
+}
+
+srs_error_t SrsAsyncFileIo::execute(SrsAsyncFileTask* task)
+{
+    srs_error_t err = srs_success;
+
+    if (!task->cond_) {
+        task->cond_ = srs_cond_new();
+    }
+
+    if ((err = submit(task)) != srs_success) {
+        return srs_error_wrap(err, "submit");
+    }
+
+    // Never free the task before done, even if the coroutine is interrupted, because the thread is using it.
+    while (!task->done_) {
+        srs_cond_wait(task->cond_);
+    }
+
+    return err;
+}
+
+srs_error_t SrsAsyncFileIo::post(SrsAsyncFileTask* task)
+{
+    srs_error_t err = srs_success;
+
+    task->detached_ = true;
+    if ((err = submit(task)) != srs_success) {
+        task->detached_ = false;
+        return srs_error_wrap(err, "submit");
+    }
+
+    return err;
+}
+
+int SrsAsyncFileIo::pending()
+{
+    return nn_pending_;
+}
+
+bool SrsAsyncFileIo::full()
+{
+    return nn_pending_ >= max_pending_;
+}
+
+srs_error_t SrsAsyncFileIo::cycle()
+{
+    srs_error_t err = srs_success;
+
+    char buf[64];
+    vector<SrsAsyncFileTask*> tasks;
+
+    while (true) {
+        if ((err = trd_->pull()) != srs_success) {
+            return srs_error_wrap(err, "pull");
+        }
+
+        if (srs_read(notify_, buf, sizeof(buf), SRS_UTIME_NO_TIMEOUT) <= 0) {
+            continue;
+        }
+
+        pthread_mutex_lock(&lock_);
+        tasks.swap(done_);
+        pthread_mutex_unlock(&lock_);
+
+        for (int i = 0; i < (int)tasks.size(); i++) {
+            SrsAsyncFileTask* task = tasks.at(i);
+            task->elapsed = srs_get_monotonic_time() - task->starttime_;
+            task->done_ = true;
+            nn_pending_--;
+
+            task->on_done();
+            if (task->detached_) {
+                srs_freep(task);
+            } else {
+                srs_cond_signal(task->cond_);
+            }
+        }
+        tasks.clear();
+    }
+
+    return err;
+}
+
+srs_error_t SrsAsyncFileIo::submit(SrsAsyncFileTask* task)
+{
+    if (threads_.empty()) {
+        return srs_error_new(ERROR_THREAD_DISPOSED, "no aio thread");
+    }
+    if (full()) {
+        return srs_error_new(ERROR_DISK_CACHE, "aio full, pending=%d", nn_pending_);
+    }
+
+    task->done_ = false;
+    task->starttime_ = srs_get_monotonic_time();
+    nn_pending_++;
+
+    pthread_mutex_lock(&lock_);
+    tasks_.push_back(task);
+    pthread_cond_signal(&cond_);
+    pthread_mutex_unlock(&lock_);
+
+    return srs_success;
+}
+
+void* SrsAsyncFileIo::run(void* arg)
+{
+    SrsAsyncFileIo* aio = (SrsAsyncFileIo*)arg;
+
+    while (true) {
+        pthread_mutex_lock(&aio->lock_);
+        while (aio->tasks_.empty() && !aio->quit_) {
+            pthread_cond_wait(&aio->cond_, &aio->lock_);
+        }
+        if (aio->quit_) {
+            pthread_mutex_unlock(&aio->lock_);
+            break;
+        }
+        SrsAsyncFileTask* task = aio->tasks_.front();
+        aio->tasks_.pop_front();
+        pthread_mutex_unlock(&aio->lock_);
+
+        process(task);
+
+        pthread_mutex_lock(&aio->lock_);
+        aio->done_.push_back(task);
+        pthread_mutex_unlock(&aio->lock_);
+
+        // Ignore EAGAIN, the ST thread is already notified.
+        char c = 0;
+        ssize_t r0 = ::write(aio->pipe_[1], &c, 1);
+        (void)r0;
+    }
+
+    return NULL;
+}
+
+void SrsAsyncFileIo::process(SrsAsyncFileTask* task)
+{
+    task->nn_done = 0;
+    task->error = 0;
+
+    while (task->nn_done < (ssize_t)task->size) {
+        char* p = task->buf + task->nn_done;
+        size_t left = task->size - task->nn_done;
+        off_t offset = task->offset + task->nn_done;
+
+        ssize_t nn = task->write ? ::pwrite(task->fd, p, left, offset) : ::pread(task->fd, p, left, offset);
+        if (nn < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nn < 0) {
+            task->error = errno;
+            break;
+        }
+        // The EOF of read.
+        if (nn == 0) {
+            break;
+        }
+        task->nn_done += nn;
+    }
+}
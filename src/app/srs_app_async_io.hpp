@@ -0,0 +1,91 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_ASYNC_IO_HPP
+#define SRS_APP_ASYNC_IO_HPP
+
+#include <srs_core.hpp>
+
+#include <pthread.h>
+#include <vector>
+#include <deque>
+
+#include <srs_app_st.hpp>
+
+// The pread or pwrite of file, which is done in the I/O thread.
+class SrsAsyncFileTask
+{
+    friend class SrsAsyncFileIo;
+public:
+    int fd;
+    bool write;
+    off_t offset;
+    char* buf;
+    size_t size;
+    // The bytes read or written, and the errno if failed.
+    ssize_t nn_done;
+    int error;
+    // The time from submitted to done.
+    srs_utime_t elapsed;
+private:
+    srs_utime_t starttime_;
+    bool done_;
+    // Whether the task is posted, and freed by the pool when done.
+    bool detached_;
+    srs_cond_t cond_;
+public:
+    SrsAsyncFileTask();
+    virtual ~SrsAsyncFileTask();
+public:
+    // Whether all bytes are read or written.
+    virtual bool success();
+    // Called in the ST thread when done.
+    virtual void on_done();
+};
+
+// The I/O thread pool for the regular file, which never blocks the ST thread like SrsFileReader, because the disk
+// may stall for tens of milliseconds. The tasks are done by the threads, and the threads notify the ST thread by
+// pipe, then the coroutine waiting for task is signaled.
+class SrsAsyncFileIo : public ISrsCoroutineHandler
+{
+private:
+    SrsCoroutine* trd_;
+    std::vector<pthread_t> threads_;
+    pthread_mutex_t lock_;
+    pthread_cond_t cond_;
+    // The tasks to do, and the done ones, protected by lock.
+    std::deque<SrsAsyncFileTask*> tasks_;
+    std::vector<SrsAsyncFileTask*> done_;
+    bool quit_;
+    // The pipe to notify the ST thread.
+    int pipe_[2];
+    srs_netfd_t notify_;
+    // The max tasks in pool, and the ones not done yet.
+    int max_pending_;
+    int nn_pending_;
+public:
+    SrsAsyncFileIo();
+    virtual ~SrsAsyncFileIo();
+public:
+    // Start the threads, the post fails when there are max pending tasks.
+    virtual srs_error_t initialize(int nn_threads, int max_pending);
+    // Do the task in I/O thread, and wait until it's done, the coroutine is blocked while the ST thread is not.
+    virtual srs_error_t execute(SrsAsyncFileTask* task);
+    // Do the task in I/O thread without waiting, the task is freed after on_done, or by caller if failed.
+    virtual srs_error_t post(SrsAsyncFileTask* task);
+    // The number of tasks not done.
+    virtual int pending();
+    virtual bool full();
+// Interface ISrsCoroutineHandler
+public:
+    virtual srs_error_t cycle();
+private:
+    virtual srs_error_t submit(SrsAsyncFileTask* task);
+    static void* run(void* arg);
+    static void process(SrsAsyncFileTask* task);
+};
+
+#endif
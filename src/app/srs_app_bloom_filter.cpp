@@ -0,0 +1,177 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_bloom_filter.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+
+// The header of encoded filter, followed by the padding to 64 bytes, and the blocks.
+struct SrsBloomFilterHeader
+{
+    uint32_t nn_blocks;
+    uint32_t nn_keys;
+    uint32_t padding;
+    uint32_t reserved;
+};
+
+// The odd constants to get the bit in each word from key, see the split block bloom filter of Parquet.
+static const uint32_t srs_bloom_salts[SRS_BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+// The bit of key in the word i of block, the block uses the high bits of hash, so mix the hash for key.
+static inline uint64_t srs_bloom_mask(uint32_t key, int i)
+{
+    return (uint64_t)1 << ((key * srs_bloom_salts[i]) >> 26);
+}
+
+SrsBloomFilter::SrsBloomFilter()
+{
+    blocks_ = NULL;
+    nn_blocks_ = 0;
+    nn_keys_ = 0;
+    mapped_ = false;
+}
+
+SrsBloomFilter::~SrsBloomFilter()
+{
+    free_blocks();
+}
+
+void SrsBloomFilter::initialize(int keys, int bits_per_key)
+{
+    free_blocks();
+
+    uint64_t bits = (uint64_t)srs_max(1, keys) * srs_max(1, bits_per_key);
+    nn_blocks_ = (uint32_t)((bits + SRS_BLOOM_BLOCK_SIZE * 8 - 1) / (SRS_BLOOM_BLOCK_SIZE * 8));
+    nn_keys_ = 0;
+    mapped_ = false;
+
+    // The new[] is only aligned to 16 bytes, so a block might straddle two cache lines.
+    void* p = NULL;
+    int r0 = posix_memalign(&p, SRS_BLOOM_BLOCK_SIZE, (size_t)nn_blocks_ * SRS_BLOOM_BLOCK_SIZE);
+    srs_assert(r0 == 0 && p);
+    blocks_ = (uint64_t*)p;
+    memset(blocks_, 0, (size_t)nn_blocks_ * SRS_BLOOM_BLOCK_SIZE);
+}
+
+void SrsBloomFilter::add(uint32_t hash)
+{
+    srs_assert(!mapped_ && nn_blocks_);
+
+    uint64_t* p = (uint64_t*)block(hash);
+    uint32_t key = hash * 0x9e3779b1U;
+    for (int i = 0; i < SRS_BLOOM_BLOCK_WORDS; i++) {
+        p[i] |= srs_bloom_mask(key, i);
+    }
+    nn_keys_++;
+}
+
+bool SrsBloomFilter::contains(uint32_t hash)
+{
+    // Everything may be in the empty filter, to check the rules.
+    if (!nn_blocks_) {
+        return true;
+    }
+
+    const uint64_t* p = block(hash);
+    uint32_t key = hash * 0x9e3779b1U;
+    uint64_t missed = 0;
+    for (int i = 0; i < SRS_BLOOM_BLOCK_WORDS; i++) {
+        missed |= ~p[i] & srs_bloom_mask(key, i);
+    }
+    return !missed;
+}
+
+void SrsBloomFilter::prefetch(uint32_t hash)
+{
+    if (nn_blocks_) {
+        __builtin_prefetch(block(hash));
+    }
+}
+
+void SrsBloomFilter::encode(string& data)
+{
+    SrsBloomFilterHeader header;
+    header.nn_blocks = nn_blocks_;
+    header.nn_keys = (uint32_t)nn_keys_;
+    header.padding = (uint32_t)((SRS_BLOOM_BLOCK_SIZE - (data.size() + sizeof(header)) % SRS_BLOOM_BLOCK_SIZE) % SRS_BLOOM_BLOCK_SIZE);
+    header.reserved = 0;
+
+    data.append((const char*)&header, sizeof(header));
+    data.append(header.padding, '\0');
+    if (nn_blocks_) {
+        data.append((const char*)blocks_, (size_t)nn_blocks_ * SRS_BLOOM_BLOCK_SIZE);
+    }
+}
+
+srs_error_t SrsBloomFilter::decode(const char* data, size_t size, size_t* pnread)
+{
+    srs_error_t err = srs_success;
+
+    if (size < sizeof(SrsBloomFilterHeader)) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "bloom filter header requires %d only %d bytes",
+            (int)sizeof(SrsBloomFilterHeader), (int)size);
+    }
+
+    SrsBloomFilterHeader* header = (SrsBloomFilterHeader*)data;
+    if (header->padding >= SRS_BLOOM_BLOCK_SIZE) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid bloom filter padding=%u", header->padding);
+    }
+
+    // Use 64 bits to avoid overflow for the corrupt header.
+    uint64_t start = sizeof(SrsBloomFilterHeader) + header->padding;
+    uint64_t end = start + (uint64_t)header->nn_blocks * SRS_BLOOM_BLOCK_SIZE;
+    if (end > size) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "bloom filter requires %u only %u bytes", (uint32_t)end, (uint32_t)size);
+    }
+
+    free_blocks();
+    blocks_ = (uint64_t*)(data + start);
+    nn_blocks_ = header->nn_blocks;
+    nn_keys_ = (int)header->nn_keys;
+    mapped_ = true;
+
+    if (pnread) {
+        *pnread = (size_t)end;
+    }
+
+    return err;
+}
+
+bool SrsBloomFilter::empty()
+{
+    return !nn_blocks_;
+}
+
+int SrsBloomFilter::size()
+{
+    return nn_keys_;
+}
+
+size_t SrsBloomFilter::memory()
+{
+    return (size_t)nn_blocks_ * SRS_BLOOM_BLOCK_SIZE;
+}
+
+void SrsBloomFilter::free_blocks()
+{
+    if (!mapped_) {
+        free(blocks_);
+    }
+    blocks_ = NULL;
+}
+
+const uint64_t* SrsBloomFilter::block(uint32_t hash)
+{
+    // Map the hash to block by multiply rather than modulo, which is fast for any number of blocks.
+    uint32_t index = (uint32_t)(((uint64_t)hash * nn_blocks_) >> 32);
+    return blocks_ + (size_t)index * SRS_BLOOM_BLOCK_WORDS;
+}
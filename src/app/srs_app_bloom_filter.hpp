@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_BLOOM_FILTER_HPP
+#define SRS_APP_BLOOM_FILTER_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+
+// The bytes of block, which is a cache line.
+#define SRS_BLOOM_BLOCK_SIZE 64
+// The words of block, one bit is set in each word for a key.
+#define SRS_BLOOM_BLOCK_WORDS 8
+
+// The blocked bloom filter, all bits of a key are in one block of cache line, so the lookup is one cache miss,
+// rather than k cache misses of the standard bloom filter, at the cost of a slightly higher false positive rate.
+// It's the front of the huge rule sets, because nearly all traffic is clean, and the filter is much smaller than
+// the rules, so the clean host is rejected without touching the rules.
+// @remark The key is a well mixed hash, for example, the hash of SrsDomainMatcher.
+class SrsBloomFilter
+{
+private:
+    uint64_t* blocks_;
+    uint32_t nn_blocks_;
+    int nn_keys_;
+    // Whether the blocks are in the decoded data, which is read-only.
+    bool mapped_;
+public:
+    SrsBloomFilter();
+    virtual ~SrsBloomFilter();
+public:
+    // Allocate the blocks for the keys, with the bits per key, about 1% false positive for 10 bits.
+    virtual void initialize(int keys, int bits_per_key);
+    // @remark Never add key to the decoded filter, which is read-only.
+    virtual void add(uint32_t hash);
+    // Whether the key may be in the filter, false means it's definitely not.
+    bool contains(uint32_t hash);
+    // Prefetch the block of key, to load the blocks of many keys in parallel.
+    void prefetch(uint32_t hash);
+    // Append the blocks to data, the blocks are aligned to 64 bytes of data, so it's aligned to cache line
+    // when data is mapped at 64 bytes.
+    virtual void encode(std::string& data);
+    // Use the blocks in data, which should be aligned to 8 bytes, and alive until the filter is freed.
+    // @param pnread The bytes of filter in data.
+    virtual srs_error_t decode(const char* data, size_t size, size_t* pnread);
+    virtual bool empty();
+    // The number of keys added before encode.
+    virtual int size();
+    // The bytes of memory used by the blocks.
+    virtual size_t memory();
+private:
+    const uint64_t* block(uint32_t hash);
+    // Free the blocks allocated by initialize, aligned to cache line, never the decoded ones.
+    void free_blocks();
+};
+
+#endif
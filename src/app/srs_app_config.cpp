@@ -1660,6 +1660,18 @@ bool SrsConfig::get_daemon()
     return SRS_CONF_PERFER_TRUE(conf->arg0());
 }
 
+int SrsConfig::get_max_connections()
+{
+    static int DEFAULT = 1000;
+
+    SrsConfDirective* conf = root->get("max_connections");
+    if (!conf || conf->arg0().empty()) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
 bool SrsConfig::get_circuit_breaker()
 {
     // SRS_OVERWRITE_BY_ENV_BOOL2("srs.circuit_breaker.enabled");
@@ -1790,5 +1802,535 @@ int SrsConfig::get_dying_pulse()
         return DEFAULT;
     }
 
+    return ::atoi(conf->arg0().c_str());
+}
+
+bool SrsConfig::get_coroutine_stack_canary()
+{
+    static bool DEFAULT = false;
+
+    SrsConfDirective* conf = root->get("coroutine");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("stack_canary");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
+bool SrsConfig::get_coroutine_stack_guard()
+{
+    static bool DEFAULT = true;
+
+    SrsConfDirective* conf = root->get("coroutine");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("stack_guard");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+int SrsConfig::get_proxy_stack_size()
+{
+    static int DEFAULT = SRS_CONF_DEFAULT_PROXY_STACK_SIZE;
+
+    SrsConfDirective* conf = root->get("coroutine");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("proxy_stack_size");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+int SrsConfig::get_api_stack_size()
+{
+    static int DEFAULT = 32 * 1024;
+
+    SrsConfDirective* conf = root->get("coroutine");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("api_stack_size");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+bool SrsConfig::get_policy_inotify()
+{
+    static bool DEFAULT = true;
+
+    SrsConfDirective* conf = root->get("policy");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("inotify");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+int SrsConfig::get_policy_verdict_cache()
+{
+    static int DEFAULT = 4096;
+
+    SrsConfDirective* conf = root->get("policy");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("verdict_cache");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+SrsConfDirective* SrsConfig::get_url_category()
+{
+    return root->get("url_category");
+}
+
+bool SrsConfig::get_url_category_enabled()
+{
+    static bool DEFAULT = false;
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("enabled");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
+string SrsConfig::get_url_category_host()
+{
+    static string DEFAULT = "127.0.0.1";
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("host");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return conf->arg0();
+}
+
+int SrsConfig::get_url_category_port()
+{
+    static int DEFAULT = 8081;
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("port");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+int SrsConfig::get_url_category_workers()
+{
+    static int DEFAULT = 2;
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("workers");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+int SrsConfig::get_url_category_batch()
+{
+    static int DEFAULT = 64;
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("batch");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+srs_utime_t SrsConfig::get_url_category_timeout()
+{
+    static srs_utime_t DEFAULT = 5 * SRS_UTIME_MILLISECONDS;
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("timeout");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (srs_utime_t)(::atoi(conf->arg0().c_str()) * SRS_UTIME_MILLISECONDS);
+}
+
+srs_utime_t SrsConfig::get_url_category_ttl()
+{
+    static srs_utime_t DEFAULT = 600 * SRS_UTIME_SECONDS;
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("ttl");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (srs_utime_t)(::atoi(conf->arg0().c_str()) * SRS_UTIME_SECONDS);
+}
+
+int SrsConfig::get_url_category_cache()
+{
+    static int DEFAULT = 65536;
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("cache");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+string SrsConfig::get_url_category_model()
+{
+    static string DEFAULT = "";
+
+    SrsConfDirective* conf = get_url_category();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("model");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return conf->arg0();
+}
+
+SrsConfDirective* SrsConfig::get_http_cache()
+{
+    return root->get("http_cache");
+}
+
+bool SrsConfig::get_http_cache_enabled()
+{
+    static bool DEFAULT = false;
+
+    SrsConfDirective* conf = get_http_cache();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("enabled");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
+int64_t SrsConfig::get_http_cache_memory()
+{
+    static int64_t DEFAULT = 256 * 1024 * 1024;
+
+    SrsConfDirective* conf = get_http_cache();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("memory");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (int64_t)::atoll(conf->arg0().c_str()) * 1024 * 1024;
+}
+
+srs_utime_t SrsConfig::get_memory_release_idle_timeout()
+{
+    static srs_utime_t DEFAULT = 5 * SRS_UTIME_SECONDS;
+
+    SrsConfDirective* conf = get_memory_release();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("idle_timeout");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (srs_utime_t)(::atoi(conf->arg0().c_str()) * SRS_UTIME_SECONDS);
+}
+
+int64_t SrsConfig::get_http_cache_max_object()
+{
+    static int64_t DEFAULT = 1024 * 1024;
+
+    SrsConfDirective* conf = get_http_cache();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("max_object");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (int64_t)::atoll(conf->arg0().c_str()) * 1024;
+}
+
+string SrsConfig::get_http_cache_disk_dir()
+{
+    static string DEFAULT = "";
+
+    SrsConfDirective* conf = get_http_cache();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("disk_dir");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return conf->arg0();
+}
+
+int64_t SrsConfig::get_http_cache_disk_size()
+{
+    static int64_t DEFAULT = (int64_t)4096 * 1024 * 1024;
+
+    SrsConfDirective* conf = get_http_cache();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("disk_size");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (int64_t)::atoll(conf->arg0().c_str()) * 1024 * 1024;
+}
+
+int SrsConfig::get_http_cache_disk_threads()
+{
+    static int DEFAULT = 2;
+
+    SrsConfDirective* conf = get_http_cache();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("disk_threads");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+SrsConfDirective* SrsConfig::get_http_collapse()
+{
+    return root->get("http_collapse");
+}
+
+bool SrsConfig::get_http_collapse_enabled()
+{
+    static bool DEFAULT = false;
+
+    SrsConfDirective* conf = get_http_collapse();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("enabled");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
+int64_t SrsConfig::get_http_collapse_max_buffer()
+{
+    static int64_t DEFAULT = 1024 * 1024;
+
+    SrsConfDirective* conf = get_http_collapse();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("max_buffer");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (int64_t)::atoll(conf->arg0().c_str()) * 1024;
+}
+
+srs_utime_t SrsConfig::get_http_collapse_timeout()
+{
+    static srs_utime_t DEFAULT = 15 * SRS_UTIME_SECONDS;
+
+    SrsConfDirective* conf = get_http_collapse();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("timeout");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (srs_utime_t)(::atoi(conf->arg0().c_str()) * SRS_UTIME_SECONDS);
+}
+
+int SrsConfig::get_http_cache_revalidate_workers()
+{
+    static int DEFAULT = 2;
+
+    SrsConfDirective* conf = get_http_cache();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("revalidate_workers");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return ::atoi(conf->arg0().c_str());
+}
+
+SrsConfDirective* SrsConfig::get_memory_release()
+{
+    return root->get("memory_release");
+}
+
+bool SrsConfig::get_memory_release_enabled()
+{
+    static bool DEFAULT = true;
+
+    SrsConfDirective* conf = get_memory_release();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("enabled");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+srs_utime_t SrsConfig::get_memory_release_interval()
+{
+    static srs_utime_t DEFAULT = 10 * SRS_UTIME_SECONDS;
+
+    SrsConfDirective* conf = get_memory_release();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("interval");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (srs_utime_t)(::atoi(conf->arg0().c_str()) * SRS_UTIME_SECONDS);
+}
+
+int64_t SrsConfig::get_memory_release_rate()
+{
+    static int64_t DEFAULT = 64 * 1024 * 1024;
+
+    SrsConfDirective* conf = get_memory_release();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("rate");
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    return (int64_t)::atoll(conf->arg0().c_str()) * 1024 * 1024;
+}
+
+int SrsConfig::get_memory_release_idle_requests()
+{
+    static int DEFAULT = 10;
+
+    SrsConfDirective* conf = get_memory_release();
+    if (!conf) {
+        return DEFAULT;
+    }
+
+    conf = conf->get("idle_requests");
+    if (!conf) {
+        return DEFAULT;
+    }
+
     return ::atoi(conf->arg0().c_str());
 }
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include <vector>
 #include <string.h>
 #define SRS_DEFAULT_CONFIG "conf/srs.conf"
+// The default stack size in bytes of proxy connection coroutine, see proxy_stack_size.
+#define SRS_CONF_DEFAULT_PROXY_STACK_SIZE (64 * 1024)
 class SrsConfig;
 class SrsConfDirective;
 
@@ -235,6 +237,8 @@ public:
     // If  true, SRS will run in daemon mode, fork and fork to reap the
     // grand-child process to init process.
     virtual bool get_daemon();
+    // Get the max connections limit of proxy.
+    virtual int get_max_connections();
 public:
     virtual srs_utime_t get_threads_interval();
     virtual bool get_circuit_breaker();
@@ -244,6 +248,85 @@ public:
     virtual int get_critical_pulse();
     virtual int get_dying_threshold();
     virtual int get_dying_pulse();
+// coroutine section
+public:
+    // Whether fill the coroutine stack with canary, to measure the stack high-water mark.
+    // @remark It commits the whole stack of each coroutine, so it's for tuning only.
+    virtual bool get_coroutine_stack_canary();
+    // Whether protect the page below the coroutine stack, to crash on stack overflow.
+    virtual bool get_coroutine_stack_guard();
+    // The stack size in bytes of proxy connection coroutine, which also relays the tunnel.
+    virtual int get_proxy_stack_size();
+    // The stack size in bytes of API connection coroutine.
+    virtual int get_api_stack_size();
+// policy section
+public:
+    // Whether watch the policy files by inotify, to reload the policy when changed.
+    virtual bool get_policy_inotify();
+    // The max number of domains in verdict cache, 0 to disable it.
+    virtual int get_policy_verdict_cache();
+// url category section
+private:
+    SrsConfDirective* get_url_category();
+public:
+    // Whether categorize the URL by the classifier service.
+    virtual bool get_url_category_enabled();
+    virtual std::string get_url_category_host();
+    virtual int get_url_category_port();
+    // The number of keep-alive connections to classifier.
+    virtual int get_url_category_workers();
+    // The max number of URLs in a request to classifier.
+    virtual int get_url_category_batch();
+    // The max time of proxy request to wait for the category, fail-open if timeout.
+    virtual srs_utime_t get_url_category_timeout();
+    // The time to cache the category of URL.
+    virtual srs_utime_t get_url_category_ttl();
+    // The max number of URLs in cache.
+    virtual int get_url_category_cache();
+    // The compiled model of in-process classifier, empty to use the service.
+    virtual std::string get_url_category_model();
+// http cache section
+private:
+    SrsConfDirective* get_http_cache();
+public:
+    // Whether cache the responses of GET in memory.
+    virtual bool get_http_cache_enabled();
+    // The max bytes of cached bodies.
+    virtual int64_t get_http_cache_memory();
+    // The max bytes of a cached body, the larger ones are relayed only.
+    virtual int64_t get_http_cache_max_object();
+    // The dir of disk tier, empty to disable it.
+    virtual std::string get_http_cache_disk_dir();
+    // The max bytes of disk tier.
+    virtual int64_t get_http_cache_disk_size();
+    // The number of I/O threads of disk tier.
+    virtual int get_http_cache_disk_threads();
+    // The number of workers to revalidate the stale objects in background, 0 to revalidate by request.
+    virtual int get_http_cache_revalidate_workers();
+// http collapse section
+private:
+    SrsConfDirective* get_http_collapse();
+public:
+    // Whether coalesce the concurrent identical GET requests into one upstream request.
+    virtual bool get_http_collapse_enabled();
+    // The max bytes of a response to share with the waiting requests.
+    virtual int64_t get_http_collapse_max_buffer();
+    // The max time to wait for the response of the first request.
+    virtual srs_utime_t get_http_collapse_timeout();
+// memory release section
+private:
+    SrsConfDirective* get_memory_release();
+public:
+    // Whether return the free memory of allocator to OS in background.
+    virtual bool get_memory_release_enabled();
+    // The interval to check the connections and release memory.
+    virtual srs_utime_t get_memory_release_interval();
+    // The max bytes to release each interval, 0 to release all free memory.
+    virtual int64_t get_memory_release_rate();
+    // The max requests per second to take the proxy as idle and release memory.
+    virtual int get_memory_release_idle_requests();
+    // The idle time of keep-alive connection to release its buffers, 0 to disable.
+    virtual srs_utime_t get_memory_release_idle_timeout();
 // http api section
 private:
     // Whether http api enabled
@@ -10,6 +10,7 @@
 #include <srs_protocol_log.hpp>
 #include <srs_app_log.hpp>
 #include <srs_core_auto_free.hpp>
+#include <srs_kernel_utility.hpp>
 
 using std::vector;
 using std::map;
@@ -17,17 +18,87 @@ using std::string;
 
 extern EVP_PKEY *ca_key;
 
+SrsResourceList::SrsResourceList()
+{
+    head_ = tail_ = NULL;
+    size_ = 0;
+}
+
+SrsResourceList::~SrsResourceList()
+{
+}
+
+void SrsResourceList::push_back(ISrsResource* c)
+{
+    SrsResourceNode& node = c->manager_node;
+    srs_assert(!node.list);
+
+    node.list = this;
+    node.prev = tail_;
+    node.next = NULL;
+
+    if (tail_) {
+        tail_->manager_node.next = c;
+    } else {
+        head_ = c;
+    }
+    tail_ = c;
+    size_++;
+}
+
+void SrsResourceList::erase(ISrsResource* c)
+{
+    SrsResourceNode& node = c->manager_node;
+    if (node.list != this) {
+        return;
+    }
+
+    if (node.prev) {
+        node.prev->manager_node.next = node.next;
+    } else {
+        head_ = node.next;
+    }
+    if (node.next) {
+        node.next->manager_node.prev = node.prev;
+    } else {
+        tail_ = node.prev;
+    }
+
+    node.list = NULL;
+    node.prev = node.next = NULL;
+    size_--;
+}
+
+bool SrsResourceList::contains(ISrsResource* c)
+{
+    return c->manager_node.list == this;
+}
+
+ISrsResource* SrsResourceList::front()
+{
+    return head_;
+}
+
+bool SrsResourceList::empty()
+{
+    return !head_;
+}
+
+int SrsResourceList::size()
+{
+    return size_;
+}
+
 SrsResourceManager::SrsResourceManager(const std::string& label, bool verbose)
 {
     verbose_ = verbose;
     label_ = label;
     cond = srs_cond_new();
     trd = NULL;
-    p_disposing_ = NULL;
     removing_ = false;
 
     nn_level0_cache_ = 100000;
-    // conns_level0_cache_ = new SrsResourceFastIdItem[nn_level0_cache_];
+    conns_level0_cache_ = new SrsResourceFastIdItem[nn_level0_cache_];
 }
 
 SrsResourceManager::~SrsResourceManager()
@@ -42,18 +113,95 @@ SrsResourceManager::~SrsResourceManager()
 
     // clear();
 
-    // srs_freepa(conns_level0_cache_);
+    srs_freepa(conns_level0_cache_);
+}
+
+int SrsResourceManager::size()
+{
+    return conns_.size();
 }
 
 void SrsResourceManager::add(ISrsResource* conn, bool* exists)
 {
-    if (std::find(conns_.begin(), conns_.end(), conn) == conns_.end()) {
-        conns_.push_back(conn);
-    } else {
+    // The resource is live, or being removed, never add it again.
+    if (conn->manager_node.list) {
         if (exists) {
             *exists = true;
         }
+        return;
+    }
+
+    conns_.push_back(conn);
+}
+
+void SrsResourceManager::add_with_id(const std::string& id, ISrsResource* conn)
+{
+    add(conn);
+
+    // The resource keeps only one id, so drop the old one, or it points to the freed resource.
+    unindex_id(conn);
+    conns_id_[id] = conn;
+    conn->manager_node.id = id;
+}
+
+void SrsResourceManager::add_with_fast_id(uint64_t id, ISrsResource* conn)
+{
+    add(conn);
+
+    std::unordered_map<uint64_t, ISrsResource*>::iterator it = conns_fast_id_.find(id);
+    if (it != conns_fast_id_.end() && it->second == conn) {
+        return;
     }
+
+    // The resource keeps only one fast id, and the id is taken over from another resource, so drop
+    // both old ones to keep the collisions of level-0 cache right.
+    unindex_fast_id(conn);
+    if (it != conns_fast_id_.end()) {
+        unindex_fast_id(it->second);
+    }
+    conns_fast_id_[id] = conn;
+    conn->manager_node.fast_id = id;
+
+    // Update the level-0 cache for fast-id.
+    SrsResourceFastIdItem* item = &conns_level0_cache_[(id | id>>32) % nn_level0_cache_];
+    item->nn_collisions++;
+    if (!item->available) {
+        item->available = true;
+        item->fast_id = id;
+        item->impl = conn;
+    }
+}
+
+void SrsResourceManager::add_with_name(const std::string& name, ISrsResource* conn)
+{
+    add(conn);
+
+    unindex_name(conn);
+    conns_name_[name] = conn;
+    conn->manager_node.name = name;
+}
+
+ISrsResource* SrsResourceManager::find_by_id(std::string id)
+{
+    std::unordered_map<string, ISrsResource*>::iterator it = conns_id_.find(id);
+    return (it != conns_id_.end())? it->second : NULL;
+}
+
+ISrsResource* SrsResourceManager::find_by_fast_id(uint64_t id)
+{
+    SrsResourceFastIdItem* item = &conns_level0_cache_[(id | id>>32) % nn_level0_cache_];
+    if (item->available && item->fast_id == id) {
+        return item->impl;
+    }
+
+    std::unordered_map<uint64_t, ISrsResource*>::iterator it = conns_fast_id_.find(id);
+    return (it != conns_fast_id_.end())? it->second : NULL;
+}
+
+ISrsResource* SrsResourceManager::find_by_name(std::string name)
+{
+    std::unordered_map<string, ISrsResource*>::iterator it = conns_name_.find(name);
+    return (it != conns_name_.end())? it->second : NULL;
 }
 
 srs_error_t SrsResourceManager::start()
@@ -74,7 +222,7 @@ srs_error_t SrsResourceManager::cycle()
 {
     srs_error_t err = srs_success;
 
-    srs_trace("%s: connection manager run, conns=%d", label_.c_str(), (int)conns_.size());
+    srs_trace("%s: connection manager run, conns=%d", label_.c_str(), conns_.size());
 
     while (true) {
         if ((err = trd->pull()) != srs_success) {
@@ -85,6 +233,11 @@ srs_error_t SrsResourceManager::cycle()
         // when we clear zombie connection.
         while (!zombies_.empty()) {
             clear();
+
+            // Yield to others between batches, for example, to accept new connections.
+            if (!zombies_.empty()) {
+                srs_usleep(0);
+            }
         }
         srs_trace("current connection is %d", conns_.size());
 
@@ -103,7 +256,7 @@ void SrsResourceManager::clear()
     SrsContextRestore(cid_);
     if (verbose_) {
         srs_trace("%s: clear zombies=%d resources, conns=%d, removing=%d, unsubs=%d",
-            label_.c_str(), (int)zombies_.size(), (int)conns_.size(), removing_, (int)unsubs_.size());
+            label_.c_str(), zombies_.size(), conns_.size(), removing_, (int)unsubs_.size());
     }
 
     // Clear all unsubscribing handlers, if not removing any resource.
@@ -117,18 +270,23 @@ void SrsResourceManager::clear()
 void SrsResourceManager::do_clear()
 {
     // To prevent thread switch when delete connection,
-    // we copy all connections then free one by one.
-    vector<ISrsResource*> copy;
-    copy.swap(zombies_);
-    p_disposing_ = &copy;
+    // we move a batch of zombies to disposing then free one by one.
+    vector<ISrsResource*> batch;
+    batch.reserve(srs_min(zombies_.size(), SRS_RESOURCE_FREE_BATCH));
+    while (!zombies_.empty() && (int)batch.size() < SRS_RESOURCE_FREE_BATCH) {
+        ISrsResource* conn = zombies_.front();
+        zombies_.erase(conn);
+        disposing_.push_back(conn);
+        batch.push_back(conn);
+    }
 
-    for (int i = 0; i < (int)copy.size(); i++) {
-        ISrsResource* conn = copy.at(i);
+    for (int i = 0; i < (int)batch.size(); i++) {
+        ISrsResource* conn = batch.at(i);
 
         if (verbose_) {
             _srs_context->set_id(conn->get_id());
             srs_trace("%s: disposing #%d resource(%s)(%p), conns=%d, disposing=%d, zombies=%d", label_.c_str(),
-                i, conn->desc().c_str(), conn, (int)conns_.size(), (int)copy.size(), (int)zombies_.size());
+                i, conn->desc().c_str(), conn, conns_.size(), disposing_.size(), zombies_.size());
         }
 
         // ++_srs_pps_dispose->sugar;
@@ -136,64 +294,29 @@ void SrsResourceManager::do_clear()
         dispose(conn);
     }
 
-    // Reset it for it points to a local object.
-    // @remark We must set the disposing to NULL to avoid reusing address,
-    // because the context might switch.
-    p_disposing_ = NULL;
-
     // We should free the resources when finished all disposing callbacks,
     // which might cause context switch and reuse the freed addresses.
-    for (int i = 0; i < (int)copy.size(); i++) {
-        srs_trace("free conn");
-        ISrsResource* conn = copy.at(i);
+    // @remark We must remove it from disposing before free it, to avoid reusing address.
+    for (int i = 0; i < (int)batch.size(); i++) {
+        ISrsResource* conn = batch.at(i);
+        disposing_.erase(conn);
         srs_freep(conn);
-        
-        // malloc_trim(0);
+    }
+
+    if (verbose_) {
+        srs_trace("%s: free %d resources, conns=%d, zombies=%d", label_.c_str(), (int)batch.size(),
+            conns_.size(), zombies_.size());
     }
 }
 
 void SrsResourceManager::dispose(ISrsResource* c)
 {
-    for (map<string, ISrsResource*>::iterator it = conns_name_.begin(); it != conns_name_.end();) {
-        if (c != it->second) {
-            ++it;
-        } else {
-            // Use C++98 style: https://stackoverflow.com/a/4636230
-            conns_name_.erase(it++);
-        }
-    }
-
-    for (map<string, ISrsResource*>::iterator it = conns_id_.begin(); it != conns_id_.end();) {
-        if (c != it->second) {
-            ++it;
-        } else {
-            // Use C++98 style: https://stackoverflow.com/a/4636230
-            conns_id_.erase(it++);
-        }
-    }
+    // Remove from the index by the keys of resource, never search it.
+    unindex_name(c);
+    unindex_id(c);
+    unindex_fast_id(c);
 
-    // for (map<uint64_t, ISrsResource*>::iterator it = conns_fast_id_.begin(); it != conns_fast_id_.end();) {
-    //     if (c != it->second) {
-    //         ++it;
-    //     } else {
-    //         // Update the level-0 cache for fast-id.
-    //         uint64_t id = it->first;
-    //         SrsResourceFastIdItem* item = &conns_level0_cache_[(id | id>>32) % nn_level0_cache_];
-    //         item->nn_collisions--;
-    //         if (!item->nn_collisions) {
-    //             item->fast_id = 0;
-    //             item->available = false;
-    //         }
-
-    //         // Use C++98 style: https://stackoverflow.com/a/4636230
-    //         conns_fast_id_.erase(it++);
-    //     }
-    // }
-
-    vector<ISrsResource*>::iterator it = std::find(conns_.begin(), conns_.end(), c);
-    if (it != conns_.end()) {
-        conns_.erase(it);
-    }
+    conns_.erase(c);
 
     // We should copy all handlers, because it may change during callback.
     vector<ISrsDisposingHandler*> handlers = handlers_;
@@ -205,7 +328,7 @@ void SrsResourceManager::dispose(ISrsResource* c)
         // Ignore if handler is unsubscribing.
         if (!unsubs_.empty() && std::find(unsubs_.begin(), unsubs_.end(), h) != unsubs_.end()) {
             srs_warn2(TAG_RESOURCE_UNSUB, "%s: ignore disposing resource(%s)(%p) for %p, conns=%d",
-                label_.c_str(), c->desc().c_str(), c, h, (int)conns_.size());
+                label_.c_str(), c->desc().c_str(), c, h, conns_.size());
             continue;
         }
 
@@ -213,6 +336,58 @@ void SrsResourceManager::dispose(ISrsResource* c)
     }
 }
 
+void SrsResourceManager::unindex_id(ISrsResource* c)
+{
+    SrsResourceNode& node = c->manager_node;
+    if (node.id.empty()) {
+        return;
+    }
+
+    std::unordered_map<string, ISrsResource*>::iterator it = conns_id_.find(node.id);
+    if (it != conns_id_.end() && it->second == c) {
+        conns_id_.erase(it);
+    }
+    node.id.clear();
+}
+
+void SrsResourceManager::unindex_fast_id(ISrsResource* c)
+{
+    SrsResourceNode& node = c->manager_node;
+
+    std::unordered_map<uint64_t, ISrsResource*>::iterator it = conns_fast_id_.find(node.fast_id);
+    if (it == conns_fast_id_.end() || it->second != c) {
+        return;
+    }
+
+    // Update the level-0 cache for fast-id.
+    uint64_t id = node.fast_id;
+    SrsResourceFastIdItem* item = &conns_level0_cache_[(id | id>>32) % nn_level0_cache_];
+    item->nn_collisions--;
+    // Drop the cache if it's this resource, the collisions are still in the hash.
+    if (!item->nn_collisions || item->impl == c) {
+        item->fast_id = 0;
+        item->impl = NULL;
+        item->available = false;
+    }
+
+    conns_fast_id_.erase(it);
+    node.fast_id = 0;
+}
+
+void SrsResourceManager::unindex_name(ISrsResource* c)
+{
+    SrsResourceNode& node = c->manager_node;
+    if (node.name.empty()) {
+        return;
+    }
+
+    std::unordered_map<string, ISrsResource*>::iterator it = conns_name_.find(node.name);
+    if (it != conns_name_.end() && it->second == c) {
+        conns_name_.erase(it);
+    }
+    node.name.clear();
+}
+
 void SrsResourceManager::remove(ISrsResource* c)
 {
     SrsContextRestore(_srs_context->get_id());
@@ -233,7 +408,7 @@ void SrsResourceManager::do_remove(ISrsResource* c)
     if (verbose_) {
         _srs_context->set_id(c->get_id());
         srs_trace("%s: before dispose resource(%s)(%p), conns=%d, zombies=%d, ign=%d, inz=%d, ind=%d",
-            label_.c_str(), c->desc().c_str(), c, (int)conns_.size(), (int)zombies_.size(), ignored,
+            label_.c_str(), c->desc().c_str(), c, conns_.size(), zombies_.size(), ignored,
             in_zombie, in_disposing);
     }
     if (ignored) {
@@ -241,6 +416,8 @@ void SrsResourceManager::do_remove(ISrsResource* c)
     }
 
     // Push to zombies, we will free it in another coroutine.
+    // @remark It's still in the index until disposed, so it's able to be found.
+    conns_.erase(c);
     zombies_.push_back(c);
 
     // We should copy all handlers, because it may change during callback.
@@ -253,7 +430,7 @@ void SrsResourceManager::do_remove(ISrsResource* c)
         // Ignore if handler is unsubscribing.
         if (!unsubs_.empty() && std::find(unsubs_.begin(), unsubs_.end(), h) != unsubs_.end()) {
             srs_warn2(TAG_RESOURCE_UNSUB, "%s: ignore before-dispose resource(%s)(%p) for %p, conns=%d",
-                label_.c_str(), c->desc().c_str(), c, h, (int)conns_.size());
+                label_.c_str(), c->desc().c_str(), c, h, conns_.size());
             continue;
         }
 
@@ -267,18 +444,10 @@ void SrsResourceManager::do_remove(ISrsResource* c)
 void SrsResourceManager::check_remove(ISrsResource* c, bool& in_zombie, bool& in_disposing)
 {
     // Only notify when not removed(in zombies_).
-    vector<ISrsResource*>::iterator it = std::find(zombies_.begin(), zombies_.end(), c);
-    if (it != zombies_.end()) {
-        in_zombie = true;
-    }
+    in_zombie = zombies_.contains(c);
 
     // Also ignore when we are disposing it.
-    if (p_disposing_) {
-        it = std::find(p_disposing_->begin(), p_disposing_->end(), c);
-        if (it != p_disposing_->end()) {
-            in_disposing = true;
-        }
-    }
+    in_disposing = disposing_.contains(c);
 }
 
 SrsTcpConnection::SrsTcpConnection(srs_netfd_t c)
@@ -359,6 +528,11 @@ srs_error_t SrsTcpConnection::read(void* buf, size_t size, ssize_t* nread)
     return skt->read(buf, size, nread);
 }
 
+srs_error_t SrsTcpConnection::readv(const iovec *iov, int iov_size, ssize_t* nread)
+{
+    return skt->readv(iov, iov_size, nread);
+}
+
 srs_error_t SrsTcpConnection::peek(void* buf, size_t size, ssize_t* nread)
 {
     return skt->peek(buf, size, nread);
@@ -450,8 +624,10 @@ srs_error_t SrsSslConnection::handshake(string key_file, string crt_file)
     SSL_set_bio(ssl, bio_in, bio_out);
 
     // SSL setup active, as server role.
+    // The read and write buffers are freed once empty, so the idle keep-alive connection holds no buffer.
+    // The SSL_free_buffers is never used, for it's unsafe in OpenSSL 1.1.1l, see CVE-2024-4741.
     SSL_set_accept_state(ssl);
-    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE);
+    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_RELEASE_BUFFERS);
 
     uint8_t* data = NULL;
     int r0, r1, size;
@@ -606,8 +782,9 @@ srs_error_t SrsSslConnection::handshake(X509* cert, EVP_PKEY* key)
     SSL_set_bio(ssl, bio_in, bio_out);
 
     // SSL setup active, as server role.
+    // The read and write buffers are freed once empty, see handshake(key_file, crt_file).
     SSL_set_accept_state(ssl);
-    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE);
+    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_RELEASE_BUFFERS);
 
     uint8_t* data = NULL;
     int r1, size;
@@ -705,6 +882,11 @@ srs_error_t SrsSslConnection::handshake(X509* cert, EVP_PKEY* key)
     return err;
 }
 
+bool SrsSslConnection::pending()
+{
+    return ssl && (SSL_pending(ssl) > 0 || BIO_ctrl_pending(bio_in) > 0);
+}
+
 void SrsSslConnection::set_recv_timeout(srs_utime_t tm)
 {
     transport->set_recv_timeout(tm);
@@ -902,8 +1084,9 @@ srs_error_t SrsSslClient::handshake()
     SSL_set_bio(ssl, bio_in, bio_out);
 
     // SSL setup active, as client role.
+    // The read and write buffers are freed once empty, see SrsSslConnection::handshake(key_file, crt_file).
     SSL_set_connect_state(ssl);
-    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE);
+    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_RELEASE_BUFFERS);
 
     // Send ClientHello.
     int r0 = SSL_do_handshake(ssl); int r1 = SSL_get_error(ssl, r0);
@@ -1072,17 +1255,17 @@ srs_error_t SrsSslClient::prepare_resign_endpoint(X509 *fake_x509, EVP_PKEY* ser
 	X509 *server_x509 = SSL_get_peer_certificate(ssl);
 	if(server_x509 != nullptr)
 	{
+		// Let OpenSSL allocate the names on heap, to keep the coroutine stack small.
 		X509_NAME * issuer = X509_get_issuer_name(server_x509);
-		char issuer_name[2048] = { 0 };
-		X509_NAME_oneline(issuer, issuer_name, sizeof(issuer_name) - 1);
-		issuer_name[sizeof(issuer_name) - 1] = 0;
+		char* issuer_name = X509_NAME_oneline(issuer, NULL, 0);
 
 		X509_NAME * subject = X509_get_subject_name(server_x509);
-		char subject_name[2048] = { 0 };
-				X509_NAME_oneline(subject, subject_name, sizeof(subject_name) - 1);
-				subject_name[sizeof(subject_name) - 1] = 0;
-		srs_trace("server certificate subject: %s ",subject_name);
-		srs_trace("server certificate issuer : %s",issuer_name);
+		char* subject_name = X509_NAME_oneline(subject, NULL, 0);
+		srs_trace("server certificate subject: %s ", subject_name ? subject_name : "");
+		srs_trace("server certificate issuer : %s", issuer_name ? issuer_name : "");
+
+		OPENSSL_free(subject_name);
+		OPENSSL_free(issuer_name);
 
 	}
 	else
@@ -1176,4 +1359,5 @@ RSA* SrsSslClient::get_new_cert_rsa(int key_length)
 srs_error_t SrsSslClient::set_SNI(std::string sni)
 {
     sni_ = sni;
+    return srs_success;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <map>
 #include <vector>
+#include <unordered_map>
 #include <openssl/ssl.h>
 #include <srs_core.hpp>
 #include <srs_protocol_st.hpp>
@@ -26,7 +27,52 @@ public:
     virtual void on_disposing(ISrsResource* c) = 0;
 };
 
+// The intrusive doubly-linked list of resources, by the SrsResourceNode of resource.
+// @remark The resource is in one list at most, so it's O(1) to add, remove and check.
+class SrsResourceList
+{
+private:
+    ISrsResource* head_;
+    ISrsResource* tail_;
+    int size_;
+public:
+    SrsResourceList();
+    virtual ~SrsResourceList();
+public:
+    void push_back(ISrsResource* c);
+    void erase(ISrsResource* c);
+    // Whether the resource is in this list.
+    bool contains(ISrsResource* c);
+    ISrsResource* front();
+    bool empty();
+    int size();
+};
+
+// The item of level-0 cache for fast id, a direct-mapped cache before the hash.
+class SrsResourceFastIdItem
+{
+public:
+    // If available, use the resource in item.
+    bool available;
+    // The fast id and the resource of it.
+    uint64_t fast_id;
+    ISrsResource* impl;
+    // The number of resources which are mapped to this item.
+    int nn_collisions;
+public:
+    SrsResourceFastIdItem() {
+        available = false;
+        fast_id = 0;
+        impl = NULL;
+        nn_collisions = 0;
+    }
+};
+
+// The max number of resources to free in a batch, then yield to others.
+#define SRS_RESOURCE_FREE_BATCH 128
+
 // The resource manager remove resource and delete it asynchronously.
+// @remark All operations are O(1), by the intrusive lists and the hash index.
 class SrsResourceManager : public ISrsCoroutineHandler, public ISrsResourceManager
 {
 private:
@@ -42,37 +88,50 @@ private:
     std::vector<ISrsDisposingHandler*> unsubs_;
     // Whether we are removing resources.
     bool removing_;
-    // // The zombie connections, we will delete it asynchronously.
-    std::vector<ISrsResource*> zombies_;
-    std::vector<ISrsResource*>* p_disposing_;
+    // The zombie connections, we will delete it asynchronously.
+    SrsResourceList zombies_;
+    // The connections which are being disposed, in current batch.
+    SrsResourceList disposing_;
 private:
-    // The connections without any id.
-    std::vector<ISrsResource*> conns_;
+    // The live connections, with or without any id.
+    SrsResourceList conns_;
     // The connections with resource id.
-    std::map<std::string, ISrsResource*> conns_id_;
+    std::unordered_map<std::string, ISrsResource*> conns_id_;
     // The connections with resource fast(int) id.
-    std::map<uint64_t, ISrsResource*> conns_fast_id_;
+    std::unordered_map<uint64_t, ISrsResource*> conns_fast_id_;
     // The level-0 fast cache for fast id.
     int nn_level0_cache_;
-    // SrsResourceFastIdItem* conns_level0_cache_;
+    SrsResourceFastIdItem* conns_level0_cache_;
     // The connections with resource name.
-    std::map<std::string, ISrsResource*> conns_name_;
+    std::unordered_map<std::string, ISrsResource*> conns_name_;
 public:
     SrsResourceManager(const std::string& label, bool verbose = false);
     virtual ~SrsResourceManager(); 
 public:
     srs_error_t start();
+    // The number of live connections.
+    int size();
 // Interface ISrsCoroutineHandler
 public:
     virtual srs_error_t cycle();    
 public:
     void add(ISrsResource* conn, bool* exists = NULL);
+    void add_with_id(const std::string& id, ISrsResource* conn);
+    void add_with_fast_id(uint64_t id, ISrsResource* conn);
+    void add_with_name(const std::string& name, ISrsResource* conn);
+    ISrsResource* find_by_id(std::string id);
+    ISrsResource* find_by_fast_id(uint64_t id);
+    ISrsResource* find_by_name(std::string name);
 // Interface ISrsResourceManager
 public:
     virtual void remove(ISrsResource* c);
 private:
     void do_remove(ISrsResource* c);
     void check_remove(ISrsResource* c, bool& in_zombie, bool& in_disposing);
+    // Remove the resource from the index by its key, ignore if the key is indexed to another one.
+    void unindex_id(ISrsResource* c);
+    void unindex_fast_id(ISrsResource* c);
+    void unindex_name(ISrsResource* c);
     void clear();
     void do_clear();
     void dispose(ISrsResource* c);
@@ -94,7 +153,7 @@ public:
 // The basic connection of SRS, for TCP based protocols,
 // all connections accept from listener must extends from this base class,
 // server will add the connection to manager, and delete it when remove.
-class SrsTcpConnection : public ISrsProtocolReadWriter
+class SrsTcpConnection : public ISrsProtocolReadWriter, public ISrsVectorReader
 {
 private:
     // The underlayer st fd handler.
@@ -118,6 +177,7 @@ public:
     virtual int64_t get_recv_bytes();
     virtual int64_t get_send_bytes();
     virtual srs_error_t read(void* buf, size_t size, ssize_t* nread);
+    virtual srs_error_t readv(const iovec *iov, int iov_size, ssize_t* nread);
     virtual void set_send_timeout(srs_utime_t tm);
     virtual srs_utime_t get_send_timeout();
     virtual srs_error_t write(void* buf, size_t size, ssize_t* nwrite);
@@ -142,6 +202,8 @@ public:
 public:
     virtual srs_error_t handshake(std::string key_file, std::string crt_file);
     virtual srs_error_t handshake(X509* cert, EVP_PKEY* key);
+    // Whether there is data received but not read, for example, the pipelined request.
+    virtual bool pending();
 // Interface ISrsProtocolReadWriter
 public:
     virtual void set_recv_timeout(srs_utime_t tm);
@@ -0,0 +1,402 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_disk_cache.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_app_async_io.hpp>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+#define SRS_DISK_CACHE_MAGIC "SRSDC01"
+#define SRS_DISK_CACHE_RECORD_MAGIC 0x53524443
+// The average bytes of object, to calculate the number of entries in index.
+#define SRS_DISK_CACHE_AVG_OBJECT (16 * 1024)
+// The max reads and writes in I/O threads, the write is dropped if full.
+#define SRS_DISK_CACHE_MAX_PENDING 1024
+
+// The index is [header][buckets], each bucket is SRS_DISK_CACHE_WAYS entries, all in host byte order.
+struct SrsDiskCacheHeader
+{
+    char magic[8];
+    uint32_t nn_buckets;
+    uint32_t reserved;
+    uint64_t capacity;
+    // The log offset of next record, which increases forever, the position in file is offset % capacity.
+    uint64_t head;
+    uint64_t reserved2[4];
+};
+
+struct SrsDiskCacheEntry
+{
+    // The hash of key, 0 is empty.
+    uint64_t hash;
+    // The log offset of record.
+    uint64_t offset;
+    uint32_t size;
+    // The seconds since epoch when the data is expired.
+    uint32_t expires;
+};
+
+// The record in data file is [record][key][data], the offset is checked when read, to detect the overwritten one.
+struct SrsDiskCacheRecord
+{
+    uint32_t magic;
+    uint32_t key_size;
+    uint64_t offset;
+    uint64_t hash;
+    uint32_t data_size;
+    uint32_t reserved;
+};
+
+// The FNV-1a hash of key, which is stable, because the index is persistent.
+static uint64_t srs_disk_cache_hash(const string& key)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < (int)key.length(); i++) {
+        hash ^= (uint8_t)key.at(i);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash ? hash : 1;
+}
+
+class SrsDiskCacheWriteTask : public SrsAsyncFileTask
+{
+public:
+    SrsDiskCache* cache;
+    std::string data;
+    uint64_t hash;
+    uint64_t log_offset;
+    uint32_t expires;
+public:
+    SrsDiskCacheWriteTask(SrsDiskCache* c) {
+        cache = c;
+        hash = 0;
+        log_offset = 0;
+        expires = 0;
+    }
+    virtual ~SrsDiskCacheWriteTask() {
+    }
+public:
+    virtual void on_done() {
+        cache->on_written(this);
+    }
+};
+
+SrsDiskCache::SrsDiskCache()
+{
+    aio_ = NULL;
+    fd_ = -1;
+    capacity_ = 0;
+    index_ = NULL;
+    index_size_ = 0;
+    header_ = NULL;
+    entries_ = NULL;
+    nn_buckets_ = 0;
+
+    nn_hits_ = 0;
+    nn_misses_ = 0;
+    nn_reads_ = 0;
+    nn_writes_ = 0;
+    nn_drops_ = 0;
+    nn_errors_ = 0;
+    nn_bytes_read_ = 0;
+    nn_bytes_written_ = 0;
+    read_elapsed_ = 0;
+    read_max_ = 0;
+    write_elapsed_ = 0;
+    write_max_ = 0;
+}
+
+SrsDiskCache::~SrsDiskCache()
+{
+    // Stop the I/O threads before closing the files.
+    srs_freep(aio_);
+
+    if (index_) {
+        ::munmap(index_, index_size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+srs_error_t SrsDiskCache::initialize(string dir, int64_t capacity, int nn_threads)
+{
+    srs_error_t err = srs_success;
+
+    dir_ = dir;
+    capacity_ = (uint64_t)capacity;
+    if (::mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "mkdir %s", dir.c_str());
+    }
+
+    // The data file is sparse, so it's fast to create a huge one.
+    string data_path = dir + "/cache.data";
+    if ((fd_ = ::open(data_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0) {
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "open %s", data_path.c_str());
+    }
+
+    struct stat st;
+    bool reset = ::fstat(fd_, &st) < 0 || (uint64_t)st.st_size != capacity_;
+    if (reset && ::ftruncate(fd_, (off_t)capacity_) < 0) {
+        return srs_error_new(ERROR_SYSTEM_FILE_WRITE, "truncate %s to %" PRId64, data_path.c_str(), capacity);
+    }
+
+    nn_buckets_ = 1024;
+    while ((uint64_t)nn_buckets_ * SRS_DISK_CACHE_WAYS < capacity_ / SRS_DISK_CACHE_AVG_OBJECT) {
+        nn_buckets_ <<= 1;
+    }
+    index_size_ = sizeof(SrsDiskCacheHeader) + (size_t)nn_buckets_ * SRS_DISK_CACHE_WAYS * sizeof(SrsDiskCacheEntry);
+
+    string index_path = dir + "/cache.index";
+    int fd = ::open(index_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "open %s", index_path.c_str());
+    }
+
+    reset = reset || ::fstat(fd, &st) < 0 || (size_t)st.st_size != index_size_;
+    if (reset && (::ftruncate(fd, 0) < 0 || ::ftruncate(fd, (off_t)index_size_) < 0)) {
+        ::close(fd);
+        return srs_error_new(ERROR_SYSTEM_FILE_WRITE, "truncate %s to %d", index_path.c_str(), (int)index_size_);
+    }
+
+    void* data = ::mmap(NULL, index_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return srs_error_new(ERROR_SYSTEM_FILE_MMAP, "mmap %s, size=%d", index_path.c_str(), (int)index_size_);
+    }
+    index_ = (char*)data;
+    header_ = (SrsDiskCacheHeader*)index_;
+    entries_ = (SrsDiskCacheEntry*)(index_ + sizeof(SrsDiskCacheHeader));
+
+    if (reset || memcmp(header_->magic, SRS_DISK_CACHE_MAGIC, sizeof(header_->magic)) != 0
+        || header_->capacity != capacity_ || header_->nn_buckets != nn_buckets_) {
+        memset(index_, 0, index_size_);
+        memcpy(header_->magic, SRS_DISK_CACHE_MAGIC, sizeof(header_->magic));
+        header_->capacity = capacity_;
+        header_->nn_buckets = nn_buckets_;
+        reset = true;
+    }
+
+    aio_ = new SrsAsyncFileIo();
+    if ((err = aio_->initialize(nn_threads, SRS_DISK_CACHE_MAX_PENDING)) != srs_success) {
+        return srs_error_wrap(err, "aio");
+    }
+
+    srs_trace("disk cache dir=%s, capacity=%dMB, buckets=%u, index=%dKB, head=%" PRId64 ", reset=%d", dir.c_str(),
+        (int)(capacity_ / 1024 / 1024), nn_buckets_, (int)(index_size_ / 1024), header_->head, reset);
+
+    return err;
+}
+
+srs_error_t SrsDiskCache::read(const string& key, uint32_t now, string& data)
+{
+    srs_error_t err = srs_success;
+
+    data.clear();
+    uint64_t hash = srs_disk_cache_hash(key);
+    SrsDiskCacheEntry* entry = find(hash);
+    if (!entry || entry->expires <= now || aio_->full()) {
+        nn_misses_++;
+        return err;
+    }
+
+    // Copy the entry, which may be replaced when reading.
+    uint64_t offset = entry->offset;
+    uint32_t size = entry->size;
+
+    string record;
+    record.resize(size);
+
+    SrsAsyncFileTask task;
+    task.fd = fd_;
+    task.offset = (off_t)(offset % capacity_);
+    task.buf = (char*)record.data();
+    task.size = size;
+    if ((err = aio_->execute(&task)) != srs_success) {
+        nn_misses_++;
+        return srs_error_wrap(err, "read");
+    }
+
+    nn_reads_++;
+    read_elapsed_ += task.elapsed;
+    read_max_ = srs_max(read_max_, task.elapsed);
+
+    if (!task.success()) {
+        nn_errors_++;
+        nn_misses_++;
+        return srs_error_new(ERROR_SYSTEM_FILE_READ, "read %s offset=%" PRId64 ", size=%u, errno=%d", key.c_str(),
+            (int64_t)task.offset, size, task.error);
+    }
+
+    // The record may be overwritten by the writes when reading.
+    SrsDiskCacheRecord r;
+    memcpy(&r, record.data(), srs_min(sizeof(r), (size_t)size));
+    if (!valid(offset) || size < sizeof(r) || r.magic != SRS_DISK_CACHE_RECORD_MAGIC || r.offset != offset || r.hash != hash
+        || sizeof(r) + r.key_size + r.data_size != size || record.compare(sizeof(r), r.key_size, key) != 0) {
+        nn_misses_++;
+        return err;
+    }
+
+    data.assign(record, sizeof(r) + r.key_size, r.data_size);
+    nn_hits_++;
+    nn_bytes_read_ += size;
+
+    return err;
+}
+
+void SrsDiskCache::write(const string& key, uint32_t expires, const string& data)
+{
+    srs_error_t err = srs_success;
+
+    // Never write the huge record, which overwrites too many records.
+    size_t size = sizeof(SrsDiskCacheRecord) + key.length() + data.length();
+    if (!aio_ || aio_->full() || size > capacity_ / 4) {
+        nn_drops_++;
+        return;
+    }
+
+    // The record is never split, so skip the tail of file.
+    uint64_t offset = header_->head;
+    if (offset % capacity_ + size > capacity_) {
+        offset += capacity_ - offset % capacity_;
+    }
+
+    SrsDiskCacheWriteTask* task = new SrsDiskCacheWriteTask(this);
+    task->hash = srs_disk_cache_hash(key);
+    task->log_offset = offset;
+    task->expires = expires;
+
+    SrsDiskCacheRecord r;
+    memset(&r, 0, sizeof(r));
+    r.magic = SRS_DISK_CACHE_RECORD_MAGIC;
+    r.key_size = (uint32_t)key.length();
+    r.offset = offset;
+    r.hash = task->hash;
+    r.data_size = (uint32_t)data.length();
+
+    task->data.reserve(size);
+    task->data.append((char*)&r, sizeof(r));
+    task->data.append(key);
+    task->data.append(data);
+
+    task->fd = fd_;
+    task->write = true;
+    task->offset = (off_t)(offset % capacity_);
+    task->buf = (char*)task->data.data();
+    task->size = size;
+
+    // Reserve the space before written, so the overwritten records are invalid when reading.
+    header_->head = offset + size;
+
+    if ((err = aio_->post(task)) != srs_success) {
+        srs_freep(err);
+        srs_freep(task);
+        nn_drops_++;
+    }
+}
+
+int SrsDiskCache::pending()
+{
+    return aio_ ? aio_->pending() : 0;
+}
+
+void SrsDiskCache::dumps(SrsJsonObject* obj)
+{
+    uint64_t nn_lookups = nn_hits_ + nn_misses_;
+
+    obj->set("dir", SrsJsonAny::str(dir_.c_str()));
+    obj->set("capacity", SrsJsonAny::integer(capacity_));
+    obj->set("head", SrsJsonAny::integer(header_ ? header_->head : 0));
+    obj->set("buckets", SrsJsonAny::integer(nn_buckets_));
+    obj->set("hits", SrsJsonAny::integer(nn_hits_));
+    obj->set("misses", SrsJsonAny::integer(nn_misses_));
+    obj->set("hit_ratio", SrsJsonAny::number(nn_lookups ? nn_hits_ * 100.0 / nn_lookups : 0));
+    obj->set("reads", SrsJsonAny::integer(nn_reads_));
+    obj->set("writes", SrsJsonAny::integer(nn_writes_));
+    obj->set("drops", SrsJsonAny::integer(nn_drops_));
+    obj->set("errors", SrsJsonAny::integer(nn_errors_));
+    obj->set("bytes_read", SrsJsonAny::integer(nn_bytes_read_));
+    obj->set("bytes_written", SrsJsonAny::integer(nn_bytes_written_));
+    obj->set("read_avg_us", SrsJsonAny::integer(nn_reads_ ? read_elapsed_ / nn_reads_ : 0));
+    obj->set("read_max_us", SrsJsonAny::integer(read_max_));
+    obj->set("write_avg_us", SrsJsonAny::integer(nn_writes_ ? write_elapsed_ / nn_writes_ : 0));
+    obj->set("write_max_us", SrsJsonAny::integer(write_max_));
+    obj->set("pending", SrsJsonAny::integer(pending()));
+}
+
+SrsDiskCacheEntry* SrsDiskCache::find(uint64_t hash)
+{
+    if (!entries_) {
+        return NULL;
+    }
+
+    SrsDiskCacheEntry* bucket = entries_ + (size_t)(hash & (nn_buckets_ - 1)) * SRS_DISK_CACHE_WAYS;
+    for (int i = 0; i < SRS_DISK_CACHE_WAYS; i++) {
+        SrsDiskCacheEntry* entry = bucket + i;
+        if (entry->hash == hash && valid(entry->offset)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool SrsDiskCache::valid(uint64_t offset)
+{
+    return offset + capacity_ >= header_->head;
+}
+
+void SrsDiskCache::on_written(SrsDiskCacheWriteTask* task)
+{
+    write_elapsed_ += task->elapsed;
+    write_max_ = srs_max(write_max_, task->elapsed);
+
+    if (!task->success()) {
+        nn_errors_++;
+        srs_warn("disk cache write offset=%" PRId64 ", size=%d failed, errno=%d", (int64_t)task->offset, (int)task->size, task->error);
+        return;
+    }
+
+    nn_writes_++;
+    nn_bytes_written_ += task->size;
+
+    // Overwritten by the later writes, for the disk is too slow.
+    if (!valid(task->log_offset)) {
+        return;
+    }
+
+    // Use the entry of same key, or the empty or overwritten one, or replace the oldest one.
+    SrsDiskCacheEntry* bucket = entries_ + (size_t)(task->hash & (nn_buckets_ - 1)) * SRS_DISK_CACHE_WAYS;
+    SrsDiskCacheEntry* victim = NULL;
+    for (int i = 0; i < SRS_DISK_CACHE_WAYS; i++) {
+        SrsDiskCacheEntry* entry = bucket + i;
+        if (entry->hash == task->hash) {
+            // The newer record of key is written by another thread.
+            if (entry->offset > task->log_offset && valid(entry->offset)) {
+                return;
+            }
+            victim = entry;
+            break;
+        }
+        if (!victim || (victim->hash && valid(victim->offset) && (!entry->hash || !valid(entry->offset) || entry->offset < victim->offset))) {
+            victim = entry;
+        }
+    }
+
+    victim->hash = task->hash;
+    victim->offset = task->log_offset;
+    victim->size = (uint32_t)task->size;
+    victim->expires = task->expires;
+}
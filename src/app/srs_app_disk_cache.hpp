@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_DISK_CACHE_HPP
+#define SRS_APP_DISK_CACHE_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+
+class SrsJsonObject;
+class SrsAsyncFileIo;
+class SrsDiskCacheWriteTask;
+struct SrsDiskCacheHeader;
+struct SrsDiskCacheEntry;
+
+// The entries of a bucket in index, the oldest entry is replaced when bucket is full.
+#define SRS_DISK_CACHE_WAYS 8
+
+// The disk tier of cache, which is a fixed-size data file written as a log, and a mapped index.
+// The records are appended at the head of log, which wraps to the start of file, and overwrites the oldest
+// records, so there is no allocation or fragmentation, the eviction is FIFO. The index is a set-associative
+// hash table of key hash to the log offset of record, the record is valid if it's not overwritten by head.
+// All files are accessed by the I/O threads, only the index is touched by the ST thread.
+// @remark The index is mapped shared, so the cache survives restart, the records are verified when read.
+class SrsDiskCache
+{
+    friend class SrsDiskCacheWriteTask;
+private:
+    std::string dir_;
+    SrsAsyncFileIo* aio_;
+    int fd_;
+    uint64_t capacity_;
+    // The mapped index, which is [header][buckets].
+    char* index_;
+    size_t index_size_;
+    SrsDiskCacheHeader* header_;
+    SrsDiskCacheEntry* entries_;
+    uint32_t nn_buckets_;
+private:
+    uint64_t nn_hits_;
+    uint64_t nn_misses_;
+    uint64_t nn_reads_;
+    uint64_t nn_writes_;
+    uint64_t nn_drops_;
+    uint64_t nn_errors_;
+    uint64_t nn_bytes_read_;
+    uint64_t nn_bytes_written_;
+    srs_utime_t read_elapsed_;
+    srs_utime_t read_max_;
+    srs_utime_t write_elapsed_;
+    srs_utime_t write_max_;
+public:
+    SrsDiskCache();
+    virtual ~SrsDiskCache();
+public:
+    // Open or create the files in dir, the index is reset if the capacity changed.
+    // @param capacity The bytes of data file.
+    // @param nn_threads The number of I/O threads.
+    virtual srs_error_t initialize(std::string dir, int64_t capacity, int nn_threads);
+    // Read the data of key, which is empty if miss or expired at now.
+    // @remark The coroutine waits for the I/O thread.
+    virtual srs_error_t read(const std::string& key, uint32_t now, std::string& data);
+    // Write the data of key in background, which is expired at expires, drop it if too many pending writes.
+    virtual void write(const std::string& key, uint32_t expires, const std::string& data);
+    // The number of reads and writes in progress.
+    virtual int pending();
+    virtual void dumps(SrsJsonObject* obj);
+private:
+    // Find the entry of hash, NULL if not found or overwritten.
+    virtual SrsDiskCacheEntry* find(uint64_t hash);
+    virtual bool valid(uint64_t offset);
+    // Update the index when the record is written.
+    virtual void on_written(SrsDiskCacheWriteTask* task);
+};
+
+#endif
@@ -0,0 +1,414 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_domain_matcher.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_core_platform.hpp>
+#include <srs_app_bloom_filter.hpp>
+
+#include <string.h>
+using namespace std;
+
+// The initial capacity of hash table, must be power of 2.
+#define SRS_DOMAIN_MATCHER_CAPACITY 1024
+// The max length of domain, see RFC1035.
+#define SRS_DOMAIN_MAX_LENGTH 253
+// Build the bloom filter when the table is larger than cache, and the bits per rule is about 0.5% false positive.
+#define SRS_DOMAIN_BLOOM_MIN_RULES 65536
+#define SRS_DOMAIN_BLOOM_BITS 12
+
+// The header of encoded rules, followed by the slots, the pool, the substrings separated by NUL, and the bloom filter.
+struct SrsDomainMatcherHeader
+{
+    uint32_t nn_rules;
+    uint32_t capacity;
+    uint32_t pool_size;
+    uint32_t substrings_size;
+};
+
+// The FNV-1a hash, fed from the end of domain in lowercase, so the suffix hash is the prefix state.
+#define SRS_DOMAIN_HASH_INIT 2166136261u
+#define SRS_DOMAIN_HASH_PRIME 16777619u
+
+static inline char srs_domain_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (c + 'a' - 'A') : c;
+}
+
+static inline uint32_t srs_domain_hash_update(uint32_t h, char c)
+{
+    return (h ^ (uint8_t)srs_domain_lower(c)) * SRS_DOMAIN_HASH_PRIME;
+}
+
+// Mix the bits by the finalizer of murmur3, because the low bits are the index of slot.
+// @remark Never use 0 as hash, which means the slot is empty.
+static inline uint32_t srs_domain_hash_final(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h ? h : 1;
+}
+
+int srs_domain_rule_parse(string rule, string& domain)
+{
+    int type = SrsDomainRuleSuffix;
+
+    rule = srs_string_trim_start(srs_string_trim_end(rule, " \t\r\n"), " \t\r\n");
+    if (srs_string_starts_with(rule, "=")) {
+        type = SrsDomainRuleExact;
+        rule = rule.substr(1);
+    } else if (srs_string_starts_with(rule, "*.")) {
+        type = SrsDomainRuleSubdomain;
+        rule = rule.substr(2);
+    } else if (srs_string_starts_with(rule, "~")) {
+        type = SrsDomainRuleSubstring;
+        rule = rule.substr(1);
+    } else if (srs_string_starts_with(rule, ".")) {
+        // The ".example.com" is the same to "example.com", for compatibility with other proxies.
+        rule = rule.substr(1);
+    }
+
+    if (type != SrsDomainRuleSubstring && srs_string_ends_with(rule, ".")) {
+        rule = rule.substr(0, rule.length() - 1);
+    }
+
+    if (rule.empty() || rule.length() > SRS_DOMAIN_MAX_LENGTH) {
+        return 0;
+    }
+
+    domain = srs_string_to_lower(rule);
+    return type;
+}
+
+SrsDomainMatcher::SrsDomainMatcher()
+{
+    slots_ = NULL;
+    mask_ = 0;
+    nn_rules_ = 0;
+    mapped_ = false;
+    bloom_ = new SrsBloomFilter();
+
+    // The offset 0 means empty slot, so never use it.
+    buffer_.push_back(0);
+    pool_ = buffer_.data();
+    pool_size_ = (uint32_t)buffer_.size();
+    rehash(SRS_DOMAIN_MATCHER_CAPACITY);
+}
+
+SrsDomainMatcher::~SrsDomainMatcher()
+{
+    if (!mapped_) {
+        srs_freepa(slots_);
+    }
+    srs_freep(bloom_);
+}
+
+srs_error_t SrsDomainMatcher::add(string rule)
+{
+    string domain;
+    int type = srs_domain_rule_parse(rule, domain);
+    if (!type) {
+        return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "invalid domain rule %s", rule.c_str());
+    }
+
+    add(domain, type);
+    return srs_success;
+}
+
+void SrsDomainMatcher::add(string domain, int type)
+{
+    srs_assert(!mapped_);
+
+    if (type == SrsDomainRuleSubstring) {
+        substrings_.push_back(domain);
+        nn_rules_++;
+        return;
+    }
+
+    uint32_t h = SRS_DOMAIN_HASH_INIT;
+    for (int i = (int)domain.length() - 1; i >= 0; i--) {
+        h = srs_domain_hash_update(h, domain.at(i));
+    }
+    h = srs_domain_hash_final(h);
+
+    // Merge the type, for example, "=example.com" and "*.example.com" is "example.com".
+    SrsDomainSlot* slot = find(h, domain.data(), (int)domain.length());
+    if (slot->offset) {
+        buffer_[slot->offset] |= (char)type;
+        return;
+    }
+
+    // Keep the load factor under 0.7, for the linear probing.
+    if ((uint64_t)(nn_rules_ + 1) * 10 > (uint64_t)(mask_ + 1) * 7) {
+        rehash((mask_ + 1) * 2);
+        slot = find(h, domain.data(), (int)domain.length());
+    }
+
+    slot->hash = h;
+    slot->offset = (uint32_t)buffer_.size();
+    buffer_.push_back((char)type);
+    buffer_.push_back((char)domain.length());
+    buffer_.insert(buffer_.end(), domain.begin(), domain.end());
+    pool_ = buffer_.data();
+    pool_size_ = (uint32_t)buffer_.size();
+    nn_rules_++;
+
+    if (!bloom_->empty()) {
+        bloom_->add(h);
+    }
+}
+
+void SrsDomainMatcher::compile()
+{
+    srs_assert(!mapped_);
+
+    int nn_domains = nn_rules_ - (int)substrings_.size();
+    if (nn_domains < SRS_DOMAIN_BLOOM_MIN_RULES) {
+        return;
+    }
+
+    bloom_->initialize(nn_domains, SRS_DOMAIN_BLOOM_BITS);
+    for (uint32_t i = 0; i <= mask_; i++) {
+        if (slots_[i].offset) {
+            bloom_->add(slots_[i].hash);
+        }
+    }
+}
+
+// Pad the data to 8 bytes.
+static void srs_domain_matcher_align(string& data)
+{
+    data.append((8 - data.size() % 8) % 8, '\0');
+}
+
+void SrsDomainMatcher::encode(string& data)
+{
+    string substrings;
+    for (int i = 0; i < (int)substrings_.size(); i++) {
+        substrings.append(substrings_[i]);
+        substrings.push_back('\0');
+    }
+
+    SrsDomainMatcherHeader header;
+    header.nn_rules = (uint32_t)nn_rules_;
+    header.capacity = mask_ + 1;
+    header.pool_size = pool_size_;
+    header.substrings_size = (uint32_t)substrings.size();
+
+    data.append((const char*)&header, sizeof(header));
+    data.append((const char*)slots_, sizeof(SrsDomainSlot) * (mask_ + 1));
+    data.append(pool_, pool_size_);
+    srs_domain_matcher_align(data);
+    data.append(substrings);
+    srs_domain_matcher_align(data);
+    bloom_->encode(data);
+}
+
+srs_error_t SrsDomainMatcher::decode(const char* data, size_t size, size_t* pnread)
+{
+    srs_error_t err = srs_success;
+
+    if (size < sizeof(SrsDomainMatcherHeader)) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "domain rules header requires %d only %d bytes",
+            (int)sizeof(SrsDomainMatcherHeader), (int)size);
+    }
+
+    SrsDomainMatcherHeader* header = (SrsDomainMatcherHeader*)data;
+    if (!header->capacity || (header->capacity & (header->capacity - 1)) || !header->pool_size) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid domain rules capacity=%u, pool=%u",
+            header->capacity, header->pool_size);
+    }
+
+    // Use 64 bits to avoid overflow for the corrupt header.
+    uint64_t pool_start = sizeof(SrsDomainMatcherHeader) + (uint64_t)sizeof(SrsDomainSlot) * header->capacity;
+    uint64_t substrings_start = pool_start + header->pool_size;
+    substrings_start += (8 - substrings_start % 8) % 8;
+    uint64_t end = substrings_start + header->substrings_size;
+    end += (8 - end % 8) % 8;
+    if (end > size) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "domain rules requires %u only %u bytes", (uint32_t)end, (uint32_t)size);
+    }
+
+    SrsBloomFilter* bloom = new SrsBloomFilter();
+    size_t nn_bloom = 0;
+    if ((err = bloom->decode(data + end, size - end, &nn_bloom)) != srs_success) {
+        srs_freep(bloom);
+        return srs_error_wrap(err, "decode bloom filter");
+    }
+    srs_freep(bloom_);
+    bloom_ = bloom;
+    end += nn_bloom;
+
+    substrings_.clear();
+    for (const char* p = data + substrings_start; p < data + substrings_start + header->substrings_size;) {
+        string substring(p, strnlen(p, data + substrings_start + header->substrings_size - p));
+        p += substring.length() + 1;
+        substrings_.push_back(substring);
+    }
+
+    if (!mapped_) {
+        srs_freepa(slots_);
+    }
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+
+    slots_ = (SrsDomainSlot*)(data + sizeof(SrsDomainMatcherHeader));
+    mask_ = header->capacity - 1;
+    pool_ = data + pool_start;
+    pool_size_ = header->pool_size;
+    nn_rules_ = (int)header->nn_rules;
+    mapped_ = true;
+
+    if (pnread) {
+        *pnread = (size_t)end;
+    }
+
+    return err;
+}
+
+bool SrsDomainMatcher::match(const string& host)
+{
+    return match(host.data(), (int)host.length());
+}
+
+bool SrsDomainMatcher::match(const char* host, int size)
+{
+    // Ignore the trailing dot of FQDN.
+    if (size > 0 && host[size - 1] == '.') {
+        size--;
+    }
+    if (size <= 0 || size > SRS_DOMAIN_MAX_LENGTH) {
+        return false;
+    }
+
+    // Hash all suffixes at the label boundary, and prefetch the slots or the blocks of filter, so the cache
+    // misses of huge table are in parallel, rather than one by one.
+    uint32_t hashes[SRS_DOMAIN_MAX_LENGTH / 2 + 1];
+    int starts[SRS_DOMAIN_MAX_LENGTH / 2 + 1];
+    int nn_suffixes = 0;
+
+    uint32_t h = SRS_DOMAIN_HASH_INIT;
+    for (int i = size - 1; i >= 0; i--) {
+        h = srs_domain_hash_update(h, host[i]);
+        if (i > 0 && host[i - 1] != '.') {
+            continue;
+        }
+        // Ignore the empty label, for example, "a..com".
+        if (i < size - 1 && host[i] == '.') {
+            continue;
+        }
+
+        uint32_t hash = srs_domain_hash_final(h);
+        if (bloom_->empty()) {
+            __builtin_prefetch(&slots_[hash & mask_]);
+        } else {
+            bloom_->prefetch(hash);
+        }
+        hashes[nn_suffixes] = hash;
+        starts[nn_suffixes++] = i;
+    }
+
+    // The parent domain matches the subdomain rule, while the host itself matches the exact rule.
+    // Only the suffixes which may be in the filter are verified by the table.
+    for (int i = 0; i < nn_suffixes; i++) {
+        if (!bloom_->contains(hashes[i])) {
+            continue;
+        }
+
+        int start = starts[i];
+        SrsDomainSlot* slot = find(hashes[i], host + start, size - start);
+        if (slot->offset && (pool_[slot->offset] & (start ? SrsDomainRuleSubdomain : SrsDomainRuleExact))) {
+            return true;
+        }
+    }
+
+    if (substrings_.empty()) {
+        return false;
+    }
+
+    string lower = srs_string_to_lower(string(host, size));
+    for (int i = 0; i < (int)substrings_.size(); i++) {
+        if (lower.find(substrings_[i]) != string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int SrsDomainMatcher::size()
+{
+    return nn_rules_;
+}
+
+size_t SrsDomainMatcher::memory()
+{
+    size_t size = sizeof(SrsDomainSlot) * (mask_ + 1) + pool_size_;
+    for (int i = 0; i < (int)substrings_.size(); i++) {
+        size += substrings_[i].capacity();
+    }
+    return size + bloom_->memory();
+}
+
+size_t SrsDomainMatcher::bloom_memory()
+{
+    return bloom_->memory();
+}
+
+SrsDomainMatcher::SrsDomainSlot* SrsDomainMatcher::find(uint32_t hash, const char* domain, int size)
+{
+    // There is always an empty slot, except the decoded data is corrupt.
+    uint32_t i = hash & mask_;
+    for (uint32_t n = 0; n <= mask_; n++, i = (i + 1) & mask_) {
+        SrsDomainSlot* slot = &slots_[i];
+        if (!slot->offset) {
+            return slot;
+        }
+        // Check the bound of offset, because the decoded data may be corrupt.
+        if (slot->hash != hash || (uint64_t)slot->offset + 2 + size > pool_size_ || (uint8_t)pool_[slot->offset + 1] != size) {
+            continue;
+        }
+
+        const char* p = &pool_[slot->offset + 2];
+        int j = 0;
+        for (; j < size && p[j] == srs_domain_lower(domain[j]); j++) {
+        }
+        if (j == size) {
+            return slot;
+        }
+    }
+
+    static SrsDomainSlot empty = {0, 0};
+    return &empty;
+}
+
+void SrsDomainMatcher::rehash(uint32_t capacity)
+{
+    SrsDomainSlot* slots = slots_;
+    uint32_t size = slots ? mask_ + 1 : 0;
+
+    slots_ = new SrsDomainSlot[capacity];
+    memset(slots_, 0, sizeof(SrsDomainSlot) * capacity);
+    mask_ = capacity - 1;
+
+    for (uint32_t i = 0; i < size; i++) {
+        SrsDomainSlot* from = &slots[i];
+        if (!from->offset) {
+            continue;
+        }
+
+        uint32_t j = from->hash & mask_;
+        while (slots_[j].offset) {
+            j = (j + 1) & mask_;
+        }
+        slots_[j] = *from;
+    }
+
+    srs_freepa(slots);
+}
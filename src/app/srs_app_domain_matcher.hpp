@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_DOMAIN_MATCHER_HPP
+#define SRS_APP_DOMAIN_MATCHER_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+
+class SrsBloomFilter;
+
+// The type of domain rule, parsed from the prefix of rule.
+enum SrsDomainRuleType
+{
+    // Match the domain itself only, for example, "=example.com".
+    SrsDomainRuleExact = 0x01,
+    // Match the subdomains only, for example, "*.example.com".
+    SrsDomainRuleSubdomain = 0x02,
+    // Match the domain and its subdomains, for example, "example.com", which is the default.
+    SrsDomainRuleSuffix = 0x03,
+    // Match if the rule is a substring of host, for example, "~example".
+    // @remark It's O(rules), so only for the few rules which really need it.
+    SrsDomainRuleSubstring = 0x04,
+};
+
+// Parse the type and domain from rule, the domain is in lowercase without the trailing dot.
+// @return The type, or 0 if the rule is invalid.
+extern int srs_domain_rule_parse(std::string rule, std::string& domain);
+
+// The domain matcher, which is a hashed suffix set of domain rules, to check the host in O(labels).
+// For host "a.b.example.com", it hashes the host from the end, and probe the set at each label boundary,
+// that is "com", "example.com", "b.example.com" and "a.b.example.com", without any allocation.
+// @remark The substring rules are not in the set, they're checked one by one.
+// @remark The table and pool are flat, so they're encoded as is, and decoded from the mapped file without copy.
+// @remark For the huge rules, for example, the phishing database, a blocked bloom filter is built by compile, which
+//      rejects most hosts before probing the table, so the clean host only touches the filter.
+class SrsDomainMatcher
+{
+private:
+    // The slot of hash table, the offset is in the pool, 0 is empty.
+    struct SrsDomainSlot
+    {
+        uint32_t hash;
+        uint32_t offset;
+    };
+private:
+    // The open addressing hash table, with linear probing.
+    SrsDomainSlot* slots_;
+    uint32_t mask_;
+    int nn_rules_;
+    // The domains of rules, each is [type:1B][length:1B][domain:length].
+    const char* pool_;
+    uint32_t pool_size_;
+    // The pool when adding rules, empty if decoded.
+    std::vector<char> buffer_;
+    std::vector<std::string> substrings_;
+    // Whether the table and pool are in the decoded data, which is read-only.
+    bool mapped_;
+    // The filter of suffix hashes, empty if not compiled or too few rules.
+    SrsBloomFilter* bloom_;
+public:
+    SrsDomainMatcher();
+    virtual ~SrsDomainMatcher();
+public:
+    // Add a rule, the type is parsed from the prefix, see SrsDomainRuleType.
+    virtual srs_error_t add(std::string rule);
+    // Add a domain with the type, the domain should be parsed by srs_domain_rule_parse.
+    // @remark Never add rule to the decoded matcher, which is read-only.
+    virtual void add(std::string domain, int type);
+    // Build the bloom filter for the huge rules, so it's built when compile the policy database.
+    virtual void compile();
+    // Append the rules to data, in the binary format, the size is aligned to 8 bytes.
+    virtual void encode(std::string& data);
+    // Use the rules in data, which should be aligned to 8 bytes, and alive until the matcher is freed.
+    // @param pnread The bytes of rules in data.
+    virtual srs_error_t decode(const char* data, size_t size, size_t* pnread);
+    // Whether host matches any rule.
+    virtual bool match(const std::string& host);
+    virtual bool match(const char* host, int size);
+    // The number of rules.
+    virtual int size();
+    // The bytes of memory used by the rules, including the bloom filter.
+    virtual size_t memory();
+    // The bytes of bloom filter, 0 if not built.
+    virtual size_t bloom_memory();
+private:
+    SrsDomainSlot* find(uint32_t hash, const char* domain, int size);
+    void rehash(uint32_t capacity);
+};
+
+#endif
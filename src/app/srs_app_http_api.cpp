@@ -10,6 +10,29 @@
 #include <srs_core_auto_free.hpp>
 #include <srs_kernel_log.hpp>
 #include <srs_app_utility.hpp>
+#include <srs_app_trace.hpp>
+#include <srs_app_st.hpp>
+#include <srs_app_conn.hpp>
+#include <srs_app_admission.hpp>
+#include <srs_app_policy.hpp>
+#include <srs_app_url_category.hpp>
+#include <srs_app_http_cache.hpp>
+#include <srs_app_http_collapser.hpp>
+#include <srs_app_memory.hpp>
+#include <srs_kernel_file.hpp>
+#include <srs_kernel_pool.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_protocol_st.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#ifdef SRS_GPERF
+#include <gperftools/profiler.h>
+#include <gperftools/heap-profiler.h>
+#endif
 
 srs_error_t srs_api_response_jsonp(ISrsHttpResponseWriter* w, string callback, string data)
 {
@@ -68,6 +91,53 @@ srs_error_t srs_api_response(ISrsHttpResponseWriter* w, ISrsHttpMessage* r, std:
     return srs_api_response_jsonp(w, callback, json);
 }
 
+srs_error_t srs_api_response_code(ISrsHttpResponseWriter* w, ISrsHttpMessage* r, int code, string msg)
+{
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+
+    obj->set("code", SrsJsonAny::integer(code));
+    obj->set("msg", SrsJsonAny::str(msg.c_str()));
+
+    return srs_api_response(w, r, obj->dumps());
+}
+
+srs_error_t srs_api_response_file(ISrsHttpResponseWriter* w, string path)
+{
+    srs_error_t err = srs_success;
+
+    SrsFileReader fr;
+    if ((err = fr.open(path)) != srs_success) {
+        return srs_error_wrap(err, "open %s", path.c_str());
+    }
+
+    SrsHttpHeader* h = w->header();
+    h->set_content_length(fr.filesize());
+    h->set_content_type("application/octet-stream");
+
+    char buf[4096];
+    while (true) {
+        ssize_t nread = 0;
+        if ((err = fr.read(buf, sizeof(buf), &nread)) != srs_success) {
+            // The reader returns error when EOF, and the body is shorter than the Content-Length for other errors.
+            if (srs_error_code(err) != ERROR_SYSTEM_FILE_EOF) {
+                return srs_error_wrap(err, "read %s", path.c_str());
+            }
+            srs_freep(err);
+            break;
+        }
+        if (nread <= 0) {
+            break;
+        }
+
+        if ((err = w->write(buf, (int)nread)) != srs_success) {
+            return srs_error_wrap(err, "write %s", path.c_str());
+        }
+    }
+
+    return err;
+}
+
 SrsGoApiRoot::SrsGoApiRoot()
 {
 }
@@ -317,3 +387,436 @@ srs_error_t SrsGoApiSelfProcStats::serve_http(ISrsHttpResponseWriter* w, ISrsHtt
     
     return srs_api_response(w, r, obj->dumps());
 }
+
+SrsGoApiTraces::SrsGoApiTraces()
+{
+}
+
+SrsGoApiTraces::~SrsGoApiTraces()
+{
+}
+
+srs_error_t SrsGoApiTraces::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+
+    obj->set("code", SrsJsonAny::integer(ERROR_SUCCESS));
+
+    SrsJsonObject* data = SrsJsonAny::object();
+    obj->set("data", data);
+
+    int slowest = 10;
+    if (!r->query_get("slowest").empty()) {
+        slowest = ::atoi(r->query_get("slowest").c_str());
+    }
+
+    std::vector<SrsTraceRecord> records;
+    _srs_trace_ring->snapshot(records);
+
+    data->set("total", SrsJsonAny::integer(_srs_trace_ring->total()));
+    data->set("capacity", SrsJsonAny::integer(_srs_trace_ring->capacity()));
+    data->set("samples", SrsJsonAny::integer(records.size()));
+
+    // The percentiles of each phase and the total, in microseconds.
+    SrsJsonObject* percentiles = SrsJsonAny::object();
+    data->set("percentiles", percentiles);
+    for (int i = 0; i <= SrsTracePhaseMax; i++) {
+        SrsTracePercentiles v = SrsTraceRing::percentiles(records, i);
+
+        SrsJsonObject* phase = SrsJsonAny::object();
+        percentiles->set(srs_trace_phase_name(i), phase);
+        phase->set("count", SrsJsonAny::integer(v.count));
+        phase->set("p50", SrsJsonAny::integer(v.p50));
+        phase->set("p90", SrsJsonAny::integer(v.p90));
+        phase->set("p99", SrsJsonAny::integer(v.p99));
+        phase->set("max", SrsJsonAny::integer(v.max));
+    }
+
+    std::vector<SrsTraceRecord> slows;
+    SrsTraceRing::slowest(records, slowest, slows);
+
+    SrsJsonArray* arr = SrsJsonAny::array();
+    data->set("slowest", arr);
+    for (int i = 0; i < (int)slows.size(); i++) {
+        SrsTraceRecord& record = slows[i];
+
+        SrsJsonObject* item = SrsJsonAny::object();
+        arr->append(item);
+        item->set("cid", SrsJsonAny::str(record.cid));
+        item->set("host", SrsJsonAny::str(record.host));
+        item->set("path", SrsJsonAny::str(record.path));
+        item->set("https", SrsJsonAny::boolean(record.https));
+        item->set("status", SrsJsonAny::integer(record.status));
+        item->set("error", SrsJsonAny::integer(record.error));
+        item->set("start_time", SrsJsonAny::integer(srsu2ms(record.start_time)));
+        item->set("elapsed", SrsJsonAny::integer(record.elapsed));
+
+        SrsJsonObject* phases = SrsJsonAny::object();
+        item->set("phases", phases);
+        for (int j = 0; j < SrsTracePhaseMax; j++) {
+            if (record.phases[j] >= 0) {
+                phases->set(srs_trace_phase_name(j), SrsJsonAny::integer(record.phases[j]));
+            }
+        }
+    }
+
+    return srs_api_response(w, r, obj->dumps());
+}
+
+SrsGoApiCoroutines::SrsGoApiCoroutines()
+{
+}
+
+SrsGoApiCoroutines::~SrsGoApiCoroutines()
+{
+}
+
+static bool srs_coroutine_info_wait_longer(const SrsCoroutineInfo& a, const SrsCoroutineInfo& b)
+{
+    return a.wait_elapsed > b.wait_elapsed;
+}
+
+srs_error_t SrsGoApiCoroutines::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+
+    obj->set("code", SrsJsonAny::integer(ERROR_SUCCESS));
+
+    SrsJsonObject* data = SrsJsonAny::object();
+    obj->set("data", data);
+
+    srs_utime_t min_wait = 0;
+    if (!r->query_get("min_wait").empty()) {
+        min_wait = ::atoi(r->query_get("min_wait").c_str()) * SRS_UTIME_MILLISECONDS;
+    }
+    string name = r->query_get("name");
+
+    std::vector<SrsCoroutineInfo> infos;
+    SrsFastCoroutine::list(infos);
+    std::sort(infos.begin(), infos.end(), srs_coroutine_info_wait_longer);
+
+    data->set("total", SrsJsonAny::integer(infos.size()));
+
+    // The number and the max stack high-water mark of each name, to size the stack.
+    // The peak is of the coroutines which are done, while max_used is of the live ones.
+    SrsJsonObject* stacks = SrsJsonAny::object();
+    data->set("stacks", stacks);
+
+    std::map<string, int> peaks;
+    SrsFastCoroutine::stack_peaks(peaks);
+
+    std::map<string, std::pair<int, int> > summary;
+    for (std::map<string, int>::iterator it = peaks.begin(); it != peaks.end(); ++it) {
+        summary[it->first] = std::make_pair(0, -1);
+    }
+    for (int i = 0; i < (int)infos.size(); i++) {
+        if (summary.find(infos[i].name) == summary.end()) {
+            summary[infos[i].name] = std::make_pair(0, -1);
+        }
+        std::pair<int, int>& v = summary[infos[i].name];
+        v.first++;
+        v.second = srs_max(v.second, infos[i].stack_used);
+    }
+    for (std::map<string, std::pair<int, int> >::iterator it = summary.begin(); it != summary.end(); ++it) {
+        SrsJsonObject* item = SrsJsonAny::object();
+        stacks->set(it->first, item);
+        item->set("count", SrsJsonAny::integer(it->second.first));
+        item->set("max_used", SrsJsonAny::integer(it->second.second));
+        item->set("peak", SrsJsonAny::integer(peaks.count(it->first) ? peaks[it->first] : -1));
+    }
+
+    SrsJsonArray* arr = SrsJsonAny::array();
+    data->set("coroutines", arr);
+    for (int i = 0; i < (int)infos.size(); i++) {
+        SrsCoroutineInfo& info = infos[i];
+        if (info.wait_elapsed < min_wait || (!name.empty() && info.name != name)) {
+            continue;
+        }
+
+        SrsJsonObject* item = SrsJsonAny::object();
+        arr->append(item);
+        item->set("name", SrsJsonAny::str(info.name.c_str()));
+        item->set("cid", SrsJsonAny::str(info.cid.c_str()));
+        item->set("age", SrsJsonAny::integer(srsu2ms(info.age)));
+        item->set("wait", SrsJsonAny::str(srs_coroutine_wait_name(info.wait)));
+        item->set("fd", SrsJsonAny::integer(info.fd));
+        item->set("wait_elapsed", SrsJsonAny::integer(srsu2ms(info.wait_elapsed)));
+        item->set("stack_size", SrsJsonAny::integer(info.stack_size));
+        item->set("stack_used", SrsJsonAny::integer(info.stack_used));
+        item->set("done", SrsJsonAny::boolean(info.done));
+    }
+
+    return srs_api_response(w, r, obj->dumps());
+}
+
+SrsGoApiMetrics::SrsGoApiMetrics(SrsResourceManager* conns)
+{
+    conns_ = conns;
+}
+
+SrsGoApiMetrics::~SrsGoApiMetrics()
+{
+}
+
+srs_error_t SrsGoApiMetrics::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+
+    obj->set("code", SrsJsonAny::integer(ERROR_SUCCESS));
+
+    SrsJsonObject* data = SrsJsonAny::object();
+    obj->set("data", data);
+
+    data->set("connections", SrsJsonAny::integer(conns_->size()));
+
+    SrsJsonObject* admission = SrsJsonAny::object();
+    data->set("admission", admission);
+    _srs_admission->dumps(admission);
+
+    return srs_api_response(w, r, obj->dumps());
+}
+
+SrsGoApiMemory::SrsGoApiMemory()
+{
+}
+
+SrsGoApiMemory::~SrsGoApiMemory()
+{
+}
+
+srs_error_t SrsGoApiMemory::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+    string rpc = r->query_get("rpc");
+    if (rpc == "release") {
+        _srs_memory_releaser->release(0);
+    } else if (!rpc.empty()) {
+        return srs_api_response_code(w, r, ERROR_HTTP_DATA_INVALID, "invalid rpc=" + rpc);
+    }
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+
+    obj->set("code", SrsJsonAny::integer(ERROR_SUCCESS));
+
+    SrsJsonObject* data = SrsJsonAny::object();
+    obj->set("data", data);
+    _srs_memory_releaser->dumps(data);
+
+    return srs_api_response(w, r, obj->dumps());
+}
+
+SrsGoApiPolicy::SrsGoApiPolicy(SrsPolicyReloader* reloader)
+{
+    reloader_ = reloader;
+}
+
+SrsGoApiPolicy::~SrsGoApiPolicy()
+{
+}
+
+srs_error_t SrsGoApiPolicy::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+    // The reload is async, query the version to check whether it's done.
+    string rpc = r->query_get("rpc");
+    if (rpc == "reload") {
+        reloader_->reload();
+    } else if (!rpc.empty()) {
+        return srs_api_response_code(w, r, ERROR_HTTP_DATA_INVALID, "invalid rpc=" + rpc);
+    }
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+
+    obj->set("code", SrsJsonAny::integer(ERROR_SUCCESS));
+
+    SrsJsonObject* data = SrsJsonAny::object();
+    obj->set("data", data);
+    reloader_->dumps(data);
+
+    SrsJsonObject* cache = SrsJsonAny::object();
+    data->set("verdict_cache", cache);
+    _srs_verdict_cache->dumps(cache);
+
+    SrsJsonObject* category = SrsJsonAny::object();
+    data->set("url_category", category);
+    _srs_url_category->dumps(category);
+
+    SrsJsonObject* http_cache = SrsJsonAny::object();
+    data->set("http_cache", http_cache);
+    _srs_http_cache->dumps(http_cache);
+
+    SrsJsonObject* http_collapse = SrsJsonAny::object();
+    data->set("http_collapse", http_collapse);
+    _srs_http_collapser->dumps(http_collapse);
+
+    // The occupancy of object pools, and the heap allocations of the arenas of transactions.
+    SrsJsonObject* pools = SrsJsonAny::object();
+    data->set("pools", pools);
+    SrsJsonArray* objects = SrsJsonAny::array();
+    pools->set("objects", objects);
+    std::vector<SrsObjectPool*>& all = SrsObjectPool::pools();
+    for (int i = 0; i < (int)all.size(); i++) {
+        SrsObjectPool* pool = all.at(i);
+        SrsJsonObject* item = SrsJsonAny::object();
+        objects->append(item);
+        item->set("name", SrsJsonAny::str(pool->name().c_str()));
+        item->set("size", SrsJsonAny::integer(pool->size()));
+        item->set("used", SrsJsonAny::integer(pool->used()));
+        item->set("cached", SrsJsonAny::integer(pool->cached()));
+        item->set("allocs", SrsJsonAny::integer(pool->nn_allocs()));
+        item->set("reuses", SrsJsonAny::integer(pool->nn_reuses()));
+    }
+    pools->set("arena_resets", SrsJsonAny::integer(SrsArena::nn_resets()));
+    pools->set("arena_blocks", SrsJsonAny::integer(SrsArena::nn_blocks()));
+
+    return srs_api_response(w, r, obj->dumps());
+}
+
+SrsGoApiCpuProfile::SrsGoApiCpuProfile()
+{
+    running_ = false;
+}
+
+SrsGoApiCpuProfile::~SrsGoApiCpuProfile()
+{
+}
+
+srs_error_t SrsGoApiCpuProfile::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+#ifndef SRS_GPERF
+    return srs_api_response_code(w, r, ERROR_GPERF_DISABLED, "configure with --with-gperf");
+#else
+    srs_error_t err = srs_success;
+
+    // Only one CPU profiler in process.
+    ProfilerState state;
+    ProfilerGetCurrentState(&state);
+    if (running_ || state.enabled) {
+        return srs_api_response_code(w, r, ERROR_GPERF_BUSY, "cpu profiler is running");
+    }
+
+    int seconds = 30;
+    if (!r->query_get("seconds").empty()) {
+        seconds = ::atoi(r->query_get("seconds").c_str());
+    }
+    seconds = srs_max(1, srs_min(600, seconds));
+
+    std::stringstream ss;
+    ss << "./output/gperf.cpu." << srsu2ms(srs_get_system_time()) << ".prof";
+    string path = ss.str();
+
+    if (!ProfilerStart(path.c_str())) {
+        return srs_api_response_code(w, r, ERROR_GPERF_PROFILER, "start cpu profiler failed");
+    }
+
+    // Only block this API connection, other coroutines are profiled.
+    running_ = true;
+    srs_trace("gperf: start cpu profiler %s for %ds", path.c_str(), seconds);
+    srs_usleep(seconds * SRS_UTIME_SECONDS);
+    ProfilerStop();
+    running_ = false;
+    srs_trace("gperf: stop cpu profiler %s", path.c_str());
+
+    if (r->query_get("format") == "raw") {
+        if ((err = srs_api_response_file(w, path)) != srs_success) {
+            return srs_error_wrap(err, "response %s", path.c_str());
+        }
+        return err;
+    }
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+
+    obj->set("code", SrsJsonAny::integer(ERROR_SUCCESS));
+
+    SrsJsonObject* data = SrsJsonAny::object();
+    obj->set("data", data);
+    data->set("path", SrsJsonAny::str(path.c_str()));
+    data->set("seconds", SrsJsonAny::integer(seconds));
+
+    return srs_api_response(w, r, obj->dumps());
+#endif
+}
+
+SrsGoApiHeapProfile::SrsGoApiHeapProfile()
+{
+}
+
+SrsGoApiHeapProfile::~SrsGoApiHeapProfile()
+{
+}
+
+srs_error_t SrsGoApiHeapProfile::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+#ifndef SRS_GPERF
+    return srs_api_response_code(w, r, ERROR_GPERF_DISABLED, "configure with --with-gperf");
+#else
+    srs_error_t err = srs_success;
+
+    string action = r->query_get("action");
+    if (action.empty()) {
+        action = "dump";
+    }
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+
+    obj->set("code", SrsJsonAny::integer(ERROR_SUCCESS));
+
+    SrsJsonObject* data = SrsJsonAny::object();
+    obj->set("data", data);
+    data->set("action", SrsJsonAny::str(action.c_str()));
+
+    if (action == "start") {
+        if (IsHeapProfilerRunning()) {
+            return srs_api_response_code(w, r, ERROR_GPERF_BUSY, "heap profiler is running");
+        }
+        HeapProfilerStart("./output/gperf.heap");
+        srs_trace("gperf: start heap profiler");
+        return srs_api_response(w, r, obj->dumps());
+    }
+
+    if (!IsHeapProfilerRunning()) {
+        return srs_api_response_code(w, r, ERROR_GPERF_PROFILER, "heap profiler not running, use action=start");
+    }
+
+    if (action == "stop") {
+        HeapProfilerStop();
+        srs_trace("gperf: stop heap profiler");
+        return srs_api_response(w, r, obj->dumps());
+    }
+
+    // Take a snapshot to our own file, because the name of HeapProfilerDump is decided by profiler.
+    std::stringstream ss;
+    ss << "./output/gperf.heap." << srsu2ms(srs_get_system_time()) << ".heap";
+    string path = ss.str();
+
+    char* profile = GetHeapProfile();
+    if (!profile) {
+        return srs_api_response_code(w, r, ERROR_GPERF_PROFILER, "get heap profile failed");
+    }
+
+    SrsFileWriter fw;
+    if ((err = fw.open(path)) == srs_success) {
+        err = fw.write(profile, strlen(profile), NULL);
+    }
+    free(profile);
+    if (err != srs_success) {
+        return srs_error_wrap(err, "write %s", path.c_str());
+    }
+    srs_trace("gperf: dump heap profile to %s", path.c_str());
+
+    if (r->query_get("format") == "raw") {
+        if ((err = srs_api_response_file(w, path)) != srs_success) {
+            return srs_error_wrap(err, "response %s", path.c_str());
+        }
+        return err;
+    }
+
+    data->set("path", SrsJsonAny::str(path.c_str()));
+    return srs_api_response(w, r, obj->dumps());
+#endif
+}
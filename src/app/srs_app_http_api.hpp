@@ -7,6 +7,8 @@
 
 class ISrsHttpMessage;
 class SrsHttpParser;
+class SrsResourceManager;
+class SrsPolicyReloader;
 
 // For http root.
 class SrsGoApiRoot : public ISrsHttpHandler
@@ -64,4 +66,88 @@ public:
     virtual srs_error_t serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
 };
 
+// Profile the CPU for N seconds by gperftools, response the path of profile.
+// @remark Use query seconds=N, default to 30, and format=raw to response the profile file.
+// @remark Requires configure with --with-gperf.
+class SrsGoApiCpuProfile : public ISrsHttpHandler
+{
+private:
+    bool running_;
+public:
+    SrsGoApiCpuProfile();
+    virtual ~SrsGoApiCpuProfile();
+public:
+    virtual srs_error_t serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
+// Start, stop or snapshot the heap profiler of gperftools, response the path of snapshot.
+// @remark Use query action=start|stop|dump, default to dump, and format=raw to response the snapshot file.
+// @remark Requires configure with --with-gperf.
+class SrsGoApiHeapProfile : public ISrsHttpHandler
+{
+public:
+    SrsGoApiHeapProfile();
+    virtual ~SrsGoApiHeapProfile();
+public:
+    virtual srs_error_t serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
+// The phase timing of recent proxy transactions, the slowest N and the percentiles of each phase.
+// @remark Use query slowest=N to specify the number of slowest transactions, default to 10.
+class SrsGoApiTraces : public ISrsHttpHandler
+{
+public:
+    SrsGoApiTraces();
+    virtual ~SrsGoApiTraces();
+public:
+    virtual srs_error_t serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
+// The live coroutines, with the blocking operation and stack high-water mark, sorted by the wait time.
+// @remark Use query min_wait=N to list the coroutines which are blocked for N ms at least, for stuck tunnels.
+// @remark Use query name=xxx to list the coroutines of name.
+class SrsGoApiCoroutines : public ISrsHttpHandler
+{
+public:
+    SrsGoApiCoroutines();
+    virtual ~SrsGoApiCoroutines();
+public:
+    virtual srs_error_t serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
+// The metrics of server, such as the connections and the admission control.
+class SrsGoApiMetrics : public ISrsHttpHandler
+{
+private:
+    SrsResourceManager* conns_;
+public:
+    SrsGoApiMetrics(SrsResourceManager* conns);
+    virtual ~SrsGoApiMetrics();
+public:
+    virtual srs_error_t serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
+// The stat of allocator, such as the heap, free bytes and fragmentation, and the release of free memory.
+// @remark Use query rpc=release to return all free memory to OS now.
+class SrsGoApiMemory : public ISrsHttpHandler
+{
+public:
+    SrsGoApiMemory();
+    virtual ~SrsGoApiMemory();
+public:
+    virtual srs_error_t serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
+// The status of policy, use rpc=reload to reload the policy.
+class SrsGoApiPolicy : public ISrsHttpHandler
+{
+private:
+    SrsPolicyReloader* reloader_;
+public:
+    SrsGoApiPolicy(SrsPolicyReloader* reloader);
+    virtual ~SrsGoApiPolicy();
+public:
+    virtual srs_error_t serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
 #endif
@@ -0,0 +1,1147 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_http_cache.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_kernel_io.hpp>
+#include <srs_kernel_consts.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_protocol_http_stack.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_app_disk_cache.hpp>
+#include <srs_app_http_revalidator.hpp>
+
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include <set>
+using namespace std;
+
+// The max percent of segments in the protected segment of SLRU.
+#define SRS_HTTP_CACHE_PROTECTED 80
+// The max freshness by Last-Modified, when the response has no explicit expiration time.
+#define SRS_HTTP_CACHE_MAX_HEURISTIC 86400
+// The seconds to keep the stale object with validators on disk, to revalidate rather than fetch it.
+#define SRS_HTTP_CACHE_MAX_STALE 86400
+
+SrsHttpCache* _srs_http_cache = NULL;
+
+void srs_http_cache_release(SrsHttpCacheObject* object)
+{
+    _srs_http_cache->release(object);
+}
+
+SrsHttpCacheControl::SrsHttpCacheControl()
+{
+    no_store = false;
+    no_cache = false;
+    private_ = false;
+    public_ = false;
+    must_revalidate = false;
+    proxy_revalidate = false;
+    max_age = -1;
+    s_maxage = -1;
+    min_fresh = -1;
+    stale_while_revalidate = -1;
+}
+
+SrsHttpCacheControl::~SrsHttpCacheControl()
+{
+}
+
+void SrsHttpCacheControl::parse(string value)
+{
+    vector<string> directives = srs_string_split(value, ",");
+    for (int i = 0; i < (int)directives.size(); i++) {
+        string directive = srs_string_trim_start(srs_string_trim_end(directives.at(i), " \t"), " \t");
+
+        string name = directive, arg;
+        size_t pos = directive.find('=');
+        if (pos != string::npos) {
+            name = directive.substr(0, pos);
+            arg = srs_string_trim_start(srs_string_trim_end(directive.substr(pos + 1), "\""), "\"");
+        }
+        name = srs_string_to_lower(srs_string_trim_end(name, " \t"));
+
+        // The delta seconds is non-negative, see RFC 7234 section 1.2.1.
+        int64_t seconds = arg.empty() ? -1 : srs_max(0, ::atoll(arg.c_str()));
+
+        if (name == "no-store") {
+            no_store = true;
+        } else if (name == "no-cache") {
+            no_cache = true;
+        } else if (name == "private") {
+            private_ = true;
+        } else if (name == "public") {
+            public_ = true;
+        } else if (name == "must-revalidate") {
+            must_revalidate = true;
+        } else if (name == "proxy-revalidate") {
+            proxy_revalidate = true;
+        } else if (name == "max-age") {
+            max_age = seconds;
+        } else if (name == "s-maxage") {
+            s_maxage = seconds;
+        } else if (name == "min-fresh") {
+            min_fresh = seconds;
+        } else if (name == "stale-while-revalidate") {
+            stale_while_revalidate = seconds;
+        }
+    }
+}
+
+time_t srs_http_cache_parse_date(string value)
+{
+    // The IMF-fixdate, the obsolete RFC 850 and asctime formats, see RFC 7231 section 7.1.1.1.
+    static const char* formats[] = {"%a, %d %b %Y %H:%M:%S GMT", "%A, %d-%b-%y %H:%M:%S GMT", "%a %b %e %H:%M:%S %Y"};
+
+    for (int i = 0; i < (int)(sizeof(formats) / sizeof(formats[0])); i++) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+
+        const char* p = strptime(value.c_str(), formats[i], &tm);
+        if (p && *p == '\0') {
+            time_t t = timegm(&tm);
+            return t > 0 ? t : 0;
+        }
+    }
+
+    return 0;
+}
+
+// Format the IMF-fixdate, for example, "Sun, 06 Nov 1994 08:49:37 GMT".
+static string srs_http_cache_format_date(time_t value)
+{
+    struct tm tm;
+    if (!gmtime_r(&value, &tm)) {
+        return "";
+    }
+
+    char buf[64];
+    size_t size = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return string(buf, size);
+}
+
+string srs_http_cache_key(bool https, SrsHttpMessage* req)
+{
+    string key = https ? "https://" : "http://";
+    key += req->get_dest_domain() + ":" + srs_int2str(req->get_dest_port()) + req->path();
+
+    string query = req->query();
+    if (!query.empty()) {
+        key += "?" + query;
+    }
+    return key;
+}
+
+// The header name as SrsHttpHeader, for example, "accept-encoding" is "Accept-Encoding".
+static string srs_http_cache_header_name(string name)
+{
+    name = srs_string_to_lower(srs_string_trim_start(srs_string_trim_end(name, " \t"), " \t"));
+    for (int i = 0; i < (int)name.length(); i++) {
+        if ((i == 0 || name.at(i - 1) == '-') && name.at(i) >= 'a' && name.at(i) <= 'z') {
+            name.at(i) = name.at(i) - 'a' + 'A';
+        }
+    }
+    return name;
+}
+
+bool srs_http_cache_vary_names(string vary, vector<string>& names)
+{
+    vector<string> values = srs_string_split(vary, ",");
+    for (int i = 0; i < (int)values.size(); i++) {
+        string name = srs_http_cache_header_name(values.at(i));
+        if (name == "*") {
+            return false;
+        }
+        if (!name.empty()) {
+            names.push_back(name);
+        }
+    }
+    return true;
+}
+
+string srs_http_cache_vary_key(SrsHttpMessage* req, const string& primary, const vector<string>& names)
+{
+    // The values are normalized by removing the spaces, for example, "gzip, br" is the same to "gzip,br".
+    string key = primary;
+    for (int i = 0; i < (int)names.size(); i++) {
+        string value = srs_string_replace(srs_string_to_lower(req->header()->get(names.at(i))), " ", "");
+        key += "\n" + names.at(i) + ":" + value;
+    }
+    return key;
+}
+
+bool srs_http_cache_has_cookie(const string& header)
+{
+    vector<string> lines = srs_string_split(header, SRS_HTTP_CRLF);
+    for (int i = 1; i < (int)lines.size(); i++) {
+        const string& line = lines.at(i);
+        size_t pos = line.find(':');
+        if (pos != string::npos && srs_http_cache_header_name(line.substr(0, pos)) == "Set-Cookie") {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether the status is cacheable, the heuristic ones are cacheable without explicit freshness, see
+// RFC 7231 section 6.1.
+static bool srs_http_cache_status(int status, bool& heuristic)
+{
+    heuristic = status == 200 || status == 203 || status == 204 || status == 300 || status == 301
+        || status == 404 || status == 405 || status == 410 || status == 414 || status == 501;
+    return heuristic || status == 302 || status == 307 || status == 308;
+}
+
+// The freshness lifetime, see RFC 7234 section 4.2.1.
+static int64_t srs_http_cache_freshness(SrsHttpHeader* h, SrsHttpCacheControl& cc, bool heuristic, time_t date, time_t last_modified)
+{
+    if (cc.s_maxage >= 0) {
+        return cc.s_maxage;
+    }
+    if (cc.max_age >= 0) {
+        return cc.max_age;
+    }
+    if (!h->get("Expires").empty()) {
+        // The invalid date, for example, "0", means already expired.
+        time_t expires = srs_http_cache_parse_date(h->get("Expires"));
+        return srs_max(0, (int64_t)(expires - date));
+    }
+    if (heuristic && last_modified && last_modified < date) {
+        return srs_min((int64_t)SRS_HTTP_CACHE_MAX_HEURISTIC, (int64_t)(date - last_modified) / 10);
+    }
+    return 0;
+}
+
+// Whether the header is hop-by-hop, or set by cache when served.
+static bool srs_http_cache_skip_header(string name)
+{
+    name = srs_string_to_lower(name);
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding"
+        || name == "te" || name == "trailer" || name == "upgrade" || name == "proxy-authenticate"
+        || name == "content-length" || name == "age";
+}
+
+// The object in disk tier is [meta][key][header][etag][varies][body], the strings are [size:4B][bytes].
+struct SrsHttpCacheObjectMeta
+{
+    int32_t status;
+    uint32_t nn_varies;
+    int64_t size;
+    int64_t last_modified;
+    int64_t request_time;
+    int64_t response_time;
+    int64_t date;
+    int64_t age_value;
+    int64_t freshness;
+    int64_t stale_while_revalidate;
+    int32_t must_revalidate;
+};
+
+static void srs_http_cache_append(string& data, const string& value)
+{
+    uint32_t size = (uint32_t)value.length();
+    data.append((char*)&size, sizeof(size));
+    data.append(value);
+}
+
+static bool srs_http_cache_consume(const string& data, size_t& pos, string& value)
+{
+    uint32_t size = 0;
+    if (pos + sizeof(size) > data.length()) {
+        return false;
+    }
+    memcpy(&size, data.data() + pos, sizeof(size));
+    pos += sizeof(size);
+
+    if (pos + size > data.length()) {
+        return false;
+    }
+    value.assign(data, pos, size);
+    pos += size;
+    return true;
+}
+
+static void srs_http_cache_encode(SrsHttpCacheObject* object, const vector<string>& varies, string& data)
+{
+    SrsHttpCacheObjectMeta meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.status = object->status;
+    meta.nn_varies = (uint32_t)varies.size();
+    meta.size = object->size;
+    meta.last_modified = object->last_modified;
+    meta.request_time = object->request_time;
+    meta.response_time = object->response_time;
+    meta.date = object->date;
+    meta.age_value = object->age_value;
+    meta.freshness = object->freshness;
+    meta.stale_while_revalidate = object->stale_while_revalidate;
+    meta.must_revalidate = object->must_revalidate;
+
+    data.reserve(sizeof(meta) + object->key.length() + object->header.length() + object->size + 256);
+    data.append((char*)&meta, sizeof(meta));
+    srs_http_cache_append(data, object->key);
+    srs_http_cache_append(data, object->header);
+    srs_http_cache_append(data, object->etag);
+    for (int i = 0; i < (int)varies.size(); i++) {
+        srs_http_cache_append(data, varies.at(i));
+    }
+
+    int64_t left = object->size;
+    for (int i = 0; i < (int)object->segments.size() && left > 0; i++) {
+        int size = (int)srs_min(left, (int64_t)SRS_HTTP_CACHE_SEGMENT);
+        data.append(object->segments.at(i), size);
+        left -= size;
+    }
+}
+
+// Decode the object without body, the body is at pos.
+static bool srs_http_cache_decode(const string& data, SrsHttpCacheObject* object, vector<string>& varies, size_t& pos)
+{
+    SrsHttpCacheObjectMeta meta;
+    if (data.length() < sizeof(meta)) {
+        return false;
+    }
+    memcpy(&meta, data.data(), sizeof(meta));
+    pos = sizeof(meta);
+
+    if (!srs_http_cache_consume(data, pos, object->key) || !srs_http_cache_consume(data, pos, object->header)
+        || !srs_http_cache_consume(data, pos, object->etag)) {
+        return false;
+    }
+    for (int i = 0; i < (int)meta.nn_varies; i++) {
+        string name;
+        if (!srs_http_cache_consume(data, pos, name)) {
+            return false;
+        }
+        varies.push_back(name);
+    }
+    if (meta.size < 0 || pos + meta.size != data.length()) {
+        return false;
+    }
+
+    object->status = meta.status;
+    object->last_modified = meta.last_modified;
+    object->request_time = meta.request_time;
+    object->response_time = meta.response_time;
+    object->date = meta.date;
+    object->age_value = meta.age_value;
+    object->freshness = meta.freshness;
+    object->stale_while_revalidate = meta.stale_while_revalidate;
+    object->must_revalidate = meta.must_revalidate;
+    return true;
+}
+
+// Whether the ETag matches any of the If-None-Match, by the weak comparison of RFC 7232 section 2.3.2.
+static bool srs_http_cache_etag_match(string etag, string if_none_match)
+{
+    if (srs_string_starts_with(etag, "W/")) {
+        etag = etag.substr(2);
+    }
+
+    vector<string> tags = srs_string_split(if_none_match, ",");
+    for (int i = 0; i < (int)tags.size(); i++) {
+        string tag = srs_string_trim_start(srs_string_trim_end(tags.at(i), " \t"), " \t");
+        if (srs_string_starts_with(tag, "W/")) {
+            tag = tag.substr(2);
+        }
+        if (tag == "*" || tag == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SrsHttpCacheSlab::SrsHttpCacheSlab()
+{
+    max_segments_ = 0;
+    nn_used_ = 0;
+}
+
+SrsHttpCacheSlab::~SrsHttpCacheSlab()
+{
+    for (int i = 0; i < (int)slabs_.size(); i++) {
+        char* slab = slabs_.at(i);
+        srs_freepa(slab);
+    }
+    slabs_.clear();
+}
+
+void SrsHttpCacheSlab::set_max(int segments)
+{
+    max_segments_ = segments;
+}
+
+char* SrsHttpCacheSlab::alloc()
+{
+    if (free_.empty()) {
+        int nn_allocated = (int)(memory() / SRS_HTTP_CACHE_SEGMENT);
+        int nn_segments = srs_min(SRS_HTTP_CACHE_SLAB_SEGMENTS, max_segments_ - nn_allocated);
+        if (nn_segments <= 0) {
+            return NULL;
+        }
+
+        char* slab = new char[(size_t)nn_segments * SRS_HTTP_CACHE_SEGMENT];
+        slabs_.push_back(slab);
+        for (int i = nn_segments - 1; i >= 0; i--) {
+            free_.push_back(slab + (size_t)i * SRS_HTTP_CACHE_SEGMENT);
+        }
+    }
+
+    char* segment = free_.back();
+    free_.pop_back();
+    nn_used_++;
+    return segment;
+}
+
+void SrsHttpCacheSlab::free(char* segment)
+{
+    free_.push_back(segment);
+    nn_used_--;
+}
+
+int SrsHttpCacheSlab::used()
+{
+    return nn_used_;
+}
+
+int SrsHttpCacheSlab::max()
+{
+    return max_segments_;
+}
+
+size_t SrsHttpCacheSlab::memory()
+{
+    return (size_t)(nn_used_ + free_.size()) * SRS_HTTP_CACHE_SEGMENT;
+}
+
+SrsHttpCacheObject::SrsHttpCacheObject()
+{
+    status = 0;
+    size = 0;
+    last_modified = 0;
+    request_time = 0;
+    response_time = 0;
+    date = 0;
+    age_value = 0;
+    freshness = 0;
+    stale_while_revalidate = 0;
+    must_revalidate = false;
+    protected_ = false;
+    refs_ = 0;
+    evicted_ = false;
+}
+
+SrsHttpCacheObject::~SrsHttpCacheObject()
+{
+}
+
+int64_t SrsHttpCacheObject::age(time_t now)
+{
+    int64_t apparent_age = srs_max(0, (int64_t)(response_time - date));
+    int64_t response_delay = response_time - request_time;
+    int64_t corrected_initial_age = srs_max(apparent_age, age_value + response_delay);
+    return corrected_initial_age + srs_max(0, (int64_t)(now - response_time));
+}
+
+bool SrsHttpCacheObject::fresh(time_t now)
+{
+    return freshness > age(now);
+}
+
+bool SrsHttpCacheObject::validatable()
+{
+    return !etag.empty() || last_modified;
+}
+
+SrsHttpCacheWriter::SrsHttpCacheWriter(SrsHttpCache* cache, SrsHttpCacheObject* object, string primary, vector<string> varies)
+{
+    cache_ = cache;
+    object_ = object;
+    primary_ = primary;
+    varies_ = varies;
+    expected_ = -1;
+    failed_ = false;
+}
+
+SrsHttpCacheWriter::~SrsHttpCacheWriter()
+{
+    if (object_) {
+        cache_->destroy(object_);
+    }
+}
+
+void SrsHttpCacheWriter::set_expected(int64_t size)
+{
+    expected_ = size;
+}
+
+void SrsHttpCacheWriter::append(const char* data, int size)
+{
+    if (failed_ || size <= 0) {
+        return;
+    }
+
+    if (object_->size + size > cache_->max_object_) {
+        failed_ = true;
+        return;
+    }
+
+    while (size > 0) {
+        int offset = (int)(object_->size % SRS_HTTP_CACHE_SEGMENT);
+        if (object_->size == (int64_t)object_->segments.size() * SRS_HTTP_CACHE_SEGMENT) {
+            char* segment = cache_->alloc_segment();
+            if (!segment) {
+                failed_ = true;
+                return;
+            }
+            object_->segments.push_back(segment);
+            offset = 0;
+        }
+
+        int nn_copy = srs_min(size, SRS_HTTP_CACHE_SEGMENT - offset);
+        memcpy(object_->segments.back() + offset, data, nn_copy);
+        object_->size += nn_copy;
+        data += nn_copy;
+        size -= nn_copy;
+    }
+}
+
+bool SrsHttpCacheWriter::commit()
+{
+    // Drop the truncated body, for the origin may close the connection.
+    if (failed_ || (expected_ >= 0 && object_->size != expected_)) {
+        cache_->nn_drops_++;
+        return false;
+    }
+
+    cache_->insert(object_, primary_, varies_);
+    cache_->persist(object_, varies_);
+    cache_->nn_stores_++;
+    object_ = NULL;
+    return true;
+}
+
+SrsHttpCache::SrsHttpCache()
+{
+    enabled_ = false;
+    max_object_ = 0;
+    slab_ = new SrsHttpCacheSlab();
+    disk_ = NULL;
+    revalidator_ = NULL;
+    nn_protected_ = 0;
+
+    nn_hits_ = 0;
+    nn_misses_ = 0;
+    nn_not_modified_ = 0;
+    nn_stale_ = 0;
+    nn_revalidates_ = 0;
+    nn_revalidated_ = 0;
+    nn_stores_ = 0;
+    nn_drops_ = 0;
+    nn_evicts_ = 0;
+    nn_bytes_hit_ = 0;
+}
+
+SrsHttpCache::~SrsHttpCache()
+{
+    // Stop the workers first, which may refresh the objects.
+    srs_freep(revalidator_);
+
+    SrsHttpCacheList* lists[] = {&probation_, &protected_};
+    for (int i = 0; i < 2; i++) {
+        for (SrsHttpCacheList::iterator it = lists[i]->begin(); it != lists[i]->end(); ++it) {
+            destroy(*it);
+        }
+        lists[i]->clear();
+    }
+    objects_.clear();
+
+    srs_freep(disk_);
+    srs_freep(slab_);
+}
+
+void SrsHttpCache::initialize(int64_t capacity, int64_t max_object)
+{
+    enabled_ = true;
+    max_object_ = max_object;
+    slab_->set_max((int)(capacity / SRS_HTTP_CACHE_SEGMENT));
+
+    srs_trace("http cache capacity=%dMB, max object=%dKB, segment=%d", (int)(capacity / 1024 / 1024),
+        (int)(max_object / 1024), SRS_HTTP_CACHE_SEGMENT);
+}
+
+srs_error_t SrsHttpCache::open_disk(string dir, int64_t capacity, int nn_threads)
+{
+    srs_error_t err = srs_success;
+
+    SrsDiskCache* disk = new SrsDiskCache();
+    if ((err = disk->initialize(dir, capacity, nn_threads)) != srs_success) {
+        srs_freep(disk);
+        return srs_error_wrap(err, "disk cache %s", dir.c_str());
+    }
+
+    srs_freep(disk_);
+    disk_ = disk;
+
+    return err;
+}
+
+srs_error_t SrsHttpCache::open_revalidator(int nn_workers)
+{
+    srs_error_t err = srs_success;
+
+    SrsHttpRevalidator* revalidator = new SrsHttpRevalidator(this);
+    if ((err = revalidator->initialize(nn_workers)) != srs_success) {
+        srs_freep(revalidator);
+        return srs_error_wrap(err, "revalidator");
+    }
+
+    srs_freep(revalidator_);
+    revalidator_ = revalidator;
+
+    return err;
+}
+
+bool SrsHttpCache::enabled()
+{
+    return enabled_;
+}
+
+SrsHttpCacheObject* SrsHttpCache::lookup(SrsHttpMessage* req, const string& key, SrsHttpCacheState& state)
+{
+    state = SrsHttpCacheMiss;
+    if (!enabled_ || !acceptable(req)) {
+        return NULL;
+    }
+
+    // The client requires the validation of origin, see RFC 7234 section 5.2.1.4 and 5.4.
+    SrsHttpHeader* h = req->header();
+    SrsHttpCacheControl cc;
+    cc.parse(h->get("Cache-Control"));
+    bool no_cache = cc.no_cache || (h->get("Cache-Control").empty() && srs_string_contains(srs_string_to_lower(h->get("Pragma")), "no-cache"));
+
+    unordered_map<string, SrsHttpCacheVary>::iterator vary = varies_.find(key);
+    string secondary = (vary == varies_.end()) ? key : srs_http_cache_vary_key(req, key, vary->second.names);
+
+    unordered_map<string, SrsHttpCacheObject*>::iterator it = objects_.find(secondary);
+
+    // Load from the disk tier, the vary of key is known after loaded.
+    if (it == objects_.end() && disk_ && load(req, key)) {
+        vary = varies_.find(key);
+        secondary = (vary == varies_.end()) ? key : srs_http_cache_vary_key(req, key, vary->second.names);
+        it = objects_.find(secondary);
+    }
+
+    if (it == objects_.end()) {
+        nn_misses_++;
+        return NULL;
+    }
+
+    SrsHttpCacheObject* object = it->second;
+    time_t t = now();
+    int64_t age = object->age(t);
+    bool constrained = no_cache || cc.max_age >= 0 || cc.min_fresh >= 0;
+    if (!no_cache && object->fresh(t) && (cc.max_age < 0 || age <= cc.max_age) && (cc.min_fresh < 0 || object->freshness - age >= cc.min_fresh)) {
+        state = SrsHttpCacheFresh;
+        nn_hits_++;
+    } else if (!object->validatable() || !h->get("If-None-Match").empty() || !h->get("If-Modified-Since").empty()) {
+        // Forward the conditional request of client as is, for the validators may be different.
+        nn_misses_++;
+        return NULL;
+    } else if (!constrained && !object->must_revalidate && age - object->freshness < object->stale_while_revalidate) {
+        state = SrsHttpCacheStale;
+        nn_stale_++;
+    } else {
+        state = SrsHttpCacheRevalidate;
+        nn_revalidates_++;
+    }
+
+    touch(object);
+    object->refs_++;
+    return object;
+}
+
+void SrsHttpCache::release(SrsHttpCacheObject* object)
+{
+    object->refs_--;
+    if (object->evicted_ && object->refs_ <= 0) {
+        destroy(object);
+    }
+}
+
+string SrsHttpCache::conditional(SrsHttpMessage* req, SrsHttpCacheObject* object)
+{
+    string header = req->get_raw_header();
+    if (!srs_string_ends_with(header, SRS_HTTP_CRLFCRLF)) {
+        return header;
+    }
+
+    // Send both validators, the server uses the If-None-Match if it supports ETag, see RFC 7232 section 6.
+    stringstream ss;
+    ss << header.substr(0, header.length() - 2);
+    if (!object->etag.empty()) {
+        ss << "If-None-Match: " << object->etag << SRS_HTTP_CRLF;
+    }
+    if (object->last_modified) {
+        ss << "If-Modified-Since: " << srs_http_cache_format_date(object->last_modified) << SRS_HTTP_CRLF;
+    }
+    ss << SRS_HTTP_CRLF;
+    return ss.str();
+}
+
+bool SrsHttpCache::revalidate(SrsHttpMessage* req, SrsHttpCacheObject* object, bool https, string host, int port)
+{
+    if (!revalidator_) {
+        return false;
+    }
+    return revalidator_->revalidate(object->key, conditional(req, object), https, host, port);
+}
+
+void SrsHttpCache::refresh(SrsHttpCacheObject* object, SrsHttpMessage* resp, time_t request_time)
+{
+    // The headers of 304 replace the stored ones of the same name, except the Set-Cookie, which is for the client
+    // who validates it, and never shared.
+    vector<string> lines = srs_string_split(resp->get_raw_header(), SRS_HTTP_CRLF);
+    set<string> names;
+    string updates;
+    for (int i = 1; i < (int)lines.size(); i++) {
+        const string& line = lines.at(i);
+        size_t pos = line.find(':');
+        if (pos == string::npos || srs_http_cache_skip_header(line.substr(0, pos))
+            || srs_http_cache_header_name(line.substr(0, pos)) == "Set-Cookie"
+        ) {
+            continue;
+        }
+        names.insert(srs_string_to_lower(line.substr(0, pos)));
+        updates += line + SRS_HTTP_CRLF;
+    }
+
+    string header;
+    lines = srs_string_split(object->header, SRS_HTTP_CRLF);
+    for (int i = 0; i < (int)lines.size(); i++) {
+        const string& line = lines.at(i);
+        size_t pos = line.find(':');
+        if (pos != string::npos && names.find(srs_string_to_lower(line.substr(0, pos))) == names.end()) {
+            header += line + SRS_HTTP_CRLF;
+        }
+    }
+    object->header = header + updates;
+
+    SrsHttpHeader h;
+    lines = srs_string_split(object->header, SRS_HTTP_CRLF);
+    for (int i = 0; i < (int)lines.size(); i++) {
+        const string& line = lines.at(i);
+        size_t pos = line.find(':');
+        if (pos != string::npos) {
+            h.set(line.substr(0, pos), srs_string_trim_start(line.substr(pos + 1), " \t"));
+        }
+    }
+
+    // Calculate the freshness again, by the updated header.
+    SrsHttpCacheControl cc;
+    cc.parse(h.get("Cache-Control"));
+    time_t t = now();
+    time_t date = srs_http_cache_parse_date(h.get("Date"));
+    date = date ? date : t;
+    bool heuristic = false;
+    srs_http_cache_status(object->status, heuristic);
+
+    object->etag = h.get("ETag");
+    object->last_modified = srs_http_cache_parse_date(h.get("Last-Modified"));
+    object->request_time = srs_min(request_time, t);
+    object->response_time = t;
+    object->date = date;
+    object->age_value = srs_max(0, ::atoll(resp->header()->get("Age").c_str()));
+    object->freshness = cc.no_cache ? 0 : srs_http_cache_freshness(&h, cc, heuristic, date, object->last_modified);
+    object->stale_while_revalidate = srs_max(0, cc.stale_while_revalidate);
+    object->must_revalidate = cc.no_cache || cc.must_revalidate || cc.proxy_revalidate;
+    nn_revalidated_++;
+
+    if (!object->evicted_) {
+        unordered_map<string, SrsHttpCacheVary>::iterator it = varies_.find(object->primary);
+        persist(object, it != varies_.end() ? it->second.names : vector<string>());
+    }
+}
+
+void SrsHttpCache::refresh(const string& key, SrsHttpMessage* resp, time_t request_time)
+{
+    unordered_map<string, SrsHttpCacheObject*>::iterator it = objects_.find(key);
+    if (it != objects_.end()) {
+        refresh(it->second, resp, request_time);
+    }
+}
+
+void SrsHttpCache::invalidate(const string& key)
+{
+    unordered_map<string, SrsHttpCacheObject*>::iterator it = objects_.find(key);
+    if (it != objects_.end()) {
+        evict(it->second);
+    }
+}
+
+srs_error_t SrsHttpCache::serve(ISrsStreamWriter* out, SrsHttpMessage* req, SrsHttpCacheObject* object, bool keep_alive, int* pstatus)
+{
+    srs_error_t err = srs_success;
+
+    // The If-None-Match takes precedence over If-Modified-Since, see RFC 7232 section 6.
+    SrsHttpHeader* h = req->header();
+    bool not_modified = false;
+    if (!h->get("If-None-Match").empty()) {
+        not_modified = !object->etag.empty() && srs_http_cache_etag_match(object->etag, h->get("If-None-Match"));
+    } else if (!h->get("If-Modified-Since").empty()) {
+        time_t since = srs_http_cache_parse_date(h->get("If-Modified-Since"));
+        time_t modified = object->last_modified ? object->last_modified : object->date;
+        not_modified = since && modified <= since;
+    }
+
+    int status = not_modified ? SRS_CONSTS_HTTP_NotModified : object->status;
+    stringstream ss;
+    ss << "HTTP/1.1 " << status << " " << srs_generate_http_status_text(status) << SRS_HTTP_CRLF;
+
+    if (!not_modified) {
+        ss << object->header;
+    } else {
+        // The 304 has no content, so ignore the headers of content.
+        vector<string> lines = srs_string_split(object->header, SRS_HTTP_CRLF);
+        for (int i = 0; i < (int)lines.size(); i++) {
+            if (!lines.at(i).empty() && !srs_string_starts_with(srs_string_to_lower(lines.at(i)), "content-")) {
+                ss << lines.at(i) << SRS_HTTP_CRLF;
+            }
+        }
+    }
+
+    time_t t = now();
+    ss << "Age: " << object->age(t) << SRS_HTTP_CRLF;
+    if (!object->fresh(t) && !object->must_revalidate) {
+        ss << "Warning: 110 - \"Response is Stale\"" << SRS_HTTP_CRLF;
+    }
+    if (!not_modified) {
+        ss << "Content-Length: " << object->size << SRS_HTTP_CRLF;
+    }
+    if (!keep_alive) {
+        ss << "Connection: close" << SRS_HTTP_CRLF;
+    }
+    ss << SRS_HTTP_CRLF;
+
+    if (pstatus) {
+        *pstatus = status;
+    }
+
+    string header = ss.str();
+    if ((err = out->write((void*)header.data(), header.size(), NULL)) != srs_success) {
+        return srs_error_wrap(err, "write header");
+    }
+
+    if (not_modified) {
+        nn_not_modified_++;
+        return err;
+    }
+
+    int64_t left = object->size;
+    for (int i = 0; i < (int)object->segments.size() && left > 0; i++) {
+        int size = (int)srs_min(left, (int64_t)SRS_HTTP_CACHE_SEGMENT);
+        if ((err = out->write(object->segments.at(i), size, NULL)) != srs_success) {
+            return srs_error_wrap(err, "write body");
+        }
+        left -= size;
+    }
+    nn_bytes_hit_ += object->size;
+
+    return err;
+}
+
+SrsHttpCacheWriter* SrsHttpCache::store(SrsHttpMessage* req, SrsHttpMessage* resp, const string& key, time_t request_time)
+{
+    if (!enabled_ || !acceptable(req)) {
+        return NULL;
+    }
+
+    bool heuristic = false;
+    int status = resp->status_code();
+    if (!srs_http_cache_status(status, heuristic)) {
+        return NULL;
+    }
+
+    // The response which is private is not stored by this cache.
+    SrsHttpHeader* h = resp->header();
+    SrsHttpCacheControl cc;
+    cc.parse(h->get("Cache-Control"));
+    if (cc.no_store || cc.private_) {
+        return NULL;
+    }
+
+    // The cookie is for the client, never share it, and the partial content is not supported.
+    if (srs_http_cache_has_cookie(resp->get_raw_header()) || !h->get("Content-Range").empty()) {
+        return NULL;
+    }
+
+    // The body is relayed only if it's chunked or has length.
+    int64_t content_length = resp->is_chunked() ? -1 : resp->content_length();
+    if ((!resp->is_chunked() && content_length < 0 && status != SRS_CONSTS_HTTP_NoContent) || content_length > max_object_) {
+        return NULL;
+    }
+
+    vector<string> varies;
+    if (!srs_http_cache_vary_names(h->get("Vary"), varies)) {
+        return NULL;
+    }
+
+    time_t t = now();
+    time_t date = srs_http_cache_parse_date(h->get("Date"));
+    date = date ? date : t;
+    time_t last_modified = srs_http_cache_parse_date(h->get("Last-Modified"));
+    bool validatable = !h->get("ETag").empty() || last_modified;
+
+    // The no-cache response is stored, but always revalidated before served, see RFC 7234 section 5.2.2.2.
+    int64_t freshness = cc.no_cache ? 0 : srs_http_cache_freshness(h, cc, heuristic, date, last_modified);
+    bool explicit_ = cc.no_cache || cc.s_maxage >= 0 || cc.max_age >= 0 || !h->get("Expires").empty();
+    if (freshness <= 0 && (!validatable || (!heuristic && !explicit_))) {
+        return NULL;
+    }
+
+    SrsHttpCacheObject* object = new SrsHttpCacheObject();
+    object->key = varies.empty() ? key : srs_http_cache_vary_key(req, key, varies);
+    object->status = status;
+    object->etag = h->get("ETag");
+    object->last_modified = last_modified;
+    object->request_time = srs_min(request_time, t);
+    object->response_time = t;
+    object->date = date;
+    object->age_value = srs_max(0, ::atoll(h->get("Age").c_str()));
+    object->freshness = freshness;
+    object->stale_while_revalidate = srs_max(0, cc.stale_while_revalidate);
+    object->must_revalidate = cc.no_cache || cc.must_revalidate || cc.proxy_revalidate;
+
+    // Keep the end-to-end headers, from the header restored by parser.
+    vector<string> lines = srs_string_split(resp->get_raw_header(), SRS_HTTP_CRLF);
+    for (int i = 1; i < (int)lines.size(); i++) {
+        const string& line = lines.at(i);
+        size_t pos = line.find(':');
+        if (pos == string::npos || srs_http_cache_skip_header(line.substr(0, pos))) {
+            continue;
+        }
+        object->header += line + SRS_HTTP_CRLF;
+    }
+
+    SrsHttpCacheWriter* writer = new SrsHttpCacheWriter(this, object, key, varies);
+    writer->set_expected(content_length);
+    return writer;
+}
+
+int SrsHttpCache::size()
+{
+    return (int)objects_.size();
+}
+
+int64_t SrsHttpCache::bytes()
+{
+    return (int64_t)slab_->used() * SRS_HTTP_CACHE_SEGMENT;
+}
+
+void SrsHttpCache::dumps(SrsJsonObject* obj)
+{
+    obj->set("enabled", SrsJsonAny::boolean(enabled_));
+    obj->set("objects", SrsJsonAny::integer(objects_.size()));
+    obj->set("bytes", SrsJsonAny::integer(bytes()));
+    obj->set("capacity", SrsJsonAny::integer((int64_t)slab_->max() * SRS_HTTP_CACHE_SEGMENT));
+    obj->set("memory", SrsJsonAny::integer(slab_->memory()));
+    obj->set("protected", SrsJsonAny::integer(protected_.size()));
+    obj->set("hits", SrsJsonAny::integer(nn_hits_));
+    obj->set("misses", SrsJsonAny::integer(nn_misses_));
+    obj->set("not_modified", SrsJsonAny::integer(nn_not_modified_));
+    obj->set("stale", SrsJsonAny::integer(nn_stale_));
+    obj->set("revalidates", SrsJsonAny::integer(nn_revalidates_));
+    obj->set("revalidated", SrsJsonAny::integer(nn_revalidated_));
+    obj->set("bytes_hit", SrsJsonAny::integer(nn_bytes_hit_));
+    obj->set("stores", SrsJsonAny::integer(nn_stores_));
+    obj->set("drops", SrsJsonAny::integer(nn_drops_));
+    obj->set("evicts", SrsJsonAny::integer(nn_evicts_));
+
+    if (disk_) {
+        SrsJsonObject* disk = SrsJsonAny::object();
+        obj->set("disk", disk);
+        disk_->dumps(disk);
+    }
+
+    if (revalidator_) {
+        SrsJsonObject* revalidator = SrsJsonAny::object();
+        obj->set("revalidator", revalidator);
+        revalidator_->dumps(revalidator);
+    }
+}
+
+time_t SrsHttpCache::now()
+{
+    return (time_t)(srs_update_system_time() / SRS_UTIME_SECONDS);
+}
+
+bool SrsHttpCache::acceptable(SrsHttpMessage* req)
+{
+    if (!req->is_http_get() || req->is_chunked() || req->content_length() > 0) {
+        return false;
+    }
+
+    // The shared cache never uses the response for authorization, see RFC 7234 section 3.2.
+    SrsHttpHeader* h = req->header();
+    if (!h->get("Authorization").empty()) {
+        return false;
+    }
+
+    SrsHttpCacheControl cc;
+    cc.parse(h->get("Cache-Control"));
+    return !cc.no_store;
+}
+
+char* SrsHttpCache::alloc_segment()
+{
+    while (true) {
+        char* segment = slab_->alloc();
+        if (segment) {
+            return segment;
+        }
+
+        // Evict the least recently used object in probation, then in protected. The segments of object in use
+        // are freed when released, so keep evicting until got one.
+        if (!probation_.empty()) {
+            evict(probation_.back());
+        } else if (!protected_.empty()) {
+            evict(protected_.back());
+        } else {
+            return NULL;
+        }
+    }
+}
+
+void SrsHttpCache::insert(SrsHttpCacheObject* object, string primary, vector<string>& varies)
+{
+    unordered_map<string, SrsHttpCacheObject*>::iterator it = objects_.find(object->key);
+    if (it != objects_.end()) {
+        evict(it->second);
+    }
+
+    SrsHttpCacheVary& vary = varies_[primary];
+    vary.names = varies;
+    vary.refs++;
+    object->primary = primary;
+
+    probation_.push_front(object);
+    object->it_ = probation_.begin();
+    object->protected_ = false;
+    objects_[object->key] = object;
+}
+
+void SrsHttpCache::persist(SrsHttpCacheObject* object, const vector<string>& varies)
+{
+    if (!disk_) {
+        return;
+    }
+
+    string data;
+    srs_http_cache_encode(object, varies, data);
+
+    // The time when the object is stale, that is, the age equals to freshness, while the stale object is kept
+    // for a while to revalidate, if it has validators.
+    time_t expires = object->response_time + object->freshness - object->age(object->response_time);
+    expires += object->validatable() ? SRS_HTTP_CACHE_MAX_STALE : 0;
+    disk_->write(object->primary, (uint32_t)srs_max(0, (int64_t)expires), data);
+}
+
+bool SrsHttpCache::load(SrsHttpMessage* req, const string& key)
+{
+    srs_error_t err = srs_success;
+
+    string data;
+    if ((err = disk_->read(key, (uint32_t)now(), data)) != srs_success) {
+        srs_warn("http cache ignore disk err %s", srs_error_desc(err).c_str());
+        srs_freep(err);
+        return false;
+    }
+    if (data.empty()) {
+        return false;
+    }
+
+    // The disk tier has the last variant only, which may not match the request.
+    size_t pos = 0;
+    vector<string> varies;
+    SrsHttpCacheObject* object = new SrsHttpCacheObject();
+    if (!srs_http_cache_decode(data, object, varies, pos) || object->key != (varies.empty() ? key : srs_http_cache_vary_key(req, key, varies))) {
+        srs_freep(object);
+        return false;
+    }
+
+    while (pos < data.length()) {
+        char* segment = alloc_segment();
+        if (!segment) {
+            destroy(object);
+            return false;
+        }
+
+        int size = (int)srs_min(data.length() - pos, (size_t)SRS_HTTP_CACHE_SEGMENT);
+        memcpy(segment, data.data() + pos, size);
+        object->segments.push_back(segment);
+        object->size += size;
+        pos += size;
+    }
+
+    insert(object, key, varies);
+    return true;
+}
+
+void SrsHttpCache::touch(SrsHttpCacheObject* object)
+{
+    if (object->protected_) {
+        protected_.splice(protected_.begin(), protected_, object->it_);
+        return;
+    }
+
+    // Promote to the protected segment, and demote the least recently used of protected to probation.
+    protected_.splice(protected_.begin(), probation_, object->it_);
+    object->protected_ = true;
+    nn_protected_ += (int)object->segments.size();
+
+    while (protected_.size() > 1 && (int64_t)nn_protected_ * 100 > (int64_t)slab_->max() * SRS_HTTP_CACHE_PROTECTED) {
+        SrsHttpCacheObject* victim = protected_.back();
+        probation_.splice(probation_.begin(), protected_, victim->it_);
+        victim->protected_ = false;
+        nn_protected_ -= (int)victim->segments.size();
+    }
+}
+
+void SrsHttpCache::evict(SrsHttpCacheObject* object)
+{
+    if (object->protected_) {
+        protected_.erase(object->it_);
+        nn_protected_ -= (int)object->segments.size();
+    } else {
+        probation_.erase(object->it_);
+    }
+    objects_.erase(object->key);
+
+    unordered_map<string, SrsHttpCacheVary>::iterator it = varies_.find(object->primary);
+    if (it != varies_.end() && --it->second.refs <= 0) {
+        varies_.erase(it);
+    }
+
+    object->evicted_ = true;
+    nn_evicts_++;
+    if (object->refs_ <= 0) {
+        destroy(object);
+    }
+}
+
+void SrsHttpCache::destroy(SrsHttpCacheObject* object)
+{
+    for (int i = 0; i < (int)object->segments.size(); i++) {
+        slab_->free(object->segments.at(i));
+    }
+    object->segments.clear();
+    srs_freep(object);
+}
@@ -0,0 +1,285 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_HTTP_CACHE_HPP
+#define SRS_APP_HTTP_CACHE_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+class SrsHttpMessage;
+class SrsJsonObject;
+class ISrsStreamWriter;
+class SrsHttpCache;
+class SrsDiskCache;
+class SrsHttpRevalidator;
+
+// The bytes of segment, the body of object is stored in segments, so the memory is never fragmented.
+#define SRS_HTTP_CACHE_SEGMENT 4096
+// The segments of a slab, which is allocated from system once.
+#define SRS_HTTP_CACHE_SLAB_SEGMENTS 256
+
+// The directives of Cache-Control, see RFC 7234 section 5.2.
+class SrsHttpCacheControl
+{
+public:
+    bool no_store;
+    bool no_cache;
+    bool private_;
+    bool public_;
+    bool must_revalidate;
+    bool proxy_revalidate;
+    // The delta seconds, -1 if not present.
+    int64_t max_age;
+    int64_t s_maxage;
+    int64_t min_fresh;
+    // The seconds to serve the stale response when revalidating it in background, see RFC 5861.
+    int64_t stale_while_revalidate;
+public:
+    SrsHttpCacheControl();
+    virtual ~SrsHttpCacheControl();
+public:
+    // Parse the value of Cache-Control, the unknown directives are ignored.
+    virtual void parse(std::string value);
+};
+
+// The state of the cached object for request.
+enum SrsHttpCacheState
+{
+    // Not cached, or stale without validators.
+    SrsHttpCacheMiss = 0,
+    // Fresh, serve it without forwarding the request.
+    SrsHttpCacheFresh,
+    // Stale but in the window of stale-while-revalidate, serve it and revalidate it in background.
+    SrsHttpCacheStale,
+    // Stale, serve it only if the server replies 304 to the conditional request.
+    SrsHttpCacheRevalidate,
+};
+
+// Parse the HTTP-date of RFC 7231, for example, "Sun, 06 Nov 1994 08:49:37 GMT".
+// @return The seconds since epoch, 0 if invalid.
+extern time_t srs_http_cache_parse_date(std::string value);
+
+// Get the primary key of request, which is the scheme, host, port, path and query.
+extern std::string srs_http_cache_key(bool https, SrsHttpMessage* req);
+
+// Parse the header names of Vary, the names are canonical like "Accept-Encoding".
+// @return false if it's "*", which never matches.
+extern bool srs_http_cache_vary_names(std::string vary, std::vector<std::string>& names);
+
+// Get the secondary key, by the primary key and the values of vary headers in request.
+extern std::string srs_http_cache_vary_key(SrsHttpMessage* req, const std::string& primary, const std::vector<std::string>& names);
+
+// Whether the raw header has a Set-Cookie field in any case, which is for one client and never shared.
+// @remark The parser only takes "Set-Cookie" and "set-cookie" as cookie, so check the raw header.
+extern bool srs_http_cache_has_cookie(const std::string& header);
+
+// The allocator of segments, which allocates slabs from system up to the max, and never frees them until
+// it's destroyed, so the memory of cache is bounded and never fragmented by the objects of any size.
+class SrsHttpCacheSlab
+{
+private:
+    std::vector<char*> slabs_;
+    std::vector<char*> free_;
+    int max_segments_;
+    int nn_used_;
+public:
+    SrsHttpCacheSlab();
+    virtual ~SrsHttpCacheSlab();
+public:
+    virtual void set_max(int segments);
+    // Get a segment, NULL if all are used.
+    virtual char* alloc();
+    virtual void free(char* segment);
+    // The number of segments in use, and the max.
+    virtual int used();
+    virtual int max();
+    // The bytes allocated from system.
+    virtual size_t memory();
+};
+
+// The cached response, the body is immutable once stored, while the header and times are updated when it's
+// revalidated by server.
+// @remark The object is reference counted, so it's never freed when writing to client, even if evicted.
+class SrsHttpCacheObject
+{
+    friend class SrsHttpCache;
+    friend class SrsHttpCacheWriter;
+public:
+    std::string key;
+    // The primary key, which is the key if no Vary.
+    std::string primary;
+    int status;
+    // The header lines without the hop-by-hop headers, Age and Content-Length, which are set when served.
+    std::string header;
+    std::vector<char*> segments;
+    int64_t size;
+    // The validators, to reply 304 for the conditional request.
+    std::string etag;
+    time_t last_modified;
+    // The times to calculate the age, see RFC 7234 section 4.2.3.
+    time_t request_time;
+    time_t response_time;
+    time_t date;
+    int64_t age_value;
+    // The seconds of freshness lifetime.
+    int64_t freshness;
+    // The seconds to serve it when stale, and whether it's never served stale without validation.
+    int64_t stale_while_revalidate;
+    bool must_revalidate;
+private:
+    // In the protected segment of SLRU, or the probation segment.
+    bool protected_;
+    std::list<SrsHttpCacheObject*>::iterator it_;
+    int refs_;
+    bool evicted_;
+public:
+    SrsHttpCacheObject();
+    virtual ~SrsHttpCacheObject();
+public:
+    // The current age in seconds.
+    virtual int64_t age(time_t now);
+    virtual bool fresh(time_t now);
+    // Whether it can be revalidated by a conditional request.
+    virtual bool validatable();
+};
+
+// Store the response body to cache when relaying it, the object is inserted when commit, or dropped when
+// it's too large or the writer is freed before commit.
+class SrsHttpCacheWriter
+{
+private:
+    SrsHttpCache* cache_;
+    SrsHttpCacheObject* object_;
+    // The primary key, and the vary headers of response.
+    std::string primary_;
+    std::vector<std::string> varies_;
+    // The expected bytes of body, -1 if chunked.
+    int64_t expected_;
+    bool failed_;
+public:
+    SrsHttpCacheWriter(SrsHttpCache* cache, SrsHttpCacheObject* object, std::string primary, std::vector<std::string> varies);
+    virtual ~SrsHttpCacheWriter();
+public:
+    virtual void set_expected(int64_t size);
+    // Append the body, the writer fails and drops the object if it's larger than max object.
+    virtual void append(const char* data, int size);
+    // Insert the object to cache, if not failed and the body is complete.
+    // @return Whether the object is inserted.
+    virtual bool commit();
+};
+
+// The names of Vary headers of a primary key, and the number of objects by it.
+struct SrsHttpCacheVary
+{
+    std::vector<std::string> names;
+    int refs;
+    SrsHttpCacheVary() : refs(0) {}
+};
+
+// The response cache of RFC 7234, which is a private cache shared by all clients of proxy.
+// The objects are keyed by URL and the request headers of Vary, the bodies are in segments of slab, and
+// the memory is bounded by a segmented LRU, the new object is in probation segment, and promoted to the
+// protected segment when hit again, so the one-hit objects never flush the hot ones.
+// @remark There is no lock, because it's only used in the ST thread.
+class SrsHttpCache
+{
+    friend class SrsHttpCacheWriter;
+private:
+    typedef std::list<SrsHttpCacheObject*> SrsHttpCacheList;
+private:
+    bool enabled_;
+    int64_t max_object_;
+    SrsHttpCacheSlab* slab_;
+    // The disk tier behind memory, NULL if disabled.
+    SrsDiskCache* disk_;
+    // The workers to revalidate the stale objects in background, NULL if disabled.
+    SrsHttpRevalidator* revalidator_;
+    // The most recently used is at front.
+    SrsHttpCacheList probation_;
+    SrsHttpCacheList protected_;
+    // The segments in protected segment, at most SRS_HTTP_CACHE_PROTECTED percent of all.
+    int nn_protected_;
+    std::unordered_map<std::string, SrsHttpCacheObject*> objects_;
+    // The Vary headers by primary key.
+    std::unordered_map<std::string, SrsHttpCacheVary> varies_;
+private:
+    uint64_t nn_hits_;
+    uint64_t nn_misses_;
+    uint64_t nn_not_modified_;
+    uint64_t nn_stale_;
+    uint64_t nn_revalidates_;
+    uint64_t nn_revalidated_;
+    uint64_t nn_stores_;
+    uint64_t nn_drops_;
+    uint64_t nn_evicts_;
+    uint64_t nn_bytes_hit_;
+public:
+    SrsHttpCache();
+    virtual ~SrsHttpCache();
+public:
+    // Enable the cache with the max bytes of bodies, and the max bytes of a body.
+    virtual void initialize(int64_t capacity, int64_t max_object);
+    // Enable the disk tier, the stored objects are also written to disk, and loaded to memory when hit.
+    virtual srs_error_t open_disk(std::string dir, int64_t capacity, int nn_threads);
+    // Start the workers to revalidate the stale objects in background, for stale-while-revalidate.
+    virtual srs_error_t open_revalidator(int nn_workers);
+    virtual bool enabled();
+    // Get the object for request, NULL if miss, the object should be released.
+    // @param state Output the state of object, which is fresh, stale or to revalidate if not NULL.
+    virtual SrsHttpCacheObject* lookup(SrsHttpMessage* req, const std::string& key, SrsHttpCacheState& state);
+    virtual void release(SrsHttpCacheObject* object);
+    // Get the request header to revalidate the object, with the validators of object.
+    virtual std::string conditional(SrsHttpMessage* req, SrsHttpCacheObject* object);
+    // Revalidate the stale object in background, by the server of host and port.
+    // @return false if not started or too many pending, the object should be revalidated by request.
+    virtual bool revalidate(SrsHttpMessage* req, SrsHttpCacheObject* object, bool https, std::string host, int port);
+    // Update the object by the 304 of server, see RFC 7234 section 4.3.4.
+    // @param request_time The time in seconds when the conditional request is sent to origin.
+    virtual void refresh(SrsHttpCacheObject* object, SrsHttpMessage* resp, time_t request_time);
+    // Update the object of key, ignore if evicted.
+    virtual void refresh(const std::string& key, SrsHttpMessage* resp, time_t request_time);
+    // Remove the object of key, for example, it's modified.
+    virtual void invalidate(const std::string& key);
+    // Write the object to client, or 304 if the request is conditional and the object is not modified.
+    // @param keep_alive Whether the client connection is keep-alive.
+    // @param pstatus Output the status code, ignored if NULL.
+    virtual srs_error_t serve(ISrsStreamWriter* out, SrsHttpMessage* req, SrsHttpCacheObject* object, bool keep_alive, int* pstatus);
+    // Start to store the response, NULL if it's not cacheable, see RFC 7234 section 3.
+    // @param request_time The time in seconds when the request is sent to origin.
+    virtual SrsHttpCacheWriter* store(SrsHttpMessage* req, SrsHttpMessage* resp, const std::string& key, time_t request_time);
+    // The number of objects, and the bytes of bodies.
+    virtual int size();
+    virtual int64_t bytes();
+    virtual void dumps(SrsJsonObject* obj);
+    // The current time in seconds.
+    virtual time_t now();
+private:
+    // Whether the request can be served from or stored to cache.
+    virtual bool acceptable(SrsHttpMessage* req);
+    // Get a segment for writer, evict the objects if full.
+    virtual char* alloc_segment();
+    virtual void insert(SrsHttpCacheObject* object, std::string primary, std::vector<std::string>& varies);
+    // Write the object to disk tier, which is keyed by the primary key, so only the last variant is on disk.
+    virtual void persist(SrsHttpCacheObject* object, const std::vector<std::string>& varies);
+    // Load the object of request from disk tier to memory.
+    // @remark The coroutine waits for the disk.
+    virtual bool load(SrsHttpMessage* req, const std::string& key);
+    virtual void touch(SrsHttpCacheObject* object);
+    virtual void evict(SrsHttpCacheObject* object);
+    virtual void destroy(SrsHttpCacheObject* object);
+};
+
+extern SrsHttpCache* _srs_http_cache;
+
+// Release the object of global cache, for SrsAutoFreeH.
+extern void srs_http_cache_release(SrsHttpCacheObject* object);
+
+#endif
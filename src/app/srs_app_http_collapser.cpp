@@ -0,0 +1,303 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_http_collapser.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_kernel_io.hpp>
+#include <srs_kernel_consts.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_app_http_cache.hpp>
+
+#include <errno.h>
+using namespace std;
+
+SrsHttpCollapser* _srs_http_collapser = NULL;
+
+SrsHttpInflight::SrsHttpInflight(SrsHttpCollapser* collapser, string key)
+{
+    collapser_ = collapser;
+    key_ = key;
+    refs_ = 0;
+    cond_ = srs_cond_new();
+
+    header_ready_ = false;
+    shareable_ = false;
+    status_ = 0;
+    chunked_ = false;
+    bytes_ = 0;
+    done_ = false;
+    failed_ = false;
+}
+
+SrsHttpInflight::~SrsHttpInflight()
+{
+    srs_cond_destroy(cond_);
+}
+
+void SrsHttpInflight::on_header(SrsHttpMessage* req, SrsHttpMessage* resp)
+{
+    header_ = resp->get_raw_header();
+    status_ = resp->status_code();
+    chunked_ = resp->is_chunked();
+
+    // The response for the client only, or too large to buffer, is never shared.
+    SrsHttpHeader* h = resp->header();
+    SrsHttpCacheControl cc;
+    cc.parse(h->get("Cache-Control"));
+    shareable_ = status_ >= SRS_CONSTS_HTTP_OK && !cc.private_ && !cc.no_store
+        && !srs_http_cache_has_cookie(header_) && srs_http_cache_vary_names(h->get("Vary"), varies_)
+        && (chunked_ || resp->content_length() <= collapser_->max_buffer_);
+    vary_key_ = srs_http_cache_vary_key(req, "", varies_);
+
+    header_ready_ = true;
+    if (!shareable_) {
+        collapser_->remove(this);
+    }
+    srs_cond_broadcast(cond_);
+}
+
+void SrsHttpInflight::on_body(const char* data, int size)
+{
+    if (!shareable_ || failed_ || size <= 0) {
+        return;
+    }
+
+    // The chunked body is larger than expected, the followers fail.
+    if (bytes_ + size > collapser_->max_buffer_) {
+        fail();
+        return;
+    }
+
+    chunks_.push_back(string(data, size));
+    bytes_ += size;
+    srs_cond_broadcast(cond_);
+}
+
+void SrsHttpInflight::on_done()
+{
+    done_ = true;
+    collapser_->remove(this);
+    srs_cond_broadcast(cond_);
+}
+
+srs_error_t SrsHttpInflight::follow(ISrsStreamWriter* out, SrsHttpMessage* req, int* pstatus, bool& fallback)
+{
+    srs_error_t err = srs_success;
+
+    fallback = false;
+    srs_utime_t deadline = srs_update_system_time() + collapser_->timeout_;
+    while (!header_ready_ && !failed_) {
+        if (srs_update_system_time() >= deadline) {
+            return srs_error_new(ERROR_SOCKET_TIMEOUT, "wait header of %s", key_.c_str());
+        }
+        if (srs_cond_timedwait(cond_, deadline - srs_update_system_time()) != 0 && errno == EINTR) {
+            return srs_error_new(ERROR_THREAD_INTERRUPED, "wait header of %s", key_.c_str());
+        }
+    }
+
+    // Send the request to server, if the response is not for it.
+    if (!header_ready_ || !shareable_ || vary_key_ != srs_http_cache_vary_key(req, "", varies_)) {
+        collapser_->nn_fallbacks_++;
+        fallback = true;
+        return err;
+    }
+
+    if (pstatus) {
+        *pstatus = status_;
+    }
+    if ((err = out->write((void*)header_.data(), header_.size(), NULL)) != srs_success) {
+        return srs_error_wrap(err, "write header");
+    }
+
+    for (size_t pos = 0; ; ) {
+        if (failed_) {
+            return srs_error_new(ERROR_HTTP_RESPONSE_EOF, "leader of %s failed", key_.c_str());
+        }
+
+        // The chunk is never moved or freed when writing, because the deque only grows until the flight is freed.
+        if (pos < chunks_.size()) {
+            const string& chunk = chunks_.at(pos++);
+            if (chunked_) {
+                char size[32];
+                int nn_size = snprintf(size, sizeof(size), "%x\r\n", (int)chunk.size());
+                if ((err = out->write(size, nn_size, NULL)) != srs_success) {
+                    return srs_error_wrap(err, "write chunk size");
+                }
+            }
+            if ((err = out->write((void*)chunk.data(), chunk.size(), NULL)) != srs_success) {
+                return srs_error_wrap(err, "write body");
+            }
+            if (chunked_ && (err = out->write((void*)"\r\n", 2, NULL)) != srs_success) {
+                return srs_error_wrap(err, "write chunk end");
+            }
+            collapser_->nn_bytes_ += chunk.size();
+            continue;
+        }
+
+        if (done_) {
+            if (chunked_ && (err = out->write((void*)"0\r\n\r\n", 5, NULL)) != srs_success) {
+                return srs_error_wrap(err, "write last chunk");
+            }
+            break;
+        }
+
+        // The leader is slow, because the server is slow.
+        if (srs_cond_timedwait(cond_, collapser_->timeout_) != 0) {
+            if (errno == EINTR) {
+                return srs_error_new(ERROR_THREAD_INTERRUPED, "wait body of %s", key_.c_str());
+            }
+            if (pos >= chunks_.size() && !done_ && !failed_) {
+                return srs_error_new(ERROR_SOCKET_TIMEOUT, "wait body of %s", key_.c_str());
+            }
+        }
+    }
+
+    return err;
+}
+
+void SrsHttpInflight::fail()
+{
+    if (failed_) {
+        return;
+    }
+
+    failed_ = true;
+    collapser_->nn_failed_++;
+    collapser_->remove(this);
+    srs_cond_broadcast(cond_);
+}
+
+SrsHttpCollapser::SrsHttpCollapser()
+{
+    enabled_ = false;
+    max_buffer_ = 0;
+    timeout_ = 0;
+
+    nn_leaders_ = 0;
+    nn_followers_ = 0;
+    nn_fallbacks_ = 0;
+    nn_failed_ = 0;
+    nn_bytes_ = 0;
+}
+
+SrsHttpCollapser::~SrsHttpCollapser()
+{
+    // The flights are freed by the coroutines, which are stopped before.
+    flights_.clear();
+}
+
+void SrsHttpCollapser::initialize(int64_t max_buffer, srs_utime_t timeout)
+{
+    enabled_ = true;
+    max_buffer_ = max_buffer;
+    timeout_ = timeout;
+
+    srs_trace("http collapsed forwarding max buffer=%dKB, timeout=%dms", (int)(max_buffer / 1024), srsu2msi(timeout));
+}
+
+bool SrsHttpCollapser::enabled()
+{
+    return enabled_;
+}
+
+SrsHttpInflight* SrsHttpCollapser::join(SrsHttpMessage* req, const string& key, bool& leader)
+{
+    if (!enabled_ || !acceptable(req)) {
+        return NULL;
+    }
+
+    SrsHttpInflight* flight = NULL;
+    unordered_map<string, SrsHttpInflight*>::iterator it = flights_.find(key);
+    if (it != flights_.end()) {
+        flight = it->second;
+        leader = false;
+        nn_followers_++;
+    } else {
+        flight = new SrsHttpInflight(this, key);
+        flights_[key] = flight;
+        leader = true;
+        nn_leaders_++;
+    }
+
+    flight->refs_++;
+    return flight;
+}
+
+void SrsHttpCollapser::release(SrsHttpInflight* flight)
+{
+    if (--flight->refs_ > 0) {
+        return;
+    }
+
+    remove(flight);
+    srs_freep(flight);
+}
+
+void SrsHttpCollapser::leave(SrsHttpInflight* flight)
+{
+    if (!flight->done_) {
+        flight->fail();
+    }
+    release(flight);
+}
+
+int SrsHttpCollapser::size()
+{
+    return (int)flights_.size();
+}
+
+void SrsHttpCollapser::dumps(SrsJsonObject* obj)
+{
+    obj->set("enabled", SrsJsonAny::boolean(enabled_));
+    obj->set("flights", SrsJsonAny::integer(flights_.size()));
+    obj->set("leaders", SrsJsonAny::integer(nn_leaders_));
+    obj->set("followers", SrsJsonAny::integer(nn_followers_));
+    obj->set("fallbacks", SrsJsonAny::integer(nn_fallbacks_));
+    obj->set("failed", SrsJsonAny::integer(nn_failed_));
+    obj->set("bytes", SrsJsonAny::integer(nn_bytes_));
+}
+
+bool SrsHttpCollapser::acceptable(SrsHttpMessage* req)
+{
+    if (!req->is_http_get() || req->is_chunked() || req->content_length() > 0) {
+        return false;
+    }
+
+    // The response to these requests may be different for each client.
+    SrsHttpHeader* h = req->header();
+    static const char* headers[] = {"Authorization", "Cookie", "Range", "If-None-Match", "If-Modified-Since",
+        "If-Match", "If-Unmodified-Since", "If-Range", "Upgrade"};
+    for (int i = 0; i < (int)(sizeof(headers) / sizeof(headers[0])); i++) {
+        if (!h->get(headers[i]).empty()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SrsHttpCollapser::remove(SrsHttpInflight* flight)
+{
+    unordered_map<string, SrsHttpInflight*>::iterator it = flights_.find(flight->key_);
+    if (it != flights_.end() && it->second == flight) {
+        flights_.erase(it);
+    }
+}
+
+SrsHttpInflightGuard::SrsHttpInflightGuard(SrsHttpInflight* flight)
+{
+    flight_ = flight;
+}
+
+SrsHttpInflightGuard::~SrsHttpInflightGuard()
+{
+    if (flight_) {
+        flight_->collapser_->leave(flight_);
+    }
+}
@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_HTTP_COLLAPSER_HPP
+#define SRS_APP_HTTP_COLLAPSER_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+#include <srs_protocol_st.hpp>
+
+class SrsHttpMessage;
+class SrsJsonObject;
+class ISrsStreamWriter;
+class SrsHttpCollapser;
+
+// The upstream response in flight, which is relayed to the leader client by the leader coroutine, and to
+// the follower clients by their coroutines, as the body arrives.
+// @remark The body is kept until the flight is done, at most max buffer bytes.
+class SrsHttpInflight
+{
+    friend class SrsHttpCollapser;
+    friend class SrsHttpInflightGuard;
+private:
+    SrsHttpCollapser* collapser_;
+    std::string key_;
+    int refs_;
+    // Signal the followers when header, body or done.
+    srs_cond_t cond_;
+private:
+    bool header_ready_;
+    // Whether the response can be relayed to other clients, for example, it's not private.
+    bool shareable_;
+    std::string header_;
+    int status_;
+    bool chunked_;
+    // The Vary names, and the values of leader request.
+    std::vector<std::string> varies_;
+    std::string vary_key_;
+    // The body parts, which are never moved when appending, so the follower writes them without copy.
+    std::deque<std::string> chunks_;
+    int64_t bytes_;
+    bool done_;
+    // The leader fails, or the body is larger than max buffer.
+    bool failed_;
+public:
+    SrsHttpInflight(SrsHttpCollapser* collapser, std::string key);
+    virtual ~SrsHttpInflight();
+// For leader.
+public:
+    // The response header is received, and it's relayed to the leader client.
+    virtual void on_header(SrsHttpMessage* req, SrsHttpMessage* resp);
+    // The body part is received, without the chunk header.
+    virtual void on_body(const char* data, int size);
+    // The whole body is received.
+    virtual void on_done();
+// For follower.
+public:
+    // Relay the response to client, as the leader receives it.
+    // @param pstatus Output the status code, ignored if NULL.
+    // @param fallback Output whether the response can't be shared, the request should be sent to server by itself.
+    virtual srs_error_t follow(ISrsStreamWriter* out, SrsHttpMessage* req, int* pstatus, bool& fallback);
+private:
+    virtual void fail();
+};
+
+// The collapsed forwarding, which coalesces the concurrent identical GET requests, the first one is sent to
+// server, while the others wait for its response, so the server only gets one request for a popular object
+// when it's first requested or expired in cache.
+// @remark The key is the URL, the Vary is checked when response header received, because it's not known before.
+// @remark The requests with credential, cookie, range or conditional headers are never coalesced, because
+//      the responses may be for the client only.
+class SrsHttpCollapser
+{
+    friend class SrsHttpInflight;
+private:
+    bool enabled_;
+    int64_t max_buffer_;
+    srs_utime_t timeout_;
+    std::unordered_map<std::string, SrsHttpInflight*> flights_;
+private:
+    uint64_t nn_leaders_;
+    uint64_t nn_followers_;
+    uint64_t nn_fallbacks_;
+    uint64_t nn_failed_;
+    uint64_t nn_bytes_;
+public:
+    SrsHttpCollapser();
+    virtual ~SrsHttpCollapser();
+public:
+    // Enable it with the max bytes of response to share, and the max time to wait for leader.
+    virtual void initialize(int64_t max_buffer, srs_utime_t timeout);
+    virtual bool enabled();
+    // Join the flight of request, create it if not exists, NULL if the request can't be coalesced.
+    // @param leader Output whether it's the first request, which should be sent to server.
+    // @remark The flight should be released.
+    virtual SrsHttpInflight* join(SrsHttpMessage* req, const std::string& key, bool& leader);
+    // Release the flight by follower.
+    virtual void release(SrsHttpInflight* flight);
+    // Release the flight by leader, it fails if not done, for example, the server is closed.
+    virtual void leave(SrsHttpInflight* flight);
+    // The number of flights.
+    virtual int size();
+    virtual void dumps(SrsJsonObject* obj);
+private:
+    virtual bool acceptable(SrsHttpMessage* req);
+    // Remove the flight, so the new request never joins it.
+    virtual void remove(SrsHttpInflight* flight);
+};
+
+// Release the flight of leader when out of scope.
+class SrsHttpInflightGuard
+{
+private:
+    SrsHttpInflight* flight_;
+public:
+    SrsHttpInflightGuard(SrsHttpInflight* flight);
+    virtual ~SrsHttpInflightGuard();
+};
+
+extern SrsHttpCollapser* _srs_http_collapser;
+
+#endif
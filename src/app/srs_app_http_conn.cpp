@@ -16,15 +16,27 @@
 #include <srs_protocol_json.hpp>
 #include <srs_app_access_log.hpp>
 #include <srs_protocol_async_dns.hpp>
+#include <srs_app_trace.hpp>
+#include <srs_app_admission.hpp>
+#include <srs_app_url_category.hpp>
+#include <srs_app_http_cache.hpp>
+#include <srs_app_http_collapser.hpp>
+#include <srs_app_memory.hpp>
 #include <poll.h>
 #include <crypto/x509.h>
 #include <crypto/evp.h>
 extern ISrsContext* _srs_context;
 extern SrsConfig* _srs_config;
-extern SrsPolicy* _srs_policy;
 extern SrsNotification* _srs_notification;
 extern SrsAccessLog* _srs_access_log;
 
+// The path and query of request, to match the url rules.
+static std::string srs_http_path_query(SrsHttpMessage* req)
+{
+    std::string query = req->query();
+    return query.empty() ? req->path() : req->path() + "?" + query;
+}
+
 EVP_PKEY *ca_key = NULL;
 ResignEndpointCertMap* g_resignEndpointCertMap = new ResignEndpointCertMap();
 static void prepareResignCA()
@@ -68,7 +80,9 @@ SrsHttpConn::SrsHttpConn(ISrsHttpConnOwner* handler, ISrsProtocolReadWriter* fd,
     create_time = srsu2ms(srs_get_system_time());
     // delta_ = new SrsNetworkDelta();
     // delta_->set_io(skt, skt);
-    trd = new SrsSTCoroutine("http", this, _srs_context->get_id());
+    SrsSTCoroutine* st = new SrsSTCoroutine("http", this, _srs_context->get_id());
+    st->set_stack_size(_srs_config->get_api_stack_size());
+    trd = st;
 }
 
 SrsHttpConn::~SrsHttpConn()
@@ -403,21 +417,34 @@ SrsHttpxProxyConn::SrsHttpxProxyConn(ISrsProtocolReadWriter* io, ISrsResourceMan
     port = port;
     clt_skt = io;
     manager = cm;
-    trd = new SrsSTCoroutine("httpProxy", this, _srs_context->generate_id());
+    SrsSTCoroutine* st = new SrsSTCoroutine("httpProxy", this, _srs_context->generate_id());
+    // The tunnel relay also runs in this coroutine, so the stack covers it.
+    st->set_stack_size(_srs_config->get_proxy_stack_size());
+    trd = st;
     is_https = false;
     svr_skt = NULL;
     clt_ssl = NULL;
     svr_ssl = NULL;
-
+    span = new SrsTraceSpan();
+    pass_buf = NULL;
+    arena = new SrsArena();
+    parser->set_arena(arena);
+    server_parser->set_arena(arena);
+    idle_timeout = _srs_config->get_memory_release_idle_timeout();
+    _srs_admission->on_connection_start();
 }
 
 SrsHttpxProxyConn::~SrsHttpxProxyConn()
 {
+    _srs_admission->on_connection_stop();
     trd->interrupt();
     srs_freep(trd);
     srs_freep(parser);
     srs_freep(server_parser);
     srs_freep(clt_skt);
+    srs_freep(span);
+    srs_freepa(pass_buf);
+    srs_freep(arena);
 
     if(svr_skt)
     {
@@ -562,16 +589,18 @@ srs_error_t SrsHttpxProxyConn::process_requests()
     if(is_https)
     {
         err = process_https_connection();
-        return err;
     }
     else
     {
         err = process_http_connection();
-        return err;
     }
+
+    // The transaction may fail before committed, for example, failed to connect to server or timeout.
+    span->finish(err);
+    return err;
 }
 
-srs_error_t SrsHttpxProxyConn::prepare403block()
+srs_error_t SrsHttpxProxyConn::prepare403block(SrsPolicyVerdict* verdict)
 {
     srs_error_t err = srs_success;
     server_http_resp = new SrsHttpMessage();
@@ -580,7 +609,11 @@ srs_error_t SrsHttpxProxyConn::prepare403block()
     block_header->set_content_type("text/html");
     block_header->set("Connection", "close");
 
-    resp_body = _srs_notification->getNotification(client_http_req->get_dest_domain(), remote_ip());
+    if(verdict->block_page.empty())
+    {
+        verdict->block_page = _srs_notification->renderDomain(client_http_req->get_dest_domain());
+    }
+    resp_body = _srs_notification->renderClient(verdict->block_page, remote_ip());
     block_header->set_content_length(resp_body.size());
     server_http_resp->restore_http_header();
     return err;
@@ -590,6 +623,14 @@ srs_error_t SrsHttpxProxyConn::process_http_connection()
 {
     srs_error_t err = srs_success;
     for (int req_id = 0; ; req_id++) {
+        // The messages of previous transaction are freed, so are its buffers.
+        arena->reset();
+
+        if(req_id > 0 && (err = wait_request()) != srs_success)
+        {
+            return srs_error_wrap(err, "wait request");
+        }
+
         ISrsHttpMessage* req = NULL;
         if ((err = parser->parse_message(clt_skt, &req)) != srs_success) {
             return srs_error_wrap(err, "parse message");
@@ -597,17 +638,109 @@ srs_error_t SrsHttpxProxyConn::process_http_connection()
         SrsAutoFree(ISrsHttpMessage, req);
         client_http_req = (SrsHttpMessage*)req;
         
-        // beta
-        // detect_url_category();
+        // For keep-alive, exclude the idle time before the request.
+        if (req_id > 0) {
+            span->reset();
+        }
+        span->set_target(false, client_http_req->get_dest_domain(), client_http_req->path());
+        _srs_memory_releaser->on_request();
 
-        if(_srs_policy->match_black_list(client_http_req->get_dest_domain()))
+        // Use the same policy during the request, even if it's reloaded.
+        SrsPolicyGuard policy;
+        SrsVerdictGuard verdict(_srs_verdict_cache->fetch(policy.get(), client_http_req->get_dest_domain()));
+        if(verdict->block || policy->match_url_black_list(srs_http_path_query(client_http_req)))
         {
-            prepare403block();
+            prepare403block(verdict.get());
             clt_skt->write(const_cast<char*>(server_http_resp->get_raw_header().c_str()), server_http_resp->get_raw_header().size(), NULL);
             clt_skt->write(const_cast<char*>(resp_body.c_str()), resp_body.size(), NULL);
+            span->set_status(403);
+            span->commit();
             return err;
         }
 
+        // Only categorize the allowed request, for the blocked one never waits for the classifier.
+        // Fail-open, the category is empty if the classifier is slow or down.
+        string category;
+        if(_srs_url_category->enabled())
+        {
+            span->begin(SrsTracePhaseCategory);
+            category = _srs_url_category->categorize(client_http_req->get_dest_domain(), client_http_req->path());
+            span->end(SrsTracePhaseCategory);
+        }
+
+        // Serve the fresh response from cache, without forwarding the request to server.
+        string cache_key;
+        time_t request_time = 0;
+        SrsHttpCacheObject* stale = NULL;
+        SrsAutoFreeH(SrsHttpCacheObject, stale, srs_http_cache_release);
+        if(_srs_http_cache->enabled())
+        {
+            cache_key = srs_http_cache_key(false, client_http_req);
+            SrsHttpCacheState state = SrsHttpCacheMiss;
+            SrsHttpCacheObject* cached = _srs_http_cache->lookup(client_http_req, cache_key, state);
+            // Serve the stale response at once, if it's revalidated in background.
+            if(state == SrsHttpCacheStale && (_srs_config->get_next_hip_proxy_enabled()
+                || !_srs_http_cache->revalidate(client_http_req, cached, false, client_http_req->get_dest_domain(), client_http_req->get_dest_port())))
+            {
+                state = SrsHttpCacheRevalidate;
+            }
+            if(state == SrsHttpCacheFresh || state == SrsHttpCacheStale)
+            {
+                int status = 0;
+                err = _srs_http_cache->serve(clt_skt, client_http_req, cached, client_http_req->is_keep_alive(), &status);
+                _srs_http_cache->release(cached);
+                if(err != srs_success)
+                {
+                    return srs_error_wrap(err, "serve cache");
+                }
+                span->set_status(status);
+                span->commit();
+                log_access(status, category);
+
+                if (!client_http_req->is_keep_alive()) {
+                    break;
+                }
+                client_http_req = NULL;
+                continue;
+            }
+            // Validate the stale response with server, which is served if not modified.
+            stale = cached;
+            request_time = _srs_http_cache->now();
+        }
+
+        // Wait for the response of the same request in flight, without forwarding the request to server.
+        SrsHttpInflight* flight = NULL;
+        bool leader = false;
+        if(_srs_http_collapser->enabled() && !stale)
+        {
+            flight = _srs_http_collapser->join(client_http_req, srs_http_cache_key(false, client_http_req), leader);
+        }
+        if(flight && !leader)
+        {
+            int status = 0;
+            bool fallback = false;
+            err = flight->follow(clt_skt, client_http_req, &status, fallback);
+            _srs_http_collapser->release(flight);
+            if(err != srs_success)
+            {
+                return srs_error_wrap(err, "follow");
+            }
+            if(!fallback)
+            {
+                span->set_status(status);
+                span->commit();
+                log_access(status, category);
+
+                if (!client_http_req->is_keep_alive()) {
+                    break;
+                }
+                client_http_req = NULL;
+                continue;
+            }
+            flight = NULL;
+        }
+        SrsHttpInflightGuard flight_guard(flight);
+
         //if configure the next hip, forward traffic to next hip
         //client -> proxy ->next hip -> ... -> server
         //client <- proxy <-next hip <- ... <- server
@@ -628,9 +761,13 @@ srs_error_t SrsHttpxProxyConn::process_http_connection()
         {
             return err;
         }
+        span->set(SrsTracePhaseDns, server_skt->dns_elapsed());
+        span->set(SrsTracePhaseConnect, server_skt->connect_elapsed());
         _srs_context->set_server_fd(server_skt->get_fd());
         //forward client req header to server
-        server_skt->write(const_cast<char*>(client_http_req->get_raw_header().c_str()), client_http_req->get_raw_header().size(), NULL);
+        span->begin(SrsTracePhaseTtfb);
+        string req_header = stale ? _srs_http_cache->conditional(client_http_req, stale) : client_http_req->get_raw_header();
+        server_skt->write(const_cast<char*>(req_header.c_str()), req_header.size(), NULL);
 
         //check whether request has body
         if(client_http_req->is_chunked() || client_http_req->content_length() > 0)
@@ -668,90 +805,98 @@ srs_error_t SrsHttpxProxyConn::process_http_connection()
         if ((err = server_parser->parse_message(svr_skt, &server_resp)) != srs_success) {
             return srs_error_wrap(err, "parse message");
         }
+        span->end(SrsTracePhaseTtfb);
 
         SrsAutoFree(ISrsHttpMessage, server_resp);
         // send response to client
         server_http_resp = (SrsHttpMessage*)server_resp;
-        clt_skt->write(const_cast<char*>(server_http_resp->get_raw_header().c_str()), server_http_resp->get_raw_header().size(), NULL);
+        span->set_status(server_http_resp->status_code());
+
+        // The stale response is not modified, refresh and serve it, see RFC 7234 section 4.3.4.
+        if(stale && server_http_resp->status_code() == SRS_CONSTS_HTTP_NotModified)
+        {
+            _srs_http_cache->refresh(stale, server_http_resp, request_time);
+            int status = 0;
+            if((err = _srs_http_cache->serve(clt_skt, client_http_req, stale, client_http_req->is_keep_alive(), &status)) != srs_success)
+            {
+                return srs_error_wrap(err, "serve cache");
+            }
+            span->set_status(status);
+            span->commit();
+            log_access(status, category);
+
+            if (!client_http_req->is_keep_alive() || !server_http_resp->is_keep_alive()) {
+                break;
+            }
+            client_http_req = NULL;
+            server_http_resp = NULL;
+            continue;
+        }
+
+        // The header is written with the first part of body if it's already buffered, or when finished if no body.
+        SrsHttpBodyRelay relay;
+        string raw_header = server_http_resp->get_raw_header();
+        relay.set_header(raw_header.data(), raw_header.size());
+
+        // Store the body to cache when relaying it, if the response is cacheable.
+        SrsHttpCacheWriter* cache_writer = NULL;
+        if(!cache_key.empty())
+        {
+            cache_writer = _srs_http_cache->store(client_http_req, server_http_resp, cache_key, request_time);
+        }
+        SrsAutoFree(SrsHttpCacheWriter, cache_writer);
+        if(flight)
+        {
+            flight->on_header(client_http_req, server_http_resp);
+        }
+
+        span->begin(SrsTracePhaseBody);
 
         if(server_http_resp->is_chunked() || server_http_resp->content_length() > 0)
         {
+            // Write the header before waiting for the body from upstream, or the client waits for it too.
+            if(!server_parser->buffered() && (err = relay.flush(clt_skt)) != srs_success)
+            {
+                return err;
+            }
+
+            // Relay the body from the buffer of relay, without copy to resp_body.
             while(1)
             {
-                resp_body = "";
-                srs_trace("start to read body");
-                int finish = 0;
-                err = server_http_resp->body_read_part(resp_body, 4096, finish);
+                char* data = NULL;
+                int size = 0;
+                err = relay.read(server_http_resp->body_reader(), &data, &size);
                 if(err != srs_success)
                 {
                     return err;
                 }
-                srs_trace("server req is chunked: %d, content_length: %d", server_http_resp->is_chunked(), server_http_resp->content_length());
-
-                if(finish && resp_body.size() == 0)
-                {   
-                    srs_trace("meet eof");
-                    if(server_http_resp->is_chunked())
-                    {
-                        srs_trace("is chunked");
-                        clt_skt->write(const_cast<char*>("0\r\n\r\n"), 5, NULL);
-                    }
+                if(!size)
+                {
                     break;
                 }
-
-                if(server_http_resp->is_chunked())
+                if(cache_writer)
                 {
-                    char temp[32];
-                    snprintf(temp, sizeof(temp), "%x", resp_body.size());
-                    srs_trace("write chunk data to client, chunk size is %s", temp);
-
-                    err = clt_skt->write(temp, strlen(temp), NULL);
-                    if(err != srs_success) 
-                    {
-                        return err;
-                    }
-
-                    err = clt_skt->write(const_cast<char*>("\r\n"), 2, NULL);
-                    if(err != srs_success) 
-                    {
-                        return err;
-                    }
-
-                    err = clt_skt->write(const_cast<char*>(resp_body.c_str()), resp_body.size(), NULL);
-                    if(err != srs_success) 
-                    {
-                        return err;
-                    }
-
-                    err = clt_skt->write(const_cast<char*>("\r\n"), 2, NULL);
-                    if(err != srs_success) 
-                    {
-                        return err;
-                    }
+                    cache_writer->append(data, size);
                 }
-                else if(server_http_resp->content_length() > 0)
+                if(flight)
                 {
-                    srs_trace("resp_body is %d", resp_body.size());
-                    err = clt_skt->write(const_cast<char*>(resp_body.c_str()), resp_body.size(), NULL);
-                    if(err != srs_success) 
-                    {
-                        return err;
-                    }
+                    flight->on_body(data, size);
                 }
 
-                if(finish)
-                {   
-                    srs_trace("meet eof");
-                    if(server_http_resp->is_chunked())
-                    {
-                        srs_trace("is chunked");
-                        clt_skt->write(const_cast<char*>("0\r\n\r\n"), 5, NULL);
-                    }
-                    break;
+                err = relay.write(clt_skt, data, size, server_http_resp->is_chunked());
+                if(err != srs_success)
+                {
+                    return err;
                 }
             }
         }   
 
+        // Write the last chunk, and the header if no body.
+        if((err = relay.finish(clt_skt, server_http_resp->is_chunked())) != srs_success)
+        {
+            return err;
+        }
+
         // if(server_http_resp->is_chunked() || server_http_resp->content_length() > 0)
         // {
         //     server_http_resp->body_read_all(resp_body);
@@ -776,6 +921,17 @@ srs_error_t SrsHttpxProxyConn::process_http_connection()
         //     clt_skt->write(const_cast<char*>(resp_body.c_str()), resp_body.size(), NULL);
         // }
 
+        if(cache_writer)
+        {
+            cache_writer->commit();
+        }
+        if(flight)
+        {
+            flight->on_done();
+        }
+        span->end(SrsTracePhaseBody);
+        span->commit();
+
         // donot keep alive, disconnect it.
         if (!client_http_req->is_keep_alive() || !server_http_resp->is_keep_alive()) {
             srs_trace("not keep-alive connection, close it now");
@@ -789,12 +945,7 @@ srs_error_t SrsHttpxProxyConn::process_http_connection()
             processHttpsTunnel();
         }
 
-        SrsAccessLogInfo* log_info = new SrsAccessLogInfo();
-        SrsAutoFree(SrsAccessLogInfo, log_info);
-        log_info->domain = client_http_req->get_dest_domain();
-        log_info->client_ip = remote_ip();
-        log_info->status_code = server_http_resp->status_code();
-        _srs_access_log->write_access_log(log_info);
+        log_access(server_http_resp->status_code(), category);
 
         resp_body = "";
         req_body = "";
@@ -816,6 +967,42 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
     client_connect_req = (SrsHttpMessage*)connect_req;
     client_connect_req->set_connection(this);
     SrsAutoFree(ISrsHttpMessage, connect_req);
+    span->set_target(true, client_connect_req->get_dest_domain(), "");
+
+    // Reject the new session fast when overloaded, before connecting to server.
+    if(_srs_admission->should_reject_connect())
+    {
+        string res = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+        clt_skt->write(const_cast<char*>(res.c_str()), res.size(), NULL);
+        srs_warn("reject CONNECT %s for water level is %s", client_connect_req->get_dest_domain().c_str(),
+            srs_admission_level_name(_srs_admission->level()));
+        span->set_status(503);
+        span->commit();
+        return err;
+    }
+
+    // The tunneled session is never filtered, so reject the blocked domain before tunneling it, even if
+    // it's tunneled for the water level is high. The decrypted session responds the block page later.
+    bool block = false;
+    bool tunnel = false;
+    if(true)
+    {
+        // Don't hold the policy for the whole session, each request in session holds it.
+        SrsPolicyGuard policy;
+        SrsVerdictGuard verdict(_srs_verdict_cache->fetch(policy.get(), client_connect_req->get_dest_domain()));
+        block = verdict->block;
+        tunnel = verdict->tunnel;
+    }
+    tunnel = tunnel || _srs_admission->should_fallback_tunnel();
+    if(block && tunnel)
+    {
+        string res = "HTTP/1.1 403 Forbidden\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+        clt_skt->write(const_cast<char*>(res.c_str()), res.size(), NULL);
+        srs_trace("block CONNECT %s, which should be tunneled", client_connect_req->get_dest_domain().c_str());
+        span->set_status(403);
+        span->commit();
+        return err;
+    }
 
     if(_srs_config->get_next_hip_proxy_enabled())
     {
@@ -830,6 +1017,8 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
             srs_trace("err = %d" , err == srs_success);
             return err;
         }
+        span->set(SrsTracePhaseDns, server_skt->dns_elapsed());
+        span->set(SrsTracePhaseConnect, server_skt->connect_elapsed());
         _srs_context->set_server_fd(server_skt->get_fd());
         server_skt->write(const_cast<char*>(client_connect_req->get_raw_header().c_str()), client_connect_req->get_raw_header().size(), NULL);
         //receive 200 connection established
@@ -854,28 +1043,36 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
         {
             return err;
         }
+        span->set(SrsTracePhaseDns, server_skt->dns_elapsed());
+        span->set(SrsTracePhaseConnect, server_skt->connect_elapsed());
         _srs_context->set_server_fd(server_skt->get_fd());
     }
 
-    //process_https_tunnel
-    if(!_srs_policy->is_https_descrypt_enable() || _srs_policy->match_tunnel_domain_list(client_connect_req->get_dest_domain()))
+    //process_https_tunnel, also tunnel the new session rather than decrypt it when water level is high.
+    if(tunnel)
     {
         //connection to server established 
         //prepare 200 to client
         string res = "HTTP/1.1 200 Connection Established\r\n\r\n";
         clt_skt->write(const_cast<char*>(res.c_str()), res.size(), NULL);
         srs_trace("write HTTP 200 connection to client");
+        span->set_status(200);
+        span->begin(SrsTracePhaseBody);
         processHttpsTunnel();
+        span->end(SrsTracePhaseBody);
+        span->commit();
         return err;
     }
 
     svr_ssl = new SrsSslClient((SrsTcpClient*)svr_skt);
     svr_ssl->set_SNI(client_connect_req->get_dest_domain());
+    span->begin(SrsTracePhaseUpstreamTls);
     if((err = svr_ssl->handshake()) != srs_success)
     {
         srs_trace("server hadnshake failed");
         return err;
     }
+    span->end(SrsTracePhaseUpstreamTls);
 
     X509 *fake_x509 = NULL;
     EVP_PKEY* server_key = NULL;
@@ -894,7 +1091,9 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
             prepareResignCA();
         }
         
+        span->begin(SrsTracePhaseForgeCert);
         svr_ssl->prepare_resign_endpoint(fake_x509, server_key);
+        span->end(SrsTracePhaseForgeCert);
         ResignEndpointCert *resignEndpointCert = new ResignEndpointCert(fake_x509, server_key);
         g_resignEndpointCertMap->insert(client_connect_req->get_dest_domain(), resignEndpointCert);
     }
@@ -907,13 +1106,23 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
     srs_trace("write HTTP 200 connection to client");
 
     clt_ssl = new SrsSslConnection(clt_skt);
+    span->begin(SrsTracePhaseDownstreamTls);
     err = clt_ssl->handshake(fake_x509, server_key);
     if(err != srs_success)
     {
         return srs_error_wrap(err, "client handshake");
     }
+    span->end(SrsTracePhaseDownstreamTls);
 
     for (int req_id = 0; ; req_id++) {
+        // The messages of previous transaction are freed, so are its buffers.
+        arena->reset();
+
+        if(req_id > 0 && (err = wait_request()) != srs_success)
+        {
+            return srs_error_wrap(err, "wait request");
+        }
+
         // get a http message from client
         // current, we are sure to get http header, body is not sure
         ISrsHttpMessage* req = NULL;
@@ -924,20 +1133,114 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
 
         client_http_req = (SrsHttpMessage*)req;
         client_http_req->set_connection(this);
+        // For keep-alive, exclude the idle time before the request.
+        if (req_id > 0) {
+            span->reset();
+        }
+        span->set_target(true, client_http_req->get_dest_domain(), client_http_req->path());
+        _srs_memory_releaser->on_request();
 
-        // beta
-        // detect_url_category();
-
-        if(_srs_policy->match_black_list(client_http_req->get_dest_domain()))
+        // Use the same policy during the request, even if it's reloaded.
+        SrsPolicyGuard policy;
+        SrsVerdictGuard verdict(_srs_verdict_cache->fetch(policy.get(), client_http_req->get_dest_domain()));
+        if(verdict->block || policy->match_url_black_list(srs_http_path_query(client_http_req)))
         {
-            err = prepare403block();
+            err = prepare403block(verdict.get());
             clt_ssl->write(const_cast<char*>(server_http_resp->get_raw_header().c_str()), server_http_resp->get_raw_header().size(), NULL);
             clt_ssl->write(const_cast<char*>(resp_body.c_str()), resp_body.size(), NULL);
+            span->set_status(403);
+            span->commit();
             return err;
         }
 
+        // Only categorize the allowed request, for the blocked one never waits for the classifier.
+        // Fail-open, the category is empty if the classifier is slow or down.
+        string category;
+        if(_srs_url_category->enabled())
+        {
+            span->begin(SrsTracePhaseCategory);
+            category = _srs_url_category->categorize(client_http_req->get_dest_domain(), client_http_req->path());
+            span->end(SrsTracePhaseCategory);
+        }
+
+        // Serve the fresh response from cache, without forwarding the request to server.
+        string cache_key;
+        time_t request_time = 0;
+        SrsHttpCacheObject* stale = NULL;
+        SrsAutoFreeH(SrsHttpCacheObject, stale, srs_http_cache_release);
+        // The response is from the server of CONNECT, so never cache it for another host.
+        if(_srs_http_cache->enabled() && client_http_req->get_dest_domain() == client_connect_req->get_dest_domain())
+        {
+            cache_key = srs_http_cache_key(true, client_http_req);
+            SrsHttpCacheState state = SrsHttpCacheMiss;
+            SrsHttpCacheObject* cached = _srs_http_cache->lookup(client_http_req, cache_key, state);
+            // Serve the stale response at once, if it's revalidated in background.
+            if(state == SrsHttpCacheStale && (_srs_config->get_next_hip_proxy_enabled()
+                || !_srs_http_cache->revalidate(client_http_req, cached, true, client_connect_req->get_dest_domain(), client_connect_req->get_dest_port())))
+            {
+                state = SrsHttpCacheRevalidate;
+            }
+            if(state == SrsHttpCacheFresh || state == SrsHttpCacheStale)
+            {
+                int status = 0;
+                err = _srs_http_cache->serve(clt_ssl, client_http_req, cached, client_http_req->is_keep_alive(), &status);
+                _srs_http_cache->release(cached);
+                if(err != srs_success)
+                {
+                    return srs_error_wrap(err, "serve cache");
+                }
+                span->set_status(status);
+                span->commit();
+                log_access(status, category);
+
+                if (!client_http_req->is_keep_alive()) {
+                    break;
+                }
+                client_http_req = NULL;
+                continue;
+            }
+            // Validate the stale response with server, which is served if not modified.
+            stale = cached;
+            request_time = _srs_http_cache->now();
+        }
+
+        // Wait for the response of the same request in flight, without forwarding the request to server.
+        SrsHttpInflight* flight = NULL;
+        bool leader = false;
+        if(_srs_http_collapser->enabled() && !stale && client_http_req->get_dest_domain() == client_connect_req->get_dest_domain())
+        {
+            flight = _srs_http_collapser->join(client_http_req, srs_http_cache_key(true, client_http_req), leader);
+        }
+        if(flight && !leader)
+        {
+            int status = 0;
+            bool fallback = false;
+            err = flight->follow(clt_ssl, client_http_req, &status, fallback);
+            _srs_http_collapser->release(flight);
+            if(err != srs_success)
+            {
+                return srs_error_wrap(err, "follow");
+            }
+            if(!fallback)
+            {
+                span->set_status(status);
+                span->commit();
+                log_access(status, category);
+
+                if (!client_http_req->is_keep_alive()) {
+                    break;
+                }
+                client_http_req = NULL;
+                continue;
+            }
+            flight = NULL;
+        }
+        SrsHttpInflightGuard flight_guard(flight);
+
         //send request header to server
-        svr_ssl->write(const_cast<char*>(client_http_req->get_raw_header().c_str()), client_http_req->get_raw_header().size(), NULL);
+        span->begin(SrsTracePhaseTtfb);
+        string req_header = stale ? _srs_http_cache->conditional(client_http_req, stale) : client_http_req->get_raw_header();
+        svr_ssl->write(const_cast<char*>(req_header.c_str()), req_header.size(), NULL);
 
         //check whether need to forward body
         if(client_http_req->is_chunked() || client_http_req->content_length() > 0)
@@ -975,60 +1278,85 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
         if ((err = server_parser->parse_message(svr_ssl, &server_resp)) != srs_success) {
             return srs_error_wrap(err, "parse message");
         }
+        span->end(SrsTracePhaseTtfb);
         SrsAutoFree(ISrsHttpMessage, server_resp);
         // send response to client
         server_http_resp = (SrsHttpMessage*)server_resp;
+        span->set_status(server_http_resp->status_code());
+
+        // The stale response is not modified, refresh and serve it, see RFC 7234 section 4.3.4.
+        if(stale && server_http_resp->status_code() == SRS_CONSTS_HTTP_NotModified)
+        {
+            _srs_http_cache->refresh(stale, server_http_resp, request_time);
+            int status = 0;
+            if((err = _srs_http_cache->serve(clt_ssl, client_http_req, stale, client_http_req->is_keep_alive(), &status)) != srs_success)
+            {
+                return srs_error_wrap(err, "serve cache");
+            }
+            span->set_status(status);
+            span->commit();
+            log_access(status, category);
+
+            if (!client_http_req->is_keep_alive() || !server_http_resp->is_keep_alive()) {
+                break;
+            }
+            client_http_req = NULL;
+            server_http_resp = NULL;
+            continue;
+        }
+
         clt_ssl->write(const_cast<char*>(server_http_resp->get_raw_header().c_str()), server_http_resp->get_raw_header().size(), NULL);
 
+        // Store the body to cache when relaying it, if the response is cacheable.
+        SrsHttpCacheWriter* cache_writer = NULL;
+        if(!cache_key.empty())
+        {
+            cache_writer = _srs_http_cache->store(client_http_req, server_http_resp, cache_key, request_time);
+        }
+        SrsAutoFree(SrsHttpCacheWriter, cache_writer);
+        if(flight)
+        {
+            flight->on_header(client_http_req, server_http_resp);
+        }
+
+        span->begin(SrsTracePhaseBody);
+
         if(server_http_resp->is_chunked() || server_http_resp->content_length() > 0)
         {
+            // Relay the body from the buffer of relay, without copy to resp_body.
+            SrsHttpBodyRelay relay;
             while(1)
             {
-                resp_body = "";
-                srs_trace("start to read body");
-                int finish = 0;
-                err = server_http_resp->body_read_part(resp_body, 4096, finish);
+                char* data = NULL;
+                int size = 0;
+                err = relay.read(server_http_resp->body_reader(), &data, &size);
                 if(err != srs_success)
                 {
                     return err;
                 }
-                if(finish && resp_body.size() == 0)
-                {
-                    srs_trace("meet eof");
-                    if(server_http_resp->is_chunked())
-                    {
-                        clt_ssl->write(const_cast<char*>("0\r\n\r\n"), 5, NULL);
-                    }
-                    break;
-                }
-
-                srs_trace("server req is chunked: %d, content_length: %d", server_http_resp->is_chunked(), server_http_resp->content_length());
-
-                if(server_http_resp->is_chunked())
+                if(cache_writer && size)
                 {
-                    char temp[32];
-                    snprintf(temp, sizeof(temp), "%x", resp_body.size());
-                    srs_trace("write chunk data to client, chunk size is %s", temp);
-
-                    clt_ssl->write(temp, strlen(temp), NULL);
-                    clt_ssl->write(const_cast<char*>("\r\n"), 2, NULL);
-                    clt_ssl->write(const_cast<char*>(resp_body.c_str()), resp_body.size(), NULL);
-                    clt_ssl->write(const_cast<char*>("\r\n"), 2, NULL);
+                    cache_writer->append(data, size);
                 }
-                else if(server_http_resp->content_length() > 0)
+                if(flight && size)
                 {
-                    srs_trace("resp_body is %d", resp_body.size());
-                    clt_ssl->write(const_cast<char*>(resp_body.c_str()), resp_body.size(), NULL);
+                    flight->on_body(data, size);
                 }
-                if(finish)
+
+                if(!size)
                 {
-                    srs_trace("meet eof");
                     if(server_http_resp->is_chunked())
                     {
                         clt_ssl->write(const_cast<char*>("0\r\n\r\n"), 5, NULL);
                     }
                     break;
                 }
+
+                err = relay.write(clt_ssl, data, size, server_http_resp->is_chunked());
+                if(err != srs_success)
+                {
+                    return err;
+                }
             }
         }  
 
@@ -1056,6 +1384,17 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
         //     clt_ssl->write(const_cast<char*>(resp_body.c_str()), resp_body.size(), NULL);
         // }
 
+        if(cache_writer)
+        {
+            cache_writer->commit();
+        }
+        if(flight)
+        {
+            flight->on_done();
+        }
+        span->end(SrsTracePhaseBody);
+        span->commit();
+
         // donot keep alive, disconnect it.
         if (!client_http_req->is_keep_alive() || !server_http_resp->is_keep_alive()) {
             srs_trace("not keep-alive connection, close it now");
@@ -1069,12 +1408,7 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
             processHttpsTunnel();
         }
 
-        SrsAccessLogInfo* log_info = new SrsAccessLogInfo();
-        SrsAutoFree(SrsAccessLogInfo, log_info);
-        log_info->domain = client_http_req->get_dest_domain();
-        log_info->client_ip = remote_ip();
-        log_info->status_code = server_http_resp->status_code();
-        _srs_access_log->write_access_log(log_info);
+        log_access(server_http_resp->status_code(), category);
         srs_trace("one https transaction done, wait next");
 
         req_body = "";
@@ -1086,12 +1420,65 @@ srs_error_t SrsHttpxProxyConn::process_https_connection()
     return err;
 }
 
+srs_error_t SrsHttpxProxyConn::wait_request()
+{
+    srs_error_t err = srs_success;
+
+    // Never wait if the connection times out before idle, or the next request is received.
+    SrsTcpConnection* client_tcp_clt = (SrsTcpConnection*)clt_skt;
+    srs_utime_t timeout = client_tcp_clt->get_recv_timeout();
+    if(!idle_timeout || (timeout != SRS_UTIME_NO_TIMEOUT && idle_timeout >= timeout))
+    {
+        return err;
+    }
+    if(parser->buffered() > 0 || (clt_ssl && clt_ssl->pending()))
+    {
+        return err;
+    }
+
+    char c;
+    client_tcp_clt->set_recv_timeout(idle_timeout);
+    err = client_tcp_clt->peek(&c, 1, NULL);
+    client_tcp_clt->set_recv_timeout(timeout);
+    if(err == srs_success || srs_error_code(err) != ERROR_SOCKET_TIMEOUT)
+    {
+        return err;
+    }
+    srs_freep(err);
+
+    release_buffers();
+
+    // Wait for the left time of receive timeout, then the buffers are allocated again by the request.
+    client_tcp_clt->set_recv_timeout(timeout == SRS_UTIME_NO_TIMEOUT ? timeout : timeout - idle_timeout);
+    err = client_tcp_clt->peek(&c, 1, NULL);
+    client_tcp_clt->set_recv_timeout(timeout);
+
+    return err;
+}
+
+void SrsHttpxProxyConn::release_buffers()
+{
+    parser->release();
+    server_parser->release();
+    arena->release();
+
+    // The capacity of string is never freed by assign.
+    string().swap(req_body);
+    string().swap(resp_body);
+
+    // The SSL buffers of both legs are already freed once empty, by SSL_MODE_RELEASE_BUFFERS.
+    _srs_memory_releaser->on_idle_release();
+}
+
 int SrsHttpxProxyConn::pass(ISrsProtocolReadWriter* in, ISrsProtocolReadWriter* out)
 {
     srs_trace("pass");
     srs_error_t err;
     int IOBUFSIZE = 4096;
-	char buf[IOBUFSIZE];
+    if (!pass_buf) {
+        pass_buf = new char[IOBUFSIZE];
+    }
+    char* buf = pass_buf;
 	ssize_t read_size = 0;
     ssize_t write_size = 0;
 
@@ -1152,40 +1539,6 @@ srs_error_t SrsHttpxProxyConn::processHttpsTunnel()
 	return err;
 }
 
-srs_error_t SrsHttpxProxyConn::detect_url_category()
-{
-    SrsHttpClient hc;
-    hc.initialize("http", "127.0.0.1", 8081, SRS_UTIME_SECONDS * 5);
-    SrsJsonObject* req_obj = SrsJsonAny::object();
-    req_obj->set("url", SrsJsonAny::str(client_http_req->uri().c_str()));
-    ISrsHttpMessage *resp = NULL;
-    hc.post("/url_detect", req_obj->dumps(), &resp);
-    std::string req_body_tmp = "";
-    
-    if(resp != NULL)
-    {
-        resp->body_read_all(req_body_tmp);
-
-        SrsJsonAny* any = NULL;
-        if ((any = SrsJsonAny::loads(req_body_tmp)) == NULL) {
-            srs_error("load error");
-        }
-
-        SrsJsonObject *obj_req = NULL;
-        SrsAutoFree(SrsJsonObject, obj_req);
-
-        if(any->is_object())
-        {
-            obj_req = any->to_object();
-        }
-
-        SrsJsonAny* prop = obj_req->get_property("category");
-        std::string category = prop->to_str();
-
-        srs_trace("url category is %s", category.c_str());
-    }
-}
-
 srs_error_t SrsHttpxProxyConn::on_disconnect()
 {
     // TODO: FIXME: Implements it.
@@ -1197,6 +1550,17 @@ string SrsHttpxProxyConn::remote_ip()
     return ip;
 }
 
+void SrsHttpxProxyConn::log_access(int status, string category)
+{
+    SrsAccessLogInfo* log_info = new SrsAccessLogInfo();
+    SrsAutoFree(SrsAccessLogInfo, log_info);
+    log_info->domain = client_http_req->get_dest_domain();
+    log_info->client_ip = remote_ip();
+    log_info->status_code = status;
+    log_info->category = category;
+    _srs_access_log->write_access_log(log_info);
+}
+
 const SrsContextId& SrsHttpxProxyConn::get_id()
 {
     return trd->cid();
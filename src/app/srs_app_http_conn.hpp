@@ -13,6 +13,8 @@
 #include <unordered_map>
 using std::unordered_map;
 class SrsHttpParser;
+class SrsTraceSpan;
+class SrsPolicyVerdict;
 
 // The owner of HTTP connection.
 class ISrsHttpConnOwner
@@ -170,6 +172,14 @@ private:
     int port;
     //check whether connection is a https request
     bool is_https;
+    //phase timing of current transaction
+    SrsTraceSpan* span;
+    //the relay buffer of tunnel, allocated on heap to keep the coroutine stack small
+    char* pass_buf;
+    //the buffers of current transaction, reset for each request
+    SrsArena* arena;
+    //the idle time of keep-alive connection to release its buffers
+    srs_utime_t idle_timeout;
 public:
     SrsHttpxProxyConn(ISrsProtocolReadWriter* io, ISrsResourceManager* cm, ISrsHttpServeMux* m, std::string cip, int port);
     virtual ~SrsHttpxProxyConn();
@@ -189,16 +199,18 @@ public:
     virtual srs_error_t check_http_or_https();
     virtual srs_error_t process_http_connection();
     virtual srs_error_t process_https_connection();
+    // Wait for the next request of keep-alive connection, release the buffers when idle.
+    virtual srs_error_t wait_request();
+    virtual void release_buffers();
     virtual int pass(ISrsProtocolReadWriter* in, ISrsProtocolReadWriter* out);
     virtual srs_error_t processHttpsTunnel();
+    // Write the access log of the current request.
+    virtual void log_access(int status, std::string category);
 public:
     virtual srs_error_t on_disconnect();
     virtual srs_error_t on_conn_done(srs_error_t r0);
 public:
-    //get url actegory of the url
-    virtual srs_error_t detect_url_category();
-public:
-    virtual srs_error_t prepare403block();
+    virtual srs_error_t prepare403block(SrsPolicyVerdict* verdict);
 };
 
 // The http server, use http stream or static server to serve requests.
@@ -0,0 +1,218 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_http_revalidator.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_consts.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_protocol_st.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_app_conn.hpp>
+#include <srs_app_http_cache.hpp>
+
+using namespace std;
+
+// The timeout to connect to server and wait for the response.
+#define SRS_HTTP_REVALIDATE_TIMEOUT (5 * SRS_UTIME_SECONDS)
+// The max number of queued requests, the stale object is revalidated by request when overloaded.
+#define SRS_HTTP_REVALIDATE_MAX_PENDING 1024
+
+SrsHttpRevalidateWorker::SrsHttpRevalidateWorker(SrsHttpRevalidator* revalidator)
+{
+    trd_ = new SrsSTCoroutine("revalidate", this);
+    revalidator_ = revalidator;
+}
+
+SrsHttpRevalidateWorker::~SrsHttpRevalidateWorker()
+{
+    srs_freep(trd_);
+}
+
+srs_error_t SrsHttpRevalidateWorker::start()
+{
+    srs_error_t err = srs_success;
+
+    if ((err = trd_->start()) != srs_success) {
+        return srs_error_wrap(err, "start revalidate worker");
+    }
+
+    return err;
+}
+
+srs_error_t SrsHttpRevalidateWorker::cycle()
+{
+    srs_error_t err = srs_success;
+
+    while (true) {
+        if ((err = trd_->pull()) != srs_success) {
+            return srs_error_wrap(err, "pull");
+        }
+
+        if (revalidator_->queue_.empty()) {
+            srs_cond_wait(revalidator_->ready_);
+            continue;
+        }
+
+        SrsHttpRevalidateTask* task = revalidator_->queue_.front();
+        revalidator_->queue_.pop_front();
+        SrsAutoFree(SrsHttpRevalidateTask, task);
+
+        // Keep the stale object if failed, which is revalidated again by the next request.
+        if ((err = revalidator_->do_revalidate(task)) != srs_success) {
+            srs_warn("revalidate %s err %s", task->key.c_str(), srs_error_desc(err).c_str());
+            srs_freep(err);
+            revalidator_->nn_errors_++;
+        }
+        revalidator_->pending_.erase(task->key);
+    }
+
+    return err;
+}
+
+SrsHttpRevalidator::SrsHttpRevalidator(SrsHttpCache* cache)
+{
+    cache_ = cache;
+    ready_ = srs_cond_new();
+
+    nn_queued_ = 0;
+    nn_dropped_ = 0;
+    nn_not_modified_ = 0;
+    nn_modified_ = 0;
+    nn_errors_ = 0;
+}
+
+SrsHttpRevalidator::~SrsHttpRevalidator()
+{
+    for (int i = 0; i < (int)workers_.size(); i++) {
+        SrsHttpRevalidateWorker* worker = workers_.at(i);
+        srs_freep(worker);
+    }
+    workers_.clear();
+
+    for (deque<SrsHttpRevalidateTask*>::iterator it = queue_.begin(); it != queue_.end(); ++it) {
+        SrsHttpRevalidateTask* task = *it;
+        srs_freep(task);
+    }
+    queue_.clear();
+
+    srs_cond_destroy(ready_);
+}
+
+srs_error_t SrsHttpRevalidator::initialize(int nn_workers)
+{
+    srs_error_t err = srs_success;
+
+    for (int i = 0; i < nn_workers; i++) {
+        SrsHttpRevalidateWorker* worker = new SrsHttpRevalidateWorker(this);
+        workers_.push_back(worker);
+
+        if ((err = worker->start()) != srs_success) {
+            return srs_error_wrap(err, "start worker #%d", i);
+        }
+    }
+
+    srs_trace("http cache revalidate workers=%d", nn_workers);
+
+    return err;
+}
+
+bool SrsHttpRevalidator::revalidate(const string& key, const string& header, bool https, string host, int port)
+{
+    if (workers_.empty()) {
+        return false;
+    }
+
+    if (pending_.find(key) != pending_.end()) {
+        return true;
+    }
+
+    if ((int)queue_.size() >= SRS_HTTP_REVALIDATE_MAX_PENDING) {
+        nn_dropped_++;
+        return false;
+    }
+
+    SrsHttpRevalidateTask* task = new SrsHttpRevalidateTask();
+    task->key = key;
+    task->https = https;
+    task->host = host;
+    task->port = port;
+    task->header = header;
+
+    queue_.push_back(task);
+    pending_.insert(key);
+    nn_queued_++;
+    srs_cond_signal(ready_);
+
+    return true;
+}
+
+void SrsHttpRevalidator::dumps(SrsJsonObject* obj)
+{
+    obj->set("workers", SrsJsonAny::integer(workers_.size()));
+    obj->set("pending", SrsJsonAny::integer(pending_.size()));
+    obj->set("queued", SrsJsonAny::integer(nn_queued_));
+    obj->set("dropped", SrsJsonAny::integer(nn_dropped_));
+    obj->set("not_modified", SrsJsonAny::integer(nn_not_modified_));
+    obj->set("modified", SrsJsonAny::integer(nn_modified_));
+    obj->set("errors", SrsJsonAny::integer(nn_errors_));
+}
+
+srs_error_t SrsHttpRevalidator::do_revalidate(SrsHttpRevalidateTask* task)
+{
+    srs_error_t err = srs_success;
+
+    SrsTcpClient tcp(task->host, task->port, SRS_HTTP_REVALIDATE_TIMEOUT);
+    if ((err = tcp.connect()) != srs_success) {
+        return srs_error_wrap(err, "connect %s:%d", task->host.c_str(), task->port);
+    }
+    tcp.set_recv_timeout(SRS_HTTP_REVALIDATE_TIMEOUT);
+    tcp.set_send_timeout(SRS_HTTP_REVALIDATE_TIMEOUT);
+
+    ISrsReader* reader = &tcp;
+    ISrsStreamWriter* writer = &tcp;
+
+    SrsSslClient* ssl = NULL;
+    SrsAutoFree(SrsSslClient, ssl);
+    if (task->https) {
+        ssl = new SrsSslClient(&tcp);
+        ssl->set_SNI(task->host);
+        if ((err = ssl->handshake()) != srs_success) {
+            return srs_error_wrap(err, "handshake %s:%d", task->host.c_str(), task->port);
+        }
+        reader = ssl;
+        writer = ssl;
+    }
+
+    time_t request_time = cache_->now();
+    if ((err = writer->write((void*)task->header.data(), task->header.size(), NULL)) != srs_success) {
+        return srs_error_wrap(err, "write request");
+    }
+
+    SrsHttpParser parser;
+    if ((err = parser.initialize(HTTP_RESPONSE)) != srs_success) {
+        return srs_error_wrap(err, "init parser");
+    }
+
+    ISrsHttpMessage* msg = NULL;
+    if ((err = parser.parse_message(reader, &msg)) != srs_success) {
+        return srs_error_wrap(err, "parse response");
+    }
+    SrsAutoFree(ISrsHttpMessage, msg);
+
+    // The body of modified response is not read, the next request fetches it.
+    SrsHttpMessage* resp = (SrsHttpMessage*)msg;
+    if (resp->status_code() == SRS_CONSTS_HTTP_NotModified) {
+        cache_->refresh(task->key, resp, request_time);
+        nn_not_modified_++;
+    } else {
+        cache_->invalidate(task->key);
+        nn_modified_++;
+    }
+
+    return err;
+}
@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_HTTP_REVALIDATOR_HPP
+#define SRS_APP_HTTP_REVALIDATOR_HPP
+
+#include <srs_core.hpp>
+#include <srs_app_st.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+
+class SrsJsonObject;
+class SrsHttpCache;
+class SrsHttpRevalidator;
+
+// The conditional request to revalidate a stale object.
+struct SrsHttpRevalidateTask
+{
+    // The key of object in cache.
+    std::string key;
+    bool https;
+    std::string host;
+    int port;
+    // The request header with validators.
+    std::string header;
+};
+
+// The worker which sends the conditional requests one by one, a connection for each request.
+class SrsHttpRevalidateWorker : public ISrsCoroutineHandler
+{
+private:
+    SrsCoroutine* trd_;
+    SrsHttpRevalidator* revalidator_;
+public:
+    SrsHttpRevalidateWorker(SrsHttpRevalidator* revalidator);
+    virtual ~SrsHttpRevalidateWorker();
+public:
+    virtual srs_error_t start();
+// Interface ISrsCoroutineHandler
+public:
+    virtual srs_error_t cycle();
+};
+
+// The stale-while-revalidate of RFC 5861, the stale object is served at once, while the workers revalidate
+// it with server in background. The object is refreshed if the server replies 304, or removed if modified,
+// so the next request fetches and stores the new one. The same object is queued once.
+// @remark There is no lock, because it's only used in the ST thread.
+class SrsHttpRevalidator
+{
+    friend class SrsHttpRevalidateWorker;
+private:
+    SrsHttpCache* cache_;
+    std::vector<SrsHttpRevalidateWorker*> workers_;
+    // The tasks to send, and the keys in queue or in flight.
+    std::deque<SrsHttpRevalidateTask*> queue_;
+    std::unordered_set<std::string> pending_;
+    // Signal the workers when queued.
+    srs_cond_t ready_;
+private:
+    uint64_t nn_queued_;
+    uint64_t nn_dropped_;
+    uint64_t nn_not_modified_;
+    uint64_t nn_modified_;
+    uint64_t nn_errors_;
+public:
+    SrsHttpRevalidator(SrsHttpCache* cache);
+    virtual ~SrsHttpRevalidator();
+public:
+    virtual srs_error_t initialize(int nn_workers);
+    // Queue the conditional request of object, ignore if it's already queued.
+    // @return false if too many pending.
+    virtual bool revalidate(const std::string& key, const std::string& header, bool https, std::string host, int port);
+    virtual void dumps(SrsJsonObject* obj);
+private:
+    virtual srs_error_t do_revalidate(SrsHttpRevalidateTask* task);
+};
+
+#endif
@@ -0,0 +1,316 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_ip_matcher.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+using namespace std;
+
+// The header of encoded rules, followed by the nodes.
+struct SrsIpMatcherHeader
+{
+    uint32_t nn_rules;
+    uint32_t nn_nodes;
+};
+
+// Get the bit at pos of address, from the most significant bit.
+static inline int srs_ip_bit(const uint8_t addr[16], int pos)
+{
+    return (addr[pos >> 3] >> (7 - (pos & 7))) & 0x01;
+}
+
+// Whether the first bits of address equal to the prefix.
+static inline bool srs_ip_prefix_match(const uint8_t addr[16], const uint8_t prefix[16], int bits)
+{
+    int bytes = bits >> 3;
+    if (memcmp(addr, prefix, bytes) != 0) {
+        return false;
+    }
+
+    int left = bits & 7;
+    if (!left) {
+        return true;
+    }
+
+    uint8_t mask = (uint8_t)(0xff << (8 - left));
+    return (addr[bytes] & mask) == (prefix[bytes] & mask);
+}
+
+// The length of common prefix of a and b, at most bits.
+static int srs_ip_common_bits(const uint8_t a[16], const uint8_t b[16], int bits)
+{
+    int n = 0;
+    while (n < bits && a[n >> 3] == b[n >> 3] && n + 8 <= bits) {
+        n += 8;
+    }
+    while (n < bits && srs_ip_bit(a, n) == srs_ip_bit(b, n)) {
+        n++;
+    }
+    return n;
+}
+
+static void srs_ip_mask(const uint8_t addr[16], int bits, uint8_t prefix[16])
+{
+    memset(prefix, 0, 16);
+    memcpy(prefix, addr, bits >> 3);
+    if (bits & 7) {
+        prefix[bits >> 3] = addr[bits >> 3] & (uint8_t)(0xff << (8 - (bits & 7)));
+    }
+}
+
+bool srs_ip_parse(const string& ip, uint8_t addr[16])
+{
+    if (ip.find(':') != string::npos) {
+        return inet_pton(AF_INET6, ip.c_str(), addr) == 1;
+    }
+
+    // Map the IPv4 to IPv6, so the dual stack address ::ffff:1.2.3.4 is the same one.
+    memset(addr, 0, 10);
+    addr[10] = addr[11] = 0xff;
+    return inet_pton(AF_INET, ip.c_str(), addr + 12) == 1;
+}
+
+int srs_ip_rule_parse(string rule, uint8_t addr[16], int& bits)
+{
+    int verdict = SrsIpVerdictDeny;
+
+    rule = srs_string_trim_start(srs_string_trim_end(rule, " \t\r\n"), " \t\r\n");
+    if (srs_string_starts_with(rule, "!")) {
+        verdict = SrsIpVerdictAllow;
+        rule = rule.substr(1);
+    }
+
+    string ip = rule;
+    string length;
+    size_t pos = rule.find('/');
+    if (pos != string::npos) {
+        ip = rule.substr(0, pos);
+        length = rule.substr(pos + 1);
+        if (length.empty()) {
+            return SrsIpVerdictNone;
+        }
+    }
+
+    if (!srs_ip_parse(ip, addr)) {
+        return SrsIpVerdictNone;
+    }
+
+    // The IPv4 prefix is in the mapped address, after the 96 bits.
+    bool ipv4 = ip.find(':') == string::npos;
+    int max = ipv4 ? 32 : 128;
+    bits = max;
+    if (!length.empty()) {
+        char* end = NULL;
+        bits = (int)::strtol(length.c_str(), &end, 10);
+        if (*end || bits < 0 || bits > max) {
+            return SrsIpVerdictNone;
+        }
+    }
+    if (ipv4) {
+        bits += 96;
+    }
+
+    return verdict;
+}
+
+SrsIpMatcher::SrsIpMatcher()
+{
+    nodes_ = NULL;
+    nn_nodes_ = 0;
+    nn_rules_ = 0;
+    mapped_ = false;
+
+    uint8_t any[16] = {0};
+    create(any, 0, SrsIpVerdictNone);
+}
+
+SrsIpMatcher::~SrsIpMatcher()
+{
+}
+
+srs_error_t SrsIpMatcher::add(string rule)
+{
+    uint8_t addr[16];
+    int bits = 0;
+
+    int verdict = srs_ip_rule_parse(rule, addr, bits);
+    if (verdict == SrsIpVerdictNone) {
+        return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "invalid ip rule %s", rule.c_str());
+    }
+
+    add(addr, bits, verdict);
+    return srs_success;
+}
+
+void SrsIpMatcher::add(const uint8_t addr[16], int bits, int verdict)
+{
+    srs_assert(!mapped_);
+
+    uint8_t prefix[16];
+    srs_ip_mask(addr, bits, prefix);
+
+    // Use index rather than pointer, because the nodes may be reallocated when creating.
+    uint32_t cur = 0;
+    while (true) {
+        if (nodes_[cur].bits == bits) {
+            nn_rules_ += nodes_[cur].verdict == SrsIpVerdictNone ? 1 : 0;
+            nodes_[cur].verdict = (uint8_t)verdict;
+            return;
+        }
+
+        int b = srs_ip_bit(prefix, nodes_[cur].bits);
+        uint32_t c = nodes_[cur].child[b];
+        if (!c) {
+            uint32_t leaf = create(prefix, bits, verdict);
+            nodes_[cur].child[b] = leaf;
+            nn_rules_++;
+            return;
+        }
+
+        int child_bits = nodes_[c].bits;
+        int common = srs_ip_common_bits(prefix, nodes_[c].prefix, srs_min(bits, child_bits));
+        if (common == child_bits) {
+            cur = c;
+            continue;
+        }
+
+        // Split the edge to child, the new prefix is the parent of child, or both are under a glue node.
+        uint32_t parent;
+        if (common == bits) {
+            parent = create(prefix, bits, verdict);
+        } else {
+            parent = create(prefix, common, SrsIpVerdictNone);
+            uint32_t leaf = create(prefix, bits, verdict);
+            nodes_[parent].child[srs_ip_bit(prefix, common)] = leaf;
+        }
+        nodes_[parent].child[srs_ip_bit(nodes_[c].prefix, common)] = c;
+        nodes_[cur].child[b] = parent;
+        nn_rules_++;
+        return;
+    }
+}
+
+static void srs_ip_matcher_align(string& data)
+{
+    data.append((8 - data.size() % 8) % 8, '\0');
+}
+
+void SrsIpMatcher::encode(string& data)
+{
+    SrsIpMatcherHeader header;
+    header.nn_rules = (uint32_t)nn_rules_;
+    header.nn_nodes = nn_nodes_;
+
+    data.append((const char*)&header, sizeof(header));
+    data.append((const char*)nodes_, sizeof(SrsIpNode) * nn_nodes_);
+    srs_ip_matcher_align(data);
+}
+
+srs_error_t SrsIpMatcher::decode(const char* data, size_t size, size_t* pnread)
+{
+    srs_error_t err = srs_success;
+
+    if (size < sizeof(SrsIpMatcherHeader)) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "ip rules header requires %d only %d bytes",
+            (int)sizeof(SrsIpMatcherHeader), (int)size);
+    }
+
+    SrsIpMatcherHeader* header = (SrsIpMatcherHeader*)data;
+    if (!header->nn_nodes) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid ip rules, no root");
+    }
+
+    uint64_t end = sizeof(SrsIpMatcherHeader) + (uint64_t)sizeof(SrsIpNode) * header->nn_nodes;
+    end += (8 - end % 8) % 8;
+    if (end > size) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "ip rules requires %u only %u bytes", (uint32_t)end, (uint32_t)size);
+    }
+
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+
+    nodes_ = (SrsIpNode*)(data + sizeof(SrsIpMatcherHeader));
+    nn_nodes_ = header->nn_nodes;
+    nn_rules_ = (int)header->nn_rules;
+    mapped_ = true;
+
+    if (pnread) {
+        *pnread = (size_t)end;
+    }
+
+    return err;
+}
+
+int SrsIpMatcher::match(const string& ip)
+{
+    // Fast path, for the most policy has no IP rules.
+    if (!nn_rules_) {
+        return SrsIpVerdictNone;
+    }
+
+    uint8_t addr[16];
+    if (!srs_ip_parse(ip, addr)) {
+        return SrsIpVerdictNone;
+    }
+
+    return match(addr);
+}
+
+int SrsIpMatcher::match(const uint8_t addr[16])
+{
+    int verdict = SrsIpVerdictNone;
+
+    // The bits and child are checked, because the decoded data may be corrupt, and the bits always
+    // increases in a valid tree, so the depth is at most 129 nodes.
+    uint32_t cur = 0;
+    for (int depth = 0; depth <= 128; depth++) {
+        SrsIpNode* node = &nodes_[cur];
+        if (node->bits > 128 || !srs_ip_prefix_match(addr, node->prefix, node->bits)) {
+            break;
+        }
+        if (node->verdict != SrsIpVerdictNone) {
+            verdict = node->verdict;
+        }
+        if (node->bits == 128) {
+            break;
+        }
+
+        cur = node->child[srs_ip_bit(addr, node->bits)];
+        if (!cur || cur >= nn_nodes_) {
+            break;
+        }
+    }
+
+    return verdict;
+}
+
+int SrsIpMatcher::size()
+{
+    return nn_rules_;
+}
+
+size_t SrsIpMatcher::memory()
+{
+    return sizeof(SrsIpNode) * nn_nodes_;
+}
+
+uint32_t SrsIpMatcher::create(const uint8_t addr[16], int bits, int verdict)
+{
+    SrsIpNode node;
+    memset(&node, 0, sizeof(node));
+    srs_ip_mask(addr, bits, node.prefix);
+    node.bits = (uint8_t)bits;
+    node.verdict = (uint8_t)verdict;
+
+    buffer_.push_back(node);
+    nodes_ = &buffer_[0];
+    nn_nodes_ = (uint32_t)buffer_.size();
+    return nn_nodes_ - 1;
+}
@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_IP_MATCHER_HPP
+#define SRS_APP_IP_MATCHER_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+
+// The verdict of client IP, decided by the longest matched prefix.
+enum SrsIpVerdict
+{
+    // No rule matches the IP.
+    SrsIpVerdictNone = 0,
+    // Allow the IP, for example, "!10.1.0.0/16", which is an exception of a wider deny rule.
+    SrsIpVerdictAllow = 1,
+    // Deny the IP, for example, "10.0.0.0/8", which is the default.
+    SrsIpVerdictDeny = 2,
+};
+
+// Parse the IP or CIDR to the 128 bits address, the IPv4 is mapped to ::ffff:0:0/96.
+// @return Whether the address is valid.
+extern bool srs_ip_parse(const std::string& ip, uint8_t addr[16]);
+// Parse the rule, which is [!]ip[/bits], the bits is for the mapped address.
+// @return The verdict, or SrsIpVerdictNone if the rule is invalid.
+extern int srs_ip_rule_parse(std::string rule, uint8_t addr[16], int& bits);
+
+// The client IP matcher, which is a path compressed binary radix tree(Patricia tree) of the IPv4 and IPv6
+// prefixes, the verdict is decided by the longest matched prefix, in O(depth) which is at most the number of
+// rules and 128, so the allow and deny rules work together, for example, deny "0.0.0.0/0" except "!10.0.0.0/8".
+// @remark The nodes are in an array and linked by index, so they're encoded as is, and decoded in place.
+class SrsIpMatcher
+{
+private:
+    // The node of tree, the prefix is masked by bits, the child is index of node, 0 is none.
+    struct SrsIpNode
+    {
+        uint8_t prefix[16];
+        uint8_t bits;
+        uint8_t verdict;
+        uint16_t reserved;
+        uint32_t child[2];
+    };
+private:
+    // The nodes, the root is always at 0 with 0 bits, so it matches all addresses.
+    SrsIpNode* nodes_;
+    uint32_t nn_nodes_;
+    int nn_rules_;
+    // The nodes when adding rules, empty if decoded.
+    std::vector<SrsIpNode> buffer_;
+    // Whether the nodes are in the decoded data, which is read-only.
+    bool mapped_;
+public:
+    SrsIpMatcher();
+    virtual ~SrsIpMatcher();
+public:
+    // Add a rule, see srs_ip_rule_parse, the later rule overwrites the same prefix.
+    virtual srs_error_t add(std::string rule);
+    // Add a prefix with the verdict, the address is masked by bits.
+    // @remark Never add rule to the decoded matcher, which is read-only.
+    virtual void add(const uint8_t addr[16], int bits, int verdict);
+    // Append the rules to data, in the binary format, the size is aligned to 8 bytes.
+    virtual void encode(std::string& data);
+    // Use the rules in data, which should be aligned to 8 bytes, and alive until the matcher is freed.
+    // @param pnread The bytes of rules in data.
+    virtual srs_error_t decode(const char* data, size_t size, size_t* pnread);
+    // Get the verdict of IP, see SrsIpVerdict.
+    virtual int match(const std::string& ip);
+    virtual int match(const uint8_t addr[16]);
+    // The number of rules.
+    virtual int size();
+    // The bytes of memory used by the rules.
+    virtual size_t memory();
+private:
+    uint32_t create(const uint8_t addr[16], int bits, int verdict);
+};
+
+#endif
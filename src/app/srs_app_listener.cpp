@@ -2,6 +2,10 @@
 #include <srs_kernel_error.hpp>
 #include <srs_core_time.hpp>
 #include <srs_kernel_log.hpp>
+#include <srs_protocol_st.hpp>
+
+// The interval to check again, when the handler pauses accepting.
+#define SRS_LISTENER_PAUSE_INTERVAL (100 * SRS_UTIME_MILLISECONDS)
 
 ISrsTcpHandler::ISrsTcpHandler()
 {
@@ -11,6 +15,11 @@ ISrsTcpHandler::~ISrsTcpHandler()
 {
 }
 
+bool ISrsTcpHandler::should_pause_accept()
+{
+    return false;
+}
+
 SrsTcpListener::SrsTcpListener(ISrsTcpHandler* h, string i, int p)
 {
     handler = h;
@@ -57,6 +66,11 @@ srs_error_t SrsTcpListener::cycle()
             return srs_error_wrap(err, "tcp listener");
         }
 
+        if (handler->should_pause_accept()) {
+            srs_usleep(SRS_LISTENER_PAUSE_INTERVAL);
+            continue;
+        }
+
         srs_netfd_t fd = srs_accept(lfd, NULL, NULL, SRS_UTIME_NO_TIMEOUT);
         if(fd == NULL){
             return srs_error_new(ERROR_SOCKET_ACCEPT, "accept at fd=%d", srs_netfd_fileno(lfd));
@@ -18,6 +18,9 @@ public:
 public:
     // When got tcp client.
     virtual srs_error_t on_tcp_client(srs_netfd_t stfd) = 0;
+    // Whether stop accepting for a while, the clients wait in the backlog of kernel.
+    // @remark Default to false, never pause.
+    virtual bool should_pause_accept();
 };
 
 class SrsTcpListener : public ISrsCoroutineHandler
@@ -0,0 +1,235 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_memory.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_kernel_pool.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_app_conn.hpp>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <malloc.h>
+#ifdef SRS_TCMALLOC
+#include <gperftools/malloc_extension_c.h>
+#endif
+using namespace std;
+
+SrsMemoryReleaser* _srs_memory_releaser = NULL;
+
+SrsMemoryStat::SrsMemoryStat()
+{
+    heap = allocated = free = rss = 0;
+}
+
+double SrsMemoryStat::fragmentation()
+{
+    return heap ? (double)free / heap : 0;
+}
+
+#ifdef SRS_TCMALLOC
+static uint64_t srs_tcmalloc_property(const char* name)
+{
+    size_t v = 0;
+    MallocExtension_GetNumericProperty(name, &v);
+    return v;
+}
+#endif
+
+void srs_memory_stat(SrsMemoryStat& stat)
+{
+#ifdef SRS_TCMALLOC
+    // The heap size includes the bytes which are released to OS, but still reserved.
+    stat.allocator = "tcmalloc";
+    stat.heap = srs_tcmalloc_property("generic.heap_size") - srs_tcmalloc_property("tcmalloc.pageheap_unmapped_bytes");
+    stat.allocated = srs_tcmalloc_property("generic.current_allocated_bytes");
+    stat.free = stat.heap > stat.allocated ? stat.heap - stat.allocated : 0;
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    // The mmapped chunks are returned to OS when freed, so they are never free.
+    struct mallinfo2 mi = mallinfo2();
+    stat.allocator = "glibc";
+    stat.heap = mi.arena + mi.hblkhd;
+    stat.allocated = mi.uordblks + mi.hblkhd;
+    stat.free = mi.fordblks;
+#else
+    struct mallinfo mi = mallinfo();
+    stat.allocator = "glibc";
+    stat.heap = (uint32_t)mi.arena + (uint32_t)mi.hblkhd;
+    stat.allocated = (uint32_t)mi.uordblks + (uint32_t)mi.hblkhd;
+    stat.free = (uint32_t)mi.fordblks;
+#endif
+
+    // The second field is the resident pages.
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        unsigned long size = 0, resident = 0;
+        if (fscanf(f, "%lu %lu", &size, &resident) == 2) {
+            stat.rss = (uint64_t)resident * ::sysconf(_SC_PAGESIZE);
+        }
+        fclose(f);
+    }
+}
+
+void srs_memory_release(uint64_t bytes)
+{
+#ifdef SRS_TCMALLOC
+    if (bytes) {
+        MallocExtension_ReleaseToSystem(bytes);
+    } else {
+        MallocExtension_ReleaseFreeMemory();
+    }
+#else
+    // The free pages in middle of heap are also released, not only the top, since glibc 2.8.
+    malloc_trim(0);
+#endif
+}
+
+bool srs_memory_is_idle(int conns, int last_conns, uint64_t requests, srs_utime_t interval, int idle_requests)
+{
+    return conns <= last_conns && requests * SRS_UTIME_SECONDS <= (uint64_t)idle_requests * interval;
+}
+
+SrsMemoryReleaser::SrsMemoryReleaser()
+{
+    trd_ = new SrsSTCoroutine("memory", this);
+    enabled_ = false;
+    conns_ = NULL;
+    interval_ = 0;
+    rate_ = 0;
+    idle_requests_ = 0;
+    last_conns_ = 0;
+    requests_ = 0;
+
+    nn_releases_ = 0;
+    nn_released_bytes_ = 0;
+    elapsed_ = 0;
+    nn_idle_releases_ = 0;
+    nn_busy_skips_ = 0;
+}
+
+SrsMemoryReleaser::~SrsMemoryReleaser()
+{
+    srs_freep(trd_);
+}
+
+srs_error_t SrsMemoryReleaser::initialize(SrsResourceManager* conns, srs_utime_t interval, uint64_t rate, int idle_requests)
+{
+    srs_error_t err = srs_success;
+
+    enabled_ = true;
+    conns_ = conns;
+    interval_ = srs_max(interval, SRS_UTIME_SECONDS);
+    rate_ = rate;
+    idle_requests_ = idle_requests;
+
+    if ((err = trd_->start()) != srs_success) {
+        return srs_error_wrap(err, "start memory releaser");
+    }
+
+    SrsMemoryStat stat;
+    srs_memory_stat(stat);
+    srs_trace("memory release by %s, interval=%dms, rate=%dMB, idle_requests=%d", stat.allocator.c_str(),
+        srsu2msi(interval_), (int)(rate / 1024 / 1024), idle_requests_);
+
+    return err;
+}
+
+uint64_t SrsMemoryReleaser::release(uint64_t bytes)
+{
+    SrsMemoryStat before;
+    srs_memory_stat(before);
+
+    srs_utime_t starttime = srs_get_monotonic_time();
+    srs_memory_release(bytes);
+    elapsed_ += srs_get_monotonic_time() - starttime;
+
+    SrsMemoryStat after;
+    srs_memory_stat(after);
+
+    uint64_t released = before.rss > after.rss ? before.rss - after.rss : 0;
+    nn_releases_++;
+    nn_released_bytes_ += released;
+
+    if (released) {
+        srs_trace("memory: release %dKB, rss=%dMB, heap=%dMB, free=%dMB", (int)(released / 1024),
+            (int)(after.rss / 1024 / 1024), (int)(after.heap / 1024 / 1024), (int)(after.free / 1024 / 1024));
+    }
+
+    return released;
+}
+
+void SrsMemoryReleaser::on_idle_release()
+{
+    nn_idle_releases_++;
+}
+
+void SrsMemoryReleaser::on_request()
+{
+    requests_++;
+}
+
+void SrsMemoryReleaser::dumps(SrsJsonObject* obj)
+{
+    SrsMemoryStat stat;
+    srs_memory_stat(stat);
+
+    obj->set("allocator", SrsJsonAny::str(stat.allocator.c_str()));
+    obj->set("heap", SrsJsonAny::integer(stat.heap));
+    obj->set("allocated", SrsJsonAny::integer(stat.allocated));
+    obj->set("free", SrsJsonAny::integer(stat.free));
+    obj->set("fragmentation", SrsJsonAny::number(stat.fragmentation()));
+    obj->set("rss", SrsJsonAny::integer(stat.rss));
+    obj->set("idle_releases", SrsJsonAny::integer(nn_idle_releases_));
+
+    SrsJsonObject* releaser = SrsJsonAny::object();
+    obj->set("release", releaser);
+    releaser->set("enabled", SrsJsonAny::boolean(enabled_));
+    releaser->set("interval", SrsJsonAny::integer(srsu2ms(interval_)));
+    releaser->set("rate", SrsJsonAny::integer(rate_));
+    releaser->set("idle_requests", SrsJsonAny::integer(idle_requests_));
+    releaser->set("busy_skips", SrsJsonAny::integer(nn_busy_skips_));
+    releaser->set("releases", SrsJsonAny::integer(nn_releases_));
+    releaser->set("released_bytes", SrsJsonAny::integer(nn_released_bytes_));
+    releaser->set("elapsed", SrsJsonAny::integer(srsu2ms(elapsed_)));
+}
+
+srs_error_t SrsMemoryReleaser::cycle()
+{
+    srs_error_t err = srs_success;
+
+    while (true) {
+        if ((err = trd_->pull()) != srs_success) {
+            return srs_error_wrap(err, "pull");
+        }
+
+        srs_usleep(interval_);
+
+        int conns = conns_->size();
+        uint64_t requests = requests_;
+        requests_ = 0;
+
+        bool idle = srs_memory_is_idle(conns, last_conns_, requests, interval_, idle_requests_);
+        last_conns_ = conns;
+        if (!idle) {
+            nn_busy_skips_++;
+            continue;
+        }
+
+        // All connections are closed, so the free objects in pools are not reused soon.
+        if (!conns) {
+            vector<SrsObjectPool*>& pools = SrsObjectPool::pools();
+            for (int i = 0; i < (int)pools.size(); i++) {
+                pools.at(i)->shrink();
+            }
+        }
+        release(rate_);
+    }
+
+    return err;
+}
+
@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_MEMORY_HPP
+#define SRS_APP_MEMORY_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+
+#include <srs_app_st.hpp>
+
+class SrsJsonObject;
+class SrsResourceManager;
+
+// The stat of allocator, in bytes.
+class SrsMemoryStat
+{
+public:
+    // The allocator, tcmalloc or glibc.
+    std::string allocator;
+    // The heap mapped from OS, which is the allocated and free bytes.
+    uint64_t heap;
+    // The bytes allocated by application.
+    uint64_t allocated;
+    // The free bytes in heap, which are not returned to OS.
+    uint64_t free;
+    // The resident bytes of process, from /proc/self/statm.
+    uint64_t rss;
+public:
+    SrsMemoryStat();
+public:
+    // The ratio of free bytes in heap.
+    double fragmentation();
+};
+
+// Get the stat of allocator.
+extern void srs_memory_stat(SrsMemoryStat& stat);
+// Return the free memory to OS, at most bytes for tcmalloc, or all free memory if 0.
+// @remark The glibc always releases all free memory by malloc_trim.
+extern void srs_memory_release(uint64_t bytes);
+// Whether the proxy is idle in the interval, that the connections are not growing, and there are not more than
+// idle_requests requests per second.
+extern bool srs_memory_is_idle(int conns, int last_conns, uint64_t requests, srs_utime_t interval, int idle_requests);
+
+// Return the free memory to OS in background, only when the proxy is idle, because the memory is reused soon
+// when it's busy, and the malloc_trim of a large heap blocks the only ST thread for long time. The glibc keeps
+// the freed memory below the mmap threshold, so the RSS never decreases without it, see doc/issues/1.md.
+class SrsMemoryReleaser : public ISrsCoroutineHandler
+{
+private:
+    SrsCoroutine* trd_;
+    bool enabled_;
+    SrsResourceManager* conns_;
+    srs_utime_t interval_;
+    uint64_t rate_;
+    int idle_requests_;
+    int last_conns_;
+    // The requests in current interval.
+    uint64_t requests_;
+private:
+    uint64_t nn_releases_;
+    uint64_t nn_released_bytes_;
+    srs_utime_t elapsed_;
+    uint64_t nn_idle_releases_;
+    uint64_t nn_busy_skips_;
+public:
+    SrsMemoryReleaser();
+    virtual ~SrsMemoryReleaser();
+public:
+    // Start to release at most rate bytes each interval, all free memory if rate is 0, when there are not more than
+    // idle_requests requests per second.
+    virtual srs_error_t initialize(SrsResourceManager* conns, srs_utime_t interval, uint64_t rate, int idle_requests);
+    // Release the free memory now, return the bytes of RSS decreased.
+    virtual uint64_t release(uint64_t bytes);
+    // When an idle connection releases its buffers.
+    virtual void on_idle_release();
+    // When a request is received from client.
+    virtual void on_request();
+    virtual void dumps(SrsJsonObject* obj);
+// Interface ISrsCoroutineHandler
+public:
+    virtual srs_error_t cycle();
+};
+
+extern SrsMemoryReleaser* _srs_memory_releaser;
+
+#endif
+
@@ -5,30 +5,202 @@
 #include <srs_kernel_utility.hpp>
 #include <srs_protocol_json.hpp>
 #include <srs_core_auto_free.hpp>
+#include <srs_app_domain_matcher.hpp>
+#include <srs_app_ip_matcher.hpp>
+#include <srs_app_url_matcher.hpp>
+
+#include <unistd.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <algorithm>
+
+// The magic and version of policy database.
+#define SRS_POLICY_DATABASE_MAGIC "SRSPOLDB"
+#define SRS_POLICY_DATABASE_VERSION 2
+
+// The flags of policy database.
+#define SRS_POLICY_FLAG_HTTPS_DESCRYPT 0x01
+
+// The sections of policy database, the unknown section is ignored.
+enum SrsPolicySection
+{
+    SrsPolicySectionBlackList = 1,
+    SrsPolicySectionTunnelDomain = 2,
+    SrsPolicySectionClientIpList = 3,
+    SrsPolicySectionUrlBlackList = 4,
+};
+
+// The policy database is [header][sections][payloads], all in host byte order and aligned to 8 bytes, the payloads
+// start at 64 bytes, so the blocks of bloom filter are aligned to cache line.
+struct SrsPolicyDatabaseHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    // The size of file, to detect the truncated file.
+    uint64_t size;
+    uint32_t nn_sections;
+    uint32_t reserved;
+};
+
+struct SrsPolicyDatabaseSection
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
 
 SrsPolicy::SrsPolicy()
 {
-    init();
+    black_list = new SrsDomainMatcher();
+    tunnel_domain = new SrsDomainMatcher();
+    client_ip_list = new SrsIpMatcher();
+    url_black_list = new SrsUrlMatcher();
+    https_descrypt_enable = false;
+    database = NULL;
+    deferred_log_ = false;
+    refs_ = 1;
+    version_ = 0;
 }
 
 SrsPolicy::~SrsPolicy()
 {
-    
+    // Free the rules before the database they point to.
+    srs_freep(black_list);
+    srs_freep(tunnel_domain);
+    srs_freep(client_ip_list);
+    srs_freep(url_black_list);
+    srs_freep(database);
 }
 
 void SrsPolicy::init()
 {
+    srs_error_t err = srs_success;
+
     https_descrypt_enable = false;
-    loadPolicy();
+    if((err = loadPolicy()) != srs_success)
+    {
+        srs_warn("load policy, %s", srs_error_desc(err).c_str());
+        srs_freep(err);
+    }
 }
 
-void SrsPolicy::loadPolicy()
+void SrsPolicy::acquire()
 {
-    srs_error_t err;
+    refs_.fetch_add(1);
+}
+
+void SrsPolicy::release()
+{
+    if(refs_.fetch_sub(1) == 1)
+    {
+        delete this;
+    }
+}
+
+uint64_t SrsPolicy::version()
+{
+    return version_;
+}
+
+void SrsPolicy::set_version(uint64_t v)
+{
+    version_ = v;
+}
+
+std::string SrsPolicy::source()
+{
+    return source_;
+}
+
+void SrsPolicy::set_deferred_log(bool v)
+{
+    deferred_log_ = v;
+}
+
+void SrsPolicy::flush_logs()
+{
+    for(size_t i = 0; i < logs_.size(); i++)
+    {
+        const std::pair<SrsLogLevel, std::string>& log = logs_[i];
+        if(log.first == SrsLogLevelWarn)
+        {
+            srs_warn("%s", log.second.c_str());
+        }
+        else
+        {
+            srs_trace("%s", log.second.c_str());
+        }
+    }
+    logs_.clear();
+}
+
+void SrsPolicy::log(SrsLogLevel level, const char* fmt, ...)
+{
+    char buf[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    logs_.push_back(std::make_pair(level, std::string(buf)));
+    if(!deferred_log_)
+    {
+        flush_logs();
+    }
+}
+
+// Get the modify time of file, 0 if not exists.
+static time_t srs_policy_file_mtime(std::string path)
+{
+    struct stat st;
+    if(::stat(path.c_str(), &st) < 0)
+    {
+        return 0;
+    }
+    return st.st_mtime;
+}
+
+srs_error_t SrsPolicy::loadPolicy()
+{
+    srs_error_t err = srs_success;
+
+    // Ignore the database which is older than json, for operator may forget to compile it.
+    time_t database_mtime = srs_policy_file_mtime(SRS_POLICY_DATABASE);
+    if(database_mtime && database_mtime >= srs_policy_file_mtime(SRS_POLICY_JSON))
+    {
+        if((err = loadCompiledPolicy(SRS_POLICY_DATABASE)) == srs_success)
+        {
+            return err;
+        }
+        log(SrsLogLevelWarn, "ignore policy database, %s", srs_error_desc(err).c_str());
+        srs_freep(err);
+    }
+    else if(database_mtime)
+    {
+        log(SrsLogLevelWarn, "ignore policy database %s for older than %s", SRS_POLICY_DATABASE, SRS_POLICY_JSON);
+    }
+
+    if((err = loadJsonPolicy(SRS_POLICY_JSON)) != srs_success)
+    {
+        return srs_error_wrap(err, "load json");
+    }
+    return err;
+}
+
+srs_error_t SrsPolicy::loadJsonPolicy(std::string path)
+{
+    srs_error_t err = srs_success;
     SrsFileReader* read = new SrsFileReader();
     SrsAutoFree(SrsFileReader, read);
-    srs_trace("start to load policy");
-    read->open("./conf/policy.json");
+    log(SrsLogLevelTrace, "start to load policy %s", path.c_str());
+    if((err = read->open(path)) != srs_success)
+    {
+        return srs_error_wrap(err, "open policy");
+    }
     std::string poliy;
     char buf[4096];
     ssize_t nread = 0;
@@ -50,82 +222,409 @@ void SrsPolicy::loadPolicy()
 
     SrsJsonAny* any = NULL;
     if ((any = SrsJsonAny::loads(poliy)) == NULL) {
-        return;
+        return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "parse policy %s", path.c_str());
     }
-
-    SrsJsonObject *obj_req = NULL;
-    SrsAutoFree(SrsJsonObject, obj_req);
-    if(any->is_object())
+    SrsAutoFree(SrsJsonAny, any);
+    if(!any->is_object())
     {
-        obj_req = any->to_object();
+        return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "policy %s is not object", path.c_str());
     }
+    SrsJsonObject *obj_req = any->to_object();
+
+    // Build the new rules, then replace the current ones.
+    SrsDomainMatcher* new_black_list = new SrsDomainMatcher();
+    SrsAutoFree(SrsDomainMatcher, new_black_list);
+    SrsDomainMatcher* new_tunnel_domain = new SrsDomainMatcher();
+    SrsAutoFree(SrsDomainMatcher, new_tunnel_domain);
+    SrsIpMatcher* new_client_ip_list = new SrsIpMatcher();
+    SrsAutoFree(SrsIpMatcher, new_client_ip_list);
+    SrsUrlMatcher* new_url_black_list = new SrsUrlMatcher();
+    SrsAutoFree(SrsUrlMatcher, new_url_black_list);
 
     SrsJsonAny* prop = obj_req->get_property("black_list");
-    if(!prop->is_array())
+    if(prop && prop->is_array())
     {
-        //parse error
-        return;
+        SrsJsonArray* array = prop->to_array();
+        for(size_t i = 0; i < array->count(); i++)
+        {
+            if((err = new_black_list->add(array->at(i)->to_str())) != srs_success)
+            {
+                log(SrsLogLevelWarn, "ignore black list, %s", srs_error_desc(err).c_str());
+                srs_freep(err);
+            }
+        }
     }
 
-    SrsJsonArray* array = prop->to_array();
-
-    for(size_t i = 0; i < array->count(); i++)
+    // The huge black list, such as the phishing database, is in files.
+    prop = obj_req->get_property("black_list_files");
+    if(prop && prop->is_array())
     {
-        std::string black_domain = array->at(i)->to_str();
-        srs_trace("push back %s", black_domain.c_str());
-        black_list_vec.push_back(black_domain);
+        SrsJsonArray* array = prop->to_array();
+        for(size_t i = 0; i < array->count(); i++)
+        {
+            loadRulesFile(array->at(i)->to_str(), new_black_list);
+        }
     }
 
     prop = obj_req->get_property("https_descrypt");
-    if(!prop->is_boolean())
+    bool new_https_descrypt_enable = prop && prop->is_boolean() && prop->to_boolean();
+
+    prop = obj_req->get_property("tunnel_domain");
+    if(prop && prop->is_array())
     {
-        return;
+        SrsJsonArray* array = prop->to_array();
+        for(size_t i = 0; i < array->count(); i++)
+        {
+            if((err = new_tunnel_domain->add(array->at(i)->to_str())) != srs_success)
+            {
+                log(SrsLogLevelWarn, "ignore tunnel domain, %s", srs_error_desc(err).c_str());
+                srs_freep(err);
+            }
+        }
+    }
+
+    // The CIDR of client, deny by default, or allow if starts with "!".
+    prop = obj_req->get_property("client_ip_list");
+    if(prop && prop->is_array())
+    {
+        SrsJsonArray* array = prop->to_array();
+        for(size_t i = 0; i < array->count(); i++)
+        {
+            if((err = new_client_ip_list->add(array->at(i)->to_str())) != srs_success)
+            {
+                log(SrsLogLevelWarn, "ignore client ip, %s", srs_error_desc(err).c_str());
+                srs_freep(err);
+            }
+        }
     }
-    https_descrypt_enable = prop->to_boolean();
 
+    // The path and query of decrypted request, all rules are compiled to one automaton.
+    prop = obj_req->get_property("url_black_list");
+    if(prop && prop->is_array())
+    {
+        SrsJsonArray* array = prop->to_array();
+        for(size_t i = 0; i < array->count(); i++)
+        {
+            if((err = new_url_black_list->add(array->at(i)->to_str())) != srs_success)
+            {
+                log(SrsLogLevelWarn, "ignore url black list, %s", srs_error_desc(err).c_str());
+                srs_freep(err);
+            }
+        }
+    }
 
-    prop = obj_req->get_property("tunnel_domain");
-    if(!prop->is_array())
+    prop = obj_req->get_property("url_black_list_files");
+    if(prop && prop->is_array())
     {
-        return;
+        SrsJsonArray* array = prop->to_array();
+        for(size_t i = 0; i < array->count(); i++)
+        {
+            loadRulesFile(array->at(i)->to_str(), new_url_black_list);
+        }
     }
+    new_url_black_list->compile();
+    new_black_list->compile();
+    new_tunnel_domain->compile();
 
-    array = prop->to_array();
+    // Free the current rules before the database they point to.
+    std::swap(black_list, new_black_list);
+    std::swap(tunnel_domain, new_tunnel_domain);
+    std::swap(client_ip_list, new_client_ip_list);
+    std::swap(url_black_list, new_url_black_list);
+    srs_freep(new_black_list);
+    srs_freep(new_tunnel_domain);
+    srs_freep(new_client_ip_list);
+    srs_freep(new_url_black_list);
+    srs_freep(database);
+    https_descrypt_enable = new_https_descrypt_enable;
+    source_ = path;
 
-    for(size_t i = 0; i < array->count(); i++)
+    log(SrsLogLevelTrace, "load policy %s, black list rules=%d, memory=%dKB, bloom=%dKB, tunnel domain rules=%d, client ip rules=%d, "
+        "url black list rules=%d, states=%d, memory=%dKB, https descrypt=%d", path.c_str(), black_list->size(),
+        (int)(black_list->memory() / 1024), (int)(black_list->bloom_memory() / 1024), tunnel_domain->size(), client_ip_list->size(), url_black_list->size(),
+        url_black_list->states(), (int)(url_black_list->memory() / 1024), https_descrypt_enable);
+    return err;
+}
+
+srs_error_t SrsPolicy::loadCompiledPolicy(std::string path)
+{
+    srs_error_t err = srs_success;
+
+    SrsFileMmap* new_database = new SrsFileMmap();
+    SrsAutoFree(SrsFileMmap, new_database);
+    if((err = new_database->open(path)) != srs_success)
     {
-        std::string tunnel_domain = array->at(i)->to_str();
-        srs_trace("push back %s", tunnel_domain.c_str());
-        tunnel_domain_vec.push_back(tunnel_domain);
+        return srs_error_wrap(err, "open database");
+    }
+
+    const char* data = new_database->data();
+    size_t size = new_database->size();
+
+    SrsPolicyDatabaseHeader* header = (SrsPolicyDatabaseHeader*)data;
+    if(size < sizeof(SrsPolicyDatabaseHeader) || memcmp(header->magic, SRS_POLICY_DATABASE_MAGIC, sizeof(header->magic)) != 0)
+    {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid database %s, size=%d", path.c_str(), (int)size);
+    }
+    if(header->version != SRS_POLICY_DATABASE_VERSION || header->size != size)
+    {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid database %s, version=%u, size=%d/%d", path.c_str(),
+            header->version, (int)size, (int)header->size);
+    }
+    if(sizeof(SrsPolicyDatabaseHeader) + (uint64_t)sizeof(SrsPolicyDatabaseSection) * header->nn_sections > size)
+    {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid database %s, sections=%u", path.c_str(), header->nn_sections);
+    }
+
+    SrsDomainMatcher* new_black_list = new SrsDomainMatcher();
+    SrsAutoFree(SrsDomainMatcher, new_black_list);
+    SrsDomainMatcher* new_tunnel_domain = new SrsDomainMatcher();
+    SrsAutoFree(SrsDomainMatcher, new_tunnel_domain);
+    SrsIpMatcher* new_client_ip_list = new SrsIpMatcher();
+    SrsAutoFree(SrsIpMatcher, new_client_ip_list);
+    SrsUrlMatcher* new_url_black_list = new SrsUrlMatcher();
+    SrsAutoFree(SrsUrlMatcher, new_url_black_list);
+
+    SrsPolicyDatabaseSection* sections = (SrsPolicyDatabaseSection*)(data + sizeof(SrsPolicyDatabaseHeader));
+    for(uint32_t i = 0; i < header->nn_sections; i++)
+    {
+        SrsPolicyDatabaseSection* section = &sections[i];
+        if(section->offset % 8 || section->offset > size || section->size > size - section->offset)
+        {
+            return srs_error_new(ERROR_POLICY_DATABASE, "invalid section type=%u, offset=%d, size=%d",
+                section->type, (int)section->offset, (int)section->size);
+        }
+
+        if(section->type == SrsPolicySectionClientIpList)
+        {
+            if((err = new_client_ip_list->decode(data + section->offset, section->size, NULL)) != srs_success)
+            {
+                return srs_error_wrap(err, "decode section type=%u", section->type);
+            }
+            continue;
+        }
+        if(section->type == SrsPolicySectionUrlBlackList)
+        {
+            if((err = new_url_black_list->decode(data + section->offset, section->size, NULL)) != srs_success)
+            {
+                return srs_error_wrap(err, "decode section type=%u", section->type);
+            }
+            continue;
+        }
+
+        SrsDomainMatcher* matcher = NULL;
+        if(section->type == SrsPolicySectionBlackList)
+        {
+            matcher = new_black_list;
+        }
+        else if(section->type == SrsPolicySectionTunnelDomain)
+        {
+            matcher = new_tunnel_domain;
+        }
+        else
+        {
+            log(SrsLogLevelWarn, "ignore unknown section type=%u", section->type);
+            continue;
+        }
+
+        if((err = matcher->decode(data + section->offset, section->size, NULL)) != srs_success)
+        {
+            return srs_error_wrap(err, "decode section type=%u", section->type);
+        }
     }
+
+    // Free the current rules before the database they point to.
+    std::swap(black_list, new_black_list);
+    std::swap(tunnel_domain, new_tunnel_domain);
+    std::swap(client_ip_list, new_client_ip_list);
+    std::swap(url_black_list, new_url_black_list);
+    srs_freep(new_black_list);
+    srs_freep(new_tunnel_domain);
+    srs_freep(new_client_ip_list);
+    srs_freep(new_url_black_list);
+    std::swap(database, new_database);
+    https_descrypt_enable = (header->flags & SRS_POLICY_FLAG_HTTPS_DESCRYPT) != 0;
+    source_ = path;
+
+    log(SrsLogLevelTrace, "load policy database %s, size=%dKB, black list rules=%d, tunnel domain rules=%d, client ip rules=%d, "
+        "url black list rules=%d, https descrypt=%d", path.c_str(), (int)(size / 1024), black_list->size(), tunnel_domain->size(),
+        client_ip_list->size(), url_black_list->size(), https_descrypt_enable);
+    return err;
 }
 
-//domain black list
-bool SrsPolicy::match_black_list(std::string url)
+srs_error_t SrsPolicy::compilePolicy(std::string path)
 {
-    for(std::string black_item : black_list_vec)
+    srs_error_t err = srs_success;
+
+    // The client ip list and url black list are not domain matchers, so they're encoded by type.
+    SrsDomainMatcher* matchers[] = {black_list, tunnel_domain, NULL, NULL};
+    uint32_t types[] = {SrsPolicySectionBlackList, SrsPolicySectionTunnelDomain, SrsPolicySectionClientIpList,
+        SrsPolicySectionUrlBlackList};
+    int nn_sections = (int)(sizeof(types) / sizeof(types[0]));
+
+    SrsPolicyDatabaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SRS_POLICY_DATABASE_MAGIC, sizeof(header.magic));
+    header.version = SRS_POLICY_DATABASE_VERSION;
+    header.flags = https_descrypt_enable ? SRS_POLICY_FLAG_HTTPS_DESCRYPT : 0;
+    header.nn_sections = nn_sections;
+
+    std::vector<SrsPolicyDatabaseSection> sections(nn_sections);
+    std::string payload;
+    uint64_t start = sizeof(SrsPolicyDatabaseHeader) + sizeof(SrsPolicyDatabaseSection) * nn_sections;
+    std::string padding((64 - start % 64) % 64, '\0');
+    start += padding.size();
+    for(int i = 0; i < nn_sections; i++)
     {
-        // srs_trace("black_item is %s", black_item.c_str());
-        if(url.find(black_item) != std::string::npos)
+        size_t offset = payload.size();
+        if(types[i] == SrsPolicySectionClientIpList)
+        {
+            client_ip_list->encode(payload);
+        }
+        else if(types[i] == SrsPolicySectionUrlBlackList)
         {
-            return true;
+            url_black_list->encode(payload);
         }
+        else
+        {
+            matchers[i]->encode(payload);
+        }
+
+        memset(&sections[i], 0, sizeof(SrsPolicyDatabaseSection));
+        sections[i].type = types[i];
+        sections[i].offset = start + offset;
+        sections[i].size = payload.size() - offset;
     }
-    return false;
+    header.size = start + payload.size();
+
+    // Write to a temporary file then rename, so the processes which map the old file are not affected.
+    std::string tmp = path + ".tmp";
+    SrsFileWriter writer;
+    if((err = writer.open(tmp)) != srs_success)
+    {
+        return srs_error_wrap(err, "open %s", tmp.c_str());
+    }
+    if((err = writer.write(&header, sizeof(header), NULL)) != srs_success)
+    {
+        return srs_error_wrap(err, "write header");
+    }
+    if((err = writer.write(&sections[0], sizeof(SrsPolicyDatabaseSection) * nn_sections, NULL)) != srs_success)
+    {
+        return srs_error_wrap(err, "write sections");
+    }
+    if((err = writer.write((void*)padding.data(), padding.size(), NULL)) != srs_success)
+    {
+        return srs_error_wrap(err, "write padding");
+    }
+    if((err = writer.write((void*)payload.data(), payload.size(), NULL)) != srs_success)
+    {
+        return srs_error_wrap(err, "write payload");
+    }
+    writer.close();
+
+    if(::rename(tmp.c_str(), path.c_str()) < 0)
+    {
+        ::unlink(tmp.c_str());
+        return srs_error_new(ERROR_SYSTEM_FILE_RENAME, "rename %s to %s", tmp.c_str(), path.c_str());
+    }
+
+    srs_trace("compile policy to %s, size=%dKB, black list rules=%d, tunnel domain rules=%d, client ip rules=%d, url black list rules=%d",
+        path.c_str(), (int)(header.size / 1024), black_list->size(), tunnel_domain->size(), client_ip_list->size(), url_black_list->size());
+    return err;
 }
 
-// tunnel domain list
-bool SrsPolicy::match_tunnel_domain_list(std::string url)
+// Add the rule in line, ignore the empty line and comment.
+template<typename T>
+static void srs_policy_add_rule(T* matcher, std::string line, int& nn_invalid)
 {
-    for(std::string tunnel_domain : tunnel_domain_vec)
+    line = srs_string_trim_start(srs_string_trim_end(line, " \t\r"), " \t");
+    if(line.empty() || line.at(0) == '#')
     {
-        srs_trace("tunnel_domain_item is %s", tunnel_domain.c_str());
-        if(url.find(tunnel_domain) != std::string::npos)
+        return;
+    }
+
+    srs_error_t err = matcher->add(line);
+    if(err != srs_success)
+    {
+        nn_invalid++;
+        srs_freep(err);
+    }
+}
+
+template<typename T>
+static void srs_policy_load_rules_file(SrsPolicy* policy, std::string path, T* matcher)
+{
+    srs_error_t err = srs_success;
+
+    SrsFileReader reader;
+    if((err = reader.open(path)) != srs_success)
+    {
+        policy->log(SrsLogLevelWarn, "ignore rules file, %s", srs_error_desc(err).c_str());
+        srs_freep(err);
+        return;
+    }
+
+    std::string line;
+    char buf[4096];
+    int nn_invalid = 0;
+    while(1)
+    {
+        ssize_t nread = 0;
+        err = reader.read(buf, sizeof(buf), &nread);
+        srs_freep(err);
+        if(nread <= 0)
+        {
+            break;
+        }
+
+        for(ssize_t i = 0; i < nread; i++)
         {
-            return true;
+            if(buf[i] != '\n')
+            {
+                line.push_back(buf[i]);
+                continue;
+            }
+            srs_policy_add_rule(matcher, line, nn_invalid);
+            line.clear();
         }
     }
-    return false;
+    // The last line without newline.
+    srs_policy_add_rule(matcher, line, nn_invalid);
+
+    policy->log(SrsLogLevelTrace, "load rules file %s, rules=%d, invalid=%d", path.c_str(), matcher->size(), nn_invalid);
+}
+
+void SrsPolicy::loadRulesFile(std::string path, SrsDomainMatcher* matcher)
+{
+    srs_policy_load_rules_file(this, path, matcher);
+}
+
+void SrsPolicy::loadRulesFile(std::string path, SrsUrlMatcher* matcher)
+{
+    srs_policy_load_rules_file(this, path, matcher);
+}
+
+// client ip list
+bool SrsPolicy::match_client_ip_list(const std::string& ip)
+{
+    return client_ip_list->match(ip) == SrsIpVerdictDeny;
+}
+
+//domain black list
+bool SrsPolicy::match_black_list(const std::string& url)
+{
+    return black_list->match(url);
+}
+
+// url black list, the path and query of decrypted request
+bool SrsPolicy::match_url_black_list(const std::string& url)
+{
+    return url_black_list->match(url);
+}
+
+// tunnel domain list
+bool SrsPolicy::match_tunnel_domain_list(const std::string& url)
+{
+    return tunnel_domain->match(url);
 }
 
 bool SrsPolicy::is_https_descrypt_enable()
@@ -133,6 +632,282 @@ bool SrsPolicy::is_https_descrypt_enable()
     return https_descrypt_enable;
 }
 
+SrsPolicyGuard::SrsPolicyGuard()
+{
+    policy_ = _srs_policy;
+    policy_->acquire();
+}
+
+SrsPolicyGuard::~SrsPolicyGuard()
+{
+    policy_->release();
+}
+
+SrsPolicy* SrsPolicyGuard::operator->()
+{
+    return policy_;
+}
+
+SrsPolicy* SrsPolicyGuard::get()
+{
+    return policy_;
+}
+
+// Wait for more changes after reload requested, for example, the editor writes the file several times.
+#define SRS_POLICY_RELOAD_SETTLE (200 * SRS_UTIME_MILLISECONDS)
+// The interval to check whether the loader thread is done.
+#define SRS_POLICY_RELOAD_CHECK (10 * SRS_UTIME_MILLISECONDS)
+
+SrsPolicyReloader::SrsPolicyReloader()
+{
+    trd_ = new SrsSTCoroutine("policy", this);
+    cond_ = srs_cond_new();
+    pending_ = false;
+    loading_ = false;
+    version_ = 0;
+    nn_reloads_ = 0;
+    nn_failed_ = 0;
+    last_reload_elapsed_ = 0;
+
+    loaded_ = false;
+    policy_ = NULL;
+    error_ = srs_success;
+}
+
+SrsPolicyReloader::~SrsPolicyReloader()
+{
+    // The coroutine is interrupted when waiting for the loader, so wait for the loader to free the policy.
+    trd_->interrupt();
+    srs_cond_signal(cond_);
+    srs_freep(trd_);
+
+    if(loading_)
+    {
+        pthread_join(loader_, NULL);
+        if(policy_)
+        {
+            policy_->release();
+        }
+        srs_freep(error_);
+    }
+
+    srs_cond_destroy(cond_);
+}
+
+srs_error_t SrsPolicyReloader::start()
+{
+    srs_error_t err = srs_success;
+
+    if((err = trd_->start()) != srs_success)
+    {
+        return srs_error_wrap(err, "start policy reloader");
+    }
+
+    return err;
+}
+
+void SrsPolicyReloader::reload()
+{
+    pending_ = true;
+    srs_cond_signal(cond_);
+}
+
+void SrsPolicyReloader::dumps(SrsJsonObject* obj)
+{
+    SrsPolicyGuard policy;
+    obj->set("version", SrsJsonAny::integer(policy->version()));
+    obj->set("source", SrsJsonAny::str(policy->source().c_str()));
+    obj->set("black_list", SrsJsonAny::integer(policy->black_list->size()));
+    obj->set("tunnel_domain", SrsJsonAny::integer(policy->tunnel_domain->size()));
+    obj->set("client_ip_list", SrsJsonAny::integer(policy->client_ip_list->size()));
+    obj->set("url_black_list", SrsJsonAny::integer(policy->url_black_list->size()));
+    obj->set("https_descrypt", SrsJsonAny::boolean(policy->is_https_descrypt_enable()));
+    obj->set("reloading", SrsJsonAny::boolean(pending_ || loading_));
+    obj->set("reloads", SrsJsonAny::integer(nn_reloads_));
+    obj->set("failed", SrsJsonAny::integer(nn_failed_));
+    obj->set("elapsed", SrsJsonAny::integer(srsu2ms(last_reload_elapsed_)));
+}
+
+srs_error_t SrsPolicyReloader::cycle()
+{
+    srs_error_t err = srs_success;
+
+    while(true)
+    {
+        if((err = trd_->pull()) != srs_success)
+        {
+            return srs_error_wrap(err, "pull");
+        }
+
+        if(!pending_)
+        {
+            srs_cond_wait(cond_);
+            continue;
+        }
+
+        srs_usleep(SRS_POLICY_RELOAD_SETTLE);
+        pending_ = false;
+
+        if((err = do_reload()) != srs_success)
+        {
+            nn_failed_++;
+            srs_warn("reload policy failed, keep version=%" PRId64 ", %s", _srs_policy->version(), srs_error_desc(err).c_str());
+            srs_freep(err);
+        }
+    }
+
+    return err;
+}
+
+srs_error_t SrsPolicyReloader::do_reload()
+{
+    srs_error_t err = srs_success;
+
+    srs_utime_t starttime = srs_get_monotonic_time();
+
+    loaded_ = false;
+    policy_ = NULL;
+    error_ = srs_success;
+    if(pthread_create(&loader_, NULL, SrsPolicyReloader::load, this) != 0)
+    {
+        return srs_error_new(ERROR_THREAD_CREATE, "create policy loader");
+    }
+    loading_ = true;
+
+    // Never block the ST thread, check the loader periodically.
+    while(!loaded_)
+    {
+        if((err = trd_->pull()) != srs_success)
+        {
+            return srs_error_wrap(err, "pull");
+        }
+        srs_usleep(SRS_POLICY_RELOAD_CHECK);
+    }
+    pthread_join(loader_, NULL);
+    loading_ = false;
+    nn_reloads_++;
+    last_reload_elapsed_ = srs_get_monotonic_time() - starttime;
+
+    policy_->set_deferred_log(false);
+    policy_->flush_logs();
+
+    if(error_ != srs_success)
+    {
+        err = error_;
+        error_ = srs_success;
+        srs_freep(policy_);
+        return srs_error_wrap(err, "load policy");
+    }
+
+    // Replace the global policy, the old one is freed when all in-flight requests release it.
+    SrsPolicy* old = _srs_policy;
+    policy_->set_version(++version_);
+    _srs_policy = policy_;
+    policy_ = NULL;
+
+    srs_trace("reload policy version=%" PRId64 " from %s, elapsed=%dms, black list=%d, tunnel domain=%d", _srs_policy->version(),
+        _srs_policy->source().c_str(), srsu2msi(last_reload_elapsed_), _srs_policy->black_list->size(), _srs_policy->tunnel_domain->size());
+
+    old->release();
+    return err;
+}
+
+void* SrsPolicyReloader::load(void* arg)
+{
+    SrsPolicyReloader* reloader = (SrsPolicyReloader*)arg;
+
+    // Never log in the loader thread, the logs are written by do_reload in the ST thread.
+    SrsPolicy* policy = new SrsPolicy();
+    policy->set_deferred_log(true);
+    reloader->error_ = policy->loadPolicy();
+    reloader->policy_ = policy;
+    reloader->loaded_ = true;
+
+    return NULL;
+}
+
+SrsPolicyInotifyWorker::SrsPolicyInotifyWorker(SrsPolicyReloader* reloader)
+{
+    trd_ = new SrsSTCoroutine("inotify", this);
+    inotify_fd_ = NULL;
+    reloader_ = reloader;
+}
+
+SrsPolicyInotifyWorker::~SrsPolicyInotifyWorker()
+{
+    srs_freep(trd_);
+    srs_close_stfd(inotify_fd_);
+}
+
+srs_error_t SrsPolicyInotifyWorker::start()
+{
+    srs_error_t err = srs_success;
+
+    int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0)
+    {
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "inotify init");
+    }
+    if((inotify_fd_ = srs_netfd_open(fd)) == NULL)
+    {
+        ::close(fd);
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "open inotify fd=%d", fd);
+    }
+
+    // Watch the directory, for the file may be replaced by rename.
+    std::string dir = srs_path_dirname(SRS_POLICY_JSON);
+    if(::inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "inotify watch %s", dir.c_str());
+    }
+
+    if((err = trd_->start()) != srs_success)
+    {
+        return srs_error_wrap(err, "start inotify");
+    }
+
+    srs_trace("policy inotify watch %s, fd=%d", dir.c_str(), fd);
+    return err;
+}
+
+srs_error_t SrsPolicyInotifyWorker::cycle()
+{
+    srs_error_t err = srs_success;
+
+    std::string json = srs_path_basename(SRS_POLICY_JSON);
+    std::string database = srs_path_basename(SRS_POLICY_DATABASE);
+
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while(true)
+    {
+        if((err = trd_->pull()) != srs_success)
+        {
+            return srs_error_wrap(err, "pull");
+        }
+
+        ssize_t nread = srs_read(inotify_fd_, buf, sizeof(buf), SRS_UTIME_NO_TIMEOUT);
+        if(nread <= 0)
+        {
+            return srs_error_new(ERROR_SYSTEM_FILE_READ, "read inotify, nread=%d", (int)nread);
+        }
+
+        for(ssize_t pos = 0; pos < nread;)
+        {
+            struct inotify_event* ie = (struct inotify_event*)(buf + pos);
+            pos += sizeof(struct inotify_event) + ie->len;
+
+            std::string name = ie->len ? ie->name : "";
+            if(name == json || name == database)
+            {
+                srs_trace("policy file %s changed, mask=%#x, reload", name.c_str(), ie->mask);
+                reloader_->reload();
+            }
+        }
+    }
+
+    return err;
+}
+
 SrsNotification::SrsNotification()
 {
     init();
@@ -175,7 +950,171 @@ void SrsNotification::loadNotification()
 
 std::string SrsNotification::getNotification(std::string domain, std::string client_ip)
 {
-    string res = srs_string_replace(notification_page, "%URL%", domain);
-    res = srs_string_replace(res, "%IP%", client_ip);
-    return res;
+    return renderClient(renderDomain(domain), client_ip);
+}
+
+std::string SrsNotification::renderDomain(std::string domain)
+{
+    return srs_string_replace(notification_page, "%URL%", domain);
+}
+
+std::string SrsNotification::renderClient(const std::string& page, std::string client_ip)
+{
+    return srs_string_replace(page, "%IP%", client_ip);
+}
+
+SrsPolicyVerdict::SrsPolicyVerdict()
+{
+    block = false;
+    tunnel = false;
+    decrypt = false;
+    refs_ = 1;
+}
+
+SrsPolicyVerdict::~SrsPolicyVerdict()
+{
+}
+
+void SrsPolicyVerdict::acquire()
+{
+    refs_++;
+}
+
+void SrsPolicyVerdict::release()
+{
+    if(--refs_ == 0)
+    {
+        delete this;
+    }
+}
+
+SrsVerdictGuard::SrsVerdictGuard(SrsPolicyVerdict* verdict)
+{
+    verdict_ = verdict;
+}
+
+SrsVerdictGuard::~SrsVerdictGuard()
+{
+    verdict_->release();
+}
+
+SrsPolicyVerdict* SrsVerdictGuard::operator->()
+{
+    return verdict_;
+}
+
+SrsPolicyVerdict* SrsVerdictGuard::get()
+{
+    return verdict_;
+}
+
+SrsVerdictCache* _srs_verdict_cache = NULL;
+
+SrsVerdictCache::SrsVerdictCache()
+{
+    capacity_ = 4096;
+    version_ = 0;
+    nn_hits_ = 0;
+    nn_misses_ = 0;
+    nn_evicts_ = 0;
+    nn_clears_ = 0;
+}
+
+SrsVerdictCache::~SrsVerdictCache()
+{
+    clear();
+}
+
+void SrsVerdictCache::set_capacity(int capacity)
+{
+    capacity_ = srs_max(0, capacity);
+
+    while((int)lru_.size() > capacity_)
+    {
+        index_.erase(lru_.back().first);
+        lru_.back().second->release();
+        lru_.pop_back();
+        nn_evicts_++;
+    }
+}
+
+SrsPolicyVerdict* SrsVerdictCache::fetch(SrsPolicy* policy, const std::string& domain)
+{
+    // The request which holds the old policy, should use the verdict of the old one.
+    if(policy->version() < version_ || !capacity_)
+    {
+        SrsPolicyVerdict* verdict = new SrsPolicyVerdict();
+        evaluate(policy, domain, verdict);
+        return verdict;
+    }
+
+    // The policy is reloaded, all verdicts are invalid.
+    if(policy->version() > version_)
+    {
+        clear();
+        version_ = policy->version();
+        nn_clears_++;
+    }
+
+    std::unordered_map<std::string, SrsVerdictList::iterator>::iterator it = index_.find(domain);
+    if(it != index_.end())
+    {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        nn_hits_++;
+
+        SrsPolicyVerdict* verdict = it->second->second;
+        verdict->acquire();
+        return verdict;
+    }
+
+    // Drop the least recently used one, which is freed when the requests release it.
+    if((int)lru_.size() >= capacity_)
+    {
+        index_.erase(lru_.back().first);
+        lru_.back().second->release();
+        lru_.pop_back();
+        nn_evicts_++;
+    }
+
+    SrsPolicyVerdict* verdict = new SrsPolicyVerdict();
+    evaluate(policy, domain, verdict);
+    lru_.push_front(std::make_pair(domain, verdict));
+    index_[domain] = lru_.begin();
+    nn_misses_++;
+
+    verdict->acquire();
+    return verdict;
+}
+
+void SrsVerdictCache::clear()
+{
+    for(SrsVerdictList::iterator it = lru_.begin(); it != lru_.end(); ++it)
+    {
+        it->second->release();
+    }
+    lru_.clear();
+    index_.clear();
+}
+
+int SrsVerdictCache::size()
+{
+    return (int)lru_.size();
+}
+
+void SrsVerdictCache::dumps(SrsJsonObject* obj)
+{
+    obj->set("version", SrsJsonAny::integer(version_));
+    obj->set("capacity", SrsJsonAny::integer(capacity_));
+    obj->set("size", SrsJsonAny::integer(lru_.size()));
+    obj->set("hits", SrsJsonAny::integer(nn_hits_));
+    obj->set("misses", SrsJsonAny::integer(nn_misses_));
+    obj->set("evicts", SrsJsonAny::integer(nn_evicts_));
+    obj->set("clears", SrsJsonAny::integer(nn_clears_));
+}
+
+void SrsVerdictCache::evaluate(SrsPolicy* policy, const std::string& domain, SrsPolicyVerdict* verdict)
+{
+    verdict->block = policy->match_black_list(domain);
+    verdict->tunnel = !policy->is_https_descrypt_enable() || policy->match_tunnel_domain_list(domain);
+    verdict->decrypt = !verdict->tunnel;
 }
@@ -1,27 +1,160 @@
 #ifndef SRS_APP_POLICY_HPP
 #define SRS_APP_POLICY_HPP
+#include <srs_core.hpp>
+#include <srs_app_st.hpp>
+#include <srs_kernel_log.hpp>
+
+#include <atomic>
 #include <vector>
 #include <string>
+#include <list>
+#include <unordered_map>
 #include <string.h>
+#include <pthread.h>
+
+class SrsDomainMatcher;
+class SrsIpMatcher;
+class SrsUrlMatcher;
+class SrsFileMmap;
+class SrsJsonObject;
+
+// The policy in json, which is edited by operators.
+#define SRS_POLICY_JSON "./conf/policy.json"
+// The policy database compiled from json by tool policy_compiler, which is mapped read-only.
+#define SRS_POLICY_DATABASE "./conf/policy.db"
 
 using std::string;
+// The policy is immutable after loaded, and it's reference counted, so the reloader is able to replace
+// the global policy, while the in-flight requests still use the old one, see SrsPolicyGuard.
 class SrsPolicy
 {
 public:
     SrsPolicy();
-    ~SrsPolicy();
+    virtual ~SrsPolicy();
 public:
     virtual void init();
+    // Hold or release a reference, the policy is freed when no reference, it's 1 when created.
+    virtual void acquire();
+    virtual void release();
+    // The version is increased for each reload, 0 for the initial one.
+    virtual uint64_t version();
+    virtual void set_version(uint64_t v);
+    // The path of json or database, which the policy is loaded from.
+    virtual std::string source();
+    // Keep the logs of loading rather than write them, for the log is not thread-safe and the policy
+    // is loaded in the loader thread, the ST thread writes them by flush_logs after the loader is done.
+    virtual void set_deferred_log(bool v);
+    virtual void flush_logs();
+    virtual void log(SrsLogLevel level, const char* fmt, ...);
 public:
-    virtual void loadPolicy();
+    // Load the policy database if it's newer than json, or the json.
+    virtual srs_error_t loadPolicy();
+    virtual srs_error_t loadJsonPolicy(std::string path);
+    // Map the policy database, the rules are used in place, so it's instant even for millions of rules,
+    // and the pages are shared by all processes.
+    virtual srs_error_t loadCompiledPolicy(std::string path);
+    // Write the policy to database, which is replaced atomically by rename.
+    virtual srs_error_t compilePolicy(std::string path);
 public:
     virtual bool is_https_descrypt_enable();
-    virtual bool match_black_list(std::string domain);
-    virtual bool match_tunnel_domain_list(std::string domain);
+    virtual bool match_black_list(const std::string& domain);
+    // Whether the path and query of request matches any url rule, in O(length of url).
+    virtual bool match_url_black_list(const std::string& url);
+    virtual bool match_tunnel_domain_list(const std::string& domain);
+    // Whether the client ip is denied, by the longest matched CIDR.
+    virtual bool match_client_ip_list(const std::string& ip);
+private:
+    // Load the rules from file, one rule per line, the line starts with # is comment.
+    virtual void loadRulesFile(std::string path, SrsDomainMatcher* matcher);
+    virtual void loadRulesFile(std::string path, SrsUrlMatcher* matcher);
 public:
-    std::vector<std::string> black_list_vec;
-    std::vector<std::string> tunnel_domain_vec;
+    SrsDomainMatcher* black_list;
+    SrsDomainMatcher* tunnel_domain;
+    SrsIpMatcher* client_ip_list;
+    SrsUrlMatcher* url_black_list;
     bool https_descrypt_enable;
+private:
+    // The mapped database, which the rules point to, NULL if load from json.
+    SrsFileMmap* database;
+    std::string source_;
+    bool deferred_log_;
+    std::vector<std::pair<SrsLogLevel, std::string> > logs_;
+    std::atomic<int> refs_;
+    uint64_t version_;
+};
+
+// The global policy, which is replaced by SrsPolicyReloader.
+extern SrsPolicy* _srs_policy;
+
+// Hold the current global policy during a request, so the request always uses the same policy, even if
+// the policy is reloaded when the coroutine is switched out. There is no lock, because the policy is
+// only replaced in the ST thread.
+class SrsPolicyGuard
+{
+private:
+    SrsPolicy* policy_;
+public:
+    SrsPolicyGuard();
+    virtual ~SrsPolicyGuard();
+public:
+    SrsPolicy* operator->();
+    SrsPolicy* get();
+};
+
+// The reloader of policy, which loads the new policy in a thread, so the ST thread is never blocked by
+// the huge policy, then replaces the global policy in the ST thread.
+// @remark The reload is triggered by SIGHUP, the inotify of policy files, or the HTTP API.
+class SrsPolicyReloader : public ISrsCoroutineHandler
+{
+private:
+    SrsCoroutine* trd_;
+    srs_cond_t cond_;
+    // Whether there is a reload request, the requests are merged when loading.
+    bool pending_;
+    bool loading_;
+    uint64_t version_;
+    // The number of reloads, and the failed ones, which keep using the current policy.
+    uint64_t nn_reloads_;
+    uint64_t nn_failed_;
+    srs_utime_t last_reload_elapsed_;
+private:
+    // The loader thread and its result.
+    pthread_t loader_;
+    std::atomic<bool> loaded_;
+    SrsPolicy* policy_;
+    srs_error_t error_;
+public:
+    SrsPolicyReloader();
+    virtual ~SrsPolicyReloader();
+public:
+    virtual srs_error_t start();
+    // Request to reload the policy, which returns immediately.
+    virtual void reload();
+    virtual void dumps(SrsJsonObject* obj);
+// Interface ISrsCoroutineHandler
+public:
+    virtual srs_error_t cycle();
+private:
+    virtual srs_error_t do_reload();
+    static void* load(void* arg);
+};
+
+// The inotify worker, which watches the policy files and triggers the reload.
+// @remark The policy compiler replaces the database by rename, so we watch the directory rather than files.
+class SrsPolicyInotifyWorker : public ISrsCoroutineHandler
+{
+private:
+    SrsCoroutine* trd_;
+    srs_netfd_t inotify_fd_;
+    SrsPolicyReloader* reloader_;
+public:
+    SrsPolicyInotifyWorker(SrsPolicyReloader* reloader);
+    virtual ~SrsPolicyInotifyWorker();
+public:
+    virtual srs_error_t start();
+// Interface ISrsCoroutineHandler
+public:
+    virtual srs_error_t cycle();
 };
 
 class SrsNotification
@@ -35,9 +168,88 @@ public:
     virtual void loadNotification();
 public:
     virtual string getNotification(std::string domain, std::string client_ip);
+    // Render the page for domain, which is the same for all clients, then fill the client per request.
+    virtual string renderDomain(std::string domain);
+    virtual string renderClient(const std::string& page, std::string client_ip);
 private:
     std::string notification_page;
 };
 
+// The verdict of policy for a domain, which is the same for all requests to the domain.
+// @remark The URL rules are not in the verdict, because they depend on the path.
+// The verdict is reference counted, so the request holds it by SrsVerdictGuard, while the cache may evict
+// or clear it when the coroutine is switched.
+// @remark The category is not in verdict, for it's by the path too, see SrsUrlCategory.
+class SrsPolicyVerdict
+{
+public:
+    SrsPolicyVerdict();
+    virtual ~SrsPolicyVerdict();
+public:
+    // Hold or release a reference, the verdict is freed when no reference, it's 1 when created.
+    virtual void acquire();
+    virtual void release();
+public:
+    // Whether the domain is in the black list.
+    bool block;
+    // Whether tunnel the HTTPS session, or decrypt it.
+    bool tunnel;
+    bool decrypt;
+    // The block page rendered for the domain, empty before the domain is blocked by any rule.
+    std::string block_page;
+private:
+    int refs_;
+};
+
+// Hold the verdict fetched from cache during a request, which releases the reference of fetch.
+class SrsVerdictGuard
+{
+private:
+    SrsPolicyVerdict* verdict_;
+public:
+    SrsVerdictGuard(SrsPolicyVerdict* verdict);
+    virtual ~SrsVerdictGuard();
+public:
+    SrsPolicyVerdict* operator->();
+    SrsPolicyVerdict* get();
+};
+
+// The LRU cache of verdicts by domain, because most requests are to a few thousand hot domains, so the
+// policy, classifier and block page are evaluated once per domain rather than once per request.
+// The verdicts are for a version of policy, and the cache is cleared when a newer policy is used.
+// @remark There is no lock, because it's only used in the ST thread.
+class SrsVerdictCache
+{
+private:
+    typedef std::list<std::pair<std::string, SrsPolicyVerdict*> > SrsVerdictList;
+    // The most recently used verdict is at front.
+    SrsVerdictList lru_;
+    std::unordered_map<std::string, SrsVerdictList::iterator> index_;
+    int capacity_;
+    // The version of policy, which the verdicts are evaluated by.
+    uint64_t version_;
+    uint64_t nn_hits_;
+    uint64_t nn_misses_;
+    uint64_t nn_evicts_;
+    uint64_t nn_clears_;
+public:
+    SrsVerdictCache();
+    virtual ~SrsVerdictCache();
+public:
+    // Set the max number of domains, 0 to disable the cache.
+    virtual void set_capacity(int capacity);
+    // Get the verdict of domain by policy, which is evaluated and cached if miss. The verdict for the
+    // old policy, held by the in-flight requests, is never cached.
+    // @remark The verdict is acquired for caller, which should release it, see SrsVerdictGuard.
+    virtual SrsPolicyVerdict* fetch(SrsPolicy* policy, const std::string& domain);
+    virtual void clear();
+    virtual int size();
+    virtual void dumps(SrsJsonObject* obj);
+private:
+    virtual void evaluate(SrsPolicy* policy, const std::string& domain, SrsPolicyVerdict* verdict);
+};
+
+extern SrsVerdictCache* _srs_verdict_cache;
+
 
 #endif
\ No newline at end of file
@@ -10,6 +10,12 @@
 #include <srs_app_http_conn.hpp>
 #include <srs_kernel_consts.hpp>
 #include <srs_app_http_api.hpp>
+#include <srs_app_admission.hpp>
+#include <srs_app_policy.hpp>
+#include <srs_app_url_category.hpp>
+#include <srs_app_http_cache.hpp>
+#include <srs_app_http_collapser.hpp>
+#include <srs_app_memory.hpp>
 #include <srs_protocol_log.hpp>
 
 extern SrsConfig* _srs_config;
@@ -86,6 +92,15 @@ srs_error_t SrsBufferListener::on_tcp_client(srs_netfd_t stfd)
     return srs_success;
 }
 
+bool SrsBufferListener::should_pause_accept()
+{
+    // Only pause the proxy, the API is always available to query the metrics.
+    if (type != SrsListenerHttpProxy) {
+        return false;
+    }
+    return _srs_admission->should_pause_accept();
+}
+
 SrsSignalManager* SrsSignalManager::instance = NULL;
 
 SrsSignalManager::SrsSignalManager(SrsServer* s)
@@ -143,33 +158,9 @@ srs_error_t SrsSignalManager::start()
     sa.sa_flags = 0;
     sigaction(SRS_SIGNAL_RELOAD, &sa, NULL);
     
-    sa.sa_handler = SrsSignalManager::sig_catcher;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    sigaction(SRS_SIGNAL_FAST_QUIT, &sa, NULL);
-
-    sa.sa_handler = SrsSignalManager::sig_catcher;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    sigaction(SRS_SIGNAL_GRACEFULLY_QUIT, &sa, NULL);
-
-    sa.sa_handler = SrsSignalManager::sig_catcher;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    sigaction(SRS_SIGNAL_ASSERT_ABORT, &sa, NULL);
+    // The quit and reopen signals are not handled by server yet, so keep the default action.
     
-    sa.sa_handler = SrsSignalManager::sig_catcher;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    sigaction(SIGINT, &sa, NULL);
-    
-    sa.sa_handler = SrsSignalManager::sig_catcher;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    sigaction(SRS_SIGNAL_REOPEN_LOG, &sa, NULL);
-    
-    srs_trace("signal installed, reload=%d, reopen=%d, fast_quit=%d, grace_quit=%d",
-              SRS_SIGNAL_RELOAD, SRS_SIGNAL_REOPEN_LOG, SRS_SIGNAL_FAST_QUIT, SRS_SIGNAL_GRACEFULLY_QUIT);
+    srs_trace("signal installed, reload=%d", SRS_SIGNAL_RELOAD);
     
     if ((err = trd->start()) != srs_success) {
         return srs_error_wrap(err, "signal manager");
@@ -193,7 +184,7 @@ srs_error_t SrsSignalManager::cycle()
         srs_read(signal_read_stfd, &signo, sizeof(int), SRS_UTIME_NO_TIMEOUT);
         
         /* Process signal synchronously */
-        // server->on_signal(signo);
+        server->on_signal(signo);
     }
     
     return err;
@@ -258,9 +249,9 @@ srs_error_t SrsServerAdapter::run(SrsWaitGroup* wg)
         return srs_error_wrap(err, "listen");
     }
 
-    // if ((err = srs->register_signal()) != srs_success) {
-    //     return srs_error_wrap(err, "register signal");
-    // }
+    if ((err = srs->register_signal()) != srs_success) {
+        return srs_error_wrap(err, "register signal");
+    }
 
     if ((err = srs->http_handle()) != srs_success) {
         return srs_error_wrap(err, "http handle");
@@ -300,6 +291,8 @@ SrsServer::SrsServer()
     http_server = new SrsHttpServer(this);
     trd_ = new SrsSTCoroutine("srs", this, _srs_context->get_id());
     reuse_api_over_server_ = false;
+    policy_reloader_ = new SrsPolicyReloader();
+    policy_inotify_ = NULL;
 }
 
 SrsServer::~SrsServer()
@@ -314,6 +307,8 @@ void SrsServer::destroy()
     dispose();
 
     srs_freep(trd_);
+    srs_freep(policy_inotify_);
+    srs_freep(policy_reloader_);
     srs_freep(signal_manager);
     srs_freep(conn_manager);
     srs_freep(http_server);
@@ -444,6 +439,9 @@ srs_error_t SrsServer::do_cycle()
             signal_reload = false;
             srs_info("get signal to reload the config.");
 
+            // The policy is reloaded in background, so never stall the requests.
+            policy_reloader_->reload();
+
             if ((err = _srs_config->reload()) != srs_success) {
                 return srs_error_wrap(err, "config reload");
             }
@@ -467,6 +465,14 @@ srs_error_t SrsServer::initialize_st()
     
     srs_trace("server main cid=%s, pid=%d, ppid=%d, asprocess=%d",
         _srs_context->get_id().c_str(), ::getpid(), ppid, asprocess);
+
+    // The coroutines started after this are able to measure the stack high-water mark.
+    bool stack_canary = _srs_config->get_coroutine_stack_canary();
+    srs_coroutine_set_stack_canary(stack_canary);
+    bool stack_guard = _srs_config->get_coroutine_stack_guard();
+    srs_coroutine_set_stack_guard(stack_guard);
+    srs_trace("coroutine stack canary=%d, guard=%d, proxy=%d, api=%d", stack_canary, stack_guard,
+        _srs_config->get_proxy_stack_size(), _srs_config->get_api_stack_size());
     
     return err;
 }
@@ -545,6 +551,27 @@ srs_error_t SrsServer::http_handle()
     if ((err = http_api_mux->handle("/api/v1/self_proc_stats", new SrsGoApiSelfProcStats())) != srs_success) {
         return srs_error_wrap(err, "handle self proc stats");
     }
+    if ((err = http_api_mux->handle("/api/v1/traces", new SrsGoApiTraces())) != srs_success) {
+        return srs_error_wrap(err, "handle traces");
+    }
+    if ((err = http_api_mux->handle("/api/v1/policy", new SrsGoApiPolicy(policy_reloader_))) != srs_success) {
+        return srs_error_wrap(err, "handle policy");
+    }
+    if ((err = http_api_mux->handle("/api/v1/metrics", new SrsGoApiMetrics(conn_manager))) != srs_success) {
+        return srs_error_wrap(err, "handle metrics");
+    }
+    if ((err = http_api_mux->handle("/api/v1/memory", new SrsGoApiMemory())) != srs_success) {
+        return srs_error_wrap(err, "handle memory");
+    }
+    if ((err = http_api_mux->handle("/api/v1/coroutines", new SrsGoApiCoroutines())) != srs_success) {
+        return srs_error_wrap(err, "handle coroutines");
+    }
+    if ((err = http_api_mux->handle("/api/v1/profile/cpu", new SrsGoApiCpuProfile())) != srs_success) {
+        return srs_error_wrap(err, "handle cpu profile");
+    }
+    if ((err = http_api_mux->handle("/api/v1/profile/heap", new SrsGoApiHeapProfile())) != srs_success) {
+        return srs_error_wrap(err, "handle heap profile");
+    }
 
     return err;
 }
@@ -561,6 +588,56 @@ srs_error_t SrsServer::start(SrsWaitGroup* wg)
         return srs_error_wrap(err, "start");
     }
 
+    if ((err = policy_reloader_->start()) != srs_success) {
+        return srs_error_wrap(err, "start policy reloader");
+    }
+    _srs_verdict_cache->set_capacity(_srs_config->get_policy_verdict_cache());
+
+    if (_srs_config->get_url_category_enabled() && !_srs_config->get_url_category_model().empty()) {
+        if ((err = _srs_url_category->initialize(_srs_config->get_url_category_model())) != srs_success) {
+            return srs_error_wrap(err, "url category");
+        }
+    } else if (_srs_config->get_url_category_enabled()) {
+        if ((err = _srs_url_category->initialize(_srs_config->get_url_category_host(), _srs_config->get_url_category_port(),
+            _srs_config->get_url_category_workers(), _srs_config->get_url_category_batch(), _srs_config->get_url_category_timeout(),
+            _srs_config->get_url_category_ttl(), _srs_config->get_url_category_cache())) != srs_success) {
+            return srs_error_wrap(err, "url category");
+        }
+    }
+
+    if (_srs_config->get_http_cache_enabled()) {
+        _srs_http_cache->initialize(_srs_config->get_http_cache_memory(), _srs_config->get_http_cache_max_object());
+    }
+    if (_srs_config->get_http_cache_enabled() && !_srs_config->get_http_cache_disk_dir().empty()) {
+        if ((err = _srs_http_cache->open_disk(_srs_config->get_http_cache_disk_dir(), _srs_config->get_http_cache_disk_size(),
+            _srs_config->get_http_cache_disk_threads())) != srs_success) {
+            return srs_error_wrap(err, "http cache");
+        }
+    }
+    if (_srs_config->get_http_cache_enabled() && _srs_config->get_http_cache_revalidate_workers() > 0) {
+        if ((err = _srs_http_cache->open_revalidator(_srs_config->get_http_cache_revalidate_workers())) != srs_success) {
+            return srs_error_wrap(err, "http cache");
+        }
+    }
+    if (_srs_config->get_http_collapse_enabled()) {
+        _srs_http_collapser->initialize(_srs_config->get_http_collapse_max_buffer(), _srs_config->get_http_collapse_timeout());
+    }
+    if (_srs_config->get_memory_release_enabled()) {
+        if ((err = _srs_memory_releaser->initialize(conn_manager, _srs_config->get_memory_release_interval(),
+            _srs_config->get_memory_release_rate(), _srs_config->get_memory_release_idle_requests())) != srs_success) {
+            return srs_error_wrap(err, "memory release");
+        }
+    }
+
+    // Ignore the inotify error, for the policy is still able to be reloaded by signal or API.
+    if (_srs_config->get_policy_inotify()) {
+        policy_inotify_ = new SrsPolicyInotifyWorker(policy_reloader_);
+        if ((err = policy_inotify_->start()) != srs_success) {
+            srs_warn("ignore policy inotify err %s", srs_error_desc(err).c_str());
+            srs_freep(err);
+        }
+    }
+
     // if ((err = setup_ticks()) != srs_success) {
     //     return srs_error_wrap(err, "tick");
     // }
@@ -791,16 +868,18 @@ srs_error_t SrsServer::fd_to_resource(SrsListenerType type, srs_netfd_t& stfd, I
         return srs_error_new(ERROR_SOCKET_GET_PEER_IP, "ignore empty ip, fd=%d", fd);
     }
 
-    // check connection limitation.
-    // int max_connections = _srs_config->get_max_connections();
-    // if (handler && (err = handler->on_accept_client(max_connections, (int)conn_manager->size())) != srs_success) {
-    //     return srs_error_wrap(err, "drop client fd=%d, ip=%s:%d, max=%d, cur=%d for err: %s",
-    //         fd, ip.c_str(), port, max_connections, (int)conn_manager->size(), srs_error_desc(err).c_str());
-    // }
-    // if ((int)conn_manager->size() >= max_connections) {
-    //     return srs_error_new(ERROR_EXCEED_CONNECTIONS, "drop fd=%d, ip=%s:%d, max=%d, cur=%d for exceed connection limits",
-    //         fd, ip.c_str(), port, max_connections, (int)conn_manager->size());
-    // }  
+    // check the client ip list, before any coroutine or buffer is allocated, so denied client is cheap.
+    if (type == SrsListenerHttpProxy && _srs_admission->should_deny_client(ip)) {
+        srs_info("deny client fd=%d, ip=%s:%d", fd, ip.c_str(), port);
+        srs_close_stfd(stfd);
+        return err;
+    }
+
+    // check connection limitation, the API is not limited to query the metrics when overloaded, and
+    // its connections are not counted.
+    if (type == SrsListenerHttpProxy && (err = _srs_admission->on_accept(_srs_admission->connections())) != srs_success) {
+        return srs_error_wrap(err, "drop fd=%d, ip=%s:%d", fd, ip.c_str(), port);
+    }
     // avoid fd leak when fork.
     // @see https://github.com/ossrs/srs/issues/518
     if (true) {
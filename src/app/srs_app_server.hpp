@@ -10,6 +10,8 @@
 #include <srs_app_conn.hpp>
 
 class SrsServer;
+class SrsPolicyReloader;
+class SrsPolicyInotifyWorker;
 class ISrsHttpServeMux;
 class SrsHttpServer;
 
@@ -66,6 +68,7 @@ public:
 // Interface ISrsTcpHandler
 public:
     virtual srs_error_t on_tcp_client(srs_netfd_t stfd);
+    virtual bool should_pause_accept();
 };
 
 // Convert signal to io,
@@ -128,6 +131,9 @@ private:
     SrsResourceManager* conn_manager;
     SrsCoroutine* trd_;
     SrsWaitGroup* wg_;
+    // Reload the policy in background, by SIGHUP, inotify or API.
+    SrsPolicyReloader* policy_reloader_;
+    SrsPolicyInotifyWorker* policy_inotify_;
 private:
     int pid_fd;
     // All listners, listener manager.
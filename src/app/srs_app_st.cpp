@@ -2,12 +2,37 @@
 #include <srs_app_st.hpp>
 #include <srs_protocol_st.hpp>
 #include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
 #include <srs_core_platform.hpp>
 
 using namespace std;
 
 extern ISrsContext* _srs_context;
 
+// The canary to fill the coroutine stack, the untouched canary is never used.
+#define SRS_STACK_CANARY 0xcdcdcdcdcdcdcdcdULL
+// The top of stack which is reserved for the frames of canary filler, never filled.
+#define SRS_STACK_CANARY_RESERVED 2048
+
+static bool _srs_coroutine_stack_canary = false;
+static bool _srs_coroutine_stack_guard = false;
+
+// The stack high-water mark peak of each name, for the coroutines which are done.
+static std::map<std::string, int> _srs_coroutine_stack_peaks;
+
+// The head of live coroutines, all coroutines run in the same ST thread.
+static SrsFastCoroutine* _srs_coroutines = NULL;
+
+void srs_coroutine_set_stack_canary(bool v)
+{
+    _srs_coroutine_stack_canary = v;
+}
+
+void srs_coroutine_set_stack_guard(bool v)
+{
+    _srs_coroutine_stack_guard = v;
+}
+
 
 
 ISrsCoroutineHandler::ISrsCoroutineHandler()
@@ -119,6 +144,13 @@ SrsFastCoroutine::SrsFastCoroutine(string n, ISrsCoroutineHandler* h)
     started = interrupted = disposed = cycle_done = false;
     stopping_ = false;
 
+    starttime_ = 0;
+    wait_.wait = SrsCoroutineWaitNone;
+    wait_.fd = -1;
+    wait_.starttime = 0;
+    stack_canary_ = false;
+    prev_ = next_ = NULL;
+
     //  0 use default, default is 64K.
     stack_size = 0;    
 }
@@ -133,6 +165,13 @@ SrsFastCoroutine::SrsFastCoroutine(string n, ISrsCoroutineHandler* h, SrsContext
     started = interrupted = disposed = cycle_done = false;
     stopping_ = false;
 
+    starttime_ = 0;
+    wait_.wait = SrsCoroutineWaitNone;
+    wait_.fd = -1;
+    wait_.starttime = 0;
+    stack_canary_ = false;
+    prev_ = next_ = NULL;
+
     //  0 use default, default is 64K.
     stack_size = 0;
 }
@@ -179,12 +218,22 @@ srs_error_t SrsFastCoroutine::start()
     }
     
     started = true;
+    starttime_ = srs_get_monotonic_time();
+    link();
 
     return err;
 }
 
 srs_error_t SrsFastCoroutine::cycle()
 {
+    srs_coroutine_wait_bind(&wait_);
+    if (_srs_coroutine_stack_guard && srs_thread_stack_guard(srs_thread_self()) != 0) {
+        srs_warn("coroutine %s stack guard failed, errno=%d", name.c_str(), errno);
+    }
+    if (_srs_coroutine_stack_canary) {
+        fill_stack_canary();
+    }
+
     if (_srs_context) {
         if (cid_.empty()) {
             cid_ = _srs_context->generate_id();
@@ -241,6 +290,9 @@ void SrsFastCoroutine::stop()
             srs_assert(trd_err == err_res);
         }
     }
+
+    // The thread is joined, so it's not alive now.
+    unlink();
     
     // If there's no error occur from worker, try to set to terminated error.
     if (trd_err == srs_success && !cycle_done) {
@@ -280,6 +332,13 @@ void* SrsFastCoroutine::pfn(void* arg)
 
     srs_error_t err = p->cycle();
 
+    // Record the peak in measuring mode, the stack is still owned by this coroutine.
+    int used = p->stack_high_water();
+    if (used > 0) {
+        int& peak = _srs_coroutine_stack_peaks[p->name];
+        peak = srs_max(peak, used);
+    }
+
     // Set the err for function pull to fetch it.
     // @see https://github.com/ossrs/srs/pull/1304#issuecomment-480484151
     if (err != srs_success) {
@@ -291,6 +350,99 @@ void* SrsFastCoroutine::pfn(void* arg)
     return (void*)err;
 }
 
+void SrsFastCoroutine::link()
+{
+    prev_ = NULL;
+    next_ = _srs_coroutines;
+    if (_srs_coroutines) {
+        _srs_coroutines->prev_ = this;
+    }
+    _srs_coroutines = this;
+}
+
+void SrsFastCoroutine::unlink()
+{
+    if (!prev_ && _srs_coroutines != this) {
+        return;
+    }
+
+    if (prev_) {
+        prev_->next_ = next_;
+    } else {
+        _srs_coroutines = next_;
+    }
+    if (next_) {
+        next_->prev_ = prev_;
+    }
+    prev_ = next_ = NULL;
+}
+
+void SrsFastCoroutine::fill_stack_canary()
+{
+    char* bottom = NULL;
+    int size = 0;
+    srs_thread_stack(srs_thread_self(), &bottom, &size);
+
+    // Never fill the stack of current frames, the stack grows down.
+    char here = 0;
+    char* limit = &here - SRS_STACK_CANARY_RESERVED;
+    if (!bottom || limit <= bottom) {
+        return;
+    }
+
+    for (uint64_t* p = (uint64_t*)bottom; (char*)(p + 1) <= limit; p++) {
+        *p = SRS_STACK_CANARY;
+    }
+    stack_canary_ = true;
+}
+
+int SrsFastCoroutine::stack_high_water()
+{
+    if (!stack_canary_ || !trd) {
+        return -1;
+    }
+
+    char* bottom = NULL;
+    int size = 0;
+    srs_thread_stack(trd, &bottom, &size);
+
+    // Search the first dirty word from the bottom, the stack above it has been used.
+    uint64_t* p = (uint64_t*)bottom;
+    uint64_t* end = (uint64_t*)(bottom + size);
+    while (p < end && *p == SRS_STACK_CANARY) {
+        p++;
+    }
+
+    return (int)((char*)end - (char*)p);
+}
+
+void SrsFastCoroutine::list(vector<SrsCoroutineInfo>& infos)
+{
+    srs_utime_t now = srs_get_monotonic_time();
+
+    for (SrsFastCoroutine* p = _srs_coroutines; p; p = p->next_) {
+        SrsCoroutineInfo info;
+        info.name = p->name;
+        info.cid = p->cid_.c_str();
+        info.age = now - p->starttime_;
+        info.wait = p->wait_.wait;
+        info.fd = p->wait_.fd;
+        info.wait_elapsed = (p->wait_.wait != SrsCoroutineWaitNone) ? now - p->wait_.starttime : 0;
+
+        char* bottom = NULL;
+        srs_thread_stack(p->trd, &bottom, &info.stack_size);
+        info.stack_used = p->stack_high_water();
+        info.done = p->cycle_done;
+
+        infos.push_back(info);
+    }
+}
+
+void SrsFastCoroutine::stack_peaks(std::map<std::string, int>& peaks)
+{
+    peaks = _srs_coroutine_stack_peaks;
+}
+
 SrsWaitGroup::SrsWaitGroup()
 {
     nn_ = 0;
@@ -4,8 +4,39 @@
 #include <srs_kernel_error.hpp>
 #include <srs_protocol_st.hpp>
 
+#include <map>
+#include <string>
+#include <vector>
+
 class SrsFastCoroutine;
 
+// The snapshot of a live coroutine, for the introspection API.
+struct SrsCoroutineInfo
+{
+    std::string name;
+    std::string cid;
+    // The elapsed time since started.
+    srs_utime_t age;
+    // The blocking operation, see SrsCoroutineWait.
+    int wait;
+    // The fd of blocking operation, -1 if not about fd.
+    int fd;
+    // The elapsed time of current blocking operation.
+    srs_utime_t wait_elapsed;
+    // The size of stack in bytes.
+    int stack_size;
+    // The stack high-water mark in bytes, -1 if the stack is not filled with canary.
+    int stack_used;
+    // Whether the cycle is done, but not stopped by the owner.
+    bool done;
+};
+
+// Whether fill the stack of new coroutines with canary, to measure the stack high-water mark.
+// @remark It's the measuring mode, the peak of each name is recorded when the coroutine cycle is done.
+extern void srs_coroutine_set_stack_canary(bool v);
+// Whether protect the page below the stack of new coroutines.
+extern void srs_coroutine_set_stack_guard(bool v);
+
 class ISrsCoroutineHandler
 {
 public:
@@ -113,6 +144,15 @@ private:
     // Sub state in disposed, we need to wait for thread to quit.
     bool stopping_;
     SrsContextId stopping_cid_;    
+private:
+    // The monotonic time when started.
+    srs_utime_t starttime_;
+    SrsCoroutineWaitState wait_;
+    // Whether the stack is filled with canary.
+    bool stack_canary_;
+    // The intrusive list of live coroutines.
+    SrsFastCoroutine* prev_;
+    SrsFastCoroutine* next_;
 public:
     SrsFastCoroutine(std::string n, ISrsCoroutineHandler* h);
     SrsFastCoroutine(std::string n, ISrsCoroutineHandler* h, SrsContextId cid);
@@ -133,6 +173,16 @@ public:
 private:
     srs_error_t cycle();
     static void* pfn(void* arg);    
+private:
+    void link();
+    void unlink();
+    void fill_stack_canary();
+    int stack_high_water();
+public:
+    // Get the snapshot of live coroutines, which are started but not stopped.
+    static void list(std::vector<SrsCoroutineInfo>& infos);
+    // Get the stack high-water mark peak of each name, for the coroutines which are done in measuring mode.
+    static void stack_peaks(std::map<std::string, int>& peaks);
 };
 
 // Like goroytine sync.WaitGroup.
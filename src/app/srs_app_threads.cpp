@@ -15,6 +15,12 @@
 #include <srs_app_utility.hpp>
 #include <srs_app_access_log.hpp>
 #include <srs_kernel_utility.hpp>
+#include <srs_app_trace.hpp>
+#include <srs_app_admission.hpp>
+#include <srs_app_url_category.hpp>
+#include <srs_app_http_cache.hpp>
+#include <srs_app_http_collapser.hpp>
+#include <srs_app_memory.hpp>
 
 using namespace std;
 
@@ -200,9 +206,17 @@ srs_error_t srs_global_initialize()
     // The global objects which depends on ST.
     _srs_hybrid = new SrsHybridServer();
     _srs_policy = new SrsPolicy();
+    _srs_policy->init();
     _srs_notification = new SrsNotification();
+    _srs_verdict_cache = new SrsVerdictCache();
+    _srs_url_category = new SrsUrlCategoryClient();
+    _srs_http_cache = new SrsHttpCache();
+    _srs_http_collapser = new SrsHttpCollapser();
+    _srs_memory_releaser = new SrsMemoryReleaser();
     _srs_access_log = new SrsAccessLog();
     _srs_circuit_breaker = new SrsCircuitBreaker();
+    _srs_trace_ring = new SrsTraceRing(SRS_TRACE_RING_SIZE);
+    _srs_admission = new SrsAdmission();
     return err;
 }
 
@@ -45,6 +45,8 @@ private:
     srs_error_t on_timer(srs_utime_t interval);
 };
 
+extern SrsCircuitBreaker* _srs_circuit_breaker;
+
 class SrsThreadMutex
 {
 private:
@@ -0,0 +1,221 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_trace.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
+
+#include <string.h>
+#include <algorithm>
+using namespace std;
+
+SrsTraceRing* _srs_trace_ring = NULL;
+
+const char* srs_trace_phase_name(int phase)
+{
+    switch (phase) {
+        case SrsTracePhaseDns: return "dns";
+        case SrsTracePhaseConnect: return "connect";
+        case SrsTracePhaseUpstreamTls: return "upstream_tls";
+        case SrsTracePhaseForgeCert: return "forge_cert";
+        case SrsTracePhaseDownstreamTls: return "downstream_tls";
+        case SrsTracePhaseCategory: return "category";
+        case SrsTracePhaseTtfb: return "ttfb";
+        case SrsTracePhaseBody: return "body";
+        default: return "total";
+    }
+}
+
+SrsTraceSpan::SrsTraceSpan()
+{
+    reset();
+}
+
+SrsTraceSpan::~SrsTraceSpan()
+{
+}
+
+void SrsTraceSpan::reset()
+{
+    memset(&record_, 0, sizeof(record_));
+    pending_ = false;
+    for (int i = 0; i < SrsTracePhaseMax; i++) {
+        record_.phases[i] = -1;
+        phase_starttime_[i] = 0;
+    }
+
+    record_.start_time = srs_get_system_time();
+    starttime_ = srs_get_monotonic_time();
+}
+
+void SrsTraceSpan::begin(SrsTracePhase phase)
+{
+    phase_starttime_[phase] = srs_get_monotonic_time();
+}
+
+void SrsTraceSpan::end(SrsTracePhase phase)
+{
+    // Ignore if not begin, for example, failed before the phase.
+    if (!phase_starttime_[phase]) {
+        return;
+    }
+
+    set(phase, srs_get_monotonic_time() - phase_starttime_[phase]);
+    phase_starttime_[phase] = 0;
+}
+
+void SrsTraceSpan::set(SrsTracePhase phase, srs_utime_t elapsed)
+{
+    record_.phases[phase] = srs_max(0, elapsed);
+}
+
+void SrsTraceSpan::set_target(bool https, string host, string path)
+{
+    pending_ = true;
+    record_.https = https;
+    snprintf(record_.host, sizeof(record_.host), "%s", host.c_str());
+    snprintf(record_.path, sizeof(record_.path), "%s", path.c_str());
+}
+
+void SrsTraceSpan::set_status(int status)
+{
+    record_.status = status;
+}
+
+void SrsTraceSpan::commit()
+{
+    record_.elapsed = srs_get_monotonic_time() - starttime_;
+    snprintf(record_.cid, sizeof(record_.cid), "%s", _srs_context->get_id().c_str());
+
+    if (_srs_trace_ring) {
+        _srs_trace_ring->push(record_);
+    }
+
+    reset();
+}
+
+void SrsTraceSpan::finish(srs_error_t err)
+{
+    if (!pending_) {
+        return;
+    }
+
+    record_.error = srs_error_code(err);
+    commit();
+}
+
+const SrsTraceRecord& SrsTraceSpan::record()
+{
+    return record_;
+}
+
+SrsTraceRing::SrsTraceRing(int capacity)
+{
+    uint64_t size = 1;
+    while (size < (uint64_t)srs_max(1, capacity)) {
+        size <<= 1;
+    }
+
+    mask_ = size - 1;
+    slots_ = new SrsTraceSlot[size];
+    for (uint64_t i = 0; i < size; i++) {
+        slots_[i].seq.store(0, std::memory_order_relaxed);
+    }
+    cursor_.store(0, std::memory_order_relaxed);
+}
+
+SrsTraceRing::~SrsTraceRing()
+{
+    srs_freepa(slots_);
+}
+
+void SrsTraceRing::push(const SrsTraceRecord& record)
+{
+    uint64_t cursor = cursor_.fetch_add(1, std::memory_order_relaxed);
+    SrsTraceSlot* slot = &slots_[cursor & mask_];
+
+    // Mark the slot as writing, then publish it with the new sequence.
+    slot->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->record = record;
+    slot->seq.store(cursor + 1, std::memory_order_release);
+}
+
+int SrsTraceRing::capacity()
+{
+    return (int)(mask_ + 1);
+}
+
+uint64_t SrsTraceRing::total()
+{
+    return cursor_.load(std::memory_order_acquire);
+}
+
+void SrsTraceRing::snapshot(vector<SrsTraceRecord>& records)
+{
+    uint64_t end = cursor_.load(std::memory_order_acquire);
+    uint64_t start = end > mask_ + 1 ? end - mask_ - 1 : 0;
+
+    records.reserve(records.size() + (size_t)(end - start));
+    for (uint64_t i = start; i < end; i++) {
+        SrsTraceSlot* slot = &slots_[i & mask_];
+
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        SrsTraceRecord record = slot->record;
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Drop the slot which is being written or overwritten by newer record.
+        if (seq != i + 1 || slot->seq.load(std::memory_order_relaxed) != seq) {
+            continue;
+        }
+        records.push_back(record);
+    }
+}
+
+static bool srs_trace_record_slower(const SrsTraceRecord& a, const SrsTraceRecord& b)
+{
+    return a.elapsed > b.elapsed;
+}
+
+void SrsTraceRing::slowest(vector<SrsTraceRecord>& records, int n, vector<SrsTraceRecord>& out)
+{
+    n = srs_min(n, (int)records.size());
+    if (n <= 0) {
+        return;
+    }
+
+    partial_sort(records.begin(), records.begin() + n, records.end(), srs_trace_record_slower);
+    out.insert(out.end(), records.begin(), records.begin() + n);
+}
+
+SrsTracePercentiles SrsTraceRing::percentiles(vector<SrsTraceRecord>& records, int phase)
+{
+    SrsTracePercentiles v;
+    memset(&v, 0, sizeof(v));
+
+    vector<srs_utime_t> values;
+    values.reserve(records.size());
+    for (int i = 0; i < (int)records.size(); i++) {
+        srs_utime_t elapsed = (phase < SrsTracePhaseMax) ? records[i].phases[phase] : records[i].elapsed;
+        if (elapsed >= 0) {
+            values.push_back(elapsed);
+        }
+    }
+
+    if (values.empty()) {
+        return v;
+    }
+
+    std::sort(values.begin(), values.end());
+    int size = (int)values.size();
+    v.count = size;
+    v.p50 = values[(size - 1) * 50 / 100];
+    v.p90 = values[(size - 1) * 90 / 100];
+    v.p99 = values[(size - 1) * 99 / 100];
+    v.max = values[size - 1];
+    return v;
+}
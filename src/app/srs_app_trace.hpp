@@ -0,0 +1,140 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_TRACE_HPP
+#define SRS_APP_TRACE_HPP
+
+#include <srs_core.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// The default number of completed transactions kept in the trace ring, must be power of 2.
+#define SRS_TRACE_RING_SIZE 4096
+
+// The phases of a proxy transaction, the order is the order in a HTTPS MITM transaction.
+enum SrsTracePhase
+{
+    // Resolve the upstream host.
+    SrsTracePhaseDns = 0,
+    // TCP connect to upstream, excluding the DNS.
+    SrsTracePhaseConnect,
+    // TLS handshake with upstream.
+    SrsTracePhaseUpstreamTls,
+    // Forge the endpoint cert, only when the cert is not cached.
+    SrsTracePhaseForgeCert,
+    // TLS handshake with client, using the forged cert.
+    SrsTracePhaseDownstreamTls,
+    // Wait for the category of URL from classifier.
+    SrsTracePhaseCategory,
+    // From request forwarded to response header received.
+    SrsTracePhaseTtfb,
+    // Relay the response body to client.
+    SrsTracePhaseBody,
+    // The number of phases, not a phase.
+    SrsTracePhaseMax,
+};
+
+// Get the name of phase, for API and log.
+extern const char* srs_trace_phase_name(int phase);
+
+// A completed transaction, which is POD to copy into the ring without any allocation.
+struct SrsTraceRecord
+{
+    // The wall clock when transaction starts, in srs_utime_t.
+    srs_utime_t start_time;
+    // The total elapsed time of transaction.
+    srs_utime_t elapsed;
+    // The elapsed time of each phase, -1 if phase not happened, for example, the TLS of plain HTTP.
+    srs_utime_t phases[SrsTracePhaseMax];
+    // The response status code, 0 if no response.
+    int status;
+    // The error code if transaction failed, for example, failed to connect to server, 0 if success.
+    int error;
+    bool https;
+    // The target host and path, truncated.
+    char host[64];
+    char path[128];
+    char cid[16];
+};
+
+// The percentiles of a phase, in srs_utime_t.
+struct SrsTracePercentiles
+{
+    int count;
+    srs_utime_t p50;
+    srs_utime_t p90;
+    srs_utime_t p99;
+    srs_utime_t max;
+};
+
+// The span to measure phases of an in-flight transaction, owned by the connection.
+// @remark Use the monotonic clock, so it's not affected by the clock jump.
+class SrsTraceSpan
+{
+private:
+    SrsTraceRecord record_;
+    // Whether the transaction has target and not committed.
+    bool pending_;
+    srs_utime_t starttime_;
+    srs_utime_t phase_starttime_[SrsTracePhaseMax];
+public:
+    SrsTraceSpan();
+    virtual ~SrsTraceSpan();
+public:
+    // Start a new transaction, all phases are reset.
+    void reset();
+    void begin(SrsTracePhase phase);
+    void end(SrsTracePhase phase);
+    // Set the elapsed time of phase, which is measured by others, for example, the DNS.
+    void set(SrsTracePhase phase, srs_utime_t elapsed);
+    void set_target(bool https, std::string host, std::string path);
+    void set_status(int status);
+    // Finish the transaction, copy it to the ring, then start a new transaction.
+    void commit();
+    // Commit the pending transaction with the error, when the connection is done, so the transactions which
+    // fail before committed are also in the ring. Ignore if no pending transaction.
+    void finish(srs_error_t err);
+    const SrsTraceRecord& record();
+};
+
+// A fixed-size ring of completed transactions, writers never block and never allocate.
+// Each slot is guarded by a sequence, so the reader drops the slot which is being overwritten.
+class SrsTraceRing
+{
+private:
+    struct SrsTraceSlot
+    {
+        // Zero if empty or being written, else the cursor of record plus 1.
+        std::atomic<uint64_t> seq;
+        SrsTraceRecord record;
+    };
+private:
+    SrsTraceSlot* slots_;
+    uint64_t mask_;
+    std::atomic<uint64_t> cursor_;
+public:
+    // @param capacity The number of slots, rounded up to power of 2.
+    SrsTraceRing(int capacity);
+    virtual ~SrsTraceRing();
+public:
+    void push(const SrsTraceRecord& record);
+    int capacity();
+    // The number of transactions ever pushed.
+    uint64_t total();
+    // Copy the records in the ring, from the oldest to the newest.
+    void snapshot(std::vector<SrsTraceRecord>& records);
+public:
+    // Get the slowest n records, sorted by the elapsed time descending.
+    static void slowest(std::vector<SrsTraceRecord>& records, int n, std::vector<SrsTraceRecord>& out);
+    // Get the percentiles of phase, use SrsTracePhaseMax for the total elapsed time.
+    static SrsTracePercentiles percentiles(std::vector<SrsTraceRecord>& records, int phase);
+};
+
+extern SrsTraceRing* _srs_trace_ring;
+
+#endif
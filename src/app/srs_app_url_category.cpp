@@ -0,0 +1,405 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_url_category.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_protocol_http_stack.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_kernel_consts.hpp>
+#include <srs_app_http_client.hpp>
+#include <srs_app_url_classifier.hpp>
+
+using namespace std;
+
+// The timeout of request to classifier, the requests of proxy never wait so long, see timeout.
+#define SRS_URL_CATEGORY_RPC_TIMEOUT (3 * SRS_UTIME_SECONDS)
+// Cache the empty category when classifier fails, to not queue the same URL again and again.
+#define SRS_URL_CATEGORY_FAILURE_TTL (1 * SRS_UTIME_SECONDS)
+// The max number of queued URLs, the new URL is not categorized when the classifier is overloaded.
+#define SRS_URL_CATEGORY_MAX_PENDING 4096
+
+SrsUrlCategoryClient* _srs_url_category = NULL;
+
+string srs_url_category_key(const string& host, const string& path)
+{
+    size_t pos = path.find('/', 1);
+    if (path.empty() || path.at(0) != '/' || pos == string::npos) {
+        return host + "/";
+    }
+    return host + path.substr(0, pos + 1);
+}
+
+SrsUrlCategoryWorker::SrsUrlCategoryWorker(SrsUrlCategoryClient* client)
+{
+    trd_ = new SrsSTCoroutine("category", this);
+    client_ = client;
+    hc_ = new SrsHttpClient();
+}
+
+SrsUrlCategoryWorker::~SrsUrlCategoryWorker()
+{
+    srs_freep(trd_);
+    srs_freep(hc_);
+}
+
+srs_error_t SrsUrlCategoryWorker::start()
+{
+    srs_error_t err = srs_success;
+
+    if ((err = hc_->initialize("http", client_->host_, client_->port_, SRS_URL_CATEGORY_RPC_TIMEOUT)) != srs_success) {
+        return srs_error_wrap(err, "init http client");
+    }
+
+    if ((err = trd_->start()) != srs_success) {
+        return srs_error_wrap(err, "start category worker");
+    }
+
+    return err;
+}
+
+srs_error_t SrsUrlCategoryWorker::cycle()
+{
+    srs_error_t err = do_cycle();
+
+    // The requests never wait for the worker which is gone.
+    client_->on_worker_quit();
+
+    return err;
+}
+
+srs_error_t SrsUrlCategoryWorker::do_cycle()
+{
+    srs_error_t err = srs_success;
+
+    while (true) {
+        if ((err = trd_->pull()) != srs_success) {
+            return srs_error_wrap(err, "pull");
+        }
+
+        if (client_->queue_.empty()) {
+            srs_cond_wait(client_->ready_);
+            continue;
+        }
+
+        // Reconnect for the next batch, for the response may be partially read.
+        if ((err = client_->do_batch(hc_)) != srs_success) {
+            srs_warn("url category err %s", srs_error_desc(err).c_str());
+            srs_freep(err);
+
+            if ((err = hc_->initialize("http", client_->host_, client_->port_, SRS_URL_CATEGORY_RPC_TIMEOUT)) != srs_success) {
+                return srs_error_wrap(err, "init http client");
+            }
+        }
+    }
+
+    return err;
+}
+
+SrsUrlCategoryClient::SrsUrlCategoryClient()
+{
+    port_ = 0;
+    nn_workers_ = 0;
+    batch_ = 0;
+    timeout_ = 0;
+    ttl_ = 0;
+    capacity_ = 0;
+    nn_alive_workers_ = 0;
+    classifier_ = NULL;
+    ready_ = srs_cond_new();
+    done_ = srs_cond_new();
+
+    nn_hits_ = 0;
+    nn_misses_ = 0;
+    nn_timeouts_ = 0;
+    nn_dropped_ = 0;
+    nn_batches_ = 0;
+    nn_urls_ = 0;
+    nn_errors_ = 0;
+    nn_classified_ = 0;
+}
+
+SrsUrlCategoryClient::~SrsUrlCategoryClient()
+{
+    for (int i = 0; i < (int)workers_.size(); i++) {
+        SrsUrlCategoryWorker* worker = workers_.at(i);
+        srs_freep(worker);
+    }
+    workers_.clear();
+    srs_freep(classifier_);
+
+    srs_cond_destroy(ready_);
+    srs_cond_destroy(done_);
+}
+
+srs_error_t SrsUrlCategoryClient::initialize(string host, int port, int workers, int batch, srs_utime_t timeout, srs_utime_t ttl, int capacity)
+{
+    srs_error_t err = srs_success;
+
+    host_ = host;
+    port_ = port;
+    nn_workers_ = srs_max(1, workers);
+    batch_ = srs_max(1, batch);
+    timeout_ = timeout;
+    ttl_ = ttl;
+    capacity_ = srs_max(1, capacity);
+
+    for (int i = 0; i < nn_workers_; i++) {
+        SrsUrlCategoryWorker* worker = new SrsUrlCategoryWorker(this);
+        workers_.push_back(worker);
+
+        if ((err = worker->start()) != srs_success) {
+            return srs_error_wrap(err, "start worker %d", i);
+        }
+        nn_alive_workers_++;
+    }
+
+    srs_trace("url category %s:%d, workers=%d, batch=%d, timeout=%dms, ttl=%ds, cache=%d", host_.c_str(), port_,
+        nn_workers_, batch_, srsu2msi(timeout_), srsu2msi(ttl_) / 1000, capacity_);
+    return err;
+}
+
+srs_error_t SrsUrlCategoryClient::initialize(string model)
+{
+    srs_error_t err = srs_success;
+
+    SrsUrlClassifier* classifier = new SrsUrlClassifier();
+    if ((err = classifier->load(model)) != srs_success) {
+        srs_freep(classifier);
+        return srs_error_wrap(err, "load model");
+    }
+
+    srs_freep(classifier_);
+    classifier_ = classifier;
+
+    srs_trace("url category model %s, classes=%d, memory=%dKB", model.c_str(), classifier_->classes(),
+        (int)(classifier_->memory() / 1024));
+    return err;
+}
+
+bool SrsUrlCategoryClient::enabled()
+{
+    return classifier_ || nn_alive_workers_ > 0;
+}
+
+string SrsUrlCategoryClient::categorize(const string& host, const string& path)
+{
+    string category;
+    if (!enabled()) {
+        return category;
+    }
+
+    // It's fast enough to score each request.
+    if (classifier_) {
+        nn_classified_++;
+        return classifier_->classify(host + path);
+    }
+
+    string key = srs_url_category_key(host, path);
+    if (fetch(key, category)) {
+        nn_hits_++;
+        return category;
+    }
+    nn_misses_++;
+
+    // Queue the URL if it's not in flight.
+    if (pending_.find(key) == pending_.end()) {
+        if ((int)queue_.size() >= SRS_URL_CATEGORY_MAX_PENDING) {
+            nn_dropped_++;
+            return category;
+        }
+
+        pending_.insert(key);
+        queue_.push_back(key);
+        srs_cond_signal(ready_);
+    }
+
+    // All requests wait on the same cond, so check the cache when any batch is done.
+    srs_utime_t deadline = srs_update_system_time() + timeout_;
+    while (true) {
+        srs_utime_t now = srs_update_system_time();
+        if (now >= deadline) {
+            break;
+        }
+
+        int r0 = srs_cond_timedwait(done_, deadline - now);
+        if (fetch(key, category)) {
+            return category;
+        }
+
+        // Timeout, or the connection is interrupted, or all workers quit.
+        if (r0 != 0 || !enabled()) {
+            break;
+        }
+    }
+
+    nn_timeouts_++;
+    return category;
+}
+
+void SrsUrlCategoryClient::dumps(SrsJsonObject* obj)
+{
+    obj->set("enabled", SrsJsonAny::boolean(enabled()));
+    obj->set("model", SrsJsonAny::boolean(classifier_ != NULL));
+    obj->set("classified", SrsJsonAny::integer(nn_classified_));
+    obj->set("workers", SrsJsonAny::integer(workers_.size()));
+    obj->set("alive_workers", SrsJsonAny::integer(nn_alive_workers_));
+    obj->set("cache", SrsJsonAny::integer(lru_.size()));
+    obj->set("pending", SrsJsonAny::integer(pending_.size()));
+    obj->set("hits", SrsJsonAny::integer(nn_hits_));
+    obj->set("misses", SrsJsonAny::integer(nn_misses_));
+    obj->set("timeouts", SrsJsonAny::integer(nn_timeouts_));
+    obj->set("dropped", SrsJsonAny::integer(nn_dropped_));
+    obj->set("batches", SrsJsonAny::integer(nn_batches_));
+    obj->set("urls", SrsJsonAny::integer(nn_urls_));
+    obj->set("errors", SrsJsonAny::integer(nn_errors_));
+}
+
+void SrsUrlCategoryClient::on_worker_quit()
+{
+    nn_alive_workers_--;
+    if (nn_alive_workers_ > 0) {
+        return;
+    }
+
+    // Disable the client, and wakeup the waiting requests, which are fail-open.
+    srs_warn("url category disabled, all %d workers quit", (int)workers_.size());
+    queue_.clear();
+    pending_.clear();
+    srs_cond_broadcast(done_);
+}
+
+srs_error_t SrsUrlCategoryClient::do_batch(SrsHttpClient* hc)
+{
+    srs_error_t err = srs_success;
+
+    vector<string> keys;
+    while (!queue_.empty() && (int)keys.size() < batch_) {
+        keys.push_back(queue_.front());
+        queue_.pop_front();
+    }
+
+    // Wakeup another worker for the left URLs.
+    if (!queue_.empty()) {
+        srs_cond_signal(ready_);
+    }
+
+    vector<string> categories;
+    if ((err = request(hc, keys, categories)) != srs_success) {
+        nn_errors_++;
+    }
+
+    // Fill the cache even if failed, so the requests are not queued again before the TTL.
+    for (int i = 0; i < (int)keys.size(); i++) {
+        const string& key = keys.at(i);
+        pending_.erase(key);
+
+        if (i < (int)categories.size()) {
+            update(key, categories.at(i), ttl_);
+        } else {
+            update(key, "", SRS_URL_CATEGORY_FAILURE_TTL);
+        }
+    }
+
+    nn_batches_++;
+    nn_urls_ += keys.size();
+    srs_cond_broadcast(done_);
+
+    return err;
+}
+
+srs_error_t SrsUrlCategoryClient::request(SrsHttpClient* hc, vector<string>& keys, vector<string>& categories)
+{
+    srs_error_t err = srs_success;
+
+    SrsJsonObject* req = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, req);
+
+    SrsJsonArray* urls = SrsJsonAny::array();
+    req->set("urls", urls);
+    for (int i = 0; i < (int)keys.size(); i++) {
+        urls->append(SrsJsonAny::str(keys.at(i).c_str()));
+    }
+
+    ISrsHttpMessage* msg = NULL;
+    if ((err = hc->post(SRS_URL_CATEGORY_API, req->dumps(), &msg)) != srs_success) {
+        return srs_error_wrap(err, "post %d urls", (int)keys.size());
+    }
+    SrsAutoFree(ISrsHttpMessage, msg);
+
+    string body;
+    if ((err = msg->body_read_all(body)) != srs_success) {
+        return srs_error_wrap(err, "read body");
+    }
+
+    int status = ((SrsHttpMessage*)msg)->status_code();
+    if (status != SRS_CONSTS_HTTP_OK) {
+        return srs_error_new(ERROR_HTTP_DATA_INVALID, "status=%d, body=%s", status, body.c_str());
+    }
+
+    SrsJsonAny* any = SrsJsonAny::loads(body);
+    SrsAutoFree(SrsJsonAny, any);
+    if (!any || !any->is_object()) {
+        return srs_error_new(ERROR_HTTP_DATA_INVALID, "invalid body=%s", body.c_str());
+    }
+
+    SrsJsonAny* prop = any->to_object()->get_property("categories");
+    if (!prop || !prop->is_array()) {
+        return srs_error_new(ERROR_HTTP_DATA_INVALID, "no categories, body=%s", body.c_str());
+    }
+
+    SrsJsonArray* arr = prop->to_array();
+    for (int i = 0; i < (int)keys.size(); i++) {
+        SrsJsonAny* category = i < arr->count() ? arr->at(i) : NULL;
+        categories.push_back((category && category->is_string()) ? category->to_str() : "");
+    }
+
+    return err;
+}
+
+bool SrsUrlCategoryClient::fetch(const string& key, string& category)
+{
+    unordered_map<string, SrsUrlCategoryList::iterator>::iterator it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+
+    SrsUrlCategoryList::iterator entry = it->second;
+    if (entry->expire < srs_update_system_time()) {
+        lru_.erase(entry);
+        index_.erase(it);
+        return false;
+    }
+
+    lru_.splice(lru_.begin(), lru_, entry);
+    category = entry->category;
+    return true;
+}
+
+void SrsUrlCategoryClient::update(const string& key, const string& category, srs_utime_t ttl)
+{
+    unordered_map<string, SrsUrlCategoryList::iterator>::iterator it = index_.find(key);
+    if (it != index_.end()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+
+    while ((int)lru_.size() >= capacity_) {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+
+    SrsUrlCategoryEntry entry;
+    entry.key = key;
+    entry.category = category;
+    entry.expire = srs_update_system_time() + ttl;
+
+    lru_.push_front(entry);
+    index_[key] = lru_.begin();
+}
@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_URL_CATEGORY_HPP
+#define SRS_APP_URL_CATEGORY_HPP
+
+#include <srs_core.hpp>
+#include <srs_app_st.hpp>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+class SrsHttpClient;
+class SrsJsonObject;
+class SrsUrlClassifier;
+class SrsUrlCategoryClient;
+
+// The API of classifier, which categorizes a batch of URLs in one request:
+//      POST /url_detect/batch {"urls":["www.example.com/news/", ...]}
+//      200 {"categories":["news", ...]}
+// the categories are in the same order of urls, empty or null if unknown.
+#define SRS_URL_CATEGORY_API "/url_detect/batch"
+
+// Get the key of URL to categorize, which is the host and the first segment of path, for example,
+// "www.example.com/news/" for "/news/2022/a.html", and "www.example.com/" for "/index.html".
+extern std::string srs_url_category_key(const std::string& host, const std::string& path);
+
+// The worker which owns a keep-alive connection to classifier, and sends the queued URLs in batch.
+class SrsUrlCategoryWorker : public ISrsCoroutineHandler
+{
+private:
+    SrsCoroutine* trd_;
+    SrsUrlCategoryClient* client_;
+    SrsHttpClient* hc_;
+public:
+    SrsUrlCategoryWorker(SrsUrlCategoryClient* client);
+    virtual ~SrsUrlCategoryWorker();
+public:
+    virtual srs_error_t start();
+// Interface ISrsCoroutineHandler
+public:
+    virtual srs_error_t cycle();
+private:
+    virtual srs_error_t do_cycle();
+};
+
+// The client of URL classifier, which never blocks the request for more than the timeout.
+// The request queues the URL and waits for the result, the workers send all queued URLs in one request,
+// so the URLs are batched naturally when the classifier is busy, and the same URL is queued once.
+// The result is cached by key with TTL, and the request is fail-open, the category is empty if the
+// classifier is slow or down, while the result still fills the cache for the later requests.
+// If the model is loaded, the URL is categorized in process, by SrsUrlClassifier, without the service.
+// @remark There is no lock, because it's only used in the ST thread.
+class SrsUrlCategoryClient
+{
+    friend class SrsUrlCategoryWorker;
+private:
+    struct SrsUrlCategoryEntry
+    {
+        std::string key;
+        std::string category;
+        srs_utime_t expire;
+    };
+    typedef std::list<SrsUrlCategoryEntry> SrsUrlCategoryList;
+private:
+    // The classifier service.
+    std::string host_;
+    int port_;
+    int nn_workers_;
+    // The max number of URLs in a request.
+    int batch_;
+    // The max time of request to wait for the category.
+    srs_utime_t timeout_;
+    srs_utime_t ttl_;
+    int capacity_;
+    std::vector<SrsUrlCategoryWorker*> workers_;
+    // The number of running workers, the client is disabled when all workers quit.
+    int nn_alive_workers_;
+    // The in-process classifier, NULL to use the service.
+    SrsUrlClassifier* classifier_;
+    // The URLs to categorize, and the ones in queue or in flight.
+    std::deque<std::string> queue_;
+    std::unordered_set<std::string> pending_;
+    // Signal the workers when queued, and the requests when categorized.
+    srs_cond_t ready_;
+    srs_cond_t done_;
+    // The LRU cache of categories, the most recently used is at front.
+    SrsUrlCategoryList lru_;
+    std::unordered_map<std::string, SrsUrlCategoryList::iterator> index_;
+private:
+    uint64_t nn_hits_;
+    uint64_t nn_misses_;
+    uint64_t nn_timeouts_;
+    uint64_t nn_dropped_;
+    uint64_t nn_batches_;
+    uint64_t nn_urls_;
+    uint64_t nn_errors_;
+    uint64_t nn_classified_;
+public:
+    SrsUrlCategoryClient();
+    virtual ~SrsUrlCategoryClient();
+public:
+    // Start the workers to the classifier, the category is always empty if not started.
+    virtual srs_error_t initialize(std::string host, int port, int workers, int batch, srs_utime_t timeout, srs_utime_t ttl, int capacity);
+    // Load the compiled model, to categorize in process rather than by the service.
+    virtual srs_error_t initialize(std::string model);
+    virtual bool enabled();
+    // Get the category of URL, empty if unknown or timeout.
+    virtual std::string categorize(const std::string& host, const std::string& path);
+    virtual void dumps(SrsJsonObject* obj);
+private:
+    // Take a batch of queued URLs, and send to classifier.
+    virtual srs_error_t do_batch(SrsHttpClient* hc);
+    virtual srs_error_t request(SrsHttpClient* hc, std::vector<std::string>& keys, std::vector<std::string>& categories);
+    // When the worker quits, for it fails to reconnect.
+    void on_worker_quit();
+    bool fetch(const std::string& key, std::string& category);
+    void update(const std::string& key, const std::string& category, srs_utime_t ttl);
+};
+
+extern SrsUrlCategoryClient* _srs_url_category;
+
+#endif
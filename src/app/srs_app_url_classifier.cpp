@@ -0,0 +1,458 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_url_classifier.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_file.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_config.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <sstream>
+using namespace std;
+
+// The magic and version of compiled model.
+#define SRS_URL_CLASSIFIER_MAGIC "SRSURLCL"
+#define SRS_URL_CLASSIFIER_VERSION 1
+
+// The compiled model is [header][names][bias][idf][weights], all in host byte order, each part is aligned
+// to 16 bytes, so the rows are loaded by vector instructions.
+struct SrsUrlClassifierHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t nn_classes;
+    uint32_t stride;
+    uint32_t nn_buckets;
+    uint32_t ngram_min;
+    uint32_t ngram_max;
+    float threshold;
+    uint32_t reserved;
+    // The size of file, to detect the truncated file.
+    uint64_t size;
+};
+
+// The vector of 4 floats, which is SSE on x86 and NEON on ARM.
+typedef float srs_vf4 __attribute__((vector_size(16)));
+
+static size_t srs_url_classifier_align(size_t size)
+{
+    return (size + 15) & ~(size_t)15;
+}
+
+uint32_t srs_url_classifier_hash(const char* p, int size)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < size; i++) {
+        h ^= (uint8_t)p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+SrsUrlClassifier::SrsUrlClassifier()
+{
+    nn_classes_ = 0;
+    stride_ = 0;
+    nn_buckets_ = 0;
+    ngram_min_ = 0;
+    ngram_max_ = 0;
+    threshold_ = 0;
+    names_ = NULL;
+    bias_ = NULL;
+    idf_ = NULL;
+    weights_ = NULL;
+    mmap_ = NULL;
+
+    // The table to count features is no less than twice of features, in power of 2.
+    lower_ = new char[SRS_URL_CLASSIFIER_MAX_URL];
+    buckets_ = new uint32_t[SRS_URL_CLASSIFIER_MAX_URL * SRS_URL_CLASSIFIER_MAX_NGRAMS];
+    keys_ = new uint32_t[SRS_URL_CLASSIFIER_MAX_URL * SRS_URL_CLASSIFIER_MAX_NGRAMS * 2];
+    counts_ = new uint16_t[SRS_URL_CLASSIFIER_MAX_URL * SRS_URL_CLASSIFIER_MAX_NGRAMS * 2];
+}
+
+SrsUrlClassifier::~SrsUrlClassifier()
+{
+    srs_freep(mmap_);
+    srs_freepa(lower_);
+    srs_freepa(buckets_);
+    srs_freepa(keys_);
+    srs_freepa(counts_);
+}
+
+srs_error_t SrsUrlClassifier::load_text(string path)
+{
+    srs_error_t err = srs_success;
+
+    SrsFileReader reader;
+    if ((err = reader.open(path)) != srs_success) {
+        return srs_error_wrap(err, "open %s", path.c_str());
+    }
+
+    string text;
+    char buf[4096];
+    while (true) {
+        ssize_t nread = 0;
+        err = reader.read(buf, sizeof(buf), &nread);
+        srs_freep(err);
+        if (nread <= 0) {
+            break;
+        }
+        text.append(buf, nread);
+    }
+
+    SrsUrlClassifierHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SRS_URL_CLASSIFIER_MAGIC, sizeof(header.magic));
+    header.version = SRS_URL_CLASSIFIER_VERSION;
+
+    vector<string> classes;
+    float idf_default = 1.0;
+    string data;
+    size_t names = 0, bias = 0, idf = 0, weights = 0;
+
+    istringstream lines(text);
+    string line;
+    for (int nn_lines = 1; getline(lines, line); nn_lines++) {
+        istringstream ss(line);
+        string key;
+        if (!(ss >> key) || key.at(0) == '#') {
+            continue;
+        }
+
+        // The rows of features, after the header.
+        if (key == "idf" || key == "weight") {
+            if (data.empty()) {
+                if (classes.empty() || !header.nn_buckets || !header.ngram_min) {
+                    return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "line %d, no ngram, buckets or classes", nn_lines);
+                }
+
+                // Allocate the model, the header is updated when done.
+                header.nn_classes = (uint32_t)classes.size();
+                header.stride = (header.nn_classes + 3) & ~3;
+                names = srs_url_classifier_align(sizeof(header));
+                bias = names + srs_url_classifier_align(SRS_URL_CLASSIFIER_NAME * header.nn_classes);
+                idf = bias + srs_url_classifier_align(sizeof(float) * header.stride);
+                weights = idf + srs_url_classifier_align(sizeof(float) * header.nn_buckets);
+                data.resize(weights + sizeof(float) * header.stride * header.nn_buckets);
+
+                for (int i = 0; i < (int)classes.size(); i++) {
+                    strncpy((char*)data.data() + names + SRS_URL_CLASSIFIER_NAME * i, classes.at(i).c_str(), SRS_URL_CLASSIFIER_NAME - 1);
+                }
+                for (int i = 0; i < (int)header.nn_buckets; i++) {
+                    ((float*)(data.data() + idf))[i] = idf_default;
+                }
+            }
+
+            uint32_t bucket = 0;
+            if (!(ss >> bucket) || bucket >= header.nn_buckets) {
+                return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "line %d, invalid bucket", nn_lines);
+            }
+
+            int nn_values = key == "idf" ? 1 : header.nn_classes;
+            float* values = key == "idf" ? (float*)(data.data() + idf) + bucket : (float*)(data.data() + weights) + header.stride * bucket;
+            for (int i = 0; i < nn_values; i++) {
+                if (!(ss >> values[i])) {
+                    return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "line %d, requires %d values", nn_lines, nn_values);
+                }
+            }
+            continue;
+        }
+
+        if (!data.empty()) {
+            return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "line %d, %s after rows", nn_lines, key.c_str());
+        }
+
+        if (key == "ngram") {
+            ss >> header.ngram_min >> header.ngram_max;
+        } else if (key == "buckets") {
+            ss >> header.nn_buckets;
+        } else if (key == "threshold") {
+            ss >> header.threshold;
+        } else if (key == "idf_default") {
+            ss >> idf_default;
+        } else if (key == "classes") {
+            for (string name; ss >> name;) {
+                classes.push_back(name);
+            }
+        } else if (key == "bias") {
+            // Parsed when the model is allocated, see below.
+            continue;
+        } else {
+            return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "line %d, unknown %s", nn_lines, key.c_str());
+        }
+    }
+
+    if (data.empty()) {
+        return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "no weight in %s", path.c_str());
+    }
+
+    // Parse the bias, which is not in order with the rows.
+    lines.clear();
+    lines.seekg(0);
+    while (getline(lines, line)) {
+        istringstream ss(line);
+        string key;
+        if (!(ss >> key) || key != "bias") {
+            continue;
+        }
+        for (int i = 0; i < (int)header.nn_classes; i++) {
+            if (!(ss >> ((float*)(data.data() + bias))[i])) {
+                return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "bias requires %d values", header.nn_classes);
+            }
+        }
+    }
+
+    header.size = data.size();
+    memcpy((char*)data.data(), &header, sizeof(header));
+
+    if ((err = parse(data.data(), data.size())) != srs_success) {
+        return srs_error_wrap(err, "parse %s", path.c_str());
+    }
+
+    buffer_.swap(data);
+    srs_freep(mmap_);
+
+    return parse(buffer_.data(), buffer_.size());
+}
+
+srs_error_t SrsUrlClassifier::load(string path)
+{
+    srs_error_t err = srs_success;
+
+    SrsFileMmap* mmap = new SrsFileMmap();
+    if ((err = mmap->open(path)) != srs_success) {
+        srs_freep(mmap);
+        return srs_error_wrap(err, "map %s", path.c_str());
+    }
+
+    if ((err = parse(mmap->data(), mmap->size())) != srs_success) {
+        srs_freep(mmap);
+        return srs_error_wrap(err, "parse %s", path.c_str());
+    }
+
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+    srs_freep(mmap_);
+    mmap_ = mmap;
+
+    return err;
+}
+
+srs_error_t SrsUrlClassifier::save(string path)
+{
+    srs_error_t err = srs_success;
+
+    if (buffer_.empty()) {
+        return srs_error_new(ERROR_SYSTEM_FILE_WRITE, "no model to save");
+    }
+
+    // Write to a temporary file then rename, so the processes which map the old file are not affected.
+    string tmp = path + ".tmp";
+    SrsFileWriter writer;
+    if ((err = writer.open(tmp)) != srs_success) {
+        return srs_error_wrap(err, "open %s", tmp.c_str());
+    }
+    if ((err = writer.write((void*)buffer_.data(), buffer_.size(), NULL)) != srs_success) {
+        return srs_error_wrap(err, "write %s", tmp.c_str());
+    }
+    writer.close();
+
+    if (::rename(tmp.c_str(), path.c_str()) < 0) {
+        ::unlink(tmp.c_str());
+        return srs_error_new(ERROR_SYSTEM_FILE_RENAME, "rename %s to %s", tmp.c_str(), path.c_str());
+    }
+
+    return err;
+}
+
+// The scores of classify and the accumulators of score are the only arrays on stack.
+static_assert(sizeof(float) * SRS_URL_CLASSIFIER_MAX_CLASSES * 2 <= SRS_URL_CLASSIFIER_MAX_STACK, "stack of classifier");
+static_assert(SRS_URL_CLASSIFIER_MAX_STACK * 16 <= SRS_CONF_DEFAULT_PROXY_STACK_SIZE, "stack of classifier");
+
+string SrsUrlClassifier::classify(const string& url, float* pprob)
+{
+    float scores[SRS_URL_CLASSIFIER_MAX_CLASSES];
+    score(url, scores);
+
+    // The softmax of the best, that is 1 / sum(exp(scores - best)).
+    int best = 0;
+    for (int i = 1; i < (int)nn_classes_; i++) {
+        if (scores[i] > scores[best]) {
+            best = i;
+        }
+    }
+
+    float sum = 0;
+    for (int i = 0; i < (int)nn_classes_; i++) {
+        sum += expf(scores[i] - scores[best]);
+    }
+    float prob = 1.0f / sum;
+
+    if (pprob) {
+        *pprob = prob;
+    }
+    return prob < threshold_ ? "" : name(best);
+}
+
+void SrsUrlClassifier::score(const string& url, float* scores)
+{
+    // Lowercase the URL, and get the buckets of all n-grams.
+    char* lower = lower_;
+    int size = srs_min((int)url.size(), SRS_URL_CLASSIFIER_MAX_URL);
+    for (int i = 0; i < size; i++) {
+        lower[i] = (char)tolower((uint8_t)url.at(i));
+    }
+
+    uint32_t* buckets = buckets_;
+    int nn_features = 0;
+    for (int i = 0; i + (int)ngram_min_ <= size; i++) {
+        // The FNV-1a of n-gram is the prefix of the longer one, so hash all n-grams at i in one pass.
+        uint32_t hash = 2166136261u;
+        for (int n = 1; n <= (int)ngram_max_ && i + n <= size; n++) {
+            hash = (hash ^ (uint8_t)lower[i + n - 1]) * 16777619u;
+            if (n >= (int)ngram_min_) {
+                buckets[nn_features++] = hash & (nn_buckets_ - 1);
+            }
+        }
+    }
+
+    // The rows are random in the large model, so load them in parallel before the accumulation.
+    for (int i = 0; i < nn_features; i++) {
+        __builtin_prefetch(weights_ + (size_t)stride_ * buckets[i]);
+    }
+
+    // Count the same features for tf, by a small open addressing table, which is much faster than sort,
+    // and the size is the power of 2 no less than twice of features.
+    int mask = 15;
+    while (mask + 1 < nn_features * 2) {
+        mask = mask * 2 + 1;
+    }
+
+    // The key is bucket+1, because zero is empty.
+    uint32_t* keys = keys_;
+    uint16_t* counts = counts_;
+    memset(keys, 0, sizeof(uint32_t) * (mask + 1));
+
+    int nn_unique = 0;
+    for (int i = 0; i < nn_features; i++) {
+        uint32_t key = buckets[i] + 1;
+        int slot = (int)((key * 2654435761u) >> 16) & mask;
+        while (keys[slot] && keys[slot] != key) {
+            slot = (slot + 1) & mask;
+        }
+
+        if (!keys[slot]) {
+            keys[slot] = key;
+            counts[slot] = 0;
+            buckets[nn_unique++] = (uint32_t)slot;
+        }
+        counts[slot]++;
+    }
+
+    srs_vf4 acc[SRS_URL_CLASSIFIER_MAX_CLASSES / 4];
+    int nn_vectors = (int)stride_ / 4;
+    for (int j = 0; j < nn_vectors; j++) {
+        acc[j] = (srs_vf4){0, 0, 0, 0};
+    }
+
+    // Now buckets are the slots of unique features, in the order of first seen.
+    float norm = 0;
+    for (int i = 0; i < nn_unique; i++) {
+        int slot = (int)buckets[i];
+        uint32_t bucket = keys[slot] - 1;
+
+        float x = counts[slot] * idf_[bucket];
+        norm += x * x;
+
+        const srs_vf4* row = (const srs_vf4*)(weights_ + (size_t)stride_ * bucket);
+        for (int j = 0; j < nn_vectors; j++) {
+            acc[j] += row[j] * x;
+        }
+    }
+
+    float scale = norm > 0 ? 1.0f / sqrtf(norm) : 0;
+    for (int i = 0; i < (int)nn_classes_; i++) {
+        scores[i] = bias_[i] + acc[i / 4][i % 4] * scale;
+    }
+}
+
+int SrsUrlClassifier::classes()
+{
+    return (int)nn_classes_;
+}
+
+string SrsUrlClassifier::name(int index)
+{
+    return string(names_ + SRS_URL_CLASSIFIER_NAME * index);
+}
+
+size_t SrsUrlClassifier::memory()
+{
+    return mmap_ ? mmap_->size() : buffer_.size();
+}
+
+srs_error_t SrsUrlClassifier::parse(const char* data, size_t size)
+{
+    if (size < sizeof(SrsUrlClassifierHeader)) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "model header requires %d only %d bytes",
+            (int)sizeof(SrsUrlClassifierHeader), (int)size);
+    }
+
+    // The rows are loaded as vectors, so the model must be aligned, which is always true for mmap and malloc.
+    if (((uintptr_t)data & 15) != 0) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "model %p not aligned", data);
+    }
+
+    SrsUrlClassifierHeader* header = (SrsUrlClassifierHeader*)data;
+    if (memcmp(header->magic, SRS_URL_CLASSIFIER_MAGIC, sizeof(header->magic)) != 0 || header->version != SRS_URL_CLASSIFIER_VERSION) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid model, version=%u", header->version);
+    }
+
+    uint32_t nn_buckets = header->nn_buckets;
+    if (!header->nn_classes || header->nn_classes > SRS_URL_CLASSIFIER_MAX_CLASSES || header->stride != ((header->nn_classes + 3) & ~3)) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid model, classes=%u, stride=%u", header->nn_classes, header->stride);
+    }
+    if (!nn_buckets || (nn_buckets & (nn_buckets - 1)) != 0) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid model, buckets=%u should be power of 2", nn_buckets);
+    }
+    if (!header->ngram_min || header->ngram_min > header->ngram_max || header->ngram_max > SRS_URL_CLASSIFIER_MAX_NGRAMS) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid model, ngram=%u-%u", header->ngram_min, header->ngram_max);
+    }
+
+    size_t names = srs_url_classifier_align(sizeof(SrsUrlClassifierHeader));
+    size_t bias = names + srs_url_classifier_align(SRS_URL_CLASSIFIER_NAME * header->nn_classes);
+    size_t idf = bias + srs_url_classifier_align(sizeof(float) * header->stride);
+    size_t weights = idf + srs_url_classifier_align(sizeof(float) * (uint64_t)nn_buckets);
+    uint64_t end = weights + sizeof(float) * (uint64_t)header->stride * nn_buckets;
+    if (end != size || header->size != size) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid model, size=%d/%d, requires %d", (int)size, (int)header->size, (int)end);
+    }
+
+    // Never trust the name in file, it must end with NUL.
+    for (int i = 0; i < (int)header->nn_classes; i++) {
+        if (data[names + SRS_URL_CLASSIFIER_NAME * (i + 1) - 1] != 0) {
+            return srs_error_new(ERROR_POLICY_DATABASE, "invalid model, name %d", i);
+        }
+    }
+
+    nn_classes_ = header->nn_classes;
+    stride_ = header->stride;
+    nn_buckets_ = nn_buckets;
+    ngram_min_ = header->ngram_min;
+    ngram_max_ = header->ngram_max;
+    threshold_ = header->threshold;
+    names_ = data + names;
+    bias_ = (const float*)(data + bias);
+    idf_ = (const float*)(data + idf);
+    weights_ = (const float*)(data + weights);
+
+    return srs_success;
+}
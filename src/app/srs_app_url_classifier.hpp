@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_URL_CLASSIFIER_HPP
+#define SRS_APP_URL_CLASSIFIER_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+
+class SrsFileMmap;
+
+// The max number of categories of model, and the max bytes of category name.
+#define SRS_URL_CLASSIFIER_MAX_CLASSES 64
+#define SRS_URL_CLASSIFIER_NAME 32
+// Only the first bytes of URL are scored, to bound the time.
+#define SRS_URL_CLASSIFIER_MAX_URL 256
+// The max n-grams at each position of URL, that is ngram_max - ngram_min + 1.
+#define SRS_URL_CLASSIFIER_MAX_NGRAMS 8
+// The max bytes of the arrays on stack of classify, for it runs on the proxy coroutine.
+#define SRS_URL_CLASSIFIER_MAX_STACK 1024
+
+// Hash the char n-gram to the feature, the bucket is the hash masked by the number of buckets.
+// @remark The exporter of model must use the same hash, which is FNV-1a of 32 bits.
+extern uint32_t srs_url_classifier_hash(const char* p, int size);
+
+// The in-process URL classifier, which is a linear model on the TF-IDF of hashed char n-grams, for example,
+// the LogisticRegression of sklearn, so the URL is scored in microseconds without the classifier service.
+// The score of category c is:
+//      bias[c] + sum(tf[f] * idf[f] * weights[f][c]) / norm(tf * idf)
+// for the n-gram features f of the lowercase URL, and the probability is the softmax of scores.
+// The weights of a feature is a row of all categories, padded to 4 floats, so the row is added to the
+// scores by vector instructions, and the URL reads only the rows of its features.
+// @remark The model is exported as text, and compiled to binary, which is mapped read-only and shared.
+// @remark The scratch of features is in classifier rather than the small stack of proxy coroutine, which is
+//      shared by all coroutines, for score never yields.
+class SrsUrlClassifier
+{
+private:
+    uint32_t nn_classes_;
+    // The floats of a row, which is nn_classes_ aligned to 4.
+    uint32_t stride_;
+    uint32_t nn_buckets_;
+    uint32_t ngram_min_;
+    uint32_t ngram_max_;
+    // The min probability of category, or unknown.
+    float threshold_;
+    // The names of categories, each is SRS_URL_CLASSIFIER_NAME bytes with NUL.
+    const char* names_;
+    const float* bias_;
+    const float* idf_;
+    const float* weights_;
+private:
+    // The binary model, compiled from text, or mapped from file.
+    std::string buffer_;
+    SrsFileMmap* mmap_;
+private:
+    // The scratch of score, the lowercase URL, the buckets of n-grams, and the table to count them.
+    char* lower_;
+    uint32_t* buckets_;
+    uint32_t* keys_;
+    uint16_t* counts_;
+public:
+    SrsUrlClassifier();
+    virtual ~SrsUrlClassifier();
+public:
+    // Load the model exported as text, see research/url-classifier/export_model.py, the format is:
+    //      ngram 3 5
+    //      buckets 262144
+    //      threshold 0.5
+    //      classes news sports
+    //      bias 0.1 -0.1
+    //      idf_default 9.2
+    //      idf <bucket> <idf>
+    //      weight <bucket> <weight of news> <weight of sports>
+    virtual srs_error_t load_text(std::string path);
+    // Map the compiled model.
+    virtual srs_error_t load(std::string path);
+    // Write the compiled model, which is replaced atomically by rename.
+    virtual srs_error_t save(std::string path);
+    // Get the category of URL, empty if the probability is lower than the threshold.
+    // @param url The host and path, for example, "www.example.com/news/a.html".
+    // @param pprob Output the probability of category, ignored if NULL.
+    virtual std::string classify(const std::string& url, float* pprob = NULL);
+    // Get the scores of all categories, before softmax.
+    virtual void score(const std::string& url, float* scores);
+    virtual int classes();
+    virtual std::string name(int index);
+    // The bytes of model.
+    virtual size_t memory();
+private:
+    srs_error_t parse(const char* data, size_t size);
+};
+
+#endif
@@ -0,0 +1,410 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_app_url_matcher.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
+
+#include <string.h>
+#include <deque>
+using namespace std;
+
+// The header of encoded rules, followed by the classes, rules, delta, out index and outputs.
+struct SrsUrlMatcherHeader
+{
+    uint32_t nn_rules;
+    uint32_t nn_states;
+    uint32_t nn_classes;
+    uint32_t nn_outputs;
+};
+
+// The next state has outputs, so the state without outputs is only one lookup per byte.
+#define SRS_URL_OUTPUT_FLAG 0x80000000
+#define SRS_URL_STATE_MASK 0x7fffffff
+
+bool srs_url_rule_parse(string rule, vector<string>& pieces)
+{
+    bool start = false;
+    bool end = false;
+
+    rule = srs_string_trim_start(srs_string_trim_end(rule, " \t\r\n"), " \t\r\n");
+    if (srs_string_starts_with(rule, "=")) {
+        start = end = true;
+        rule = rule.substr(1);
+    } else if (srs_string_starts_with(rule, "~")) {
+        rule = rule.substr(1);
+    } else if (srs_string_starts_with(rule, "/")) {
+        start = true;
+    } else {
+        return false;
+    }
+
+    vector<string> parts = srs_string_split(rule, "*");
+    if (rule.empty() || parts.empty()) {
+        return false;
+    }
+
+    // The anchor is not for the wildcard, for example, "=*.exe" is not anchored at start.
+    if (start && !parts.front().empty()) {
+        parts.front().insert(parts.front().begin(), SRS_URL_ANCHOR_START);
+    }
+    if (end && !parts.back().empty()) {
+        parts.back().push_back(SRS_URL_ANCHOR_END);
+    }
+
+    pieces.clear();
+    for (int i = 0; i < (int)parts.size(); i++) {
+        if (parts[i].empty()) {
+            continue;
+        }
+        if (parts[i].length() > 0xffff) {
+            return false;
+        }
+        pieces.push_back(parts[i]);
+    }
+
+    return !pieces.empty() && pieces.size() <= 0xffff;
+}
+
+SrsUrlMatcher::SrsUrlMatcher()
+{
+    classes_ = NULL;
+    rules_ = NULL;
+    delta_ = NULL;
+    out_index_ = NULL;
+    outputs_ = NULL;
+    nn_rules_ = 0;
+    nn_states_ = 0;
+    nn_classes_ = 0;
+    nn_outputs_ = 0;
+    mapped_ = false;
+
+    compile();
+}
+
+SrsUrlMatcher::~SrsUrlMatcher()
+{
+}
+
+srs_error_t SrsUrlMatcher::add(string rule)
+{
+    srs_assert(!mapped_);
+
+    vector<string> pieces;
+    if (!srs_url_rule_parse(rule, pieces)) {
+        return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "invalid url rule %s", rule.c_str());
+    }
+
+    pieces_.push_back(pieces);
+    return srs_success;
+}
+
+void SrsUrlMatcher::compile()
+{
+    srs_assert(!mapped_);
+
+    // Assign a class for each byte in pieces, the others are class 0.
+    vector<uint16_t> classes(256, 0);
+    uint32_t nn_classes = 1;
+    for (int i = 0; i < (int)pieces_.size(); i++) {
+        for (int j = 0; j < (int)pieces_[i].size(); j++) {
+            const string& piece = pieces_[i][j];
+            for (int k = 0; k < (int)piece.length(); k++) {
+                uint8_t c = (uint8_t)piece.at(k);
+                if (!classes[c]) {
+                    classes[c] = (uint16_t)nn_classes++;
+                }
+            }
+        }
+    }
+
+    // Build the trie of pieces, the root is state 0.
+    const uint32_t none = (uint32_t)-1;
+    vector<uint32_t> delta(nn_classes, none);
+    vector<vector<SrsUrlOutput> > outputs(1);
+    vector<uint16_t> rules(pieces_.size());
+    for (int i = 0; i < (int)pieces_.size(); i++) {
+        rules[i] = (uint16_t)pieces_[i].size();
+
+        for (int j = 0; j < (int)pieces_[i].size(); j++) {
+            const string& piece = pieces_[i][j];
+
+            uint32_t state = 0;
+            for (int k = 0; k < (int)piece.length(); k++) {
+                uint32_t c = classes[(uint8_t)piece.at(k)];
+                if (delta[state * nn_classes + c] == none) {
+                    delta[state * nn_classes + c] = (uint32_t)outputs.size();
+                    delta.resize(delta.size() + nn_classes, none);
+                    outputs.resize(outputs.size() + 1);
+                }
+                state = delta[state * nn_classes + c];
+            }
+
+            SrsUrlOutput output;
+            output.rule = (uint32_t)i;
+            output.piece = (uint16_t)j;
+            output.length = (uint16_t)piece.length();
+            outputs[state].push_back(output);
+        }
+    }
+
+    // Convert the trie to DFA in BFS order, the missing edge goes to the next state of the fail state,
+    // and the outputs of fail state are merged, because the fail state is shorter so it's done before.
+    uint32_t nn_states = (uint32_t)outputs.size();
+    vector<uint32_t> fail(nn_states, 0);
+    deque<uint32_t> queue;
+    for (uint32_t c = 0; c < nn_classes; c++) {
+        uint32_t& next = delta[c];
+        if (next == none) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    while (!queue.empty()) {
+        uint32_t state = queue.front();
+        queue.pop_front();
+
+        const vector<SrsUrlOutput>& inherited = outputs[fail[state]];
+        outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+
+        for (uint32_t c = 0; c < nn_classes; c++) {
+            uint32_t& next = delta[state * nn_classes + c];
+            uint32_t fallback = delta[fail[state] * nn_classes + c];
+            if (next == none) {
+                next = fallback;
+            } else {
+                fail[next] = fallback;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    classes_buffer_.swap(classes);
+    rules_buffer_.swap(rules);
+    delta_buffer_.swap(delta);
+
+    out_index_buffer_.clear();
+    outputs_buffer_.clear();
+    for (uint32_t i = 0; i < nn_states; i++) {
+        out_index_buffer_.push_back((uint32_t)outputs_buffer_.size());
+        outputs_buffer_.insert(outputs_buffer_.end(), outputs[i].begin(), outputs[i].end());
+    }
+    out_index_buffer_.push_back((uint32_t)outputs_buffer_.size());
+
+    for (size_t i = 0; i < delta_buffer_.size(); i++) {
+        if (!outputs[delta_buffer_[i]].empty()) {
+            delta_buffer_[i] |= SRS_URL_OUTPUT_FLAG;
+        }
+    }
+
+    classes_ = &classes_buffer_[0];
+    rules_ = rules_buffer_.empty() ? NULL : &rules_buffer_[0];
+    delta_ = &delta_buffer_[0];
+    out_index_ = &out_index_buffer_[0];
+    outputs_ = outputs_buffer_.empty() ? NULL : &outputs_buffer_[0];
+    nn_rules_ = (uint32_t)rules_buffer_.size();
+    nn_states_ = nn_states;
+    nn_classes_ = nn_classes;
+    nn_outputs_ = (uint32_t)outputs_buffer_.size();
+    update_url_classes();
+}
+
+static void srs_url_matcher_append(string& data, const void* p, size_t size)
+{
+    data.append((const char*)p, size);
+    data.append((8 - data.size() % 8) % 8, '\0');
+}
+
+void SrsUrlMatcher::encode(string& data)
+{
+    SrsUrlMatcherHeader header;
+    header.nn_rules = nn_rules_;
+    header.nn_states = nn_states_;
+    header.nn_classes = nn_classes_;
+    header.nn_outputs = nn_outputs_;
+
+    srs_url_matcher_append(data, &header, sizeof(header));
+    srs_url_matcher_append(data, classes_, sizeof(uint16_t) * 256);
+    srs_url_matcher_append(data, rules_, sizeof(uint16_t) * nn_rules_);
+    srs_url_matcher_append(data, delta_, sizeof(uint32_t) * nn_states_ * nn_classes_);
+    srs_url_matcher_append(data, out_index_, sizeof(uint32_t) * (nn_states_ + 1));
+    srs_url_matcher_append(data, outputs_, sizeof(SrsUrlOutput) * nn_outputs_);
+}
+
+// Get the offset of next table, which is aligned to 8 bytes.
+static uint64_t srs_url_matcher_next(uint64_t offset, uint64_t size)
+{
+    offset += size;
+    return offset + (8 - offset % 8) % 8;
+}
+
+srs_error_t SrsUrlMatcher::decode(const char* data, size_t size, size_t* pnread)
+{
+    srs_error_t err = srs_success;
+
+    if (size < sizeof(SrsUrlMatcherHeader)) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "url rules header requires %d only %d bytes",
+            (int)sizeof(SrsUrlMatcherHeader), (int)size);
+    }
+
+    SrsUrlMatcherHeader* header = (SrsUrlMatcherHeader*)data;
+    if (!header->nn_states || !header->nn_classes || header->nn_classes > 257) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "invalid url rules states=%u, classes=%u",
+            header->nn_states, header->nn_classes);
+    }
+
+    // Use 64 bits to avoid overflow for the corrupt header.
+    uint64_t classes = srs_url_matcher_next(0, sizeof(SrsUrlMatcherHeader));
+    uint64_t rules = srs_url_matcher_next(classes, sizeof(uint16_t) * 256);
+    uint64_t delta = srs_url_matcher_next(rules, sizeof(uint16_t) * (uint64_t)header->nn_rules);
+    uint64_t out_index = srs_url_matcher_next(delta, sizeof(uint32_t) * (uint64_t)header->nn_states * header->nn_classes);
+    uint64_t outputs = srs_url_matcher_next(out_index, sizeof(uint32_t) * ((uint64_t)header->nn_states + 1));
+    uint64_t end = srs_url_matcher_next(outputs, sizeof(SrsUrlOutput) * (uint64_t)header->nn_outputs);
+    if (end > size) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "url rules requires %u only %u bytes", (uint32_t)end, (uint32_t)size);
+    }
+
+    classes_buffer_.clear();
+    classes_buffer_.shrink_to_fit();
+    rules_buffer_.clear();
+    rules_buffer_.shrink_to_fit();
+    delta_buffer_.clear();
+    delta_buffer_.shrink_to_fit();
+    out_index_buffer_.clear();
+    out_index_buffer_.shrink_to_fit();
+    outputs_buffer_.clear();
+    outputs_buffer_.shrink_to_fit();
+    pieces_.clear();
+
+    classes_ = (const uint16_t*)(data + classes);
+    rules_ = (const uint16_t*)(data + rules);
+    delta_ = (const uint32_t*)(data + delta);
+    out_index_ = (const uint32_t*)(data + out_index);
+    outputs_ = (const SrsUrlOutput*)(data + outputs);
+    nn_rules_ = header->nn_rules;
+    nn_states_ = header->nn_states;
+    nn_classes_ = header->nn_classes;
+    nn_outputs_ = header->nn_outputs;
+    mapped_ = true;
+    update_url_classes();
+
+    if (pnread) {
+        *pnread = (size_t)end;
+    }
+
+    return err;
+}
+
+bool SrsUrlMatcher::match(const string& url)
+{
+    // Fast path, for the most policy has no URL rules.
+    if (!nn_rules_) {
+        return false;
+    }
+
+    // The progress of rules with wildcards, only for the matched ones.
+    vector<SrsUrlProgress> progresses;
+
+    // The state is checked, because the decoded data may be corrupt.
+    uint32_t next = delta_[classes_[(uint8_t)SRS_URL_ANCHOR_START] % nn_classes_];
+    uint32_t state = next & SRS_URL_STATE_MASK;
+    if (state >= nn_states_) {
+        return false;
+    }
+    if ((next & SRS_URL_OUTPUT_FLAG) && on_outputs(state, 0, progresses)) {
+        return true;
+    }
+
+    const uint8_t* p = (const uint8_t*)url.data();
+    uint32_t size = (uint32_t)url.length();
+    for (uint32_t pos = 0; pos < size; pos++) {
+        next = delta_[state * nn_classes_ + url_classes_[p[pos]]];
+        state = next & SRS_URL_STATE_MASK;
+        if (state >= nn_states_) {
+            return false;
+        }
+        if ((next & SRS_URL_OUTPUT_FLAG) && on_outputs(state, pos + 1, progresses)) {
+            return true;
+        }
+    }
+
+    next = delta_[state * nn_classes_ + classes_[(uint8_t)SRS_URL_ANCHOR_END] % nn_classes_];
+    state = next & SRS_URL_STATE_MASK;
+    if (state >= nn_states_) {
+        return false;
+    }
+    return (next & SRS_URL_OUTPUT_FLAG) && on_outputs(state, size + 1, progresses);
+}
+
+int SrsUrlMatcher::size()
+{
+    return mapped_ ? (int)nn_rules_ : (int)pieces_.size();
+}
+
+int SrsUrlMatcher::states()
+{
+    return (int)nn_states_;
+}
+
+void SrsUrlMatcher::update_url_classes()
+{
+    for (int i = 0; i < 256; i++) {
+        url_classes_[i] = classes_[i] < nn_classes_ ? classes_[i] : 0;
+    }
+    url_classes_[(uint8_t)SRS_URL_ANCHOR_START] = 0;
+    url_classes_[(uint8_t)SRS_URL_ANCHOR_END] = 0;
+}
+
+bool SrsUrlMatcher::on_outputs(uint32_t state, uint32_t pos, vector<SrsUrlProgress>& progresses)
+{
+    uint32_t start = out_index_[state];
+    uint32_t stop = srs_min(out_index_[state + 1], nn_outputs_);
+    for (uint32_t i = start; i < stop; i++) {
+        const SrsUrlOutput& output = outputs_[i];
+        if (output.rule >= nn_rules_) {
+            continue;
+        }
+
+        uint32_t nn_pieces = rules_[output.rule];
+        if (nn_pieces <= 1) {
+            return true;
+        }
+
+        // The piece should be after the previous one, the first occurrence is the best, which ends first.
+        SrsUrlProgress* progress = NULL;
+        for (int j = 0; j < (int)progresses.size(); j++) {
+            if (progresses[j].rule == output.rule) {
+                progress = &progresses[j];
+                break;
+            }
+        }
+
+        if (!progress) {
+            if (output.piece == 0) {
+                SrsUrlProgress v = {output.rule, 1, pos + 1};
+                progresses.push_back(v);
+            }
+            continue;
+        }
+
+        if (progress->next == output.piece && pos + 1 >= progress->end + output.length) {
+            progress->next++;
+            progress->end = pos + 1;
+            if (progress->next >= nn_pieces) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+size_t SrsUrlMatcher::memory()
+{
+    return sizeof(uint16_t) * 256 + sizeof(uint16_t) * nn_rules_ + sizeof(uint32_t) * nn_states_ * nn_classes_
+        + sizeof(uint32_t) * (nn_states_ + 1) + sizeof(SrsUrlOutput) * nn_outputs_;
+}
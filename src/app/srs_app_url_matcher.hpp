@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_APP_URL_MATCHER_HPP
+#define SRS_APP_URL_MATCHER_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+
+// The anchors of URL, the URL is matched as [start][path?query][end].
+#define SRS_URL_ANCHOR_START '\x01'
+#define SRS_URL_ANCHOR_END '\x02'
+
+// Parse the URL rule to the literal pieces, which are separated by the wildcard "*".
+// The rule is one of:
+//      "/ads/"             The prefix of path, the "/" is required.
+//      "=/ads/banner.js"   The whole path and query.
+//      "~utm_source="      The substring of path and query.
+// and any "*" in rule matches any bytes, for example, "/api/*/delete" or "=*.exe".
+// @remark The anchors are in pieces, the start is SRS_URL_ANCHOR_START and the end is SRS_URL_ANCHOR_END.
+// @return Whether the rule is valid.
+extern bool srs_url_rule_parse(std::string rule, std::vector<std::string>& pieces);
+
+// The URL matcher, which compiles all pieces of rules into one Aho-Corasick automaton, then converts it to
+// a DFA, so the URL is traversed once, one table lookup per byte, whatever the number of rules.
+// The bytes not in any rule share one class, so the table is states x classes rather than states x 256.
+// For the rule with wildcards, the pieces must be found in order, which is tracked only for the matched
+// pieces, so it's still not related to the number of rules.
+// @remark The tables are flat, so they're encoded as is, and decoded from the mapped file without copy.
+class SrsUrlMatcher
+{
+private:
+    // The output of state, the piece of rule which ends at the state.
+    struct SrsUrlOutput
+    {
+        uint32_t rule;
+        uint16_t piece;
+        uint16_t length;
+    };
+    // The state of rule with wildcards, which pieces are matched in order.
+    struct SrsUrlProgress
+    {
+        uint32_t rule;
+        // The next piece to match, and where the previous piece ends.
+        uint32_t next;
+        uint32_t end;
+    };
+private:
+    // The class of each byte, 0 is for the bytes not in any rule.
+    const uint16_t* classes_;
+    // The number of pieces of each rule.
+    const uint16_t* rules_;
+    // The next state of each state and class, with SRS_URL_OUTPUT_FLAG if the next state has outputs.
+    const uint32_t* delta_;
+    // The outputs of state i are outputs_[out_index_[i], out_index_[i+1]).
+    const uint32_t* out_index_;
+    const SrsUrlOutput* outputs_;
+    uint32_t nn_rules_;
+    uint32_t nn_states_;
+    uint32_t nn_classes_;
+    uint32_t nn_outputs_;
+    // The class of each byte in URL, the anchors and the corrupt classes are 0.
+    uint16_t url_classes_[256];
+    // The tables when compiled, empty if decoded.
+    std::vector<uint16_t> classes_buffer_;
+    std::vector<uint16_t> rules_buffer_;
+    std::vector<uint32_t> delta_buffer_;
+    std::vector<uint32_t> out_index_buffer_;
+    std::vector<SrsUrlOutput> outputs_buffer_;
+    // The rules to compile.
+    std::vector<std::vector<std::string> > pieces_;
+    // Whether the tables are in the decoded data, which is read-only.
+    bool mapped_;
+public:
+    SrsUrlMatcher();
+    virtual ~SrsUrlMatcher();
+public:
+    // Add a rule, see srs_url_rule_parse, which takes effect after compile.
+    // @remark Never add rule to the decoded matcher, which is read-only.
+    virtual srs_error_t add(std::string rule);
+    // Build the automaton of all rules.
+    virtual void compile();
+    // Append the compiled rules to data, in the binary format, the size is aligned to 8 bytes.
+    virtual void encode(std::string& data);
+    // Use the rules in data, which should be aligned to 8 bytes, and alive until the matcher is freed.
+    // @param pnread The bytes of rules in data.
+    virtual srs_error_t decode(const char* data, size_t size, size_t* pnread);
+    // Whether the path and query matches any rule.
+    // @param url The path with query, for example, "/ads/banner.js?id=1".
+    virtual bool match(const std::string& url);
+    // The number of rules.
+    virtual int size();
+    // The number of states of automaton.
+    virtual int states();
+    // The bytes of memory used by the rules.
+    virtual size_t memory();
+private:
+    void update_url_classes();
+    // Handle the outputs of state, the URL ends at pos.
+    // @return Whether any rule is matched.
+    bool on_outputs(uint32_t state, uint32_t pos, std::vector<SrsUrlProgress>& progresses);
+};
+
+#endif
@@ -95,6 +95,12 @@
 #define ERROR_CLS_INVALID_CONFIG            1085
 #define ERROR_CLS_EXCEED_SIZE               1086
 #define ERROR_SOCKET_PEEK                   1087
+#define ERROR_GPERF_DISABLED                1088
+#define ERROR_GPERF_BUSY                    1089
+#define ERROR_GPERF_PROFILER                1090
+#define ERROR_SYSTEM_FILE_MMAP              1091
+#define ERROR_POLICY_DATABASE               1092
+#define ERROR_DISK_CACHE                    1093
 
 ///////////////////////////////////////////////////////
 // RTMP protocol error.
@@ -1,6 +1,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 
 #include <srs_kernel_file.hpp>
 #include <srs_kernel_log.hpp>
@@ -266,4 +267,67 @@ srs_error_t SrsFileReader::lseek(off_t offset, int whence, off_t* seeked)
     return srs_success;
 }
 
+SrsFileMmap::SrsFileMmap()
+{
+    data_ = NULL;
+    size_ = 0;
+}
+
+SrsFileMmap::~SrsFileMmap()
+{
+    close();
+}
+
+srs_error_t SrsFileMmap::open(string p)
+{
+    srs_error_t err = srs_success;
+
+    if (data_) {
+        return srs_error_new(ERROR_SYSTEM_FILE_ALREADY_OPENED, "file %s already opened", path.c_str());
+    }
+
+    int fd = ::open(p.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return srs_error_new(ERROR_SYSTEM_FILE_OPENE, "open file %s failed", p.c_str());
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || st.st_size <= 0) {
+        ::close(fd);
+        return srs_error_new(ERROR_SYSTEM_FILE_READ, "invalid file %s", p.c_str());
+    }
 
+    // The map is still valid after the fd is closed.
+    void* data = ::mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return srs_error_new(ERROR_SYSTEM_FILE_MMAP, "mmap file %s, size=%d", p.c_str(), (int)st.st_size);
+    }
+
+    path = p;
+    data_ = (char*)data;
+    size_ = (size_t)st.st_size;
+
+    return err;
+}
+
+void SrsFileMmap::close()
+{
+    if (!data_) {
+        return;
+    }
+
+    ::munmap(data_, size_);
+    data_ = NULL;
+    size_ = 0;
+}
+
+const char* SrsFileMmap::data()
+{
+    return data_;
+}
+
+size_t SrsFileMmap::size()
+{
+    return size_;
+}
@@ -80,6 +80,28 @@ public:
     virtual srs_error_t lseek(off_t offset, int whence, off_t* seeked);
 };
 
+/**
+ * The read-only memory map of file, the pages are shared by processes and backed by the page cache,
+ * so it's loaded instantly and never uses the heap.
+ * @remark Never truncate or write the file in place, replace it by rename instead.
+ */
+class SrsFileMmap
+{
+private:
+    std::string path;
+    char* data_;
+    size_t size_;
+public:
+    SrsFileMmap();
+    virtual ~SrsFileMmap();
+public:
+    virtual srs_error_t open(std::string p);
+    virtual void close();
+public:
+    virtual const char* data();
+    virtual size_t size();
+};
+
 // For utest to mock it.
 typedef int (*srs_open_t)(const char* path, int oflag, ...);
 typedef ssize_t (*srs_write_t)(int fildes, const void* buf, size_t nbyte);
@@ -10,6 +10,14 @@ ISrsReader::~ISrsReader()
 
 }
 
+ISrsVectorReader::ISrsVectorReader()
+{
+}
+
+ISrsVectorReader::~ISrsVectorReader()
+{
+}
+
 ISrsSeeker::ISrsSeeker()
 {
 }
@@ -13,6 +13,23 @@ public:
     virtual srs_error_t read(void* buf, size_t size, ssize_t* nread) = 0;
 };
 
+/**
+ * The vector reader to read from channel to vector(iovc).
+ */
+class ISrsVectorReader
+{
+public:
+    ISrsVectorReader();
+    virtual ~ISrsVectorReader();
+public:
+    /**
+     * read to iov from reader, fill the next iov only when the previous one is full.
+     * @nread the actual read bytes. NULL to ignore.
+     * @remark for the ring buffer, to read into the free space at the end and start of buffer.
+     */
+    virtual srs_error_t readv(const iovec *iov, int iov_size, ssize_t* nread) = 0;
+};
+
 /**
  * The seeker to seek with a device.
  */
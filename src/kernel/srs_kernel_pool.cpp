@@ -0,0 +1,254 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#include <srs_kernel_pool.hpp>
+
+#include <new>
+using namespace std;
+
+static bool _srs_pool_enabled = true;
+
+SrsObjectPool::SrsObjectPool(string name, size_t size, int max_cached)
+{
+    name_ = name;
+    // The free object holds the pointer to next one.
+    size_ = size > sizeof(void*) ? size : sizeof(void*);
+    max_cached_ = max_cached;
+    free_ = NULL;
+    nn_cached_ = 0;
+
+    nn_used_ = 0;
+    nn_allocs_ = 0;
+    nn_reuses_ = 0;
+
+    pools().push_back(this);
+}
+
+SrsObjectPool::~SrsObjectPool()
+{
+    shrink();
+
+    vector<SrsObjectPool*>& all = pools();
+    for (vector<SrsObjectPool*>::iterator it = all.begin(); it != all.end(); ++it) {
+        if (*it == this) {
+            all.erase(it);
+            break;
+        }
+    }
+}
+
+void* SrsObjectPool::alloc(size_t size)
+{
+    // The subclass is larger, which is never pooled.
+    if (size > size_) {
+        return ::operator new(size);
+    }
+
+    nn_used_++;
+    nn_allocs_++;
+
+    if (free_) {
+        void* p = free_;
+        free_ = *(void**)p;
+        nn_cached_--;
+        nn_reuses_++;
+        return p;
+    }
+
+    return ::operator new(size_);
+}
+
+void SrsObjectPool::free(void* p, size_t size)
+{
+    if (!p) {
+        return;
+    }
+
+    if (size > size_) {
+        ::operator delete(p);
+        return;
+    }
+
+    nn_used_--;
+
+    if (!_srs_pool_enabled || nn_cached_ >= max_cached_) {
+        ::operator delete(p);
+        return;
+    }
+
+    *(void**)p = free_;
+    free_ = p;
+    nn_cached_++;
+}
+
+void SrsObjectPool::shrink()
+{
+    while (free_) {
+        void* p = free_;
+        free_ = *(void**)p;
+        ::operator delete(p);
+    }
+    nn_cached_ = 0;
+}
+
+string SrsObjectPool::name()
+{
+    return name_;
+}
+
+size_t SrsObjectPool::size()
+{
+    return size_;
+}
+
+int SrsObjectPool::used()
+{
+    return nn_used_;
+}
+
+int SrsObjectPool::cached()
+{
+    return nn_cached_;
+}
+
+uint64_t SrsObjectPool::nn_allocs()
+{
+    return nn_allocs_;
+}
+
+uint64_t SrsObjectPool::nn_reuses()
+{
+    return nn_reuses_;
+}
+
+void SrsObjectPool::set_enabled(bool v)
+{
+    _srs_pool_enabled = v;
+
+    if (!v) {
+        vector<SrsObjectPool*>& all = pools();
+        for (int i = 0; i < (int)all.size(); i++) {
+            all.at(i)->shrink();
+        }
+    }
+}
+
+vector<SrsObjectPool*>& SrsObjectPool::pools()
+{
+    // Never free it, because the pools are used by the global objects, when they are freed at exit.
+    static vector<SrsObjectPool*>* all = new vector<SrsObjectPool*>();
+    return *all;
+}
+
+struct SrsArenaBlock
+{
+    SrsArenaBlock* next;
+};
+
+// The buffers are aligned as operator new, and the data of block follows the header.
+#define SRS_ARENA_ALIGN 16
+#define SRS_ARENA_HEADER ((sizeof(SrsArenaBlock) + SRS_ARENA_ALIGN - 1) & ~(size_t)(SRS_ARENA_ALIGN - 1))
+
+static SrsArenaBlock* srs_arena_block_new(size_t size, SrsArenaBlock* next)
+{
+    SrsArenaBlock* block = (SrsArenaBlock*)::operator new(SRS_ARENA_HEADER + size);
+    block->next = next;
+    return block;
+}
+
+static char* srs_arena_block_data(SrsArenaBlock* block)
+{
+    return (char*)block + SRS_ARENA_HEADER;
+}
+
+uint64_t SrsArena::nn_resets_ = 0;
+uint64_t SrsArena::nn_blocks_ = 0;
+
+SrsArena::SrsArena(size_t block_size)
+{
+    block_size_ = block_size;
+    head_ = large_ = NULL;
+    pos_ = end_ = NULL;
+    used_ = 0;
+}
+
+SrsArena::~SrsArena()
+{
+    release();
+}
+
+void* SrsArena::alloc(size_t size)
+{
+    size = (size + SRS_ARENA_ALIGN - 1) & ~(size_t)(SRS_ARENA_ALIGN - 1);
+    used_ += size;
+
+    // The large buffer uses its own block, so the current block is not wasted.
+    if (size > block_size_) {
+        large_ = srs_arena_block_new(size, large_);
+        nn_blocks_++;
+        return srs_arena_block_data(large_);
+    }
+
+    if (!head_ || pos_ + size > end_) {
+        head_ = srs_arena_block_new(block_size_, head_);
+        pos_ = srs_arena_block_data(head_);
+        end_ = pos_ + block_size_;
+        nn_blocks_++;
+    }
+
+    void* p = pos_;
+    pos_ += size;
+    return p;
+}
+
+void SrsArena::reset()
+{
+    while (large_) {
+        SrsArenaBlock* block = large_;
+        large_ = block->next;
+        ::operator delete(block);
+    }
+
+    while (head_ && head_->next) {
+        SrsArenaBlock* block = head_;
+        head_ = block->next;
+        ::operator delete(block);
+    }
+
+    if (head_) {
+        pos_ = srs_arena_block_data(head_);
+        end_ = pos_ + block_size_;
+    }
+    used_ = 0;
+    nn_resets_++;
+}
+
+void SrsArena::release()
+{
+    reset();
+
+    if (head_) {
+        ::operator delete(head_);
+        head_ = NULL;
+        pos_ = end_ = NULL;
+    }
+}
+
+size_t SrsArena::used()
+{
+    return used_;
+}
+
+uint64_t SrsArena::nn_resets()
+{
+    return nn_resets_;
+}
+
+uint64_t SrsArena::nn_blocks()
+{
+    return nn_blocks_;
+}
+
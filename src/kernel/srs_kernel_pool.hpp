@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2013-2022 The SRS Authors
+//
+// SPDX-License-Identifier: MIT or MulanPSL-2.0
+//
+
+#ifndef SRS_KERNEL_POOL_HPP
+#define SRS_KERNEL_POOL_HPP
+
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+
+// The max number of free objects kept by a pool, the others are returned to heap.
+#define SRS_POOL_MAX_CACHED 1024
+// The default block size of arena, which fits the buffers to read the request and response body.
+#define SRS_ARENA_BLOCK_SIZE 8192
+
+// The free list of objects of a type, so the objects created and freed for each request are reused, rather
+// than allocated from heap, which fragments badly when the small objects are freed in a different order.
+// @remark Not thread-safe, the objects must be created and freed by the ST thread of worker.
+// @remark The object of a subclass, which is larger, is allocated from heap.
+class SrsObjectPool
+{
+private:
+    std::string name_;
+    size_t size_;
+    int max_cached_;
+    // The free objects, each links to the next one by its first bytes.
+    void* free_;
+    int nn_cached_;
+private:
+    int nn_used_;
+    uint64_t nn_allocs_;
+    uint64_t nn_reuses_;
+public:
+    SrsObjectPool(std::string name, size_t size, int max_cached);
+    virtual ~SrsObjectPool();
+public:
+    virtual void* alloc(size_t size);
+    virtual void free(void* p, size_t size);
+    // Return all free objects to heap.
+    virtual void shrink();
+public:
+    virtual std::string name();
+    virtual size_t size();
+    // The number of objects in use, and kept in free list.
+    virtual int used();
+    virtual int cached();
+    virtual uint64_t nn_allocs();
+    virtual uint64_t nn_reuses();
+public:
+    // Disable all pools, for example, to check memory by valgrind, the free objects are returned to heap.
+    static void set_enabled(bool v);
+    // All pools, which live until the process exits.
+    static std::vector<SrsObjectPool*>& pools();
+};
+
+// Allocate the objects of class from pool, for example:
+//      class SrsHttpHeader {
+//          SRS_DECLARE_POOL();
+//      ...
+//      SRS_IMPLEMENT_POOL(SrsHttpHeader);
+// @remark The macro changes the access to public.
+#define SRS_DECLARE_POOL() \
+    public: \
+        static void* operator new(size_t size); \
+        static void operator delete(void* p, size_t size)
+#define SRS_IMPLEMENT_POOL(T) \
+    static SrsObjectPool* _srs_pool_##T() { \
+        static SrsObjectPool* pool = new SrsObjectPool(#T, sizeof(T), SRS_POOL_MAX_CACHED); \
+        return pool; \
+    } \
+    void* T::operator new(size_t size) { return _srs_pool_##T()->alloc(size); } \
+    void T::operator delete(void* p, size_t size) { _srs_pool_##T()->free(p, size); }
+
+struct SrsArenaBlock;
+
+// The bump allocator for the buffers of a transaction, which are never freed one by one, but all at once when
+// the transaction is done. The first block is kept for the next transaction, so there is no heap allocation
+// for a normal transaction.
+// @remark The coroutine which owns the arena should reset it, when the buffers are not used.
+class SrsArena
+{
+private:
+    size_t block_size_;
+    // The blocks in use, the head is the current one, the first block is the tail.
+    SrsArenaBlock* head_;
+    // The blocks for the buffers larger than block size.
+    SrsArenaBlock* large_;
+    char* pos_;
+    char* end_;
+    size_t used_;
+private:
+    static uint64_t nn_resets_;
+    static uint64_t nn_blocks_;
+public:
+    SrsArena(size_t block_size = SRS_ARENA_BLOCK_SIZE);
+    virtual ~SrsArena();
+public:
+    // Allocate the aligned buffer, which is valid until reset.
+    virtual void* alloc(size_t size);
+    // Free all buffers, keep the first block.
+    virtual void reset();
+    // Free all buffers and blocks, for example, when connection is idle.
+    virtual void release();
+    // The bytes allocated since reset.
+    virtual size_t used();
+public:
+    // The number of resets and blocks allocated from heap, of all arenas.
+    static uint64_t nn_resets();
+    static uint64_t nn_blocks();
+};
+
+#endif
+
@@ -3,6 +3,7 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <time.h>
 #endif
 
 #include <inttypes.h>
@@ -87,6 +88,17 @@ srs_utime_t srs_update_system_time()
     return _srs_system_time_us_cache;
 }
 
+srs_utime_t srs_get_monotonic_time()
+{
+    // The CLOCK_MONOTONIC is served by vDSO, which is cheap enough for per-request timing.
+    timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+        return -1;
+    }
+
+    return ((int64_t)now.tv_sec) * 1000 * 1000 + (int64_t)now.tv_nsec / 1000;
+}
+
 string srs_string_replace(string str, string old_str, string new_str)
 {
     std::string ret = str;
@@ -110,6 +122,34 @@ bool srs_string_ends_with(string str, string flag)
     return (pos != string::npos) && (pos == str.length() - flag.length());
 }
 
+bool srs_string_starts_with(string str, string flag)
+{
+    return str.compare(0, flag.length(), flag) == 0;
+}
+
+string srs_string_trim_start(string str, string trim_chars)
+{
+    size_t pos = str.find_first_not_of(trim_chars);
+    return (pos == string::npos) ? "" : str.substr(pos);
+}
+
+string srs_string_trim_end(string str, string trim_chars)
+{
+    size_t pos = str.find_last_not_of(trim_chars);
+    return (pos == string::npos) ? "" : str.substr(0, pos + 1);
+}
+
+string srs_string_to_lower(string str)
+{
+    for (size_t i = 0; i < str.length(); i++) {
+        char c = str.at(i);
+        if (c >= 'A' && c <= 'Z') {
+            str.at(i) = c + 'a' - 'A';
+        }
+    }
+    return str;
+}
+
 string srs_int2str(int64_t value)
 {
     // len(max int64_t) is 20, plus one "+-."
@@ -14,6 +14,10 @@ extern srs_utime_t srs_get_system_startup_time();
 
 extern srs_utime_t srs_update_system_time();
 
+// Get the monotonic time in srs_utime_t, without cache, for measuring short intervals.
+// @remark It's not the wall clock, only the diff of two values makes sense.
+extern srs_utime_t srs_get_monotonic_time();
+
 // The "ANY" address to listen, it's "0.0.0.0" for ipv4, and "::" for ipv6.
 // @remark We prefer ipv4, only use ipv6 if ipv4 is disabled.
 extern std::string srs_any_address_for_listener();
@@ -25,6 +29,12 @@ extern void srs_parse_endpoint(std::string hostport, std::string& ip, int& port)
 // Replace old_str to new_str of str
 extern std::string srs_string_replace(std::string str, std::string old_str, std::string new_str);
 extern bool srs_string_ends_with(std::string str, std::string flag);
+extern bool srs_string_starts_with(std::string str, std::string flag);
+// Trim the chars in trim_chars at the start or end of str.
+extern std::string srs_string_trim_start(std::string str, std::string trim_chars);
+extern std::string srs_string_trim_end(std::string str, std::string trim_chars);
+// Convert the ASCII letters to lowercase.
+extern std::string srs_string_to_lower(std::string str);
 
 // Parse the int64 value to string.
 extern std::string srs_int2str(int64_t value);
@@ -6,6 +6,13 @@
 
 #include <srs_protocol_conn.hpp>
 
+SrsResourceNode::SrsResourceNode()
+{
+    list = NULL;
+    prev = next = NULL;
+    fast_id = 0;
+}
+
 ISrsResource::ISrsResource()
 {
 }
@@ -11,9 +11,32 @@
 
 #include <string>
 
+class ISrsResource;
+
+// The intrusive node of resource, which is only touched by the manager,
+// so the manager is able to add, remove and find the resource in O(1).
+// @remark A resource is able to be managed by one manager at most.
+class SrsResourceNode
+{
+public:
+    // The list which the resource is in, NULL if not in any list.
+    void* list;
+    ISrsResource* prev;
+    ISrsResource* next;
+    // The index keys of resource, to remove from the index without search.
+    std::string id;
+    std::string name;
+    uint64_t fast_id;
+public:
+    SrsResourceNode();
+};
+
 // The resource managed by ISrsResourceManager.
 class ISrsResource
 {
+public:
+    // Only for the manager.
+    SrsResourceNode manager_node;
 public:
     ISrsResource();
     virtual ~ISrsResource();
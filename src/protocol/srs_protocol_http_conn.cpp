@@ -12,7 +12,9 @@ using std::vector;
 SrsHttpParser::SrsHttpParser()
 {
     buffer = new SrsFastStream();
+    buffer->set_ring(true);
     header = NULL;
+    arena_ = NULL;
 
     p_body_start = p_header_tail = NULL;
     type_ = HTTP_REQUEST;
@@ -52,6 +54,11 @@ void SrsHttpParser::set_jsonp(bool allow_jsonp)
     jsonp = allow_jsonp;
 }
 
+void SrsHttpParser::set_arena(SrsArena* arena)
+{
+    arena_ = arena;
+}
+
 srs_error_t SrsHttpParser::parse_message(ISrsReader* reader, ISrsHttpMessage** ppmsg)
 {
     srs_error_t err = srs_success;
@@ -91,6 +98,7 @@ srs_error_t SrsHttpParser::parse_message(ISrsReader* reader, ISrsHttpMessage** p
     
     // create msg
     SrsHttpMessage* msg = new SrsHttpMessage(reader, buffer);
+    msg->set_arena(arena_);
 
     // Initialize the basic information.
 
@@ -114,12 +122,30 @@ srs_error_t SrsHttpParser::parse_message(ISrsReader* reader, ISrsHttpMessage** p
     return err;
 }
 
+int SrsHttpParser::buffered()
+{
+    return buffer->total_size();
+}
+
+void SrsHttpParser::release()
+{
+    buffer->shrink();
+    srs_freep(header);
+
+    // The capacity of string is never freed by assign.
+    std::string().swap(field_name);
+    std::string().swap(field_value);
+    std::string().swap(url);
+}
+
 srs_error_t SrsHttpParser::parse_message_imp(ISrsReader* reader)
 {
     srs_error_t err = srs_success;
     
     while (true) {
         if (buffer->size() > 0) {
+            // The header should be contiguous to discover its length, so never parse it at the wrap point.
+            buffer->linearize();
             ssize_t consumed = http_parser_execute(&parser, &settings, buffer->bytes(), buffer->size());
             // The error is set in http_errno.
             enum http_errno code;
@@ -298,6 +324,8 @@ int SrsHttpParser::on_body(http_parser* parser, const char* at, size_t length)
     return 0;
 }
 
+SRS_IMPLEMENT_POOL(SrsHttpResponseReader);
+
 SrsHttpResponseReader::SrsHttpResponseReader(SrsHttpMessage* msg, ISrsReader* reader, SrsFastStream* body)
 {
     skt = reader;
@@ -486,10 +514,185 @@ srs_error_t SrsHttpResponseReader::read_specified(void* data, size_t nb_data, ss
     return err;
 }
 
+// The pools of relay buffers, of each size from SRS_HTTP_READ_CACHE_BYTES to SRS_HTTP_RELAY_MAX_BYTES.
+static SrsObjectPool* srs_http_relay_pool(int size)
+{
+    static SrsObjectPool* pools[5] = {NULL};
+
+    int i = 0;
+    while ((SRS_HTTP_READ_CACHE_BYTES << i) < size) {
+        i++;
+    }
+    srs_assert(i < (int)(sizeof(pools) / sizeof(pools[0])));
+
+    if (!pools[i]) {
+        char name[32];
+        snprintf(name, sizeof(name), "SrsHttpBodyRelay%dKB", (SRS_HTTP_READ_CACHE_BYTES << i) / 1024);
+        pools[i] = new SrsObjectPool(name, SRS_HTTP_READ_CACHE_BYTES << i, SRS_HTTP_RELAY_MAX_CACHED);
+    }
+    return pools[i];
+}
+
+SrsHttpBodyRelay::SrsHttpBodyRelay()
+{
+    size_ = SRS_HTTP_READ_CACHE_BYTES;
+    buf_ = NULL;
+    grow_ = false;
+    header_ = NULL;
+    nn_header_ = 0;
+}
+
+SrsHttpBodyRelay::~SrsHttpBodyRelay()
+{
+    if (buf_) {
+        srs_http_relay_pool(size_)->free(buf_, size_);
+    }
+}
+
+srs_error_t SrsHttpBodyRelay::read(ISrsHttpResponseReader* body, char** pdata, int* psize)
+{
+    srs_error_t err = srs_success;
+
+    *pdata = NULL;
+    *psize = 0;
+
+    if (grow_ && buf_) {
+        srs_http_relay_pool(size_)->free(buf_, size_);
+        size_ *= 2;
+        buf_ = NULL;
+    }
+    grow_ = false;
+
+    if (!buf_) {
+        buf_ = (char*)srs_http_relay_pool(size_)->alloc(size_);
+    }
+
+    // The reader may read nothing, for example, the end of chunk.
+    while (!body->eof()) {
+        ssize_t nread = 0;
+        if ((err = body->read(buf_, size_, &nread)) != srs_success) {
+            int code = srs_error_code(err);
+            if (code == ERROR_SYSTEM_FILE_EOF || code == ERROR_HTTP_RESPONSE_EOF || code == ERROR_HTTP_REQUEST_EOF
+                || code == ERROR_HTTP_STREAM_EOF
+            ) {
+                srs_freep(err);
+                return err;
+            }
+            return srs_error_wrap(err, "read body");
+        }
+
+        if (nread > 0) {
+            *pdata = buf_;
+            *psize = (int)nread;
+            grow_ = (nread == size_ && size_ < SRS_HTTP_RELAY_MAX_BYTES);
+            return err;
+        }
+    }
+
+    return err;
+}
+
+void SrsHttpBodyRelay::set_header(const char* data, int size)
+{
+    header_ = data;
+    nn_header_ = size;
+}
+
+srs_error_t SrsHttpBodyRelay::flush(ISrsWriter* out)
+{
+    srs_error_t err = srs_success;
+
+    if (nn_header_ && (err = out->write((void*)header_, nn_header_, NULL)) != srs_success) {
+        return srs_error_wrap(err, "write header %d", nn_header_);
+    }
+
+    header_ = NULL;
+    nn_header_ = 0;
+
+    return err;
+}
+
+srs_error_t SrsHttpBodyRelay::write(ISrsWriter* out, char* data, int size, bool chunked)
+{
+    srs_error_t err = srs_success;
+
+    // The header, chunk header, data and CRLF.
+    iovec iovs[4];
+    int nn_iovs = 0;
+
+    if (nn_header_) {
+        iovs[nn_iovs].iov_base = (char*)header_;
+        iovs[nn_iovs++].iov_len = nn_header_;
+    }
+
+    if (chunked) {
+        iovs[nn_iovs].iov_base = chunk_header_;
+        iovs[nn_iovs++].iov_len = snprintf(chunk_header_, sizeof(chunk_header_), "%x" SRS_HTTP_CRLF, size);
+    }
+
+    iovs[nn_iovs].iov_base = data;
+    iovs[nn_iovs++].iov_len = size;
+
+    if (chunked) {
+        iovs[nn_iovs].iov_base = (char*)SRS_HTTP_CRLF;
+        iovs[nn_iovs++].iov_len = 2;
+    }
+
+    if (nn_iovs == 1) {
+        err = out->write(data, size, NULL);
+    } else {
+        err = out->writev(iovs, nn_iovs, NULL);
+    }
+    if (err != srs_success) {
+        return srs_error_wrap(err, "write body %d, header %d, chunked %d", size, nn_header_, chunked);
+    }
+
+    header_ = NULL;
+    nn_header_ = 0;
+
+    return err;
+}
+
+srs_error_t SrsHttpBodyRelay::finish(ISrsWriter* out, bool chunked)
+{
+    srs_error_t err = srs_success;
+
+    iovec iovs[2];
+    int nn_iovs = 0;
+
+    if (nn_header_) {
+        iovs[nn_iovs].iov_base = (char*)header_;
+        iovs[nn_iovs++].iov_len = nn_header_;
+    }
+
+    if (chunked) {
+        iovs[nn_iovs].iov_base = (char*)"0" SRS_HTTP_CRLFCRLF;
+        iovs[nn_iovs++].iov_len = 5;
+    }
+
+    if (nn_iovs && (err = out->writev(iovs, nn_iovs, NULL)) != srs_success) {
+        return srs_error_wrap(err, "write header %d, chunked %d", nn_header_, chunked);
+    }
+
+    header_ = NULL;
+    nn_header_ = 0;
+
+    return err;
+}
+
+int SrsHttpBodyRelay::size()
+{
+    return size_;
+}
+
+SRS_IMPLEMENT_POOL(SrsHttpMessage);
+
 SrsHttpMessage::SrsHttpMessage(ISrsReader* reader, SrsFastStream* buffer) : ISrsHttpMessage()
 {
     // owner_conn = NULL;
     chunked = false;
+    arena_ = NULL;
+    scratch_ = NULL;
     _uri = new SrsHttpUri();
     _body = new SrsHttpResponseReader(this, reader, buffer);
 
@@ -632,6 +835,11 @@ void SrsHttpMessage::set_connection(ISrsConnection* conn)
     owner_conn = conn;
 }
 
+void SrsHttpMessage::set_arena(SrsArena* arena)
+{
+    arena_ = arena;
+}
+
 string SrsHttpMessage::url()
 {
     return _uri->get_url();
@@ -727,8 +935,13 @@ srs_error_t SrsHttpMessage::body_read_all(string& body)
 
 srs_error_t SrsHttpMessage::body_read_part(string& body, int read_size, int& finish)
 {
+    // The buffer to read is allocated once for the message, rather than for each part.
+    if (arena_ && !scratch_) {
+        scratch_ = (char*)arena_->alloc(SRS_HTTP_READ_CACHE_BYTES);
+    }
+
     //process Transfer-Encoding: Trunked
-    return srs_ioutil_read_part(_body, body, read_size, finish);
+    return srs_ioutil_read_part(_body, body, read_size, finish, scratch_);
 }
 
 ISrsHttpResponseReader* SrsHttpMessage::body_reader()
@@ -12,6 +12,10 @@
 // The http chunked header size,
 // for writev, there always one chunk to send it.
 #define SRS_HTTP_HEADER_CACHE_SIZE 64
+// The max size of buffer to relay body, which grows from SRS_HTTP_READ_CACHE_BYTES when the buffer is full.
+#define SRS_HTTP_RELAY_MAX_BYTES 65536
+// The max number of free buffers kept by the pool of each size.
+#define SRS_HTTP_RELAY_MAX_CACHED 64
 
 class SrsHttpResponseReader;
 
@@ -25,6 +29,8 @@ private:
     SrsFastStream* buffer;
     // Whether allow jsonp parse.
     bool jsonp;    
+    // The arena of transaction for the messages, which is reset by the owner.
+    SrsArena* arena_;
 private:
     std::string field_name;
     std::string field_value;
@@ -46,12 +52,19 @@ public:
     virtual srs_error_t initialize(enum http_parser_type type);
     // Whether allow jsonp parser, which indicates the method in query string.
     virtual void set_jsonp(bool allow_jsonp);
+    // Allocate the buffers of messages from arena, which should be valid until the messages are freed.
+    virtual void set_arena(SrsArena* arena);
     // always parse a http message,
     // that is, the *ppmsg always NOT-NULL when return success.
     // or error and *ppmsg must be NULL.
     // @remark, if success, *ppmsg always NOT-NULL, *ppmsg always is_complete().
     // @remark user must free the ppmsg if not NULL.
     virtual srs_error_t parse_message(ISrsReader* reader, ISrsHttpMessage** ppmsg);
+    // The bytes read but not parsed, for example, the pipelined request.
+    virtual int buffered();
+    // Free the buffers when connection is idle, which are allocated again by next message.
+    // @remark The messages should be freed, and the bytes not parsed are kept.
+    virtual void release();
 private:
     // parse the HTTP message to member field: msg.
     virtual srs_error_t parse_message_imp(ISrsReader* reader);
@@ -67,6 +80,7 @@ private:
 
 class SrsHttpMessage : public ISrsHttpMessage
 {
+    SRS_DECLARE_POOL();
 private:
     // The body object, reader object.
     // @remark, user can get body in string by get_body().
@@ -74,6 +88,9 @@ private:
     // Use a buffer to read and send ts file.
     // The transport connection, can be NULL.
     ISrsConnection* owner_conn;
+    // The arena of transaction, and the buffer to read body from it, can be NULL.
+    SrsArena* arena_;
+    char* scratch_;
 private:
     // The request type defined as
     //      enum http_parser_type { HTTP_REQUEST, HTTP_RESPONSE, HTTP_BOTH };
@@ -128,6 +145,7 @@ public:
     virtual void set_https(bool v);
 public:
     virtual void set_connection(ISrsConnection* conn);
+    virtual void set_arena(SrsArena* arena);
 public:
     // The schema, http or https.
     virtual std::string schema();
@@ -227,6 +245,7 @@ public:
 
 class SrsHttpResponseReader : public ISrsHttpResponseReader
 {
+    SRS_DECLARE_POOL();
 private:
     ISrsReader* skt;
     SrsHttpMessage* owner;
@@ -253,4 +272,49 @@ private:
     virtual srs_error_t read_specified(void* buf, size_t size, ssize_t* nread);
 };
 
+// Relay the body from reader to writer, read into a buffer from pool and write it out, without allocation and copy
+// for each part. The buffer grows by twice when filled by a read, up to SRS_HTTP_RELAY_MAX_BYTES.
+// For example:
+//      SrsHttpBodyRelay relay;
+//      relay.set_header(header.data(), header.size());
+//      if (!parser->buffered()) {
+//          err = relay.flush(skt);
+//      }
+//      char* data = NULL; int size = 0;
+//      while ((err = relay.read(msg->body_reader(), &data, &size)) == srs_success && size > 0) {
+//          err = relay.write(skt, data, size, msg->is_chunked());
+//      }
+//      err = relay.finish(skt, msg->is_chunked());
+class SrsHttpBodyRelay
+{
+private:
+    char* buf_;
+    int size_;
+    // Whether grow the buffer at next read, because the data of last read is in it.
+    bool grow_;
+    // The chunk header to write, the size in hex and CRLF.
+    char chunk_header_[SRS_HTTP_HEADER_CACHE_SIZE];
+    // The header of message not written, which is written with the first part of body.
+    const char* header_;
+    int nn_header_;
+public:
+    SrsHttpBodyRelay();
+    virtual ~SrsHttpBodyRelay();
+public:
+    // Read the next part of body, the data is valid until next read. The size is 0 for EOF.
+    virtual srs_error_t read(ISrsHttpResponseReader* body, char** pdata, int* psize);
+    // Write the header of message with the first part of body, so there is only one syscall for each part.
+    // @remark The header should be valid until written.
+    virtual void set_header(const char* data, int size);
+    // Write the header if not written yet, for example, no body buffered, so the client never waits for the header
+    // until the upstream sends the body.
+    virtual srs_error_t flush(ISrsWriter* out);
+    // Write the part of body, and its chunk header and CRLF in one writev if chunked.
+    virtual srs_error_t write(ISrsWriter* out, char* data, int size, bool chunked);
+    // Write the header if not written yet, for example, no body, and the last chunk if chunked.
+    virtual srs_error_t finish(ISrsWriter* out, bool chunked);
+    // The size of buffer to read.
+    virtual int size();
+};
+
 #endif
\ No newline at end of file
@@ -480,6 +480,8 @@ ISrsHttpMessage::~ISrsHttpMessage()
 {
 }
 
+SRS_IMPLEMENT_POOL(SrsHttpUri);
+
 SrsHttpUri::SrsHttpUri()
 {
     port = 0;
@@ -665,6 +667,8 @@ srs_error_t SrsHttpUri::path_unescape(std::string s, std::string& value)
   return unescapse(s, value, encodePathSegment);
 }
 
+SRS_IMPLEMENT_POOL(SrsHttpHeader);
+
 SrsHttpHeader::SrsHttpHeader()
 {
 }
@@ -9,6 +9,7 @@
 #include <srs_core.hpp>
 #include <srs_kernel_io.hpp>
 #include <srs_kernel_utility.hpp>
+#include <srs_kernel_pool.hpp>
 
 using std::string;
 using std::map;
@@ -122,6 +123,7 @@ public:
 
 class SrsHttpHeader
 {
+    SRS_DECLARE_POOL();
 private:
     std::map<std::string, std::string> headers;
     std::vector<std::string> cookie_list;
@@ -238,6 +240,7 @@ public:
 // Used to resolve the http uri.
 class SrsHttpUri
 {
+    SRS_DECLARE_POOL();
 private:
     std::string url_;
     std::string schema;
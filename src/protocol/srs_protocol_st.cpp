@@ -4,6 +4,8 @@
 #include <st.h>
 #include <string.h>
 #include <arpa/inet.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <srs_protocol_st.hpp>
 #include <srs_protocol_async_dns.hpp>
 #include <srs_kernel_error.hpp>
@@ -11,10 +13,34 @@
 #include <srs_core.hpp>
 #include <srs_core_platform.hpp>
 #include <srs_core_auto_free.hpp>
+#include <srs_kernel_utility.hpp>
 // nginx also set to 512
 #define SERVER_LISTEN_BACKLOG 512
 extern SrsAsyncDns* _srs_dns_query;
 extern __thread int _st_num_free_stacks;
+
+// The head of ST thread and stack, must match _st_thread_t and _st_stack_t in 3rdparty/st-srs/common.h
+struct SrsStStackHead
+{
+    void* links[2];
+    char* vaddr;
+    int vaddr_size;
+    int stk_size;
+    char* stk_bottom;
+    char* stk_top;
+};
+
+struct SrsStThreadHead
+{
+    int state;
+    int flags;
+    void* start;
+    void* arg;
+    void* retval;
+    SrsStStackHead* stack;
+};
+
+static int _srs_coroutine_wait_key = -1;
 #ifdef __linux__
 #include <sys/epoll.h>
 
@@ -145,10 +171,11 @@ void srs_thread_interrupt(srs_thread_t thread)
 
 int srs_poll(struct pollfd *pds, int npds, srs_utime_t timeout)
 {
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitPoll, npds > 0 ? pds[0].fd : -1);
     return st_poll(pds, npds, timeout);
 }
 
-srs_error_t srs_tcp_connect(string server, int port, srs_utime_t tm, srs_netfd_t* pstfd)
+srs_error_t srs_tcp_connect(string server, int port, srs_utime_t tm, srs_netfd_t* pstfd, srs_utime_t* pdns)
 {
     st_utime_t timeout = ST_UTIME_NO_TIMEOUT;
     if (tm != SRS_UTIME_NO_TIMEOUT) {
@@ -163,7 +190,11 @@ srs_error_t srs_tcp_connect(string server, int port, srs_utime_t tm, srs_netfd_t
     server_addr.sin_port = htons(port);
     SrsAsyncDns* _srs_dns_query = new SrsAsyncDns();
     SrsAutoFree(SrsAsyncDns, _srs_dns_query);
+    srs_utime_t dns_starttime = srs_get_monotonic_time();
     _srs_dns_query->do_resolve(server, port, &server_addr);
+    if (pdns) {
+        *pdns = srs_get_monotonic_time() - dns_starttime;
+    }
     srs_trace("addr is %u", server_addr.sin_addr.s_addr);
     if(server_addr.sin_addr.s_addr == 0)
     {
@@ -195,6 +226,7 @@ srs_error_t srs_tcp_connect(string server, int port, srs_utime_t tm, srs_netfd_t
     //     return srs_error_new(ERROR_ST_CONNECT, "connect to %s:%d", server.c_str(), port);
     // }
 
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitConnect, sock);
     if (st_connect((st_netfd_t)stfd, (struct sockaddr *)&server_addr, sizeof(server_addr), timeout) == -1){
         srs_trace("connect failed, errmsg: %s", strerror(errno));
         srs_close_stfd(stfd);
@@ -290,16 +322,19 @@ srs_error_t srs_tcp_listen(std::string ip, int port, srs_netfd_t* pfd)
 
 srs_netfd_t srs_accept(srs_netfd_t stfd, struct sockaddr *addr, int *addrlen, srs_utime_t timeout)
 {
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitAccept, st_netfd_fileno((st_netfd_t)stfd));
     return (srs_netfd_t)st_accept((st_netfd_t)stfd, addr, addrlen, (st_utime_t)timeout);
 }
 
 ssize_t srs_read(srs_netfd_t stfd, void *buf, size_t nbyte, srs_utime_t timeout)
 {
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitRead, st_netfd_fileno((st_netfd_t)stfd));
     return st_read((st_netfd_t)stfd, buf, nbyte, (st_utime_t)timeout);
 }
 
 ssize_t srs_peek(srs_netfd_t stfd, void *buf, size_t nbyte, srs_utime_t timeout)
 {
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitRead, st_netfd_fileno((st_netfd_t)stfd));
     return st_peek((st_netfd_t)stfd, buf, nbyte, (st_utime_t)timeout);
 }
 
@@ -310,9 +345,79 @@ int srs_netfd_fileno(srs_netfd_t stfd)
 
 int srs_usleep(srs_utime_t usecs)
 {
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitSleep, -1);
     return st_usleep((st_utime_t)usecs);
 }
 
+void srs_thread_stack(srs_thread_t thread, char** pbottom, int* psize)
+{
+    SrsStStackHead* stack = thread ? ((SrsStThreadHead*)thread)->stack : NULL;
+
+    *pbottom = stack ? stack->stk_bottom : NULL;
+    *psize = stack ? stack->stk_size : 0;
+}
+
+int srs_thread_stack_guard(srs_thread_t thread)
+{
+    char* bottom = NULL;
+    int size = 0;
+    srs_thread_stack(thread, &bottom, &size);
+    if (!bottom) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The ST stack is mmapped with a redzone page below the bottom, so it's safe to protect it again.
+    static long pagesize = sysconf(_SC_PAGESIZE);
+    char* guard = (char*)((uintptr_t)bottom & ~(uintptr_t)(pagesize - 1)) - pagesize;
+    return mprotect(guard, pagesize, PROT_NONE);
+}
+
+const char* srs_coroutine_wait_name(int wait)
+{
+    switch (wait) {
+        case SrsCoroutineWaitRead: return "read";
+        case SrsCoroutineWaitWrite: return "write";
+        case SrsCoroutineWaitPoll: return "poll";
+        case SrsCoroutineWaitAccept: return "accept";
+        case SrsCoroutineWaitConnect: return "connect";
+        case SrsCoroutineWaitCond: return "cond";
+        case SrsCoroutineWaitLock: return "lock";
+        case SrsCoroutineWaitSleep: return "sleep";
+        default: return "none";
+    }
+}
+
+void srs_coroutine_wait_bind(SrsCoroutineWaitState* state)
+{
+    if (_srs_coroutine_wait_key < 0) {
+        int r0 = srs_key_create(&_srs_coroutine_wait_key, NULL);
+        srs_assert(r0 == 0);
+    }
+
+    int r0 = srs_thread_setspecific(_srs_coroutine_wait_key, state);
+    srs_assert(r0 == 0);
+}
+
+SrsCoroutineWaitScope::SrsCoroutineWaitScope(int wait, int fd)
+{
+    // No key means no coroutine is bound, so we never touch the ST before it's initialized.
+    state_ = (SrsCoroutineWaitState*)srs_thread_getspecific(_srs_coroutine_wait_key);
+    if (state_) {
+        state_->wait = wait;
+        state_->fd = fd;
+        state_->starttime = srs_get_monotonic_time();
+    }
+}
+
+SrsCoroutineWaitScope::~SrsCoroutineWaitScope()
+{
+    if (state_) {
+        state_->wait = SrsCoroutineWaitNone;
+        state_->fd = -1;
+    }
+}
+
 SrsStSocket::SrsStSocket()
 {
     init(NULL);
@@ -371,6 +476,7 @@ srs_error_t SrsStSocket::read(void* buf, size_t size, ssize_t* nread)
     srs_assert(stfd_);
 
     ssize_t nb_read;
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitRead, st_netfd_fileno((st_netfd_t)stfd_));
     if (rtm == SRS_UTIME_NO_TIMEOUT) {
         nb_read = st_read((st_netfd_t)stfd_, buf, size, ST_UTIME_NO_TIMEOUT);
     } else {
@@ -403,6 +509,42 @@ srs_error_t SrsStSocket::read(void* buf, size_t size, ssize_t* nread)
     return err;
 }
 
+srs_error_t SrsStSocket::readv(const iovec *iov, int iov_size, ssize_t* nread)
+{
+    srs_error_t err = srs_success;
+
+    srs_assert(stfd_);
+
+    ssize_t nb_read;
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitRead, st_netfd_fileno((st_netfd_t)stfd_));
+    if (rtm == SRS_UTIME_NO_TIMEOUT) {
+        nb_read = st_readv((st_netfd_t)stfd_, iov, iov_size, ST_UTIME_NO_TIMEOUT);
+    } else {
+        nb_read = st_readv((st_netfd_t)stfd_, iov, iov_size, rtm);
+    }
+
+    if (nread) {
+        *nread = nb_read;
+    }
+
+    // Same to read, 0 means the network connection is closed.
+    if (nb_read <= 0) {
+        if (nb_read < 0 && errno == ETIME) {
+            return srs_error_new(ERROR_SOCKET_TIMEOUT, "readv timeout %d ms", srsu2msi(rtm));
+        }
+
+        if (nb_read == 0) {
+            errno = ECONNRESET;
+        }
+
+        return srs_error_new(ERROR_SOCKET_READ, "readv error: %s", strerror(errno));
+    }
+
+    rbytes += nb_read;
+
+    return err;
+}
+
 srs_error_t SrsStSocket::read_fully(void* buf, size_t size, ssize_t* nread)
 {
     srs_error_t err = srs_success;
@@ -410,6 +552,7 @@ srs_error_t SrsStSocket::read_fully(void* buf, size_t size, ssize_t* nread)
     srs_assert(stfd_);
     
     ssize_t nb_read;
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitRead, st_netfd_fileno((st_netfd_t)stfd_));
     if (rtm == SRS_UTIME_NO_TIMEOUT) {
         nb_read = st_read_fully((st_netfd_t)stfd_, buf, size, ST_UTIME_NO_TIMEOUT);
     } else {
@@ -447,6 +590,7 @@ srs_error_t SrsStSocket::peek(void* buf, size_t size, ssize_t* nread)
     srs_assert(stfd_);
 
     ssize_t nb_read;
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitRead, st_netfd_fileno((st_netfd_t)stfd_));
     if (rtm == SRS_UTIME_NO_TIMEOUT) {
         nb_read = st_peek((st_netfd_t)stfd_, buf, size, ST_UTIME_NO_TIMEOUT);
     } else {
@@ -484,6 +628,7 @@ srs_error_t SrsStSocket::write(void* buf, size_t size, ssize_t* nwrite)
     srs_assert(stfd_);
     
     ssize_t nb_write;
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitWrite, st_netfd_fileno((st_netfd_t)stfd_));
     if (stm == SRS_UTIME_NO_TIMEOUT) {
         nb_write = st_write((st_netfd_t)stfd_, buf, size, ST_UTIME_NO_TIMEOUT);
     } else {
@@ -516,6 +661,7 @@ srs_error_t SrsStSocket::writev(const iovec *iov, int iov_size, ssize_t* nwrite)
     srs_assert(stfd_);
     
     ssize_t nb_write;
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitWrite, st_netfd_fileno((st_netfd_t)stfd_));
     if (stm == SRS_UTIME_NO_TIMEOUT) {
         nb_write = st_writev((st_netfd_t)stfd_, iov, iov_size, ST_UTIME_NO_TIMEOUT);
     } else {
@@ -553,11 +699,13 @@ int srs_cond_destroy(srs_cond_t cond)
 
 int srs_cond_wait(srs_cond_t cond)
 {
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitCond, -1);
     return st_cond_wait((st_cond_t)cond);
 }
 
 int srs_cond_timedwait(srs_cond_t cond, srs_utime_t timeout)
 {
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitCond, -1);
     return st_cond_timedwait((st_cond_t)cond, (st_utime_t)timeout);
 }
 
@@ -605,6 +753,7 @@ int srs_mutex_destroy(srs_mutex_t mutex)
 
 int srs_mutex_lock(srs_mutex_t mutex)
 {
+    SrsCoroutineWaitScope scope(SrsCoroutineWaitLock, -1);
     return st_mutex_lock((st_mutex_t)mutex);
 }
 
@@ -621,6 +770,8 @@ SrsTcpClient::SrsTcpClient(string h, int p, srs_utime_t tm)
     host = h;
     port = p;
     timeout = tm;
+    dns_elapsed_ = 0;
+    connect_elapsed_ = 0;
 }
 
 SrsTcpClient::~SrsTcpClient()
@@ -634,7 +785,10 @@ srs_error_t SrsTcpClient::connect()
     srs_error_t err = srs_success;
     
     srs_netfd_t stfd = NULL;
-    if ((err = srs_tcp_connect(host, port, timeout, &stfd)) != srs_success) {
+    srs_utime_t starttime = srs_get_monotonic_time();
+    err = srs_tcp_connect(host, port, timeout, &stfd, &dns_elapsed_);
+    connect_elapsed_ = srs_get_monotonic_time() - starttime - dns_elapsed_;
+    if (err != srs_success) {
         return srs_error_wrap(err, "tcp: connect %s:%d to=%dms", host.c_str(), port, srsu2msi(timeout));
     }
 
@@ -651,6 +805,16 @@ srs_error_t SrsTcpClient::connect()
 
     return err;
 }
+srs_utime_t SrsTcpClient::dns_elapsed()
+{
+    return dns_elapsed_;
+}
+
+srs_utime_t SrsTcpClient::connect_elapsed()
+{
+    return connect_elapsed_;
+}
+
 int SrsTcpClient::get_fd()
 {
     return srs_netfd_fileno(stfd_);
@@ -691,6 +855,11 @@ srs_error_t SrsTcpClient::read(void* buf, size_t size, ssize_t* nread)
     return io->read(buf, size, nread);
 }
 
+srs_error_t SrsTcpClient::readv(const iovec *iov, int iov_size, ssize_t* nread)
+{
+    return io->readv(iov, iov_size, nread);
+}
+
 srs_error_t SrsTcpClient::read_fully(void* buf, size_t size, ssize_t* nread)
 {
     return io->read_fully(buf, size, nread);
@@ -35,7 +35,8 @@ extern void srs_thread_interrupt(srs_thread_t thread);
 
 // For client, to open socket and connect to server.
 // @param tm The timeout in srs_utime_t.
-extern srs_error_t srs_tcp_connect(std::string server, int port, srs_utime_t tm, srs_netfd_t* pstfd);
+// @param pdns Output the elapsed time of DNS lookup, ignored if NULL.
+extern srs_error_t srs_tcp_connect(std::string server, int port, srs_utime_t tm, srs_netfd_t* pstfd, srs_utime_t* pdns = NULL);
 
 // Close the netfd, and close the underlayer fd.
 // @remark when close, user must ensure io completed.
@@ -81,6 +82,56 @@ extern int srs_netfd_fileno(srs_netfd_t stfd);
 
 extern int srs_usleep(srs_utime_t usecs);
 
+// Get the usable stack of coroutine, the stack grows down from pbottom + psize.
+extern void srs_thread_stack(srs_thread_t thread, char** pbottom, int* psize);
+
+// Protect the page below the stack of coroutine, so the stack overflow crashes immediately,
+// rather than corrupts the memory of others silently.
+// @return 0 if success, or -1 with errno.
+extern int srs_thread_stack_guard(srs_thread_t thread);
+
+// The blocking operation of coroutine, for introspection.
+enum SrsCoroutineWait
+{
+    SrsCoroutineWaitNone = 0,
+    SrsCoroutineWaitRead,
+    SrsCoroutineWaitWrite,
+    SrsCoroutineWaitPoll,
+    SrsCoroutineWaitAccept,
+    SrsCoroutineWaitConnect,
+    SrsCoroutineWaitCond,
+    SrsCoroutineWaitLock,
+    SrsCoroutineWaitSleep,
+};
+
+// Get the name of wait, for API and log.
+extern const char* srs_coroutine_wait_name(int wait);
+
+// The wait state of coroutine, updated by the blocking wrappers.
+struct SrsCoroutineWaitState
+{
+    // The blocking operation, see SrsCoroutineWait.
+    int wait;
+    // The fd of blocking operation, -1 if not about fd.
+    int fd;
+    // The monotonic time when starts waiting.
+    srs_utime_t starttime;
+};
+
+// Bind the wait state to current coroutine, NULL to unbind.
+// @remark The blocking wrappers ignore the coroutine which is not bound.
+extern void srs_coroutine_wait_bind(SrsCoroutineWaitState* state);
+
+// Mark current coroutine as waiting, until out of the scope.
+class SrsCoroutineWaitScope
+{
+private:
+    SrsCoroutineWaitState* state_;
+public:
+    SrsCoroutineWaitScope(int wait, int fd);
+    virtual ~SrsCoroutineWaitScope();
+};
+
 // The mutex locker.
 #define SrsLocker(instance) \
     impl__SrsLocker _SRS_free_##instance(&instance)
@@ -132,6 +183,7 @@ public:
     // @param nread, the actual read bytes, ignore if NULL.
     virtual srs_error_t read(void* buf, size_t size, ssize_t* nread);
     virtual srs_error_t read_fully(void* buf, size_t size, ssize_t* nread);
+    virtual srs_error_t readv(const iovec *iov, int iov_size, ssize_t* nread);
     // @param nwrite, the actual write bytes, ignore if NULL.
     virtual srs_error_t write(void* buf, size_t size, ssize_t* nwrite);
     virtual srs_error_t writev(const iovec *iov, int iov_size, ssize_t* nwrite);
@@ -146,7 +198,7 @@ public:
 //      client.write("Hello world!", 12, NULL);
 //      client.read(buf, 4096, NULL);
 // @remark User can directly free the object, which will close the fd.
-class SrsTcpClient : public ISrsProtocolReadWriter
+class SrsTcpClient : public ISrsProtocolReadWriter, public ISrsVectorReader
 {
 private:
     srs_netfd_t stfd_;
@@ -156,6 +208,9 @@ private:
     int port;
     // The timeout in srs_utime_t.
     srs_utime_t timeout;
+    // The elapsed time of DNS lookup and TCP connect, for the last connect.
+    srs_utime_t dns_elapsed_;
+    srs_utime_t connect_elapsed_;
 public:
     // Constructor.
     // @param h the ip or hostname of server.
@@ -167,6 +222,9 @@ public:
     // Connect to server over TCP.
     // @remark We will close the exists connection before do connect.
     virtual srs_error_t connect();
+    // The elapsed time of last connect, the connect_elapsed excludes the DNS lookup.
+    virtual srs_utime_t dns_elapsed();
+    virtual srs_utime_t connect_elapsed();
 // Interface ISrsProtocolReadWriter
     virtual int get_fd();
 public:
@@ -178,6 +236,7 @@ public:
     virtual int64_t get_send_bytes();
     virtual srs_error_t read(void* buf, size_t size, ssize_t* nread);
     virtual srs_error_t read_fully(void* buf, size_t size, ssize_t* nread);
+    virtual srs_error_t readv(const iovec *iov, int iov_size, ssize_t* nread);
     virtual srs_error_t write(void* buf, size_t size, ssize_t* nwrite);
     virtual srs_error_t writev(const iovec *iov, int iov_size, ssize_t* nwrite);
 };
@@ -18,9 +18,11 @@ SrsFastStream::SrsFastStream(int size)
     _handler = NULL;
 #endif
     
+    // The buffer is allocated when read, so the idle connection holds no buffer.
     nb_buffer = size? size:SRS_DEFAULT_RECV_BUFFER_SIZE;
-    buffer = (char*)malloc(nb_buffer);
-    p = end = buffer;
+    buffer = p = end = NULL;
+    ring = false;
+    nb_wrapped = 0;
 }
 
 SrsFastStream::~SrsFastStream()
@@ -29,11 +31,66 @@ SrsFastStream::~SrsFastStream()
     buffer = NULL;
 }
 
+void SrsFastStream::set_ring(bool v)
+{
+    ring = v;
+}
+
 int SrsFastStream::size()
 {
     return (int)(end - p);
 }
 
+int SrsFastStream::total_size()
+{
+    return (int)(end - p) + nb_wrapped;
+}
+
+void SrsFastStream::linearize()
+{
+    if (!nb_wrapped) {
+        return;
+    }
+
+    // Generally, the bytes to the end of buffer are few, for example, the part of header or chunk size, which
+    // are moved to start of buffer, without copy, if the free space is enough.
+    int nb_bytes = (int)(end - p);
+    char* copy = NULL;
+    if (nb_bytes > (int)(p - buffer) - nb_wrapped) {
+        copy = new char[nb_bytes];
+        memcpy(copy, p, nb_bytes);
+    }
+
+    memmove(buffer + nb_bytes, buffer, nb_wrapped);
+    memcpy(buffer, copy? copy : p, nb_bytes);
+    srs_freepa(copy);
+
+    p = buffer;
+    end = p + nb_bytes + nb_wrapped;
+    nb_wrapped = 0;
+}
+
+void SrsFastStream::rewind()
+{
+    if (p == end && nb_wrapped) {
+        p = buffer;
+        end = buffer + nb_wrapped;
+        nb_wrapped = 0;
+    }
+}
+
+bool SrsFastStream::shrink()
+{
+    // Never free the bytes not consumed, for example, the pipelined request.
+    if (!buffer || end > p) {
+        return false;
+    }
+
+    free(buffer);
+    buffer = p = end = NULL;
+    return true;
+}
+
 void SrsFastStream::set_buffer(int buffer_size)
 {
     // never exceed the max size.
@@ -47,6 +104,9 @@ void SrsFastStream::set_buffer(int buffer_size)
     if (nb_resize_buf <= nb_buffer) {
         return;
     }
+    // the wrapped bytes must follow the others, which are not at the end of buffer when realloc.
+    linearize();
+
     // realloc for buffer change bigger.
     int start = (int)(p - buffer);
     int nb_bytes = (int)(end - p);
@@ -65,7 +125,9 @@ char* SrsFastStream::bytes()
 char SrsFastStream::read_1byte()
 {
     srs_assert(end - p >= 1);
-    return *p++;
+    char v = *p++;
+    rewind();
+    return v;
 }
 
 char* SrsFastStream::read_slice(int size)
@@ -76,6 +138,7 @@ char* SrsFastStream::read_slice(int size)
     
     char* ptr = p;
     p += size;
+    rewind();
     
     return ptr;
 }
@@ -85,6 +148,7 @@ void SrsFastStream::skip(int size)
     srs_assert(end - p >= size);
     srs_assert(p + size >= buffer);
     p += size;
+    rewind();
 }
 
 srs_error_t SrsFastStream::grow(ISrsReader* reader, int required_size)
@@ -97,6 +161,14 @@ srs_error_t SrsFastStream::grow(ISrsReader* reader, int required_size)
     // must be positive.
     srs_assert(required_size > 0);
 
+    if (!buffer) {
+        buffer = p = end = (char*)malloc(nb_buffer);
+    }
+
+    if (ring) {
+        return grow_ring(reader, required_size);
+    }
+
     // the free space of buffer,
     //      buffer = consumed_bytes + exists_bytes + free_space.
     int nb_free_space = (int)(buffer + nb_buffer - end);
@@ -143,3 +215,65 @@ srs_error_t SrsFastStream::grow(ISrsReader* reader, int required_size)
     return err;
 }
 
+srs_error_t SrsFastStream::grow_ring(ISrsReader* reader, int required_size)
+{
+    srs_error_t err = srs_success;
+
+    // the required bytes straddle the end of buffer, for example, the chunk size.
+    if (nb_wrapped) {
+        linearize();
+        if (end - p >= required_size) {
+            return err;
+        }
+    }
+
+    // reset when buffer is empty.
+    if (p == end) {
+        p = end = buffer;
+    }
+
+    // the free space at the end and start of buffer,
+    //      buffer = free_front + exists_bytes + free_tail.
+    int nb_exists_bytes = (int)(end - p);
+    int nb_free_tail = (int)(buffer + nb_buffer - end);
+    int nb_free_front = (int)(p - buffer);
+    if (nb_exists_bytes + nb_free_tail + nb_free_front < required_size) {
+        return srs_error_new(ERROR_READER_BUFFER_OVERFLOW, "overflow, required=%d, max=%d, left=%d", required_size, nb_buffer, nb_free_tail + nb_free_front);
+    }
+
+    // only move when the required bytes should be contiguous, but not enough space at the end.
+    if (nb_exists_bytes + nb_free_tail < required_size) {
+        buffer = (char*)memmove(buffer, p, nb_exists_bytes);
+        p = buffer;
+        end = p + nb_exists_bytes;
+        nb_free_tail += nb_free_front;
+        nb_free_front = 0;
+    }
+
+    // the bytes more than the end of buffer are wrapped to the start, if reader supports readv.
+    ISrsVectorReader* vreader = dynamic_cast<ISrsVectorReader*>(reader);
+    while (end - p < required_size) {
+        ssize_t nread;
+        if (vreader && nb_free_front) {
+            iovec iovs[2];
+            iovs[0].iov_base = end;
+            iovs[0].iov_len = nb_free_tail;
+            iovs[1].iov_base = buffer;
+            iovs[1].iov_len = nb_free_front;
+            err = vreader->readv(iovs, 2, &nread);
+        } else {
+            err = reader->read(end, nb_free_tail, &nread);
+        }
+        if (err != srs_success) {
+            return srs_error_wrap(err, "read bytes");
+        }
+
+        srs_assert((int)nread > 0);
+        int nb_tail = srs_min((int)nread, nb_free_tail);
+        end += nb_tail;
+        nb_free_tail -= nb_tail;
+        nb_wrapped += (int)nread - nb_tail;
+    }
+
+    return err;
+}
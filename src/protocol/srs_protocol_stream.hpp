@@ -20,15 +20,34 @@ private:
     char* buffer;
     // the size of buffer.
     int nb_buffer;
+    // whether read into the free space at the start of buffer, when the end of buffer is full.
+    bool ring;
+    // the bytes wrapped to the start of buffer, which follow the bytes to the end of buffer.
+    //      buffer <= wrapped bytes <= p <= end == buffer+nb_buffer
+    int nb_wrapped;
 public:
     // If buffer is 0, use default size.
     SrsFastStream(int size=0);
     virtual ~SrsFastStream();
 public:
+    /**
+     * Use the ring buffer, to read by readv into the free space at the end and start of buffer, rather than move the
+     * bytes to the start of buffer. The bytes() and size() are the contiguous bytes to the end of buffer, then the
+     * wrapped bytes when consumed.
+     */
+    virtual void set_ring(bool v);
     /**
      * get the size of current bytes in buffer.
+     * @remark For ring buffer, it's the contiguous bytes from bytes().
      */
     virtual int size();
+    // The size of all bytes in buffer, including the wrapped bytes of ring buffer.
+    virtual int total_size();
+    // Move the wrapped bytes of ring buffer to follow the contiguous bytes.
+    virtual void linearize();
+    // Free the buffer if all bytes are consumed, which is allocated again when grow.
+    // @return Whether the buffer is freed.
+    virtual bool shrink();
     virtual void set_buffer(int buffer_size);    
     virtual char* read_slice(int size);
     virtual char* bytes();
@@ -54,6 +73,10 @@ public:
      * @remark, we actually maybe read more than required_size, maybe 4k for example.
      */
     virtual srs_error_t grow(ISrsReader* reader, int required_size);
+private:
+    virtual srs_error_t grow_ring(ISrsReader* reader, int required_size);
+    // Start from the wrapped bytes, when the bytes to the end of buffer are consumed.
+    virtual void rewind();
 
 };
 
@@ -129,13 +129,13 @@ srs_error_t srs_ioutil_read_all(ISrsReader* in, std::string& content)
     return err;
 }
 
-srs_error_t srs_ioutil_read_part(ISrsReader* in, std::string& content, int size, int& finish)
+srs_error_t srs_ioutil_read_part(ISrsReader* in, std::string& content, int size, int& finish, char* cache)
 {
     srs_error_t err = srs_success;
-    srs_trace("srs_ioutil_read_part");
     // Cache to read, it might cause coroutine switch, so we use local cache here.
-    char* buf = new char[SRS_HTTP_READ_CACHE_BYTES];
-    SrsAutoFreeA(char, buf);
+    char* local = cache ? NULL : new char[SRS_HTTP_READ_CACHE_BYTES];
+    SrsAutoFreeA(char, local);
+    char* buf = cache ? cache : local;
 
     // Whatever, read util EOF.
     while (true) {
@@ -156,7 +156,6 @@ srs_error_t srs_ioutil_read_part(ISrsReader* in, std::string& content, int size,
         if (nb_read > 0) {
             content.append(buf, nb_read);
         }
-        srs_trace("content size = %d", content.size());
         if(content.size() > size)
         {
             break;
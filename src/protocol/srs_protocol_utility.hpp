@@ -21,5 +21,7 @@ extern srs_error_t srs_write_large_iovs(ISrsProtocolReadWriter* skt, iovec* iovs
 
 // Read all content util EOF.
 extern srs_error_t srs_ioutil_read_all(ISrsReader* in, std::string& content);
-extern srs_error_t srs_ioutil_read_part(ISrsReader* in, std::string& content, int size, int& finish);
+// Read the content more than size bytes, or util EOF.
+// @param cache The buffer to read, at least SRS_HTTP_READ_CACHE_BYTES, or NULL to allocate it.
+extern srs_error_t srs_ioutil_read_part(ISrsReader* in, std::string& content, int size, int& finish, char* cache = NULL);
 #endif
\ No newline at end of file
@@ -0,0 +1,152 @@
+// The offline compiler of policy, which compiles the json policy to the database, for the proxy to map it.
+//      ./output/policy_compiler -i ./conf/policy.json -o ./conf/policy.db
+// To check the database, for example, whether the host is in the black list:
+//      ./output/policy_compiler -c ./conf/policy.db www.example.com
+// To compile the model of URL classifier exported as text, and check it:
+//      ./output/policy_compiler -m ./model.txt -o ./conf/url_category.model
+//      ./output/policy_compiler -u ./conf/url_category.model www.example.com/news/
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <srs_core.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_protocol_log.hpp>
+#include <srs_app_log.hpp>
+#include <srs_app_threads.hpp>
+#include <srs_app_config.hpp>
+#include <srs_app_policy.hpp>
+#include <srs_app_access_log.hpp>
+#include <srs_app_domain_matcher.hpp>
+#include <srs_app_url_classifier.hpp>
+
+// @global log and context.
+ISrsLog* _srs_log = NULL;
+// It SHOULD be thread-safe, because it use thread-local thread private data.
+ISrsContext* _srs_context = NULL;
+// @global config object for app module.
+SrsConfig* _srs_config = NULL;
+// @global policy object for app module
+SrsPolicy* _srs_policy = NULL;
+// @global notification object for app module
+SrsNotification* _srs_notification = NULL;
+
+SrsAccessLog* _srs_access_log = NULL;
+SrsCircuitBreaker* _srs_circuit_breaker = NULL;
+
+static void usage(const char* name)
+{
+    printf("Usage: %s -i <policy.json> [-o <policy.db>]\n", name);
+    printf("       %s -c <policy.db> [host ...]\n", name);
+    printf("       %s -m <model.txt> -o <model>\n", name);
+    printf("       %s -u <model> [url ...]\n", name);
+    printf("    -i      The json policy to compile.\n");
+    printf("    -o      The database to write, default to %s\n", SRS_POLICY_DATABASE);
+    printf("    -c      Check the database, and match the hosts.\n");
+    printf("    -m      The model of URL classifier to compile, which is exported as text.\n");
+    printf("    -u      Check the model, and classify the URLs.\n");
+}
+
+srs_error_t do_main(int argc, char** argv)
+{
+    srs_error_t err = srs_success;
+
+    std::string input, output = SRS_POLICY_DATABASE, check, model, check_model;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:c:m:u:h")) != -1) {
+        switch (opt) {
+            case 'i': input = optarg; break;
+            case 'o': output = optarg; break;
+            case 'c': check = optarg; break;
+            case 'm': model = optarg; break;
+            case 'u': check_model = optarg; break;
+            default: usage(argv[0]); return srs_success;
+        }
+    }
+
+    if (!model.empty() || !check_model.empty()) {
+        SrsUrlClassifier classifier;
+        if (!check_model.empty()) {
+            if ((err = classifier.load(check_model)) != srs_success) {
+                return srs_error_wrap(err, "load %s", check_model.c_str());
+            }
+
+            for (int i = optind; i < argc; i++) {
+                float prob = 0;
+                std::string category = classifier.classify(argv[i], &prob);
+                printf("%s category=%s, prob=%.3f\n", argv[i], category.c_str(), prob);
+            }
+            return err;
+        }
+
+        if (output == SRS_POLICY_DATABASE) {
+            return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "no output of model");
+        }
+        if ((err = classifier.load_text(model)) != srs_success) {
+            return srs_error_wrap(err, "load %s", model.c_str());
+        }
+        if ((err = classifier.save(output)) != srs_success) {
+            return srs_error_wrap(err, "save %s", output.c_str());
+        }
+
+        srs_trace("compile model %s to %s ok, classes=%d, size=%dKB", model.c_str(), output.c_str(),
+            classifier.classes(), (int)(classifier.memory() / 1024));
+        return err;
+    }
+
+    if (input.empty() && check.empty()) {
+        usage(argv[0]);
+        return srs_error_new(ERROR_SYSTEM_CONFIG_INVALID, "no input");
+    }
+
+    SrsPolicy policy;
+    if (!check.empty()) {
+        if ((err = policy.loadCompiledPolicy(check)) != srs_success) {
+            return srs_error_wrap(err, "load %s", check.c_str());
+        }
+
+        for (int i = optind; i < argc; i++) {
+            printf("%s black_list=%d, tunnel_domain=%d\n", argv[i], policy.match_black_list(argv[i]),
+                policy.match_tunnel_domain_list(argv[i]));
+        }
+        return err;
+    }
+
+    srs_utime_t starttime = srs_get_monotonic_time();
+    if ((err = policy.loadJsonPolicy(input)) != srs_success) {
+        return srs_error_wrap(err, "load %s", input.c_str());
+    }
+    if ((err = policy.compilePolicy(output)) != srs_success) {
+        return srs_error_wrap(err, "compile %s", output.c_str());
+    }
+
+    // Verify the database by loading it.
+    SrsPolicy verify;
+    if ((err = verify.loadCompiledPolicy(output)) != srs_success) {
+        return srs_error_wrap(err, "verify %s", output.c_str());
+    }
+    if (verify.black_list->size() != policy.black_list->size() || verify.tunnel_domain->size() != policy.tunnel_domain->size()) {
+        return srs_error_new(ERROR_POLICY_DATABASE, "verify %s, rules mismatch", output.c_str());
+    }
+
+    srs_trace("compile %s to %s ok, elapsed=%dms", input.c_str(), output.c_str(),
+        srsu2msi(srs_get_monotonic_time() - starttime));
+    return err;
+}
+
+int main(int argc, char** argv)
+{
+    _srs_log = new SrsFileLog();
+    _srs_context = new SrsThreadContext();
+
+    // The shell truncates the exit status to 8 bits, so fail by 1 and print the code.
+    srs_error_t err = do_main(argc, argv);
+    if (err != srs_success) {
+        srs_error("Failed, code=%d, %s", srs_error_code(err), srs_error_desc(err).c_str());
+        srs_freep(err);
+        return 1;
+    }
+
+    return 0;
+}
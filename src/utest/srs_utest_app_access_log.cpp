@@ -30,3 +30,16 @@ VOID TEST(SrsAccessLog, test1)
     mockSrsAccessLog.write_access_log(log_info);
     EXPECT_EQ("1.1.1.1\texample.com\t200\r\n", mockSrsAccessLog.getStr());
 }
+
+VOID TEST(SrsAccessLog, WithCategory)
+{
+    SrsAccessLogInfo* log_info = new SrsAccessLogInfo();
+    SrsAutoFree(SrsAccessLogInfo, log_info);
+    log_info->client_ip = "1.1.1.1";
+    log_info->domain  = "example.com";
+    log_info->status_code = 200;
+    log_info->category = "news";
+    MockSrsAccessLog mockSrsAccessLog;
+    mockSrsAccessLog.write_access_log(log_info);
+    EXPECT_EQ("1.1.1.1\texample.com\t200\tnews\r\n", mockSrsAccessLog.getStr());
+}
@@ -0,0 +1,73 @@
+#include <srs_utest_app_admission.hpp>
+#include <srs_utest_config.hpp>
+#include <srs_app_admission.hpp>
+#include <srs_app_config.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_core_auto_free.hpp>
+
+extern SrsConfig* _srs_config;
+
+VOID TEST(SrsAdmission, MaxConnections)
+{
+    srs_error_t err = srs_success;
+
+    MockSrsConfig conf;
+    HELPER_EXPECT_SUCCESS(conf.parse("max_connections 2;"));
+    EXPECT_EQ(2, conf.get_max_connections());
+
+    SrsConfig* old = _srs_config;
+    _srs_config = &conf;
+
+    SrsAdmission admission;
+    HELPER_EXPECT_SUCCESS(admission.on_accept(0));
+    HELPER_EXPECT_SUCCESS(admission.on_accept(1));
+
+    err = admission.on_accept(2);
+    EXPECT_EQ(ERROR_EXCEED_CONNECTIONS, srs_error_code(err));
+    srs_freep(err);
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    admission.dumps(obj);
+    EXPECT_EQ(1, obj->get_property("exceed")->to_integer());
+    EXPECT_EQ(2, obj->get_property("max_connections")->to_integer());
+
+    _srs_config = old;
+}
+
+VOID TEST(SrsAdmission, CountProxyConnections)
+{
+    SrsAdmission admission;
+    EXPECT_EQ(0, admission.connections());
+
+    admission.on_connection_start();
+    admission.on_connection_start();
+    EXPECT_EQ(2, admission.connections());
+
+    admission.on_connection_stop();
+    EXPECT_EQ(1, admission.connections());
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    admission.dumps(obj);
+    EXPECT_EQ(1, obj->get_property("connections")->to_integer());
+}
+
+VOID TEST(SrsAdmission, NormalLevel)
+{
+    // Never shed load when the circuit breaker is not at high water level.
+    SrsAdmission admission;
+    EXPECT_EQ(SrsAdmissionLevelNormal, admission.level());
+    EXPECT_FALSE(admission.should_pause_accept());
+    EXPECT_FALSE(admission.should_reject_connect());
+    EXPECT_FALSE(admission.should_fallback_tunnel());
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    admission.dumps(obj);
+    EXPECT_STREQ("normal", obj->get_property("level")->to_str().c_str());
+    EXPECT_EQ(0, obj->get_property("reject_connect")->to_integer());
+    EXPECT_EQ(0, obj->get_property("fallback_tunnel")->to_integer());
+    EXPECT_EQ(0, obj->get_property("pause")->to_integer());
+}
@@ -0,0 +1,166 @@
+#include <srs_utest_app_conn.hpp>
+#include <srs_app_conn.hpp>
+
+class MockResource : public ISrsResource
+{
+public:
+    SrsContextId cid;
+    int* nn_freed;
+public:
+    MockResource(int* freed = NULL) {
+        nn_freed = freed;
+    }
+    virtual ~MockResource() {
+        if (nn_freed) {
+            (*nn_freed)++;
+        }
+    }
+    virtual const SrsContextId& get_id() {
+        return cid;
+    }
+    virtual std::string desc() {
+        return "mock";
+    }
+};
+
+VOID TEST(SrsResourceList, PushEraseAnyOrder)
+{
+    MockResource a, b, c;
+    SrsResourceList list;
+    EXPECT_TRUE(list.empty());
+
+    list.push_back(&a);
+    list.push_back(&b);
+    list.push_back(&c);
+    EXPECT_EQ(3, list.size());
+    EXPECT_TRUE(list.contains(&b));
+    EXPECT_EQ(&a, list.front());
+
+    // Erase from the middle, the head and the tail.
+    list.erase(&b);
+    EXPECT_FALSE(list.contains(&b));
+    EXPECT_EQ(2, list.size());
+    list.erase(&a);
+    EXPECT_EQ(&c, list.front());
+    list.erase(&c);
+    EXPECT_TRUE(list.empty());
+    EXPECT_EQ(0, list.size());
+
+    // Ignore the resource which is not in this list.
+    SrsResourceList other;
+    other.push_back(&a);
+    list.erase(&a);
+    EXPECT_TRUE(other.contains(&a));
+    EXPECT_FALSE(list.contains(&a));
+    other.erase(&a);
+}
+
+VOID TEST(SrsResourceManager, AddFindAndRemove)
+{
+    srs_error_t err = srs_success;
+
+    int nn_freed = 0;
+    SrsResourceManager manager("utest");
+    HELPER_EXPECT_SUCCESS(manager.start());
+
+    MockResource* a = new MockResource(&nn_freed);
+    MockResource* b = new MockResource(&nn_freed);
+    MockResource* c = new MockResource(&nn_freed);
+    manager.add(a);
+    manager.add_with_id("b", b);
+    manager.add_with_fast_id(100, c);
+    manager.add_with_name("c", c);
+    EXPECT_EQ(3, manager.size());
+
+    bool exists = false;
+    manager.add(a, &exists);
+    EXPECT_TRUE(exists);
+    EXPECT_EQ(3, manager.size());
+
+    EXPECT_EQ(b, manager.find_by_id("b"));
+    EXPECT_EQ(c, manager.find_by_fast_id(100));
+    EXPECT_EQ(c, manager.find_by_name("c"));
+    EXPECT_TRUE(NULL == manager.find_by_fast_id(101));
+
+    // Remove twice is ignored, and the zombie is still able to be found until disposed.
+    manager.remove(b);
+    manager.remove(b);
+    EXPECT_EQ(2, manager.size());
+    EXPECT_EQ(b, manager.find_by_id("b"));
+
+    manager.remove(a);
+    manager.remove(c);
+    srs_usleep(10 * SRS_UTIME_MILLISECONDS);
+
+    EXPECT_EQ(3, nn_freed);
+    EXPECT_EQ(0, manager.size());
+    EXPECT_TRUE(NULL == manager.find_by_id("b"));
+    EXPECT_TRUE(NULL == manager.find_by_fast_id(100));
+    EXPECT_TRUE(NULL == manager.find_by_name("c"));
+}
+
+VOID TEST(SrsResourceManager, ReindexWithNewKey)
+{
+    srs_error_t err = srs_success;
+
+    int nn_freed = 0;
+    SrsResourceManager manager("utest");
+    HELPER_EXPECT_SUCCESS(manager.start());
+
+    MockResource* a = new MockResource(&nn_freed);
+    MockResource* b = new MockResource(&nn_freed);
+    manager.add_with_id("a0", a);
+    manager.add_with_id("a1", a);
+    manager.add_with_name("a0", a);
+    manager.add_with_name("a1", a);
+    manager.add_with_fast_id(100, a);
+    manager.add_with_fast_id(101, a);
+    EXPECT_EQ(1, manager.size());
+
+    // The old keys are dropped, or they point to the freed resource.
+    EXPECT_TRUE(NULL == manager.find_by_id("a0"));
+    EXPECT_TRUE(NULL == manager.find_by_name("a0"));
+    EXPECT_TRUE(NULL == manager.find_by_fast_id(100));
+    EXPECT_EQ(a, manager.find_by_id("a1"));
+    EXPECT_EQ(a, manager.find_by_name("a1"));
+    EXPECT_EQ(a, manager.find_by_fast_id(101));
+
+    // The fast id is taken over by another resource.
+    manager.add_with_fast_id(101, b);
+    EXPECT_EQ(b, manager.find_by_fast_id(101));
+
+    manager.remove(a);
+    manager.remove(b);
+    srs_usleep(10 * SRS_UTIME_MILLISECONDS);
+
+    EXPECT_EQ(2, nn_freed);
+    EXPECT_TRUE(NULL == manager.find_by_id("a1"));
+    EXPECT_TRUE(NULL == manager.find_by_name("a1"));
+    EXPECT_TRUE(NULL == manager.find_by_fast_id(101));
+}
+
+VOID TEST(SrsResourceManager, FreeInBatches)
+{
+    srs_error_t err = srs_success;
+
+    int nn_freed = 0;
+    SrsResourceManager manager("utest");
+    HELPER_EXPECT_SUCCESS(manager.start());
+
+    int nn = SRS_RESOURCE_FREE_BATCH * 3 + 1;
+    std::vector<MockResource*> conns;
+    for (int i = 0; i < nn; i++) {
+        MockResource* conn = new MockResource(&nn_freed);
+        manager.add_with_fast_id(i, conn);
+        conns.push_back(conn);
+    }
+    EXPECT_EQ(nn, manager.size());
+
+    for (int i = 0; i < nn; i++) {
+        manager.remove(conns[i]);
+    }
+    EXPECT_EQ(0, manager.size());
+
+    srs_usleep(10 * SRS_UTIME_MILLISECONDS);
+    EXPECT_EQ(nn, nn_freed);
+}
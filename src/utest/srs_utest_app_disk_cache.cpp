@@ -0,0 +1,277 @@
+#include <srs_utest_app_disk_cache.hpp>
+#include <srs_app_disk_cache.hpp>
+#include <srs_app_async_io.hpp>
+#include <srs_app_http_cache.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_utest_protocol.hpp>
+#include <srs_utest_app_http_cache.hpp>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+
+#define MOCK_DISK_CACHE_DIR "/tmp/srs-utest-disk-cache"
+
+// Remove the files of disk cache.
+class MockDiskCacheDir
+{
+public:
+    MockDiskCacheDir() {
+        cleanup();
+    }
+    virtual ~MockDiskCacheDir() {
+        cleanup();
+    }
+private:
+    void cleanup() {
+        ::unlink(MOCK_DISK_CACHE_DIR "/cache.data");
+        ::unlink(MOCK_DISK_CACHE_DIR "/cache.index");
+        ::unlink(MOCK_DISK_CACHE_DIR "/aio");
+        ::rmdir(MOCK_DISK_CACHE_DIR);
+    }
+};
+
+// Wait for the writes in background.
+static void mock_disk_cache_flush(SrsDiskCache* disk)
+{
+    for (int i = 0; i < 1000 && disk->pending() > 0; i++) {
+        srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+    }
+}
+
+class MockAsyncFileTask : public SrsAsyncFileTask
+{
+public:
+    int* nn_done_tasks;
+    string data;
+public:
+    MockAsyncFileTask(int* v) {
+        nn_done_tasks = v;
+    }
+    virtual ~MockAsyncFileTask() {
+    }
+    virtual void on_done() {
+        (*nn_done_tasks)++;
+    }
+};
+
+VOID TEST(SrsAsyncFileIo, ReadWrite)
+{
+    srs_error_t err = srs_success;
+
+    MockDiskCacheDir dir;
+    ASSERT_EQ(0, ::mkdir(MOCK_DISK_CACHE_DIR, 0755));
+    int fd = ::open(MOCK_DISK_CACHE_DIR "/aio", O_RDWR | O_CREAT, 0644);
+    ASSERT_TRUE(fd >= 0);
+
+    SrsAsyncFileIo aio;
+    HELPER_ASSERT_SUCCESS(aio.initialize(2, 4));
+
+    // Write and wait.
+    string data = "Hello, world!";
+    SrsAsyncFileTask w;
+    w.fd = fd;
+    w.write = true;
+    w.offset = 100;
+    w.buf = (char*)data.data();
+    w.size = data.length();
+    HELPER_ASSERT_SUCCESS(aio.execute(&w));
+    EXPECT_TRUE(w.success());
+    EXPECT_EQ(0, aio.pending());
+
+    char buf[32] = {0};
+    SrsAsyncFileTask r;
+    r.fd = fd;
+    r.offset = 100;
+    r.buf = buf;
+    r.size = data.length();
+    HELPER_ASSERT_SUCCESS(aio.execute(&r));
+    EXPECT_TRUE(r.success());
+    EXPECT_STREQ("Hello, world!", buf);
+
+    // Read after EOF.
+    SrsAsyncFileTask eof;
+    eof.fd = fd;
+    eof.offset = 110;
+    eof.buf = buf;
+    eof.size = sizeof(buf);
+    HELPER_ASSERT_SUCCESS(aio.execute(&eof));
+    EXPECT_FALSE(eof.success());
+    EXPECT_EQ(3, eof.nn_done);
+
+    // Post without waiting, the task is freed by pool.
+    int nn_done_tasks = 0;
+    for (int i = 0; i < 4; i++) {
+        MockAsyncFileTask* task = new MockAsyncFileTask(&nn_done_tasks);
+        task->data = "ABCD";
+        task->fd = fd;
+        task->write = true;
+        task->offset = i * 4;
+        task->buf = (char*)task->data.data();
+        task->size = task->data.length();
+        HELPER_ASSERT_SUCCESS(aio.post(task));
+    }
+
+    // The pool is full.
+    MockAsyncFileTask* task = new MockAsyncFileTask(&nn_done_tasks);
+    SrsAutoFree(MockAsyncFileTask, task);
+    HELPER_EXPECT_FAILED(aio.post(task));
+
+    for (int i = 0; i < 1000 && aio.pending() > 0; i++) {
+        srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+    }
+    EXPECT_EQ(4, nn_done_tasks);
+    EXPECT_EQ(16, ::pread(fd, buf, 16, 0));
+    EXPECT_EQ(0, memcmp(buf, "ABCDABCDABCDABCD", 16));
+
+    ::close(fd);
+}
+
+VOID TEST(SrsDiskCache, ReadWrite)
+{
+    srs_error_t err = srs_success;
+
+    MockDiskCacheDir dir;
+    SrsDiskCache disk;
+    HELPER_ASSERT_SUCCESS(disk.initialize(MOCK_DISK_CACHE_DIR, 1024 * 1024, 2));
+
+    disk.write("http://example.com:80/a", 2000, "Hello");
+    disk.write("http://example.com:80/b", 2000, string(10000, 'b'));
+    mock_disk_cache_flush(&disk);
+
+    string data;
+    HELPER_ASSERT_SUCCESS(disk.read("http://example.com:80/a", 1000, data));
+    EXPECT_STREQ("Hello", data.c_str());
+    HELPER_ASSERT_SUCCESS(disk.read("http://example.com:80/b", 1000, data));
+    EXPECT_TRUE(data == string(10000, 'b'));
+
+    // Miss or expired.
+    data = "";
+    HELPER_ASSERT_SUCCESS(disk.read("http://example.com:80/c", 1000, data));
+    EXPECT_TRUE(data.empty());
+    HELPER_ASSERT_SUCCESS(disk.read("http://example.com:80/a", 2000, data));
+    EXPECT_TRUE(data.empty());
+
+    // Replace the data of key.
+    disk.write("http://example.com:80/a", 2000, "World");
+    mock_disk_cache_flush(&disk);
+    HELPER_ASSERT_SUCCESS(disk.read("http://example.com:80/a", 1000, data));
+    EXPECT_STREQ("World", data.c_str());
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    disk.dumps(obj);
+    EXPECT_EQ(3, obj->get_property("hits")->to_integer());
+    EXPECT_EQ(2, obj->get_property("misses")->to_integer());
+    EXPECT_EQ(3, obj->get_property("writes")->to_integer());
+}
+
+VOID TEST(SrsDiskCache, WrapAround)
+{
+    srs_error_t err = srs_success;
+
+    MockDiskCacheDir dir;
+    SrsDiskCache disk;
+    HELPER_ASSERT_SUCCESS(disk.initialize(MOCK_DISK_CACHE_DIR, 64 * 1024, 1));
+
+    // The log wraps, and the oldest records are overwritten, each pass is 8 records.
+    for (int i = 0; i < 20; i++) {
+        disk.write("key" + srs_int2str(100 + i), 2000, string(8000, 'a' + i));
+        mock_disk_cache_flush(&disk);
+    }
+
+    string data;
+    HELPER_ASSERT_SUCCESS(disk.read("key100", 1000, data));
+    EXPECT_TRUE(data.empty());
+    HELPER_ASSERT_SUCCESS(disk.read("key111", 1000, data));
+    EXPECT_TRUE(data.empty());
+    for (int i = 12; i < 20; i++) {
+        HELPER_ASSERT_SUCCESS(disk.read("key" + srs_int2str(100 + i), 1000, data));
+        EXPECT_TRUE(data == string(8000, 'a' + i));
+    }
+
+    // The huge record is dropped.
+    disk.write("huge", 2000, string(16 * 1024, 'x'));
+    HELPER_ASSERT_SUCCESS(disk.read("huge", 1000, data));
+    EXPECT_TRUE(data.empty());
+}
+
+VOID TEST(SrsDiskCache, Reopen)
+{
+    srs_error_t err = srs_success;
+
+    MockDiskCacheDir dir;
+    if (true) {
+        SrsDiskCache disk;
+        HELPER_ASSERT_SUCCESS(disk.initialize(MOCK_DISK_CACHE_DIR, 1024 * 1024, 1));
+        disk.write("key", 2000, "Hello");
+        mock_disk_cache_flush(&disk);
+    }
+
+    // The index is persistent.
+    string data;
+    if (true) {
+        SrsDiskCache disk;
+        HELPER_ASSERT_SUCCESS(disk.initialize(MOCK_DISK_CACHE_DIR, 1024 * 1024, 1));
+        HELPER_ASSERT_SUCCESS(disk.read("key", 1000, data));
+        EXPECT_STREQ("Hello", data.c_str());
+    }
+
+    // The index is reset when capacity changed.
+    if (true) {
+        SrsDiskCache disk;
+        HELPER_ASSERT_SUCCESS(disk.initialize(MOCK_DISK_CACHE_DIR, 2 * 1024 * 1024, 1));
+        data = "";
+        HELPER_ASSERT_SUCCESS(disk.read("key", 1000, data));
+        EXPECT_TRUE(data.empty());
+    }
+}
+
+// The request and response of the disk tier, the response is cached for 60s.
+static string mock_disk_cache_request(string path)
+{
+    return mock_http_cache_request(path, "Accept-Encoding: gzip\r\n");
+}
+
+static string mock_disk_cache_response(string headers, string body)
+{
+    return mock_http_cache_response("Cache-Control: max-age=60\r\n" + headers, body);
+}
+
+VOID TEST(SrsHttpCache, DiskTier)
+{
+    srs_error_t err = srs_success;
+
+    MockDiskCacheDir dir;
+    MockHttpCache cache;
+    cache.initialize(2 * SRS_HTTP_CACHE_SEGMENT, SRS_HTTP_CACHE_SEGMENT);
+    HELPER_ASSERT_SUCCESS(cache.open_disk(MOCK_DISK_CACHE_DIR, 1024 * 1024, 1));
+
+    // The memory is for two objects, so the first one is evicted from memory, and loaded from disk.
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_disk_cache_request("/a"), mock_disk_cache_response("", "Hello a"), "Hello a"));
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_disk_cache_request("/b"), mock_disk_cache_response("Vary: Accept-Encoding\r\n", "Hello b"), "Hello b"));
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_disk_cache_request("/c"), mock_disk_cache_response("", "Hello c"), "Hello c"));
+    EXPECT_EQ(2, cache.size());
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    for (int i = 0; i < 1000; i++) {
+        cache.dumps(obj);
+        if (obj->get_property("disk")->to_object()->get_property("pending")->to_integer() == 0) {
+            break;
+        }
+        srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+    }
+
+    EXPECT_TRUE(srs_string_ends_with(mock_http_cache_serve(&cache, mock_http_cache_request("/a", "")), "\r\n\r\nHello a"));
+    EXPECT_TRUE(srs_string_ends_with(mock_http_cache_serve(&cache, mock_http_cache_request("/a", "")), "\r\n\r\nHello a"));
+
+    // The variant on disk must match the request.
+    EXPECT_STREQ("", mock_http_cache_serve(&cache, mock_http_cache_request("/b", "Accept-Encoding: br\r\n")).c_str());
+    EXPECT_TRUE(srs_string_ends_with(mock_http_cache_serve(&cache, mock_http_cache_request("/b", "Accept-Encoding: gzip\r\n")), "\r\n\r\nHello b"));
+    EXPECT_STREQ("", mock_http_cache_serve(&cache, mock_http_cache_request("/d", "")).c_str());
+}
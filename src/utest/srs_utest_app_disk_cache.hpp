@@ -0,0 +1,5 @@
+#ifndef SRS_UTEST_APP_DISK_CACHE_HPP
+#define SRS_UTEST_APP_DISK_CACHE_HPP
+#include <srs_utest_main.hpp>
+
+#endif
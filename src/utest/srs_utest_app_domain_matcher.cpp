@@ -0,0 +1,382 @@
+#include <srs_utest_app_domain_matcher.hpp>
+#include <srs_app_domain_matcher.hpp>
+#include <srs_app_ip_matcher.hpp>
+#include <srs_app_url_matcher.hpp>
+#include <srs_app_bloom_filter.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_app_policy.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_app_st.hpp>
+
+#include <unistd.h>
+
+VOID TEST(SrsDomainMatcher, ParseRule)
+{
+    std::string domain;
+    EXPECT_EQ(SrsDomainRuleSuffix, srs_domain_rule_parse(" Example.COM.\r\n", domain));
+    EXPECT_STREQ("example.com", domain.c_str());
+    EXPECT_EQ(SrsDomainRuleSuffix, srs_domain_rule_parse(".example.com", domain));
+    EXPECT_STREQ("example.com", domain.c_str());
+    EXPECT_EQ(SrsDomainRuleExact, srs_domain_rule_parse("=example.com", domain));
+    EXPECT_EQ(SrsDomainRuleSubdomain, srs_domain_rule_parse("*.example.com", domain));
+    EXPECT_STREQ("example.com", domain.c_str());
+    EXPECT_EQ(SrsDomainRuleSubstring, srs_domain_rule_parse("~phish", domain));
+    EXPECT_STREQ("phish", domain.c_str());
+    EXPECT_EQ(0, srs_domain_rule_parse("", domain));
+    EXPECT_EQ(0, srs_domain_rule_parse("=", domain));
+    EXPECT_EQ(0, srs_domain_rule_parse(std::string(254, 'a'), domain));
+}
+
+VOID TEST(SrsDomainMatcher, MatchByType)
+{
+    srs_error_t err = srs_success;
+
+    SrsDomainMatcher m;
+    HELPER_EXPECT_SUCCESS(m.add("example.com"));
+    HELPER_EXPECT_SUCCESS(m.add("=exact.org"));
+    HELPER_EXPECT_SUCCESS(m.add("*.sub.net"));
+    EXPECT_EQ(3, m.size());
+
+    // Suffix matches the domain and its subdomains, but not the partial label.
+    EXPECT_TRUE(m.match("example.com"));
+    EXPECT_TRUE(m.match("www.Example.com"));
+    EXPECT_TRUE(m.match("a.b.example.com."));
+    EXPECT_FALSE(m.match("badexample.com"));
+    EXPECT_FALSE(m.match("example.com.cn"));
+    EXPECT_FALSE(m.match("com"));
+
+    EXPECT_TRUE(m.match("exact.org"));
+    EXPECT_FALSE(m.match("www.exact.org"));
+
+    EXPECT_FALSE(m.match("sub.net"));
+    EXPECT_TRUE(m.match("www.sub.net"));
+
+    EXPECT_FALSE(m.match(""));
+    EXPECT_FALSE(m.match("."));
+
+    // Merge the exact and subdomain rules.
+    HELPER_EXPECT_SUCCESS(m.add("=sub.net"));
+    EXPECT_EQ(3, m.size());
+    EXPECT_TRUE(m.match("sub.net"));
+
+    HELPER_EXPECT_FAILED(m.add("*."));
+}
+
+VOID TEST(SrsDomainMatcher, MatchSubstring)
+{
+    srs_error_t err = srs_success;
+
+    SrsDomainMatcher m;
+    EXPECT_FALSE(m.match("www.example.com"));
+
+    HELPER_EXPECT_SUCCESS(m.add("~ampl"));
+    EXPECT_TRUE(m.match("www.EXAMPLE.com"));
+    EXPECT_FALSE(m.match("www.test.com"));
+}
+
+VOID TEST(SrsDomainMatcher, ManyRules)
+{
+    SrsDomainMatcher m;
+
+    // Grow the hash table several times.
+    char buf[64];
+    for (int i = 0; i < 10000; i++) {
+        snprintf(buf, sizeof(buf), "d%d.example%d.com", i, i % 100);
+        m.add(buf, SrsDomainRuleSuffix);
+    }
+    EXPECT_EQ(10000, m.size());
+
+    for (int i = 0; i < 10000; i++) {
+        snprintf(buf, sizeof(buf), "www.d%d.example%d.com", i, i % 100);
+        EXPECT_TRUE(m.match(buf));
+        snprintf(buf, sizeof(buf), "d%d.example%d.com", i, (i + 1) % 100);
+        EXPECT_FALSE(m.match(buf));
+    }
+}
+
+VOID TEST(SrsDomainMatcher, EncodeDecode)
+{
+    srs_error_t err = srs_success;
+
+    SrsDomainMatcher m;
+    HELPER_EXPECT_SUCCESS(m.add("example.com"));
+    HELPER_EXPECT_SUCCESS(m.add("=exact.org"));
+    HELPER_EXPECT_SUCCESS(m.add("~phish"));
+    HELPER_EXPECT_SUCCESS(m.add("~scam"));
+
+    std::string data;
+    m.encode(data);
+    EXPECT_EQ(0, (int)(data.size() % 8));
+
+    SrsDomainMatcher d;
+    size_t nread = 0;
+    HELPER_EXPECT_SUCCESS(d.decode(data.data(), data.size(), &nread));
+    EXPECT_EQ(data.size(), nread);
+    EXPECT_EQ(4, d.size());
+    EXPECT_TRUE(d.match("www.example.com"));
+    EXPECT_TRUE(d.match("exact.org"));
+    EXPECT_FALSE(d.match("www.exact.org"));
+    EXPECT_TRUE(d.match("phishing.net"));
+    EXPECT_TRUE(d.match("scam.net"));
+    EXPECT_FALSE(d.match("www.test.com"));
+
+    // The truncated data.
+    SrsDomainMatcher t;
+    HELPER_EXPECT_FAILED(t.decode(data.data(), data.size() - 8, NULL));
+    HELPER_EXPECT_FAILED(t.decode(data.data(), 8, NULL));
+}
+
+VOID TEST(SrsBloomFilter, FalsePositive)
+{
+    srs_error_t err = srs_success;
+
+    SrsBloomFilter empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_TRUE(empty.contains(100));
+
+    SrsBloomFilter f;
+    f.initialize(10000, 12);
+    EXPECT_EQ(0, (int)(f.memory() % SRS_BLOOM_BLOCK_SIZE));
+    for (uint32_t i = 0; i < 10000; i++) {
+        f.add(i * 0x9e3779b1U + 1);
+    }
+    EXPECT_EQ(10000, f.size());
+
+    int nn_false = 0;
+    for (uint32_t i = 0; i < 10000; i++) {
+        EXPECT_TRUE(f.contains(i * 0x9e3779b1U + 1));
+        nn_false += f.contains(i * 0x85ebca6bU + 7) ? 1 : 0;
+    }
+    EXPECT_LT(nn_false, 200);
+
+    // The blocks are aligned to 64 bytes of data.
+    std::string data("abc");
+    f.encode(data);
+    EXPECT_EQ(0, (int)((data.size() - f.memory()) % SRS_BLOOM_BLOCK_SIZE));
+
+    SrsBloomFilter d;
+    size_t nread = 0;
+    HELPER_EXPECT_SUCCESS(d.decode(data.data() + 3, data.size() - 3, &nread));
+    EXPECT_EQ(data.size() - 3, nread);
+    EXPECT_EQ(f.memory(), d.memory());
+    EXPECT_TRUE(d.contains(1));
+    HELPER_EXPECT_FAILED(d.decode(data.data() + 3, data.size() - 64, NULL));
+}
+
+VOID TEST(SrsDomainMatcher, BloomFilter)
+{
+    srs_error_t err = srs_success;
+
+    SrsDomainMatcher m;
+    char buf[64];
+    for (int i = 0; i < 70000; i++) {
+        snprintf(buf, sizeof(buf), "p%d.phish%d.com", i, i % 100);
+        m.add(buf, SrsDomainRuleSuffix);
+    }
+    HELPER_EXPECT_SUCCESS(m.add("~scam"));
+    EXPECT_EQ(0, (int)m.bloom_memory());
+
+    m.compile();
+    EXPECT_LT(0, (int)m.bloom_memory());
+    // The rule added after compile is also in the filter.
+    HELPER_EXPECT_SUCCESS(m.add("=late.org"));
+
+    std::string data;
+    m.encode(data);
+
+    SrsDomainMatcher d;
+    HELPER_EXPECT_SUCCESS(d.decode(data.data(), data.size(), NULL));
+    EXPECT_EQ(m.bloom_memory(), d.bloom_memory());
+
+    SrsDomainMatcher* matchers[] = {&m, &d};
+    for (int j = 0; j < 2; j++) {
+        SrsDomainMatcher* matcher = matchers[j];
+        for (int i = 0; i < 70000; i += 7) {
+            snprintf(buf, sizeof(buf), "www.p%d.phish%d.com", i, i % 100);
+            EXPECT_TRUE(matcher->match(buf));
+            snprintf(buf, sizeof(buf), "p%d.phish%d.com", i, (i + 1) % 100);
+            EXPECT_FALSE(matcher->match(buf));
+        }
+        EXPECT_TRUE(matcher->match("late.org"));
+        EXPECT_FALSE(matcher->match("www.late.org"));
+        EXPECT_TRUE(matcher->match("scam.net"));
+    }
+}
+
+VOID TEST(SrsPolicy, CompileAndLoad)
+{
+    srs_error_t err = srs_success;
+
+    std::string path = "/tmp/srs_utest_policy.db";
+
+    SrsPolicy policy;
+    HELPER_EXPECT_SUCCESS(policy.black_list->add("example.com"));
+    HELPER_EXPECT_SUCCESS(policy.tunnel_domain->add("*.bank.com"));
+    HELPER_EXPECT_SUCCESS(policy.client_ip_list->add("10.0.0.0/8"));
+    HELPER_EXPECT_SUCCESS(policy.url_black_list->add("/ads/"));
+    policy.url_black_list->compile();
+    policy.https_descrypt_enable = true;
+    HELPER_EXPECT_SUCCESS(policy.compilePolicy(path));
+
+    SrsPolicy loaded;
+    HELPER_EXPECT_SUCCESS(loaded.loadCompiledPolicy(path));
+    EXPECT_TRUE(loaded.is_https_descrypt_enable());
+    EXPECT_TRUE(loaded.match_black_list("www.example.com"));
+    EXPECT_FALSE(loaded.match_black_list("www.bank.com"));
+    EXPECT_TRUE(loaded.match_tunnel_domain_list("www.bank.com"));
+    EXPECT_FALSE(loaded.match_tunnel_domain_list("bank.com"));
+    EXPECT_TRUE(loaded.match_client_ip_list("10.0.0.1"));
+    EXPECT_FALSE(loaded.match_client_ip_list("11.0.0.1"));
+    EXPECT_TRUE(loaded.match_url_black_list("/ads/banner.js"));
+    EXPECT_FALSE(loaded.match_url_black_list("/index.html"));
+
+    // Not a database.
+    HELPER_EXPECT_FAILED(loaded.loadCompiledPolicy("./conf/policy.json"));
+    HELPER_EXPECT_FAILED(loaded.loadCompiledPolicy("/tmp/srs_utest_policy_not_exists.db"));
+    EXPECT_TRUE(loaded.match_black_list("www.example.com"));
+
+    ::unlink(path.c_str());
+}
+
+VOID TEST(SrsPolicy, GuardKeepsOldPolicy)
+{
+    SrsPolicy* current = _srs_policy;
+    _srs_policy = new SrsPolicy();
+    _srs_policy->black_list->add("example.com");
+
+    SrsPolicyGuard* guard = new SrsPolicyGuard();
+    SrsPolicy* old = _srs_policy;
+
+    // Replace the policy, the old one is alive until the guard is released.
+    _srs_policy = new SrsPolicy();
+    _srs_policy->set_version(1);
+    old->release();
+
+    EXPECT_EQ(0, (int)(*guard)->version());
+    EXPECT_TRUE((*guard)->match_black_list("www.example.com"));
+    if (true) {
+        SrsPolicyGuard policy;
+        EXPECT_EQ(1, (int)policy->version());
+        EXPECT_FALSE(policy->match_black_list("www.example.com"));
+    }
+    srs_freep(guard);
+
+    _srs_policy->release();
+    _srs_policy = current;
+}
+
+VOID TEST(SrsPolicy, ReloadInBackground)
+{
+    SrsPolicy* current = _srs_policy;
+    _srs_policy = new SrsPolicy();
+
+    SrsPolicyReloader* reloader = new SrsPolicyReloader();
+    EXPECT_TRUE(reloader->start() == srs_success);
+
+    SrsPolicyGuard* guard = new SrsPolicyGuard();
+    reloader->reload();
+
+    // Merge the requests, and never block the ST thread.
+    reloader->reload();
+    int64_t reloads = 0;
+    for (int i = 0; i < 100 && !reloads; i++) {
+        srs_usleep(10 * SRS_UTIME_MILLISECONDS);
+
+        SrsJsonObject* obj = SrsJsonAny::object();
+        SrsAutoFree(SrsJsonObject, obj);
+        reloader->dumps(obj);
+        reloads = obj->get_property("reloads")->to_integer();
+    }
+    EXPECT_EQ(1, reloads);
+
+    // Keep the policy if failed, for example, the policy file not exists.
+    int version = srs_path_exists(SRS_POLICY_JSON) ? 1 : 0;
+    EXPECT_EQ(version, (int)_srs_policy->version());
+    EXPECT_EQ(0, (int)(*guard)->version());
+
+    srs_freep(guard);
+    srs_freep(reloader);
+    _srs_policy->release();
+    _srs_policy = current;
+}
+
+VOID TEST(SrsPolicy, VerdictCache)
+{
+    SrsPolicy* policy = new SrsPolicy();
+    policy->black_list->add("example.com");
+    policy->tunnel_domain->add("bank.com");
+    policy->https_descrypt_enable = true;
+    policy->set_version(1);
+
+    SrsVerdictCache cache;
+    cache.set_capacity(2);
+
+    if(true)
+    {
+        SrsVerdictGuard verdict(cache.fetch(policy, "www.example.com"));
+        EXPECT_TRUE(verdict->block);
+        EXPECT_FALSE(verdict->tunnel);
+        EXPECT_TRUE(verdict->decrypt);
+        verdict->block_page = "blocked";
+    }
+
+    if(true)
+    {
+        SrsVerdictGuard verdict(cache.fetch(policy, "www.bank.com"));
+        EXPECT_FALSE(verdict->block);
+        EXPECT_TRUE(verdict->tunnel);
+        EXPECT_FALSE(verdict->decrypt);
+    }
+
+    // Hit, and the rendered page is kept.
+    if(true)
+    {
+        SrsVerdictGuard verdict(cache.fetch(policy, "www.example.com"));
+        EXPECT_EQ("blocked", verdict->block_page);
+        EXPECT_EQ(2, cache.size());
+    }
+
+    // The bank is least recently used, so it's evicted, but it's still valid for the request holds it.
+    SrsVerdictGuard bank(cache.fetch(policy, "www.bank.com"));
+    cache.fetch(policy, "www.example.com")->release();
+    cache.fetch(policy, "www.other.com")->release();
+    EXPECT_EQ(2, cache.size());
+    EXPECT_TRUE(bank->tunnel);
+    EXPECT_EQ("blocked", SrsVerdictGuard(cache.fetch(policy, "www.example.com"))->block_page);
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    cache.dumps(obj);
+    EXPECT_EQ(4, obj->get_property("hits")->to_integer());
+    EXPECT_EQ(3, obj->get_property("misses")->to_integer());
+    EXPECT_EQ(1, obj->get_property("evicts")->to_integer());
+
+    // The newer policy clears the cache.
+    SrsPolicy* reloaded = new SrsPolicy();
+    reloaded->set_version(2);
+    if(true)
+    {
+        SrsVerdictGuard verdict(cache.fetch(reloaded, "www.example.com"));
+        EXPECT_FALSE(verdict->block);
+        EXPECT_TRUE(verdict->block_page.empty());
+        EXPECT_EQ(1, cache.size());
+    }
+
+    // The in-flight request with the old policy, never pollutes the cache, and its verdict is owned.
+    SrsVerdictGuard stale(cache.fetch(policy, "www.example.com"));
+    EXPECT_FALSE(SrsVerdictGuard(cache.fetch(reloaded, "www.example.com"))->block);
+    EXPECT_FALSE(SrsVerdictGuard(cache.fetch(policy, "www.other.com"))->block);
+    EXPECT_TRUE(stale->block);
+    EXPECT_EQ(1, cache.size());
+
+    // Disabled.
+    cache.set_capacity(0);
+    EXPECT_EQ(0, cache.size());
+    EXPECT_TRUE(SrsVerdictGuard(cache.fetch(policy, "www.example.com"))->block);
+    EXPECT_EQ(0, cache.size());
+
+    reloaded->release();
+    policy->release();
+}
@@ -0,0 +1,494 @@
+#include <srs_utest_app_http_cache.hpp>
+#include <srs_app_http_cache.hpp>
+#include <srs_app_http_revalidator.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_utest_protocol.hpp>
+#include <srs_utest_http.hpp>
+
+using namespace std;
+
+MockHttpCache::MockHttpCache()
+{
+    now_ = MOCK_HTTP_CACHE_NOW;
+}
+
+MockHttpCache::~MockHttpCache()
+{
+}
+
+time_t MockHttpCache::now()
+{
+    return now_;
+}
+
+string mock_http_cache_request(string path, string headers)
+{
+    return "GET " + path + " HTTP/1.1\r\nHost: example.com\r\n" + headers + "\r\n";
+}
+
+string mock_http_cache_response(string headers, string body)
+{
+    return "HTTP/1.1 200 OK\r\nDate: Sun, 06 Nov 1994 08:49:37 GMT\r\nConnection: keep-alive\r\n" + headers
+        + "Content-Length: " + srs_int2str(body.length()) + "\r\n\r\n";
+}
+
+bool mock_http_cache_store(SrsHttpCache* cache, string req, string resp, string body)
+{
+    MockHttpParsedMessage r(HTTP_REQUEST, req);
+    MockHttpParsedMessage w(HTTP_RESPONSE, resp);
+    if (!r.msg || !w.msg) {
+        return false;
+    }
+
+    SrsHttpCacheWriter* writer = cache->store(r.msg, w.msg, srs_http_cache_key(false, r.msg), cache->now());
+    SrsAutoFree(SrsHttpCacheWriter, writer);
+    if (!writer) {
+        return false;
+    }
+
+    writer->append(body.data(), body.length());
+    return writer->commit();
+}
+
+string mock_http_cache_serve(SrsHttpCache* cache, string req, bool keep_alive)
+{
+    MockHttpParsedMessage r(HTTP_REQUEST, req);
+    SrsHttpCacheState state = SrsHttpCacheMiss;
+    SrsHttpCacheObject* obj = cache->lookup(r.msg, srs_http_cache_key(false, r.msg), state);
+    if (!obj) {
+        return "";
+    }
+    if (state != SrsHttpCacheFresh) {
+        cache->release(obj);
+        return "";
+    }
+
+    MockBufferIO out;
+    srs_error_t err = cache->serve(&out, r.msg, obj, keep_alive, NULL);
+    cache->release(obj);
+    if (err != srs_success) {
+        srs_freep(err);
+        return "";
+    }
+    return string(out.out_buffer.bytes(), out.out_buffer.length());
+}
+
+// Get the state of cached object for request.
+static SrsHttpCacheState mock_http_cache_state(SrsHttpCache* cache, string req)
+{
+    MockHttpParsedMessage r(HTTP_REQUEST, req);
+    SrsHttpCacheState state = SrsHttpCacheMiss;
+    SrsHttpCacheObject* obj = cache->lookup(r.msg, srs_http_cache_key(false, r.msg), state);
+    if (obj) {
+        cache->release(obj);
+    }
+    return state;
+}
+
+VOID TEST(SrsHttpCache, ParseCacheControl)
+{
+    SrsHttpCacheControl cc;
+    cc.parse("public, Max-Age=60 , s-maxage=\"120\", no-cache=\"Set-Cookie\", unknown=1, min-fresh=-5");
+    EXPECT_TRUE(cc.public_);
+    EXPECT_TRUE(cc.no_cache);
+    EXPECT_FALSE(cc.no_store);
+    EXPECT_FALSE(cc.private_);
+    EXPECT_EQ(60, cc.max_age);
+    EXPECT_EQ(120, cc.s_maxage);
+    EXPECT_EQ(0, cc.min_fresh);
+
+    SrsHttpCacheControl empty;
+    empty.parse("");
+    EXPECT_FALSE(empty.no_cache);
+    EXPECT_EQ(-1, empty.max_age);
+    EXPECT_EQ(-1, empty.s_maxage);
+
+    SrsHttpCacheControl cc2;
+    cc2.parse("private,no-store,must-revalidate,proxy-revalidate");
+    EXPECT_TRUE(cc2.private_);
+    EXPECT_TRUE(cc2.no_store);
+    EXPECT_TRUE(cc2.must_revalidate);
+    EXPECT_TRUE(cc2.proxy_revalidate);
+}
+
+VOID TEST(SrsHttpCache, ParseDate)
+{
+    EXPECT_EQ(MOCK_HTTP_CACHE_NOW, srs_http_cache_parse_date("Sun, 06 Nov 1994 08:49:37 GMT"));
+    EXPECT_EQ(MOCK_HTTP_CACHE_NOW, srs_http_cache_parse_date("Sunday, 06-Nov-94 08:49:37 GMT"));
+    EXPECT_EQ(MOCK_HTTP_CACHE_NOW, srs_http_cache_parse_date("Sun Nov  6 08:49:37 1994"));
+    EXPECT_EQ(0, srs_http_cache_parse_date("0"));
+    EXPECT_EQ(0, srs_http_cache_parse_date(""));
+    EXPECT_EQ(0, srs_http_cache_parse_date("Sun, 06 Nov 1994 08:49:37 GMT trailing"));
+}
+
+VOID TEST(SrsHttpCache, StoreAndServe)
+{
+    MockHttpCache cache;
+    cache.initialize(1024 * 1024, 64 * 1024);
+
+    string req = mock_http_cache_request("/index.html?v=1", "");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\nETag: \"v1\"\r\n", "Hello"), "Hello"));
+    EXPECT_EQ(1, cache.size());
+    EXPECT_EQ(SRS_HTTP_CACHE_SEGMENT, cache.bytes());
+
+    cache.now_ += 10;
+    string res = mock_http_cache_serve(&cache, req);
+    EXPECT_TRUE(srs_string_starts_with(res, "HTTP/1.1 200 OK\r\n"));
+    EXPECT_TRUE(srs_string_contains(res, "\r\nETag: \"v1\"\r\n"));
+    EXPECT_TRUE(srs_string_contains(res, "\r\nAge: 10\r\n"));
+    EXPECT_TRUE(srs_string_contains(res, "\r\nContent-Length: 5\r\n"));
+    EXPECT_FALSE(srs_string_contains(res, "keep-alive"));
+    EXPECT_TRUE(srs_string_ends_with(res, "\r\n\r\nHello"));
+
+    // The client is not keep-alive.
+    res = mock_http_cache_serve(&cache, req, false);
+    EXPECT_TRUE(srs_string_contains(res, "\r\nConnection: close\r\n"));
+
+    // The query is part of key.
+    EXPECT_TRUE(mock_http_cache_serve(&cache, mock_http_cache_request("/index.html?v=2", "")).empty());
+    // The client requires the validation of origin.
+    EXPECT_TRUE(mock_http_cache_serve(&cache, mock_http_cache_request("/index.html?v=1", "Cache-Control: no-cache\r\n")).empty());
+    EXPECT_TRUE(mock_http_cache_serve(&cache, mock_http_cache_request("/index.html?v=1", "Pragma: no-cache\r\n")).empty());
+    EXPECT_TRUE(mock_http_cache_serve(&cache, mock_http_cache_request("/index.html?v=1", "Cache-Control: max-age=5\r\n")).empty());
+    EXPECT_TRUE(mock_http_cache_serve(&cache, mock_http_cache_request("/index.html?v=1", "Cache-Control: min-fresh=55\r\n")).empty());
+    EXPECT_FALSE(mock_http_cache_serve(&cache, mock_http_cache_request("/index.html?v=1", "Cache-Control: min-fresh=30\r\n")).empty());
+
+    // Stale after max-age.
+    cache.now_ += 50;
+    EXPECT_TRUE(mock_http_cache_serve(&cache, req).empty());
+}
+
+VOID TEST(SrsHttpCache, Freshness)
+{
+    MockHttpCache cache;
+    cache.initialize(1024 * 1024, 64 * 1024);
+
+    // The s-maxage overrides max-age.
+    string req = mock_http_cache_request("/a", "");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=10, s-maxage=100\r\n", "a"), "a"));
+    cache.now_ += 50;
+    EXPECT_FALSE(mock_http_cache_serve(&cache, req).empty());
+
+    // The Age from upstream cache is counted.
+    cache.now_ = MOCK_HTTP_CACHE_NOW;
+    req = mock_http_cache_request("/b", "");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\nAge: 50\r\n", "b"), "b"));
+    EXPECT_TRUE(srs_string_contains(mock_http_cache_serve(&cache, req), "\r\nAge: 50\r\n"));
+    cache.now_ += 10;
+    EXPECT_TRUE(mock_http_cache_serve(&cache, req).empty());
+
+    // The Expires relative to Date.
+    cache.now_ = MOCK_HTTP_CACHE_NOW;
+    req = mock_http_cache_request("/c", "");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, mock_http_cache_response("Expires: Sun, 06 Nov 1994 08:50:37 GMT\r\n", "c"), "c"));
+    cache.now_ += 59;
+    EXPECT_FALSE(mock_http_cache_serve(&cache, req).empty());
+    cache.now_ += 1;
+    EXPECT_TRUE(mock_http_cache_serve(&cache, req).empty());
+
+    // The heuristic freshness is 10% of the time since Last-Modified.
+    cache.now_ = MOCK_HTTP_CACHE_NOW;
+    req = mock_http_cache_request("/d", "");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, mock_http_cache_response("Last-Modified: Sun, 06 Nov 1994 08:39:37 GMT\r\n", "d"), "d"));
+    cache.now_ += 59;
+    EXPECT_FALSE(mock_http_cache_serve(&cache, req).empty());
+    cache.now_ += 1;
+    EXPECT_TRUE(mock_http_cache_serve(&cache, req).empty());
+}
+
+VOID TEST(SrsHttpCache, NotCacheable)
+{
+    MockHttpCache cache;
+    cache.initialize(1024 * 1024, 64 * 1024);
+
+    string req = mock_http_cache_request("/", "");
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: no-store, max-age=60\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: private, max-age=60\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: no-cache, max-age=60\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=0\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Expires: 0\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\nVary: *\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\nSet-Cookie: id=1\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\nSET-COOKIE: id=1\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\nset-Cookie: id=1\r\n", "a"), "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\nContent-Range: bytes 0-0/2\r\n", "a"), "a"));
+
+    // The request with credential, or not GET.
+    string resp = mock_http_cache_response("Cache-Control: max-age=60\r\n", "a");
+    EXPECT_FALSE(mock_http_cache_store(&cache, mock_http_cache_request("/", "Authorization: Basic YTpi\r\n"), resp, "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, mock_http_cache_request("/", "Cache-Control: no-store\r\n"), resp, "a"));
+    EXPECT_FALSE(mock_http_cache_store(&cache, "HEAD / HTTP/1.1\r\nHost: example.com\r\n\r\n", resp, "a"));
+
+    // The status without explicit freshness.
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, "HTTP/1.1 302 Found\r\nLocation: /a\r\nLast-Modified: Sun, 06 Nov 1994 08:39:37 GMT\r\nContent-Length: 0\r\n\r\n", ""));
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, "HTTP/1.1 302 Found\r\nLocation: /a\r\nCache-Control: max-age=60\r\nContent-Length: 0\r\n\r\n", ""));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, "HTTP/1.1 500 Internal Server Error\r\nCache-Control: max-age=60\r\nContent-Length: 0\r\n\r\n", ""));
+    EXPECT_EQ(1, cache.size());
+
+    // The disabled cache.
+    MockHttpCache disabled;
+    EXPECT_FALSE(mock_http_cache_store(&disabled, req, resp, "a"));
+}
+
+VOID TEST(SrsHttpCache, Vary)
+{
+    MockHttpCache cache;
+    cache.initialize(1024 * 1024, 64 * 1024);
+
+    string resp = mock_http_cache_response("Cache-Control: max-age=60\r\nVary: accept-encoding\r\n", "gz");
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_http_cache_request("/", "Accept-Encoding: gzip, br\r\n"), resp, "gz"));
+    resp = mock_http_cache_response("Cache-Control: max-age=60\r\nVary: accept-encoding\r\n", "id");
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_http_cache_request("/", ""), resp, "id"));
+    EXPECT_EQ(2, cache.size());
+
+    EXPECT_TRUE(srs_string_ends_with(mock_http_cache_serve(&cache, mock_http_cache_request("/", "Accept-Encoding: gzip,br\r\n")), "gz"));
+    EXPECT_TRUE(srs_string_ends_with(mock_http_cache_serve(&cache, mock_http_cache_request("/", "")), "id"));
+    EXPECT_TRUE(mock_http_cache_serve(&cache, mock_http_cache_request("/", "Accept-Encoding: br\r\n")).empty());
+}
+
+VOID TEST(SrsHttpCache, NotModified)
+{
+    MockHttpCache cache;
+    cache.initialize(1024 * 1024, 64 * 1024);
+
+    string resp = mock_http_cache_response("Cache-Control: max-age=60\r\nETag: W/\"v1\"\r\nLast-Modified: Sun, 06 Nov 1994 08:39:37 GMT\r\nContent-Type: text/plain\r\n", "Hello");
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_http_cache_request("/", ""), resp, "Hello"));
+
+    string res = mock_http_cache_serve(&cache, mock_http_cache_request("/", "If-None-Match: \"v0\", \"v1\"\r\n"));
+    EXPECT_TRUE(srs_string_starts_with(res, "HTTP/1.1 304 Not Modified\r\n"));
+    EXPECT_TRUE(srs_string_contains(res, "\r\nETag: W/\"v1\"\r\n"));
+    EXPECT_FALSE(srs_string_contains(res, "Content-"));
+    EXPECT_TRUE(srs_string_ends_with(res, "\r\n\r\n"));
+
+    // The If-None-Match takes precedence over If-Modified-Since.
+    res = mock_http_cache_serve(&cache, mock_http_cache_request("/", "If-None-Match: \"v0\"\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n"));
+    EXPECT_TRUE(srs_string_starts_with(res, "HTTP/1.1 200 OK\r\n"));
+
+    res = mock_http_cache_serve(&cache, mock_http_cache_request("/", "If-Modified-Since: Sun, 06 Nov 1994 08:39:37 GMT\r\n"));
+    EXPECT_TRUE(srs_string_starts_with(res, "HTTP/1.1 304 Not Modified\r\n"));
+    res = mock_http_cache_serve(&cache, mock_http_cache_request("/", "If-Modified-Since: Sun, 06 Nov 1994 08:39:36 GMT\r\n"));
+    EXPECT_TRUE(srs_string_starts_with(res, "HTTP/1.1 200 OK\r\n"));
+}
+
+VOID TEST(SrsHttpCache, SegmentedLRU)
+{
+    MockHttpCache cache;
+    cache.initialize(4 * SRS_HTTP_CACHE_SEGMENT, 2 * SRS_HTTP_CACHE_SEGMENT);
+
+    string resp = mock_http_cache_response("Cache-Control: max-age=60\r\n", "a");
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_http_cache_request("/a", ""), resp, "a"));
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_http_cache_request("/b", ""), resp, "a"));
+
+    // The hit object is protected, so the one-hit objects are evicted first.
+    EXPECT_FALSE(mock_http_cache_serve(&cache, mock_http_cache_request("/a", "")).empty());
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_http_cache_request("/c", ""), resp, "a"));
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_http_cache_request("/d", ""), resp, "a"));
+    EXPECT_TRUE(mock_http_cache_store(&cache, mock_http_cache_request("/e", ""), resp, "a"));
+    EXPECT_EQ(4, cache.size());
+    EXPECT_EQ(4 * SRS_HTTP_CACHE_SEGMENT, cache.bytes());
+
+    EXPECT_FALSE(mock_http_cache_serve(&cache, mock_http_cache_request("/a", "")).empty());
+    EXPECT_TRUE(mock_http_cache_serve(&cache, mock_http_cache_request("/b", "")).empty());
+    EXPECT_FALSE(mock_http_cache_serve(&cache, mock_http_cache_request("/c", "")).empty());
+
+    // The object larger than max object is dropped.
+    string body(2 * SRS_HTTP_CACHE_SEGMENT + 1, 'x');
+    EXPECT_FALSE(mock_http_cache_store(&cache, mock_http_cache_request("/f", ""), mock_http_cache_response("Cache-Control: max-age=60\r\n", body), body));
+    EXPECT_EQ(4, cache.size());
+}
+
+VOID TEST(SrsHttpCache, WriterAndRelease)
+{
+    MockHttpCache cache;
+    cache.initialize(1024 * 1024, 64 * 1024);
+
+    // The chunked body larger than max object, or truncated body, is dropped.
+    string req = mock_http_cache_request("/", "");
+    string body(64 * 1024 + 1, 'x');
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, "HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\nTransfer-Encoding: chunked\r\n\r\n", body));
+    EXPECT_FALSE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\n", "Hello"), "Hel"));
+    EXPECT_EQ(0, cache.size());
+    EXPECT_EQ(0, cache.bytes());
+
+    // The chunked body in segments.
+    body = string(SRS_HTTP_CACHE_SEGMENT + 10, 'y');
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, "HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\nTransfer-Encoding: chunked\r\n\r\n", body));
+    EXPECT_EQ(2 * SRS_HTTP_CACHE_SEGMENT, cache.bytes());
+    string res = mock_http_cache_serve(&cache, req);
+    EXPECT_FALSE(srs_string_contains(res, "chunked"));
+    EXPECT_TRUE(srs_string_contains(res, "\r\nContent-Length: 4106\r\n"));
+    EXPECT_TRUE(srs_string_ends_with(res, "\r\n\r\n" + body));
+
+    // The object in use is freed when released, even if it's replaced.
+    MockHttpParsedMessage r(HTTP_REQUEST, req);
+    SrsHttpCacheState state = SrsHttpCacheMiss;
+    SrsHttpCacheObject* obj = cache.lookup(r.msg, srs_http_cache_key(false, r.msg), state);
+    ASSERT_TRUE(obj != NULL);
+    EXPECT_EQ(SrsHttpCacheFresh, state);
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: max-age=60\r\n", "Hello"), "Hello"));
+    EXPECT_EQ(1, cache.size());
+    EXPECT_EQ(3 * SRS_HTTP_CACHE_SEGMENT, cache.bytes());
+    EXPECT_EQ(SRS_HTTP_CACHE_SEGMENT + 10, obj->size);
+    cache.release(obj);
+    EXPECT_EQ(SRS_HTTP_CACHE_SEGMENT, cache.bytes());
+    EXPECT_TRUE(srs_string_ends_with(mock_http_cache_serve(&cache, req), "Hello"));
+}
+
+VOID TEST(SrsHttpCache, Revalidate)
+{
+    MockHttpCache cache;
+    cache.initialize(1024 * 1024, 64 * 1024);
+
+    string req = mock_http_cache_request("/", "");
+    string resp = mock_http_cache_response("Cache-Control: max-age=10\r\nETag: \"v1\"\r\nLast-Modified: Sun, 06 Nov 1994 08:39:37 GMT\r\nX-Version: 1\r\n", "Hello");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, resp, "Hello"));
+    EXPECT_EQ(SrsHttpCacheFresh, mock_http_cache_state(&cache, req));
+
+    // The stale object is validated by the validators of it.
+    cache.now_ += 20;
+    MockHttpParsedMessage r(HTTP_REQUEST, req);
+    SrsHttpCacheState state = SrsHttpCacheMiss;
+    SrsHttpCacheObject* obj = cache.lookup(r.msg, srs_http_cache_key(false, r.msg), state);
+    ASSERT_TRUE(obj != NULL);
+    EXPECT_EQ(SrsHttpCacheRevalidate, state);
+
+    string header = cache.conditional(r.msg, obj);
+    EXPECT_TRUE(srs_string_starts_with(header, "GET / HTTP/1.1\r\n"));
+    EXPECT_TRUE(srs_string_contains(header, "\r\nIf-None-Match: \"v1\"\r\n"));
+    EXPECT_TRUE(srs_string_ends_with(header, "\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:39:37 GMT\r\n\r\n"));
+
+    // The 304 updates the headers and freshness, the body is kept.
+    MockHttpParsedMessage w(HTTP_RESPONSE, "HTTP/1.1 304 Not Modified\r\nDate: Sun, 06 Nov 1994 08:49:57 GMT\r\nCache-Control: max-age=60\r\nETag: \"v1\"\r\nX-Version: 2\r\n\r\n");
+    cache.refresh(obj, w.msg, cache.now_);
+    cache.release(obj);
+
+    EXPECT_EQ(SrsHttpCacheFresh, mock_http_cache_state(&cache, req));
+    string res = mock_http_cache_serve(&cache, req);
+    EXPECT_TRUE(srs_string_contains(res, "\r\nX-Version: 2\r\n"));
+    EXPECT_FALSE(srs_string_contains(res, "X-Version: 1"));
+    EXPECT_TRUE(srs_string_contains(res, "\r\nLast-Modified: Sun, 06 Nov 1994 08:39:37 GMT\r\n"));
+    EXPECT_TRUE(srs_string_contains(res, "\r\nAge: 0\r\n"));
+    EXPECT_TRUE(srs_string_ends_with(res, "\r\n\r\nHello"));
+
+    cache.now_ += 60;
+    EXPECT_EQ(SrsHttpCacheRevalidate, mock_http_cache_state(&cache, req));
+
+    // The conditional request of client is forwarded as is.
+    EXPECT_EQ(SrsHttpCacheMiss, mock_http_cache_state(&cache, mock_http_cache_request("/", "If-None-Match: \"v0\"\r\n")));
+
+    // The Set-Cookie of 304 is never merged into the shared object.
+    if (true) {
+        MockHttpParsedMessage r(HTTP_REQUEST, req);
+        SrsHttpCacheState state = SrsHttpCacheMiss;
+        SrsHttpCacheObject* obj = cache.lookup(r.msg, srs_http_cache_key(false, r.msg), state);
+        ASSERT_TRUE(obj != NULL);
+
+        MockHttpParsedMessage w(HTTP_RESPONSE, "HTTP/1.1 304 Not Modified\r\nDate: Sun, 06 Nov 1994 08:50:37 GMT\r\nCache-Control: max-age=60\r\nSet-Cookie: id=1\r\nSET-COOKIE: id=2\r\n\r\n");
+        cache.refresh(obj, w.msg, cache.now_);
+        cache.release(obj);
+
+        EXPECT_EQ(SrsHttpCacheFresh, mock_http_cache_state(&cache, req));
+        string res = mock_http_cache_serve(&cache, req);
+        EXPECT_FALSE(srs_string_contains(srs_string_to_lower(res), "set-cookie"));
+        EXPECT_TRUE(srs_string_ends_with(res, "\r\n\r\nHello"));
+    }
+
+    // The modified object is removed.
+    cache.invalidate(srs_http_cache_key(false, r.msg));
+    EXPECT_EQ(0, cache.size());
+}
+
+VOID TEST(SrsHttpCache, StaleWhileRevalidate)
+{
+    srs_error_t err = srs_success;
+
+    MockHttpCache cache;
+    cache.initialize(1024 * 1024, 64 * 1024);
+
+    string req = mock_http_cache_request("/", "");
+    string resp = mock_http_cache_response("Cache-Control: max-age=10, stale-while-revalidate=30\r\nETag: \"v1\"\r\n", "Hello");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, resp, "Hello"));
+
+    cache.now_ += 20;
+    if (true) {
+        MockHttpParsedMessage r(HTTP_REQUEST, req);
+        SrsHttpCacheState state = SrsHttpCacheMiss;
+        SrsHttpCacheObject* obj = cache.lookup(r.msg, srs_http_cache_key(false, r.msg), state);
+        ASSERT_TRUE(obj != NULL);
+        EXPECT_EQ(SrsHttpCacheStale, state);
+
+        MockBufferIO out;
+        HELPER_EXPECT_SUCCESS(cache.serve(&out, r.msg, obj, true, NULL));
+        cache.release(obj);
+        string res(out.out_buffer.bytes(), out.out_buffer.length());
+        EXPECT_TRUE(srs_string_contains(res, "\r\nAge: 20\r\nWarning: 110 - \"Response is Stale\"\r\n"));
+    }
+
+    // The client requires the fresh response.
+    EXPECT_EQ(SrsHttpCacheRevalidate, mock_http_cache_state(&cache, mock_http_cache_request("/", "Cache-Control: max-age=0\r\n")));
+    EXPECT_EQ(SrsHttpCacheRevalidate, mock_http_cache_state(&cache, mock_http_cache_request("/", "Pragma: no-cache\r\n")));
+
+    // Out of the window of stale-while-revalidate.
+    cache.now_ += 21;
+    EXPECT_EQ(SrsHttpCacheRevalidate, mock_http_cache_state(&cache, req));
+
+    // Never serve stale, if must-revalidate.
+    cache.now_ = MOCK_HTTP_CACHE_NOW;
+    req = mock_http_cache_request("/a", "");
+    resp = mock_http_cache_response("Cache-Control: max-age=10, stale-while-revalidate=30, must-revalidate\r\nETag: \"v1\"\r\n", "a");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, resp, "a"));
+    cache.now_ += 20;
+    EXPECT_EQ(SrsHttpCacheRevalidate, mock_http_cache_state(&cache, req));
+
+    // The no-cache response with validators is stored, but always revalidated.
+    cache.now_ = MOCK_HTTP_CACHE_NOW;
+    req = mock_http_cache_request("/b", "");
+    EXPECT_TRUE(mock_http_cache_store(&cache, req, mock_http_cache_response("Cache-Control: no-cache\r\nETag: \"v1\"\r\n", "b"), "b"));
+    EXPECT_EQ(SrsHttpCacheRevalidate, mock_http_cache_state(&cache, req));
+
+    // The stale response without validators is never stored.
+    EXPECT_FALSE(mock_http_cache_store(&cache, mock_http_cache_request("/c", ""), mock_http_cache_response("Cache-Control: max-age=0\r\n", "c"), "c"));
+}
+
+static int mock_http_revalidator_pending(SrsHttpRevalidator* revalidator)
+{
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    revalidator->dumps(obj);
+    return (int)obj->get_property("pending")->to_integer();
+}
+
+VOID TEST(SrsHttpRevalidator, QueueOnce)
+{
+    srs_error_t err = srs_success;
+
+    MockHttpCache cache;
+    SrsHttpRevalidator revalidator(&cache);
+
+    // Not started.
+    EXPECT_FALSE(revalidator.revalidate("key", "GET / HTTP/1.1\r\n\r\n", false, "127.0.0.1", 1));
+
+    HELPER_EXPECT_SUCCESS(revalidator.initialize(1));
+    EXPECT_TRUE(revalidator.revalidate("key", "GET / HTTP/1.1\r\n\r\n", false, "127.0.0.1", 1));
+    EXPECT_TRUE(revalidator.revalidate("key", "GET / HTTP/1.1\r\n\r\n", false, "127.0.0.1", 1));
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    revalidator.dumps(obj);
+    EXPECT_EQ(1, obj->get_property("queued")->to_integer());
+
+    // The connection is refused, the error is ignored.
+    for (int i = 0; i < 100 && mock_http_revalidator_pending(&revalidator) > 0; i++) {
+        srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+    }
+
+    SrsJsonObject* done = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, done);
+    revalidator.dumps(done);
+    EXPECT_EQ(0, done->get_property("pending")->to_integer());
+    EXPECT_EQ(1, done->get_property("errors")->to_integer());
+}
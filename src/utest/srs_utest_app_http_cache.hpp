@@ -0,0 +1,30 @@
+#ifndef SRS_UTEST_APP_HTTP_CACHE_HPP
+#define SRS_UTEST_APP_HTTP_CACHE_HPP
+#include <srs_utest_main.hpp>
+
+#include <srs_app_http_cache.hpp>
+
+// The Date of responses, that is "Sun, 06 Nov 1994 08:49:37 GMT".
+#define MOCK_HTTP_CACHE_NOW 784111777
+
+// The cache with mocked clock.
+class MockHttpCache : public SrsHttpCache
+{
+public:
+    time_t now_;
+public:
+    MockHttpCache();
+    virtual ~MockHttpCache();
+public:
+    virtual time_t now();
+};
+
+// The GET request of example.com, and the 200 response with Date of MOCK_HTTP_CACHE_NOW.
+std::string mock_http_cache_request(std::string path, std::string headers);
+std::string mock_http_cache_response(std::string headers, std::string body);
+// Store the response of request, return whether it's stored.
+bool mock_http_cache_store(SrsHttpCache* cache, std::string req, std::string resp, std::string body);
+// Serve the request from cache, return the response, or empty if miss.
+std::string mock_http_cache_serve(SrsHttpCache* cache, std::string req, bool keep_alive = true);
+
+#endif
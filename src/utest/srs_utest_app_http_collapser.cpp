@@ -0,0 +1,299 @@
+#include <srs_utest_app_http_collapser.hpp>
+#include <srs_app_http_collapser.hpp>
+#include <srs_app_http_cache.hpp>
+#include <srs_app_st.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_utest_protocol.hpp>
+#include <srs_utest_http.hpp>
+
+using namespace std;
+
+// The follower client, which relays the response of leader to out.
+class MockHttpFollower : public ISrsCoroutineHandler
+{
+public:
+    SrsHttpCollapser* collapser;
+    SrsHttpInflight* flight;
+    MockHttpParsedMessage req;
+    MockBufferIO out;
+    SrsSTCoroutine trd;
+    srs_error_t err;
+    int status;
+    bool fallback;
+    bool done;
+public:
+    MockHttpFollower(SrsHttpCollapser* c, string r) : req(HTTP_REQUEST, r), trd("utest-follower", this) {
+        collapser = c;
+        err = srs_success;
+        status = 0;
+        fallback = false;
+        done = false;
+
+        bool leader = true;
+        flight = collapser->join(req.msg, srs_http_cache_key(false, req.msg), leader);
+    }
+    virtual ~MockHttpFollower() {
+        trd.stop();
+        srs_freep(err);
+    }
+    virtual srs_error_t cycle() {
+        err = flight->follow(&out, req.msg, &status, fallback);
+        collapser->release(flight);
+        done = true;
+        return srs_success;
+    }
+    string output() {
+        return string(out.out_buffer.bytes(), out.out_buffer.length());
+    }
+};
+
+static string mock_http_collapse_request(string headers)
+{
+    return "GET /index.html HTTP/1.1\r\nHost: example.com\r\n" + headers + "\r\n";
+}
+
+VOID TEST(SrsHttpCollapser, Join)
+{
+    SrsHttpCollapser c;
+    MockHttpParsedMessage r(HTTP_REQUEST, mock_http_collapse_request(""));
+    string key = srs_http_cache_key(false, r.msg);
+
+    // Never coalesce if disabled.
+    bool leader = false;
+    EXPECT_TRUE(c.join(r.msg, key, leader) == NULL);
+
+    c.initialize(1024, 100 * SRS_UTIME_MILLISECONDS);
+    SrsHttpInflight* f0 = c.join(r.msg, key, leader);
+    ASSERT_TRUE(f0 != NULL);
+    EXPECT_TRUE(leader);
+
+    SrsHttpInflight* f1 = c.join(r.msg, key, leader);
+    EXPECT_TRUE(f1 == f0);
+    EXPECT_FALSE(leader);
+    EXPECT_EQ(1, c.size());
+
+    // The requests for the client only.
+    if (true) {
+        MockHttpParsedMessage m(HTTP_REQUEST, mock_http_collapse_request("Cookie: id=1\r\n"));
+        EXPECT_TRUE(c.join(m.msg, key, leader) == NULL);
+    }
+    if (true) {
+        MockHttpParsedMessage m(HTTP_REQUEST, mock_http_collapse_request("Range: bytes=0-1\r\n"));
+        EXPECT_TRUE(c.join(m.msg, key, leader) == NULL);
+    }
+    if (true) {
+        MockHttpParsedMessage m(HTTP_REQUEST, mock_http_collapse_request("If-None-Match: \"v1\"\r\n"));
+        EXPECT_TRUE(c.join(m.msg, key, leader) == NULL);
+    }
+    if (true) {
+        MockHttpParsedMessage m(HTTP_REQUEST, "POST /index.html HTTP/1.1\r\nHost: example.com\r\nContent-Length: 0\r\n\r\n");
+        EXPECT_TRUE(c.join(m.msg, key, leader) == NULL);
+    }
+
+    // The new request is the leader of a new flight, after the flight is done.
+    f0->on_done();
+    EXPECT_EQ(0, c.size());
+    SrsHttpInflight* f2 = c.join(r.msg, key, leader);
+    EXPECT_TRUE(leader);
+    EXPECT_TRUE(f2 != f0);
+
+    c.release(f1);
+    c.leave(f0);
+    c.leave(f2);
+    EXPECT_EQ(0, c.size());
+}
+
+VOID TEST(SrsHttpCollapser, RelayToFollowers)
+{
+    srs_error_t err = srs_success;
+
+    SrsHttpCollapser c;
+    c.initialize(1024, 100 * SRS_UTIME_MILLISECONDS);
+
+    MockHttpParsedMessage r(HTTP_REQUEST, mock_http_collapse_request(""));
+    bool leader = false;
+    SrsHttpInflight* flight = c.join(r.msg, srs_http_cache_key(false, r.msg), leader);
+    ASSERT_TRUE(leader);
+    SrsHttpInflightGuard guard(flight);
+
+    MockHttpFollower f0(&c, mock_http_collapse_request(""));
+    MockHttpFollower f1(&c, mock_http_collapse_request(""));
+    ASSERT_TRUE(f0.flight == flight && f1.flight == flight);
+    HELPER_EXPECT_SUCCESS(f0.trd.start());
+    srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+
+    string header = "HTTP/1.1 200 OK\r\nContent-Length: 11\r\n\r\n";
+    MockHttpParsedMessage w(HTTP_RESPONSE, header);
+    flight->on_header(r.msg, w.msg);
+    flight->on_body("hello", 5);
+    srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+    EXPECT_STREQ((header + "hello").c_str(), f0.output().c_str());
+
+    // The late follower gets the received body at once.
+    HELPER_EXPECT_SUCCESS(f1.trd.start());
+    flight->on_body(" world", 6);
+    flight->on_done();
+    srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+
+    EXPECT_TRUE(f0.done && f1.done);
+    HELPER_EXPECT_SUCCESS(srs_error_copy(f0.err));
+    HELPER_EXPECT_SUCCESS(srs_error_copy(f1.err));
+    EXPECT_FALSE(f0.fallback);
+    EXPECT_EQ(200, f0.status);
+    EXPECT_STREQ((header + "hello world").c_str(), f0.output().c_str());
+    EXPECT_STREQ((header + "hello world").c_str(), f1.output().c_str());
+}
+
+VOID TEST(SrsHttpCollapser, RelayChunked)
+{
+    srs_error_t err = srs_success;
+
+    SrsHttpCollapser c;
+    c.initialize(1024, 100 * SRS_UTIME_MILLISECONDS);
+
+    MockHttpParsedMessage r(HTTP_REQUEST, mock_http_collapse_request(""));
+    bool leader = false;
+    SrsHttpInflight* flight = c.join(r.msg, srs_http_cache_key(false, r.msg), leader);
+    SrsHttpInflightGuard guard(flight);
+
+    MockHttpFollower f0(&c, mock_http_collapse_request(""));
+    HELPER_EXPECT_SUCCESS(f0.trd.start());
+
+    string header = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+    MockHttpParsedMessage w(HTTP_RESPONSE, header);
+    flight->on_header(r.msg, w.msg);
+    flight->on_body("hello", 5);
+    flight->on_body("0123456789abcdef", 16);
+    flight->on_done();
+    srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+
+    EXPECT_TRUE(f0.done);
+    HELPER_EXPECT_SUCCESS(srs_error_copy(f0.err));
+    EXPECT_STREQ((header + "5\r\nhello\r\n10\r\n0123456789abcdef\r\n0\r\n\r\n").c_str(), f0.output().c_str());
+}
+
+VOID TEST(SrsHttpCollapser, Fallback)
+{
+    srs_error_t err = srs_success;
+
+    SrsHttpCollapser c;
+    c.initialize(1024, 100 * SRS_UTIME_MILLISECONDS);
+
+    // The response with Set-Cookie in any case is for the leader only.
+    if (true) {
+        MockHttpParsedMessage r(HTTP_REQUEST, mock_http_collapse_request(""));
+        bool leader = false;
+        SrsHttpInflight* flight = c.join(r.msg, srs_http_cache_key(false, r.msg), leader);
+        SrsHttpInflightGuard guard(flight);
+
+        MockHttpFollower f0(&c, mock_http_collapse_request(""));
+        HELPER_EXPECT_SUCCESS(f0.trd.start());
+
+        MockHttpParsedMessage w(HTTP_RESPONSE, "HTTP/1.1 200 OK\r\nSET-COOKIE: id=1\r\nContent-Length: 0\r\n\r\n");
+        flight->on_header(r.msg, w.msg);
+        EXPECT_EQ(0, c.size());
+        srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+
+        EXPECT_TRUE(f0.done);
+        HELPER_EXPECT_SUCCESS(srs_error_copy(f0.err));
+        EXPECT_TRUE(f0.fallback);
+        EXPECT_EQ(0, (int)f0.out.out_buffer.length());
+        flight->on_done();
+    }
+
+    // The response varies by the header, which is different for the follower.
+    if (true) {
+        MockHttpParsedMessage r(HTTP_REQUEST, mock_http_collapse_request("Accept-Language: en\r\n"));
+        bool leader = false;
+        SrsHttpInflight* flight = c.join(r.msg, srs_http_cache_key(false, r.msg), leader);
+        SrsHttpInflightGuard guard(flight);
+
+        MockHttpFollower f0(&c, mock_http_collapse_request("Accept-Language: fr\r\n"));
+        MockHttpFollower f1(&c, mock_http_collapse_request("Accept-Language: en\r\n"));
+        HELPER_EXPECT_SUCCESS(f0.trd.start());
+        HELPER_EXPECT_SUCCESS(f1.trd.start());
+
+        MockHttpParsedMessage w(HTTP_RESPONSE, "HTTP/1.1 200 OK\r\nVary: Accept-Language\r\nContent-Length: 2\r\n\r\n");
+        flight->on_header(r.msg, w.msg);
+        flight->on_body("en", 2);
+        flight->on_done();
+        srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+
+        EXPECT_TRUE(f0.done && f1.done);
+        EXPECT_TRUE(f0.fallback);
+        EXPECT_FALSE(f1.fallback);
+        HELPER_EXPECT_SUCCESS(srs_error_copy(f1.err));
+        EXPECT_TRUE(srs_string_ends_with(f1.output(), "\r\n\r\nen"));
+    }
+}
+
+VOID TEST(SrsHttpCollapser, LeaderFailed)
+{
+    SrsHttpCollapser c;
+    c.initialize(8, 100 * SRS_UTIME_MILLISECONDS);
+
+    // The leader is disconnected from server, before the body is done.
+    if (true) {
+        MockHttpParsedMessage r(HTTP_REQUEST, mock_http_collapse_request(""));
+        MockHttpFollower* f0 = NULL;
+        SrsAutoFree(MockHttpFollower, f0);
+
+        if (true) {
+            bool leader = false;
+            SrsHttpInflight* flight = c.join(r.msg, srs_http_cache_key(false, r.msg), leader);
+            SrsHttpInflightGuard guard(flight);
+            EXPECT_TRUE(leader);
+
+            f0 = new MockHttpFollower(&c, mock_http_collapse_request(""));
+            EXPECT_TRUE(f0->flight == flight);
+            f0->trd.start();
+
+            MockHttpParsedMessage w(HTTP_RESPONSE, "HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\n");
+            flight->on_header(r.msg, w.msg);
+            flight->on_body("he", 2);
+        }
+        srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+
+        EXPECT_TRUE(f0->done);
+        EXPECT_TRUE(f0->err != srs_success);
+        EXPECT_EQ(0, c.size());
+    }
+
+    // The chunked body is larger than max buffer.
+    if (true) {
+        MockHttpParsedMessage r(HTTP_REQUEST, mock_http_collapse_request(""));
+        bool leader = false;
+        SrsHttpInflight* flight = c.join(r.msg, srs_http_cache_key(false, r.msg), leader);
+        SrsHttpInflightGuard guard(flight);
+
+        MockHttpFollower f0(&c, mock_http_collapse_request(""));
+        f0.trd.start();
+
+        MockHttpParsedMessage w(HTTP_RESPONSE, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+        flight->on_header(r.msg, w.msg);
+        flight->on_body("hello", 5);
+        flight->on_body("world", 5);
+        flight->on_done();
+        srs_usleep(1 * SRS_UTIME_MILLISECONDS);
+
+        EXPECT_TRUE(f0.done);
+        EXPECT_TRUE(f0.err != srs_success);
+    }
+
+    // The leader is too slow.
+    if (true) {
+        MockHttpParsedMessage r(HTTP_REQUEST, mock_http_collapse_request(""));
+        bool leader = false;
+        SrsHttpInflight* flight = c.join(r.msg, srs_http_cache_key(false, r.msg), leader);
+        SrsHttpInflightGuard guard(flight);
+
+        MockHttpFollower f0(&c, mock_http_collapse_request(""));
+        f0.trd.start();
+        srs_usleep(150 * SRS_UTIME_MILLISECONDS);
+
+        EXPECT_TRUE(f0.done);
+        EXPECT_TRUE(f0.err != srs_success);
+    }
+}
@@ -0,0 +1,120 @@
+#include <srs_utest_app_ip_matcher.hpp>
+#include <srs_app_ip_matcher.hpp>
+#include <srs_kernel_error.hpp>
+
+VOID TEST(SrsIpMatcher, ParseRule)
+{
+    uint8_t addr[16];
+    int bits = 0;
+
+    EXPECT_EQ(SrsIpVerdictDeny, srs_ip_rule_parse("1.1.1.1", addr, bits));
+    EXPECT_EQ(128, bits);
+    EXPECT_EQ(0xff, addr[10]);
+    EXPECT_EQ(1, addr[15]);
+    EXPECT_EQ(SrsIpVerdictAllow, srs_ip_rule_parse(" !10.0.0.0/8\r\n", addr, bits));
+    EXPECT_EQ(104, bits);
+    EXPECT_EQ(SrsIpVerdictDeny, srs_ip_rule_parse("2001:db8::/32", addr, bits));
+    EXPECT_EQ(32, bits);
+    EXPECT_EQ(SrsIpVerdictDeny, srs_ip_rule_parse("::/0", addr, bits));
+    EXPECT_EQ(0, bits);
+
+    EXPECT_EQ(SrsIpVerdictNone, srs_ip_rule_parse("", addr, bits));
+    EXPECT_EQ(SrsIpVerdictNone, srs_ip_rule_parse("1.1.1", addr, bits));
+    EXPECT_EQ(SrsIpVerdictNone, srs_ip_rule_parse("1.1.1.1/33", addr, bits));
+    EXPECT_EQ(SrsIpVerdictNone, srs_ip_rule_parse("1.1.1.1/", addr, bits));
+    EXPECT_EQ(SrsIpVerdictNone, srs_ip_rule_parse("::1/129", addr, bits));
+    EXPECT_EQ(SrsIpVerdictNone, srs_ip_rule_parse("example.com", addr, bits));
+}
+
+VOID TEST(SrsIpMatcher, LongestPrefix)
+{
+    srs_error_t err = srs_success;
+
+    SrsIpMatcher m;
+    EXPECT_EQ(SrsIpVerdictNone, m.match("1.1.1.1"));
+
+    HELPER_EXPECT_SUCCESS(m.add("10.0.0.0/8"));
+    HELPER_EXPECT_SUCCESS(m.add("!10.1.0.0/16"));
+    HELPER_EXPECT_SUCCESS(m.add("10.1.2.3"));
+    HELPER_EXPECT_SUCCESS(m.add("192.168.1.0/24"));
+    HELPER_EXPECT_SUCCESS(m.add("2001:db8::/32"));
+    HELPER_EXPECT_SUCCESS(m.add("!2001:db8:1::/48"));
+    HELPER_EXPECT_FAILED(m.add("10.0.0.0/40"));
+    EXPECT_EQ(6, m.size());
+
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("10.0.0.1"));
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("10.255.255.255"));
+    EXPECT_EQ(SrsIpVerdictAllow, m.match("10.1.0.1"));
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("10.1.2.3"));
+    EXPECT_EQ(SrsIpVerdictAllow, m.match("10.1.2.4"));
+    EXPECT_EQ(SrsIpVerdictNone, m.match("11.0.0.1"));
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("192.168.1.100"));
+    EXPECT_EQ(SrsIpVerdictNone, m.match("192.168.2.1"));
+
+    // The IPv4 mapped address is the same as IPv4.
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("::ffff:10.0.0.1"));
+    EXPECT_EQ(SrsIpVerdictAllow, m.match("::ffff:10.1.0.1"));
+
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("2001:db8::1"));
+    EXPECT_EQ(SrsIpVerdictAllow, m.match("2001:db8:1::1"));
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("2001:db8:2::1"));
+    EXPECT_EQ(SrsIpVerdictNone, m.match("2001:db9::1"));
+    EXPECT_EQ(SrsIpVerdictNone, m.match("invalid"));
+
+    // The later rule overwrites the same prefix.
+    HELPER_EXPECT_SUCCESS(m.add("!10.0.0.0/8"));
+    EXPECT_EQ(6, m.size());
+    EXPECT_EQ(SrsIpVerdictAllow, m.match("10.0.0.1"));
+}
+
+VOID TEST(SrsIpMatcher, DenyAllExcept)
+{
+    srs_error_t err = srs_success;
+
+    // Insert the wider prefix after the narrower one, to split the edge.
+    SrsIpMatcher m;
+    HELPER_EXPECT_SUCCESS(m.add("!172.16.0.0/12"));
+    HELPER_EXPECT_SUCCESS(m.add("!127.0.0.1"));
+    HELPER_EXPECT_SUCCESS(m.add("0.0.0.0/0"));
+    HELPER_EXPECT_SUCCESS(m.add("::/0"));
+
+    EXPECT_EQ(SrsIpVerdictAllow, m.match("172.16.0.1"));
+    EXPECT_EQ(SrsIpVerdictAllow, m.match("172.31.255.255"));
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("172.32.0.1"));
+    EXPECT_EQ(SrsIpVerdictAllow, m.match("127.0.0.1"));
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("127.0.0.2"));
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("8.8.8.8"));
+    EXPECT_EQ(SrsIpVerdictDeny, m.match("::1"));
+}
+
+VOID TEST(SrsIpMatcher, EncodeDecode)
+{
+    srs_error_t err = srs_success;
+
+    SrsIpMatcher m;
+    HELPER_EXPECT_SUCCESS(m.add("10.0.0.0/8"));
+    HELPER_EXPECT_SUCCESS(m.add("!10.1.0.0/16"));
+    HELPER_EXPECT_SUCCESS(m.add("2001:db8::/32"));
+
+    std::string data;
+    m.encode(data);
+    EXPECT_EQ(0, (int)(data.size() % 8));
+
+    // Use uint64_t to align the data as the mapped file.
+    std::vector<uint64_t> buf(data.size() / 8);
+    memcpy(&buf[0], data.data(), data.size());
+
+    SrsIpMatcher d;
+    size_t nread = 0;
+    HELPER_EXPECT_SUCCESS(d.decode((const char*)&buf[0], data.size(), &nread));
+    EXPECT_EQ(data.size(), nread);
+    EXPECT_EQ(3, d.size());
+    EXPECT_EQ(SrsIpVerdictDeny, d.match("10.0.0.1"));
+    EXPECT_EQ(SrsIpVerdictAllow, d.match("10.1.0.1"));
+    EXPECT_EQ(SrsIpVerdictDeny, d.match("2001:db8::1"));
+    EXPECT_EQ(SrsIpVerdictNone, d.match("1.1.1.1"));
+
+    // Truncated data.
+    HELPER_EXPECT_FAILED(d.decode((const char*)&buf[0], data.size() - 8, NULL));
+    HELPER_EXPECT_FAILED(d.decode((const char*)&buf[0], 4, NULL));
+}
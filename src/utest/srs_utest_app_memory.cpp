@@ -0,0 +1,77 @@
+#include <srs_utest_app_memory.hpp>
+#include <srs_app_memory.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_protocol_json.hpp>
+
+#include <vector>
+using namespace std;
+
+VOID TEST(SrsMemory, StatOfAllocator)
+{
+    SrsMemoryStat stat;
+    srs_memory_stat(stat);
+    EXPECT_FALSE(stat.allocator.empty());
+    EXPECT_GT(stat.rss, 0);
+    EXPECT_GE(stat.heap, stat.free);
+
+    // The allocated bytes grow with the live objects.
+    vector<char*> blocks;
+    for (int i = 0; i < 1024; i++) {
+        blocks.push_back(new char[1024]);
+    }
+    SrsMemoryStat allocated;
+    srs_memory_stat(allocated);
+    EXPECT_GE(allocated.allocated, stat.allocated + 1024 * 1024);
+
+    for (int i = 0; i < (int)blocks.size(); i++) {
+        char* p = blocks.at(i);
+        srs_freepa(p);
+    }
+    SrsMemoryStat freed;
+    srs_memory_stat(freed);
+    EXPECT_LT(freed.allocated, allocated.allocated);
+    EXPECT_GE(freed.fragmentation(), 0);
+    EXPECT_LE(freed.fragmentation(), 1);
+}
+
+VOID TEST(SrsMemory, ReleaseFreeMemory)
+{
+    SrsMemoryReleaser releaser;
+
+    // Free a large batch of small blocks, which are kept by allocator.
+    vector<char*> blocks;
+    for (int i = 0; i < 32 * 1024; i++) {
+        blocks.push_back(new char[512]);
+    }
+    for (int i = 0; i < (int)blocks.size(); i++) {
+        char* p = blocks.at(i);
+        srs_freepa(p);
+    }
+
+    releaser.release(0);
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    releaser.dumps(obj);
+
+    SrsJsonAny* prop = obj->get_property("release");
+    ASSERT_TRUE(prop && prop->is_object());
+    SrsJsonObject* release = prop->to_object();
+    EXPECT_FALSE(release->get_property("enabled")->to_boolean());
+    EXPECT_EQ(1, release->get_property("releases")->to_integer());
+    EXPECT_TRUE(obj->get_property("fragmentation")->is_number());
+}
+
+VOID TEST(SrsMemory, ReleaseOnlyWhenIdle)
+{
+    // The connections are growing.
+    EXPECT_FALSE(srs_memory_is_idle(11, 10, 0, 10 * SRS_UTIME_SECONDS, 10));
+
+    // The connections are not growing, but it's busy at the peak load.
+    EXPECT_FALSE(srs_memory_is_idle(10, 10, 101, 10 * SRS_UTIME_SECONDS, 10));
+    EXPECT_FALSE(srs_memory_is_idle(0, 10, 1, 10 * SRS_UTIME_SECONDS, 0));
+
+    // Not more than 10 requests per second.
+    EXPECT_TRUE(srs_memory_is_idle(10, 10, 100, 10 * SRS_UTIME_SECONDS, 10));
+    EXPECT_TRUE(srs_memory_is_idle(0, 10, 0, 10 * SRS_UTIME_SECONDS, 0));
+}
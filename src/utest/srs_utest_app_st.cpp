@@ -0,0 +1,127 @@
+#include <srs_utest_app_st.hpp>
+#include <srs_app_st.hpp>
+
+class MockSleepHandler : public ISrsCoroutineHandler
+{
+public:
+    SrsCoroutine* trd;
+public:
+    MockSleepHandler() {
+        trd = NULL;
+    }
+    virtual ~MockSleepHandler() {
+    }
+    virtual srs_error_t cycle() {
+        srs_error_t err = srs_success;
+        while (true) {
+            if ((err = trd->pull()) != srs_success) {
+                return srs_error_wrap(err, "pull");
+            }
+            srs_usleep(100 * SRS_UTIME_MILLISECONDS);
+        }
+        return err;
+    }
+};
+
+static bool mock_find_coroutine(std::string name, SrsCoroutineInfo& info)
+{
+    std::vector<SrsCoroutineInfo> infos;
+    SrsFastCoroutine::list(infos);
+    for (int i = 0; i < (int)infos.size(); i++) {
+        if (infos[i].name == name) {
+            info = infos[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+VOID TEST(SrsCoroutineIntrospection, ListLiveCoroutine)
+{
+    srs_error_t err = srs_success;
+
+    MockSleepHandler h;
+    SrsSTCoroutine trd("utest-sleep", &h);
+    h.trd = &trd;
+
+    SrsCoroutineInfo info;
+    EXPECT_FALSE(mock_find_coroutine("utest-sleep", info));
+
+    HELPER_EXPECT_SUCCESS(trd.start());
+    srs_usleep(10 * SRS_UTIME_MILLISECONDS);
+
+    EXPECT_TRUE(mock_find_coroutine("utest-sleep", info));
+    EXPECT_EQ(SrsCoroutineWaitSleep, info.wait);
+    EXPECT_STREQ("sleep", srs_coroutine_wait_name(info.wait));
+    EXPECT_EQ(-1, info.fd);
+    EXPECT_EQ(-1, info.stack_used);
+    EXPECT_FALSE(info.cid.empty());
+    EXPECT_FALSE(info.done);
+    EXPECT_GT(info.stack_size, 0);
+
+    trd.stop();
+    EXPECT_FALSE(mock_find_coroutine("utest-sleep", info));
+}
+
+VOID TEST(SrsCoroutineIntrospection, StackHighWater)
+{
+    srs_error_t err = srs_success;
+
+    srs_coroutine_set_stack_canary(true);
+
+    MockSleepHandler h;
+    SrsSTCoroutine trd("utest-canary", &h);
+    trd.set_stack_size(64 * 1024);
+    h.trd = &trd;
+
+    HELPER_EXPECT_SUCCESS(trd.start());
+    srs_usleep(10 * SRS_UTIME_MILLISECONDS);
+    srs_coroutine_set_stack_canary(false);
+
+    SrsCoroutineInfo info;
+    EXPECT_TRUE(mock_find_coroutine("utest-canary", info));
+    // The ST reuses the free stack which is big enough.
+    EXPECT_GE(info.stack_size, 64 * 1024);
+    EXPECT_GT(info.stack_used, 0);
+    EXPECT_LT(info.stack_used, info.stack_size);
+
+    trd.stop();
+}
+
+class MockDoneHandler : public ISrsCoroutineHandler
+{
+public:
+    MockDoneHandler() {
+    }
+    virtual ~MockDoneHandler() {
+    }
+    virtual srs_error_t cycle() {
+        char buf[4096];
+        memset(buf, 0, sizeof(buf));
+        return srs_success;
+    }
+};
+
+VOID TEST(SrsCoroutineIntrospection, StackPeakOfDone)
+{
+    srs_error_t err = srs_success;
+
+    srs_coroutine_set_stack_canary(true);
+    srs_coroutine_set_stack_guard(true);
+
+    MockDoneHandler h;
+    SrsSTCoroutine trd("utest-done", &h);
+    trd.set_stack_size(32 * 1024);
+
+    HELPER_EXPECT_SUCCESS(trd.start());
+    srs_usleep(10 * SRS_UTIME_MILLISECONDS);
+    srs_coroutine_set_stack_canary(false);
+    srs_coroutine_set_stack_guard(false);
+    trd.stop();
+
+    std::map<std::string, int> peaks;
+    SrsFastCoroutine::stack_peaks(peaks);
+    EXPECT_TRUE(peaks.find("utest-done") != peaks.end());
+    EXPECT_GT(peaks["utest-done"], 4096);
+    EXPECT_LT(peaks["utest-done"], 32 * 1024);
+}
@@ -0,0 +1,131 @@
+#include <srs_utest_app_trace.hpp>
+#include <srs_app_trace.hpp>
+#include <srs_kernel_error.hpp>
+
+static SrsTraceRecord mock_trace_record(srs_utime_t elapsed)
+{
+    SrsTraceRecord record;
+    memset(&record, 0, sizeof(record));
+    for (int i = 0; i < SrsTracePhaseMax; i++) {
+        record.phases[i] = -1;
+    }
+    record.elapsed = elapsed;
+    record.phases[SrsTracePhaseTtfb] = elapsed / 2;
+    return record;
+}
+
+VOID TEST(SrsTraceRing, RoundUpCapacity)
+{
+    SrsTraceRing ring(100);
+    EXPECT_EQ(128, ring.capacity());
+
+    SrsTraceRing ring1(0);
+    EXPECT_EQ(1, ring1.capacity());
+}
+
+VOID TEST(SrsTraceRing, OverwriteOldest)
+{
+    SrsTraceRing ring(4);
+    for (int i = 1; i <= 6; i++) {
+        ring.push(mock_trace_record(i));
+    }
+    EXPECT_EQ(6, (int)ring.total());
+
+    std::vector<SrsTraceRecord> records;
+    ring.snapshot(records);
+    ASSERT_EQ(4, (int)records.size());
+    EXPECT_EQ(3, records[0].elapsed);
+    EXPECT_EQ(6, records[3].elapsed);
+}
+
+VOID TEST(SrsTraceRing, SlowestAndPercentiles)
+{
+    SrsTraceRing ring(256);
+    for (int i = 1; i <= 100; i++) {
+        ring.push(mock_trace_record(i * 10));
+    }
+
+    std::vector<SrsTraceRecord> records;
+    ring.snapshot(records);
+
+    std::vector<SrsTraceRecord> slows;
+    SrsTraceRing::slowest(records, 3, slows);
+    ASSERT_EQ(3, (int)slows.size());
+    EXPECT_EQ(1000, slows[0].elapsed);
+    EXPECT_EQ(990, slows[1].elapsed);
+    EXPECT_EQ(980, slows[2].elapsed);
+
+    SrsTracePercentiles total = SrsTraceRing::percentiles(records, SrsTracePhaseMax);
+    EXPECT_EQ(100, total.count);
+    EXPECT_EQ(500, total.p50);
+    EXPECT_EQ(900, total.p90);
+    EXPECT_EQ(990, total.p99);
+    EXPECT_EQ(1000, total.max);
+
+    SrsTracePercentiles ttfb = SrsTraceRing::percentiles(records, SrsTracePhaseTtfb);
+    EXPECT_EQ(100, ttfb.count);
+    EXPECT_EQ(500, ttfb.max);
+
+    // The phase not happened is ignored.
+    SrsTracePercentiles dns = SrsTraceRing::percentiles(records, SrsTracePhaseDns);
+    EXPECT_EQ(0, dns.count);
+}
+
+VOID TEST(SrsTraceSpan, PhasesAndReset)
+{
+    SrsTraceSpan span;
+    span.set_target(true, "www.example.com", "/index.html");
+    span.set(SrsTracePhaseDns, 100);
+    span.begin(SrsTracePhaseTtfb);
+    span.end(SrsTracePhaseTtfb);
+    // End without begin is ignored.
+    span.end(SrsTracePhaseBody);
+
+    const SrsTraceRecord& record = span.record();
+    EXPECT_TRUE(record.https);
+    EXPECT_STREQ("www.example.com", record.host);
+    EXPECT_STREQ("/index.html", record.path);
+    EXPECT_EQ(100, record.phases[SrsTracePhaseDns]);
+    EXPECT_LE(0, record.phases[SrsTracePhaseTtfb]);
+    EXPECT_EQ(-1, record.phases[SrsTracePhaseBody]);
+    EXPECT_EQ(-1, record.phases[SrsTracePhaseConnect]);
+
+    span.reset();
+    EXPECT_EQ(-1, span.record().phases[SrsTracePhaseDns]);
+    EXPECT_STREQ("", span.record().host);
+}
+
+VOID TEST(SrsTraceSpan, FinishFailedTransaction)
+{
+    SrsTraceRing ring(4);
+    SrsTraceRing* old = _srs_trace_ring;
+    _srs_trace_ring = &ring;
+
+    // No pending transaction, for example, the keep-alive connection is closed when idle.
+    SrsTraceSpan span;
+    span.finish(srs_success);
+    EXPECT_EQ(0, (int)ring.total());
+
+    // The committed transaction is not pushed again.
+    span.set_target(false, "www.example.com", "/");
+    span.set_status(200);
+    span.commit();
+    span.finish(srs_success);
+    EXPECT_EQ(1, (int)ring.total());
+
+    // Failed before committed.
+    span.set_target(true, "www.example.com", "");
+    srs_error_t err = srs_error_new(ERROR_SOCKET_TIMEOUT, "connect");
+    span.finish(err);
+    srs_freep(err);
+    EXPECT_EQ(2, (int)ring.total());
+
+    std::vector<SrsTraceRecord> records;
+    ring.snapshot(records);
+    EXPECT_EQ(2, (int)records.size());
+    EXPECT_EQ(0, records.at(0).error);
+    EXPECT_EQ(ERROR_SOCKET_TIMEOUT, records.at(1).error);
+    EXPECT_EQ(0, records.at(1).status);
+
+    _srs_trace_ring = old;
+}
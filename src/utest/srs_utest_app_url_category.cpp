@@ -0,0 +1,188 @@
+#include <srs_utest_app_url_category.hpp>
+#include <srs_app_url_category.hpp>
+#include <srs_app_conn.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_protocol_json.hpp>
+#include <srs_protocol_http_conn.hpp>
+
+#define MOCK_CLASSIFIER_PORT 28081
+
+// The stub of classifier, which serves one keep-alive connection at a time, and replies "news" for the
+// URL with "/news/", or null for others.
+class MockClassifier : public ISrsCoroutineHandler
+{
+public:
+    SrsCoroutine* trd;
+    srs_netfd_t lfd;
+    // The delay before response, and the requests received.
+    srs_utime_t delay;
+    int nn_requests;
+public:
+    MockClassifier() {
+        trd = new SrsSTCoroutine("classifier", this);
+        lfd = NULL;
+        delay = 0;
+        nn_requests = 0;
+    }
+    virtual ~MockClassifier() {
+        srs_freep(trd);
+        srs_close_stfd(lfd);
+    }
+    srs_error_t start() {
+        srs_error_t err = srs_success;
+        if ((err = srs_tcp_listen("127.0.0.1", MOCK_CLASSIFIER_PORT, &lfd)) != srs_success) {
+            return srs_error_wrap(err, "listen");
+        }
+        return trd->start();
+    }
+    virtual srs_error_t cycle() {
+        srs_error_t err = srs_success;
+        while (true) {
+            if ((err = trd->pull()) != srs_success) {
+                return srs_error_wrap(err, "pull");
+            }
+            srs_netfd_t cfd = srs_accept(lfd, NULL, NULL, SRS_UTIME_NO_TIMEOUT);
+            if (!cfd) {
+                continue;
+            }
+            SrsTcpConnection conn(cfd);
+            err = serve(&conn);
+            srs_freep(err);
+        }
+        return err;
+    }
+    srs_error_t serve(SrsTcpConnection* conn) {
+        srs_error_t err = srs_success;
+        SrsHttpParser parser;
+        if ((err = parser.initialize(HTTP_REQUEST)) != srs_success) {
+            return err;
+        }
+        while (true) {
+            ISrsHttpMessage* msg = NULL;
+            if ((err = parser.parse_message(conn, &msg)) != srs_success) {
+                return err;
+            }
+            SrsAutoFree(ISrsHttpMessage, msg);
+
+            string body;
+            if ((err = msg->body_read_all(body)) != srs_success) {
+                return err;
+            }
+            nn_requests++;
+
+            SrsJsonAny* req = SrsJsonAny::loads(body);
+            SrsAutoFree(SrsJsonAny, req);
+            SrsJsonArray* urls = req->to_object()->get_property("urls")->to_array();
+
+            SrsJsonObject* res = SrsJsonAny::object();
+            SrsAutoFree(SrsJsonObject, res);
+            SrsJsonArray* categories = SrsJsonAny::array();
+            res->set("categories", categories);
+            for (int i = 0; i < urls->count(); i++) {
+                bool news = urls->at(i)->to_str().find("/news/") != string::npos;
+                categories->append(news ? SrsJsonAny::str("news") : SrsJsonAny::null());
+            }
+
+            if (delay) {
+                srs_usleep(delay);
+            }
+
+            string data = res->dumps();
+            string header = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + srs_int2str(data.size()) + "\r\n\r\n";
+            data = header + data;
+            if ((err = conn->write((void*)data.data(), data.size(), NULL)) != srs_success) {
+                return err;
+            }
+        }
+        return err;
+    }
+};
+
+VOID TEST(SrsUrlCategory, Key)
+{
+    EXPECT_STREQ("www.example.com/news/", srs_url_category_key("www.example.com", "/news/2022/a.html").c_str());
+    EXPECT_STREQ("www.example.com/news/", srs_url_category_key("www.example.com", "/news/").c_str());
+    EXPECT_STREQ("www.example.com/", srs_url_category_key("www.example.com", "/news").c_str());
+    EXPECT_STREQ("www.example.com/", srs_url_category_key("www.example.com", "/").c_str());
+    EXPECT_STREQ("www.example.com/", srs_url_category_key("www.example.com", "").c_str());
+}
+
+VOID TEST(SrsUrlCategory, Disabled)
+{
+    SrsUrlCategoryClient client;
+    EXPECT_FALSE(client.enabled());
+    EXPECT_TRUE(client.categorize("www.example.com", "/news/a.html").empty());
+}
+
+VOID TEST(SrsUrlCategory, BatchAndCache)
+{
+    srs_error_t err = srs_success;
+
+    MockClassifier classifier;
+    classifier.delay = 30 * SRS_UTIME_MILLISECONDS;
+    HELPER_ASSERT_SUCCESS(classifier.start());
+
+    if (true) {
+        SrsUrlCategoryClient client;
+        HELPER_ASSERT_SUCCESS(client.initialize("127.0.0.1", MOCK_CLASSIFIER_PORT, 1, 64, 5 * SRS_UTIME_MILLISECONDS,
+            10 * SRS_UTIME_SECONDS, 1024));
+
+        // Fail-open when the classifier is slow, and the URLs are queued when the request is in flight.
+        EXPECT_TRUE(client.categorize("a.com", "/news/1.html").empty());
+        EXPECT_TRUE(client.categorize("b.com", "/news/1.html").empty());
+        EXPECT_TRUE(client.categorize("c.com", "/index.html").empty());
+        EXPECT_TRUE(client.categorize("d.com", "/about.html").empty());
+
+        // Wait for the two batches, the first URL, then the queued three.
+        srs_usleep(100 * SRS_UTIME_MILLISECONDS);
+        EXPECT_EQ(2, classifier.nn_requests);
+
+        // Hit the cache, the same prefix shares the category.
+        EXPECT_STREQ("news", client.categorize("a.com", "/news/2.html").c_str());
+        EXPECT_STREQ("news", client.categorize("b.com", "/news/").c_str());
+        EXPECT_TRUE(client.categorize("c.com", "/").empty());
+        EXPECT_EQ(2, classifier.nn_requests);
+
+        SrsJsonObject* obj = SrsJsonAny::object();
+        SrsAutoFree(SrsJsonObject, obj);
+        client.dumps(obj);
+        EXPECT_EQ(3, obj->get_property("hits")->to_integer());
+        EXPECT_EQ(4, obj->get_property("misses")->to_integer());
+        EXPECT_EQ(4, obj->get_property("timeouts")->to_integer());
+        EXPECT_EQ(2, obj->get_property("batches")->to_integer());
+        EXPECT_EQ(4, obj->get_property("urls")->to_integer());
+        EXPECT_EQ(0, obj->get_property("errors")->to_integer());
+    }
+
+    // Wait for the category when the classifier is fast.
+    if (true) {
+        classifier.delay = 0;
+
+        SrsUrlCategoryClient client;
+        HELPER_ASSERT_SUCCESS(client.initialize("127.0.0.1", MOCK_CLASSIFIER_PORT, 1, 64, 1 * SRS_UTIME_SECONDS,
+            10 * SRS_UTIME_SECONDS, 1024));
+        EXPECT_STREQ("news", client.categorize("e.com", "/news/1.html").c_str());
+        EXPECT_TRUE(client.categorize("e.com", "/about/1.html").empty());
+        EXPECT_EQ(4, classifier.nn_requests);
+    }
+}
+
+VOID TEST(SrsUrlCategory, ClassifierDown)
+{
+    srs_error_t err = srs_success;
+
+    SrsUrlCategoryClient client;
+    HELPER_ASSERT_SUCCESS(client.initialize("127.0.0.1", MOCK_CLASSIFIER_PORT + 1, 1, 64, 100 * SRS_UTIME_MILLISECONDS,
+        10 * SRS_UTIME_SECONDS, 1024));
+
+    // The failure is cached for a while, so the next request never waits.
+    EXPECT_TRUE(client.categorize("a.com", "/news/1.html").empty());
+    EXPECT_TRUE(client.categorize("a.com", "/news/2.html").empty());
+
+    SrsJsonObject* obj = SrsJsonAny::object();
+    SrsAutoFree(SrsJsonObject, obj);
+    client.dumps(obj);
+    EXPECT_EQ(1, obj->get_property("hits")->to_integer());
+    EXPECT_EQ(1, obj->get_property("errors")->to_integer());
+}
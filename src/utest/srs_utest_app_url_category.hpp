@@ -0,0 +1,5 @@
+#ifndef SRS_UTEST_APP_URL_CATEGORY_HPP
+#define SRS_UTEST_APP_URL_CATEGORY_HPP
+#include <srs_utest_main.hpp>
+
+#endif
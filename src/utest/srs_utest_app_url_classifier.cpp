@@ -0,0 +1,142 @@
+#include <srs_utest_app_url_classifier.hpp>
+#include <srs_app_url_classifier.hpp>
+#include <srs_app_url_category.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_file.hpp>
+
+#include <unistd.h>
+#include <sstream>
+#include <map>
+
+#define MOCK_MODEL_BUCKETS 65536
+
+// Write the model which knows "news" and "sport" by the trigrams.
+static srs_error_t mock_model_text(std::string path)
+{
+    std::map<uint32_t, std::string> rows;
+    const char* words[] = {"news", "sport"};
+    const char* weights[] = {" 4 -4", " -4 4"};
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j + 3 <= (int)strlen(words[i]); j++) {
+            uint32_t bucket = srs_url_classifier_hash(words[i] + j, 3) & (MOCK_MODEL_BUCKETS - 1);
+            rows[bucket] = weights[i];
+        }
+    }
+
+    std::stringstream ss;
+    ss << "# The mock model\n" << "ngram 3 3\n" << "buckets " << MOCK_MODEL_BUCKETS << "\n" << "threshold 0.6\n"
+        << "classes news sports\n" << "bias 0.1 0\n" << "idf_default 2\n";
+    for (std::map<uint32_t, std::string>::iterator it = rows.begin(); it != rows.end(); ++it) {
+        ss << "idf " << it->first << " 1.5\n";
+        ss << "weight " << it->first << it->second << "\n";
+    }
+
+    SrsFileWriter writer;
+    srs_error_t err = writer.open(path);
+    if (err != srs_success) {
+        return err;
+    }
+    std::string text = ss.str();
+    return writer.write((void*)text.data(), text.size(), NULL);
+}
+
+VOID TEST(SrsUrlClassifier, ClassifyText)
+{
+    srs_error_t err = srs_success;
+
+    std::string path = "/tmp/srs_utest_url_model.txt";
+    HELPER_ASSERT_SUCCESS(mock_model_text(path));
+
+    SrsUrlClassifier classifier;
+    HELPER_ASSERT_SUCCESS(classifier.load_text(path));
+    EXPECT_EQ(2, classifier.classes());
+    EXPECT_STREQ("news", classifier.name(0).c_str());
+    EXPECT_STREQ("sports", classifier.name(1).c_str());
+
+    float prob = 0;
+    EXPECT_STREQ("news", classifier.classify("www.example.com/NEWS/a.html", &prob).c_str());
+    EXPECT_GT(prob, 0.9);
+    EXPECT_STREQ("sports", classifier.classify("espn.com/sport/", &prob).c_str());
+    EXPECT_GT(prob, 0.9);
+
+    // Unknown if lower than the threshold, the probability is near to 0.5 by bias only.
+    EXPECT_STREQ("", classifier.classify("www.example.com/about.html", &prob).c_str());
+    EXPECT_LT(prob, 0.6);
+    EXPECT_STREQ("", classifier.classify("", &prob).c_str());
+
+    // Both words, decided by the number of features.
+    float scores[2];
+    classifier.score("news/sport", scores);
+    EXPECT_LT(scores[0], scores[1]);
+
+    ::unlink(path.c_str());
+}
+
+VOID TEST(SrsUrlClassifier, SaveAndMap)
+{
+    srs_error_t err = srs_success;
+
+    std::string text = "/tmp/srs_utest_url_model.txt";
+    std::string path = "/tmp/srs_utest_url_model.bin";
+    HELPER_ASSERT_SUCCESS(mock_model_text(text));
+
+    SrsUrlClassifier compiled;
+    HELPER_ASSERT_SUCCESS(compiled.load_text(text));
+    HELPER_ASSERT_SUCCESS(compiled.save(path));
+
+    SrsUrlClassifier loaded;
+    HELPER_ASSERT_SUCCESS(loaded.load(path));
+    EXPECT_EQ(compiled.memory(), loaded.memory());
+
+    float a = 0, b = 0;
+    EXPECT_STREQ("news", loaded.classify("www.example.com/news/a.html", &a).c_str());
+    compiled.classify("www.example.com/news/a.html", &b);
+    EXPECT_FLOAT_EQ(a, b);
+
+    // The mapped model in client.
+    SrsUrlCategoryClient client;
+    HELPER_ASSERT_SUCCESS(client.initialize(path));
+    EXPECT_TRUE(client.enabled());
+    EXPECT_STREQ("sports", client.categorize("espn.com", "/sport/").c_str());
+
+    // Not a model.
+    HELPER_EXPECT_FAILED(loaded.load(text));
+    HELPER_EXPECT_FAILED(loaded.load_text(path));
+    EXPECT_STREQ("news", loaded.classify("www.example.com/news/a.html").c_str());
+
+    ::unlink(text.c_str());
+    ::unlink(path.c_str());
+}
+
+VOID TEST(SrsUrlClassifier, InvalidText)
+{
+    srs_error_t err = srs_success;
+
+    std::string path = "/tmp/srs_utest_url_model.txt";
+    const char* texts[] = {
+        // No header.
+        "weight 1 1 1\n",
+        // Bucket out of range.
+        "ngram 3 3\nbuckets 16\nclasses a b\nweight 16 1 1\n",
+        // Not enough weights.
+        "ngram 3 3\nbuckets 16\nclasses a b\nweight 1 1\n",
+        // Not power of 2.
+        "ngram 3 3\nbuckets 10\nclasses a b\nweight 1 1 1\n",
+        // No rows.
+        "ngram 3 3\nbuckets 16\nclasses a b\n",
+        // Header after rows.
+        "ngram 3 3\nbuckets 16\nclasses a b\nweight 1 1 1\nthreshold 0.5\n",
+    };
+
+    for (int i = 0; i < (int)(sizeof(texts) / sizeof(texts[0])); i++) {
+        SrsFileWriter writer;
+        HELPER_ASSERT_SUCCESS(writer.open(path));
+        HELPER_ASSERT_SUCCESS(writer.write((void*)texts[i], strlen(texts[i]), NULL));
+        writer.close();
+
+        SrsUrlClassifier classifier;
+        HELPER_EXPECT_FAILED(classifier.load_text(path));
+    }
+
+    ::unlink(path.c_str());
+}
@@ -0,0 +1,150 @@
+#include <srs_utest_app_url_matcher.hpp>
+#include <srs_app_url_matcher.hpp>
+#include <srs_kernel_error.hpp>
+
+VOID TEST(SrsUrlMatcher, ParseRule)
+{
+    std::vector<std::string> pieces;
+
+    EXPECT_TRUE(srs_url_rule_parse("/ads/", pieces));
+    ASSERT_EQ(1, (int)pieces.size());
+    EXPECT_STREQ("\x01/ads/", pieces[0].c_str());
+
+    EXPECT_TRUE(srs_url_rule_parse(" =/ads/banner.js\r\n", pieces));
+    ASSERT_EQ(1, (int)pieces.size());
+    EXPECT_STREQ("\x01/ads/banner.js\x02", pieces[0].c_str());
+
+    EXPECT_TRUE(srs_url_rule_parse("~utm_source=", pieces));
+    ASSERT_EQ(1, (int)pieces.size());
+    EXPECT_STREQ("utm_source=", pieces[0].c_str());
+
+    EXPECT_TRUE(srs_url_rule_parse("=/api/*/delete", pieces));
+    ASSERT_EQ(2, (int)pieces.size());
+    EXPECT_STREQ("\x01/api/", pieces[0].c_str());
+    EXPECT_STREQ("/delete\x02", pieces[1].c_str());
+
+    EXPECT_TRUE(srs_url_rule_parse("=*.exe", pieces));
+    ASSERT_EQ(1, (int)pieces.size());
+    EXPECT_STREQ(".exe\x02", pieces[0].c_str());
+
+    EXPECT_FALSE(srs_url_rule_parse("", pieces));
+    EXPECT_FALSE(srs_url_rule_parse("ads", pieces));
+    EXPECT_FALSE(srs_url_rule_parse("~", pieces));
+    EXPECT_FALSE(srs_url_rule_parse("~**", pieces));
+    EXPECT_FALSE(srs_url_rule_parse("=", pieces));
+}
+
+VOID TEST(SrsUrlMatcher, Match)
+{
+    srs_error_t err = srs_success;
+
+    SrsUrlMatcher m;
+    EXPECT_FALSE(m.match("/ads/banner.js"));
+
+    HELPER_EXPECT_SUCCESS(m.add("/ads/"));
+    HELPER_EXPECT_SUCCESS(m.add("=/track.gif"));
+    HELPER_EXPECT_SUCCESS(m.add("~utm_source="));
+    HELPER_EXPECT_SUCCESS(m.add("=/api/*/delete"));
+    HELPER_EXPECT_SUCCESS(m.add("=*.exe"));
+    HELPER_EXPECT_SUCCESS(m.add("~/download*token=*&sig="));
+    HELPER_EXPECT_FAILED(m.add("ads"));
+    EXPECT_EQ(6, m.size());
+
+    // Not compiled yet.
+    EXPECT_FALSE(m.match("/ads/banner.js"));
+    m.compile();
+
+    // Prefix.
+    EXPECT_TRUE(m.match("/ads/banner.js"));
+    EXPECT_TRUE(m.match("/ads/"));
+    EXPECT_FALSE(m.match("/ads"));
+    EXPECT_FALSE(m.match("/static/ads/banner.js"));
+
+    // Exact.
+    EXPECT_TRUE(m.match("/track.gif"));
+    EXPECT_FALSE(m.match("/track.gif?id=1"));
+    EXPECT_FALSE(m.match("/v1/track.gif"));
+
+    // Substring.
+    EXPECT_TRUE(m.match("/index.html?utm_source=mail"));
+    EXPECT_FALSE(m.match("/index.html?utm_medium=mail"));
+
+    // Glob.
+    EXPECT_TRUE(m.match("/api/users/delete"));
+    EXPECT_TRUE(m.match("/api//delete"));
+    EXPECT_TRUE(m.match("/api/delete/x/delete"));
+    EXPECT_FALSE(m.match("/api/delete"));
+    EXPECT_FALSE(m.match("/api/users/delete/1"));
+    EXPECT_FALSE(m.match("/v1/api/users/delete"));
+    EXPECT_TRUE(m.match("/files/setup.exe"));
+    EXPECT_FALSE(m.match("/files/setup.exe.txt"));
+    EXPECT_TRUE(m.match("/v1/download/file?token=abc&sig=1"));
+    EXPECT_FALSE(m.match("/v1/download/file?sig=1&token=abc"));
+    EXPECT_FALSE(m.match("/v1/download/file?token=&sig"));
+
+    // The anchor in url is not anchor.
+    EXPECT_FALSE(m.match(std::string("/x\x01/ads/", 8)));
+    EXPECT_FALSE(m.match(std::string("/track.gif\x02", 11)));
+    EXPECT_FALSE(m.match(""));
+}
+
+VOID TEST(SrsUrlMatcher, OverlappedPieces)
+{
+    srs_error_t err = srs_success;
+
+    // The pieces share prefix and suffix, to verify the fail links and merged outputs.
+    SrsUrlMatcher m;
+    HELPER_EXPECT_SUCCESS(m.add("~he"));
+    HELPER_EXPECT_SUCCESS(m.add("~she"));
+    HELPER_EXPECT_SUCCESS(m.add("~his"));
+    HELPER_EXPECT_SUCCESS(m.add("~hers"));
+    HELPER_EXPECT_SUCCESS(m.add("=/ab*ba*ab"));
+    m.compile();
+
+    EXPECT_TRUE(m.match("/ushers"));
+    EXPECT_TRUE(m.match("/xhisx"));
+    EXPECT_FALSE(m.match("/hxsx"));
+
+    SrsUrlMatcher g;
+    HELPER_EXPECT_SUCCESS(g.add("=/ab*ba*ab"));
+    g.compile();
+    EXPECT_TRUE(g.match("/abbaab"));
+    EXPECT_TRUE(g.match("/abxbaxab"));
+    EXPECT_FALSE(g.match("/abab"));
+    EXPECT_FALSE(g.match("/aba"));
+    EXPECT_FALSE(g.match("/abbab"));
+}
+
+VOID TEST(SrsUrlMatcher, EncodeDecode)
+{
+    srs_error_t err = srs_success;
+
+    SrsUrlMatcher m;
+    HELPER_EXPECT_SUCCESS(m.add("/ads/"));
+    HELPER_EXPECT_SUCCESS(m.add("=/api/*/delete"));
+    HELPER_EXPECT_SUCCESS(m.add("~utm_source="));
+    m.compile();
+
+    std::string data;
+    m.encode(data);
+    EXPECT_EQ(0, (int)(data.size() % 8));
+
+    // Use uint64_t to align the data as the mapped file.
+    std::vector<uint64_t> buf(data.size() / 8);
+    memcpy(&buf[0], data.data(), data.size());
+
+    SrsUrlMatcher d;
+    size_t nread = 0;
+    HELPER_EXPECT_SUCCESS(d.decode((const char*)&buf[0], data.size(), &nread));
+    EXPECT_EQ(data.size(), nread);
+    EXPECT_EQ(3, d.size());
+    EXPECT_EQ(m.states(), d.states());
+    EXPECT_TRUE(d.match("/ads/1.js"));
+    EXPECT_TRUE(d.match("/api/x/delete"));
+    EXPECT_TRUE(d.match("/?utm_source=x"));
+    EXPECT_FALSE(d.match("/index.html"));
+
+    // Truncated data.
+    HELPER_EXPECT_FAILED(d.decode((const char*)&buf[0], data.size() - 8, NULL));
+    HELPER_EXPECT_FAILED(d.decode((const char*)&buf[0], 8, NULL));
+}
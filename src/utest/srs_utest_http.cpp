@@ -1,4 +1,5 @@
 #include <srs_utest_http.hpp>
+#include <srs_core_auto_free.hpp>
 
 MockResponseWriter::MockResponseWriter()
 {
@@ -93,6 +94,49 @@ MockMSegmentsReader::~MockMSegmentsReader()
 {
 }
 
+MockCountedWriter::MockCountedWriter()
+{
+    nn_writes = 0;
+}
+
+MockCountedWriter::~MockCountedWriter()
+{
+}
+
+srs_error_t MockCountedWriter::write(void* buf, size_t size, ssize_t* nwrite)
+{
+    nn_writes++;
+    return MockBufferIO::write(buf, size, nwrite);
+}
+
+srs_error_t MockCountedWriter::writev(const iovec *iov, int iov_size, ssize_t* nwrite)
+{
+    // The writev of base class writes each iov, which is not counted.
+    int nn = nn_writes;
+    srs_error_t err = MockBufferIO::writev(iov, iov_size, nwrite);
+    nn_writes = nn + 1;
+    return err;
+}
+
+MockHttpParsedMessage::MockHttpParsedMessage(http_parser_type type, string data)
+{
+    msg = NULL;
+    io.append(data);
+
+    ISrsHttpMessage* m = NULL;
+    srs_error_t err = hp.initialize(type);
+    if (err == srs_success) {
+        err = hp.parse_message(&io, &m);
+    }
+    srs_freep(err);
+    msg = (SrsHttpMessage*)m;
+}
+
+MockHttpParsedMessage::~MockHttpParsedMessage()
+{
+    srs_freep(msg);
+}
+
 srs_error_t MockMSegmentsReader::read(void* buf, size_t size, ssize_t* nread)
 {
     srs_error_t err = srs_success;
@@ -171,4 +215,161 @@ VOID TEST(ProtocolHTTPTest, ChunkSmallBuffer)
 
         srs_freep(msg);
     }
-}
\ No newline at end of file
+}
+
+VOID TEST(ProtocolHTTPTest, ReleaseIdleParser)
+{
+    srs_error_t err;
+
+    if (true) {
+        MockMSegmentsReader io;
+        io.append("POST /a HTTP/1.1\r\nHost: a.com\r\nContent-Length: 5\r\n\r\nHello");
+
+        SrsHttpParser hp; HELPER_ASSERT_SUCCESS(hp.initialize(HTTP_REQUEST));
+        ISrsHttpMessage* msg = NULL; HELPER_ASSERT_SUCCESS(hp.parse_message(&io, &msg));
+        EXPECT_STREQ("/a", msg->path().c_str());
+
+        // The bytes not read are kept.
+        EXPECT_EQ(5, hp.buffered());
+        hp.release();
+        string body; HELPER_ASSERT_SUCCESS(msg->body_read_all(body));
+        EXPECT_STREQ("Hello", body.c_str());
+        srs_freep(msg);
+
+        EXPECT_EQ(0, hp.buffered());
+        hp.release();
+
+        io.append("GET /c HTTP/1.1\r\nHost: c.com\r\n\r\n");
+        HELPER_ASSERT_SUCCESS(hp.parse_message(&io, &msg));
+        EXPECT_STREQ("/c", msg->path().c_str());
+        EXPECT_STREQ("c.com", msg->header()->get("Host").c_str());
+        srs_freep(msg);
+    }
+}
+
+VOID TEST(ProtocolHTTPTest, RelayBody)
+{
+    srs_error_t err;
+
+    // The buffer grows when it's filled.
+    if (true) {
+        string body(20000, 'x');
+        MockMSegmentsReader io;
+        io.append(mock_http_response(200, body));
+
+        SrsHttpParser hp; HELPER_ASSERT_SUCCESS(hp.initialize(HTTP_RESPONSE));
+        ISrsHttpMessage* msg = NULL; HELPER_ASSERT_SUCCESS(hp.parse_message(&io, &msg));
+        SrsAutoFree(ISrsHttpMessage, msg);
+
+        MockBufferIO out;
+        SrsHttpBodyRelay relay;
+        int nn_parts = 0;
+        while (true) {
+            char* data = NULL; int size = 0;
+            HELPER_ASSERT_SUCCESS(relay.read(msg->body_reader(), &data, &size));
+            if (!size) {
+                break;
+            }
+            HELPER_ASSERT_SUCCESS(relay.write(&out, data, size, false));
+            nn_parts++;
+        }
+
+        EXPECT_EQ(3, nn_parts);
+        EXPECT_EQ(16384, relay.size());
+        EXPECT_EQ(body, string(out.out_buffer.bytes(), out.out_buffer.length()));
+    }
+
+    // Write the chunk header and CRLF with the data.
+    if (true) {
+        MockMSegmentsReader io;
+        io.append(mock_http_response2(200, "5\r\nHello\r\n0\r\n\r\n"));
+
+        SrsHttpParser hp; HELPER_ASSERT_SUCCESS(hp.initialize(HTTP_RESPONSE));
+        ISrsHttpMessage* msg = NULL; HELPER_ASSERT_SUCCESS(hp.parse_message(&io, &msg));
+        SrsAutoFree(ISrsHttpMessage, msg);
+
+        MockBufferIO out;
+        SrsHttpBodyRelay relay;
+        char* data = NULL; int size = 0;
+        HELPER_ASSERT_SUCCESS(relay.read(msg->body_reader(), &data, &size));
+        EXPECT_EQ(5, size);
+        HELPER_ASSERT_SUCCESS(relay.write(&out, data, size, true));
+        EXPECT_STREQ("5\r\nHello\r\n", string(out.out_buffer.bytes(), out.out_buffer.length()).c_str());
+
+        HELPER_ASSERT_SUCCESS(relay.read(msg->body_reader(), &data, &size));
+        EXPECT_EQ(0, size);
+    }
+}
+
+VOID TEST(ProtocolHTTPTest, RelayGatheredWrites)
+{
+    srs_error_t err;
+
+    // The header and chunk framing are written with the data, one write for each part.
+    if (true) {
+        MockMSegmentsReader io;
+        io.append(mock_http_response2(200, "5\r\nHello\r\n"));
+        io.append("6\r\nWorld!\r\n");
+        io.append("0\r\n\r\n");
+
+        SrsHttpParser hp; HELPER_ASSERT_SUCCESS(hp.initialize(HTTP_RESPONSE));
+        ISrsHttpMessage* msg = NULL; HELPER_ASSERT_SUCCESS(hp.parse_message(&io, &msg));
+        SrsAutoFree(ISrsHttpMessage, msg);
+
+        MockCountedWriter out;
+        SrsHttpBodyRelay relay;
+        relay.set_header("HTTP/1.1 200 OK\r\n\r\n", 19);
+        while (true) {
+            char* data = NULL; int size = 0;
+            HELPER_ASSERT_SUCCESS(relay.read(msg->body_reader(), &data, &size));
+            if (!size) {
+                break;
+            }
+            HELPER_ASSERT_SUCCESS(relay.write(&out, data, size, true));
+        }
+        HELPER_ASSERT_SUCCESS(relay.finish(&out, true));
+
+        EXPECT_EQ(3, out.nn_writes);
+        EXPECT_STREQ("HTTP/1.1 200 OK\r\n\r\n5\r\nHello\r\n6\r\nWorld!\r\n0\r\n\r\n",
+            string(out.out_buffer.bytes(), out.out_buffer.length()).c_str());
+    }
+
+    // The header is written alone before reading the body, if no body buffered.
+    if (true) {
+        MockMSegmentsReader io;
+        io.append(mock_http_response2(200, ""));
+        io.append("5\r\nHello\r\n");
+        io.append("0\r\n\r\n");
+
+        SrsHttpParser hp; HELPER_ASSERT_SUCCESS(hp.initialize(HTTP_RESPONSE));
+        ISrsHttpMessage* msg = NULL; HELPER_ASSERT_SUCCESS(hp.parse_message(&io, &msg));
+        SrsAutoFree(ISrsHttpMessage, msg);
+        EXPECT_EQ(0, hp.buffered());
+
+        MockCountedWriter out;
+        SrsHttpBodyRelay relay;
+        relay.set_header("HTTP/1.1 200 OK\r\n\r\n", 19);
+        HELPER_ASSERT_SUCCESS(relay.flush(&out));
+        EXPECT_EQ(1, out.nn_writes);
+
+        char* data = NULL; int size = 0;
+        HELPER_ASSERT_SUCCESS(relay.read(msg->body_reader(), &data, &size));
+        HELPER_ASSERT_SUCCESS(relay.write(&out, data, size, true));
+        HELPER_ASSERT_SUCCESS(relay.finish(&out, true));
+
+        EXPECT_EQ(3, out.nn_writes);
+        EXPECT_STREQ("HTTP/1.1 200 OK\r\n\r\n5\r\nHello\r\n0\r\n\r\n",
+            string(out.out_buffer.bytes(), out.out_buffer.length()).c_str());
+    }
+
+    // The header is written when finished, if no body.
+    if (true) {
+        MockCountedWriter out;
+        SrsHttpBodyRelay relay;
+        relay.set_header("HTTP/1.1 204 No Content\r\n\r\n", 27);
+        HELPER_ASSERT_SUCCESS(relay.finish(&out, false));
+
+        EXPECT_EQ(1, out.nn_writes);
+        EXPECT_STREQ("HTTP/1.1 204 No Content\r\n\r\n", string(out.out_buffer.bytes(), out.out_buffer.length()).c_str());
+    }
+}
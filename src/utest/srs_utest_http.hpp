@@ -45,6 +45,31 @@ public:
     virtual srs_error_t read(void* buf, size_t size, ssize_t* nread);
 };
 
+// Count the calls to write, each one is a syscall for socket.
+class MockCountedWriter : public MockBufferIO
+{
+public:
+    int nn_writes;
+public:
+    MockCountedWriter();
+    virtual ~MockCountedWriter();
+public:
+    virtual srs_error_t write(void* buf, size_t size, ssize_t* nwrite);
+    virtual srs_error_t writev(const iovec *iov, int iov_size, ssize_t* nwrite);
+};
+
+// The parsed request or response header, the body is left in io.
+class MockHttpParsedMessage
+{
+public:
+    MockBufferIO io;
+    SrsHttpParser hp;
+    SrsHttpMessage* msg;
+public:
+    MockHttpParsedMessage(http_parser_type type, string data);
+    virtual ~MockHttpParsedMessage();
+};
+
 string mock_http_response(int status, string content);
 string mock_http_response2(int status, string content);
 bool is_string_contain(string substr, string str);
@@ -52,4 +77,4 @@ bool is_string_contain(string substr, string str);
 #define __MOCK_HTTP_EXPECT_STREQ(status, text, w) \
         EXPECT_STREQ(mock_http_response(status, text).c_str(), HELPER_BUFFER2STR(&w.io.out_buffer).c_str())
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
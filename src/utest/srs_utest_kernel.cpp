@@ -78,3 +78,136 @@ VOID TEST(KernelFastBufferTest, Grow2)
        
 }
 
+
+VOID TEST(KernelFastBufferTest, Shrink)
+{
+    srs_error_t err;
+
+    if(true) {
+        SrsFastStream b(6);
+        MockBufferReader r("Hello, world!");
+        EXPECT_FALSE(b.shrink());
+
+        // Keep the bytes not consumed.
+        HELPER_ASSERT_SUCCESS(b.grow(&r, 5));
+        b.skip(2);
+        EXPECT_FALSE(b.shrink());
+        EXPECT_EQ(4, b.size());
+
+        b.skip(4);
+        EXPECT_TRUE(b.shrink());
+        EXPECT_EQ(0, b.size());
+
+        // Allocate again when read.
+        HELPER_ASSERT_SUCCESS(b.grow(&r, 5));
+        EXPECT_EQ(' ', b.read_1byte());
+    }
+}
+
+MockVectorReader::MockVectorReader(const char* data) : MockBufferReader(data)
+{
+}
+
+MockVectorReader::~MockVectorReader()
+{
+}
+
+srs_error_t MockVectorReader::readv(const iovec *iov, int iov_size, ssize_t* nread)
+{
+    srs_error_t err = srs_success;
+
+    ssize_t nn = 0;
+    for (int i = 0; i < iov_size; i++) {
+        ssize_t n = 0;
+        if ((err = read(iov[i].iov_base, iov[i].iov_len, &n)) != srs_success) {
+            // Got some bytes, EOF at next read.
+            if (nn) {
+                srs_freep(err);
+                break;
+            }
+            return err;
+        }
+
+        nn += n;
+        if (n < (ssize_t)iov[i].iov_len) {
+            break;
+        }
+    }
+
+    if (nread) {
+        *nread = nn;
+    }
+    return err;
+}
+
+VOID TEST(KernelFastBufferTest, RingReadv)
+{
+    srs_error_t err;
+
+    // Read into the free space at start of buffer, without move.
+    if(true) {
+        SrsFastStream b(8);
+        b.set_ring(true);
+
+        MockVectorReader r0("Hello");
+        HELPER_ASSERT_SUCCESS(b.grow(&r0, 1));
+        EXPECT_STREQ("Hell", string(b.read_slice(4), 4).c_str());
+
+        MockVectorReader r1(", world");
+        HELPER_ASSERT_SUCCESS(b.grow(&r1, 2));
+        EXPECT_EQ(4, b.size());
+        EXPECT_EQ(8, b.total_size());
+
+        // Start from the wrapped bytes, when the bytes to the end are consumed.
+        EXPECT_STREQ("o, w", string(b.read_slice(4), 4).c_str());
+        EXPECT_EQ(4, b.size());
+        EXPECT_EQ(4, b.total_size());
+        EXPECT_STREQ("orld", string(b.read_slice(4), 4).c_str());
+        EXPECT_EQ(0, b.total_size());
+    }
+
+    // Linearize the bytes which straddle the wrap point, by copy.
+    if(true) {
+        SrsFastStream b(8);
+        b.set_ring(true);
+
+        MockVectorReader r0("Hello");
+        HELPER_ASSERT_SUCCESS(b.grow(&r0, 1));
+        b.skip(4);
+
+        MockVectorReader r1(", world");
+        HELPER_ASSERT_SUCCESS(b.grow(&r1, 2));
+        HELPER_ASSERT_SUCCESS(b.grow(&r1, 6));
+        EXPECT_EQ(8, b.size());
+        EXPECT_STREQ("o, world", string(b.bytes(), b.size()).c_str());
+    }
+
+    // Linearize the bytes which straddle the wrap point, by move.
+    if(true) {
+        SrsFastStream b(8);
+        b.set_ring(true);
+
+        MockVectorReader r0("Hello");
+        HELPER_ASSERT_SUCCESS(b.grow(&r0, 1));
+        b.skip(4);
+
+        MockVectorReader r1(", wo");
+        HELPER_ASSERT_SUCCESS(b.grow(&r1, 2));
+        b.skip(3);
+        EXPECT_EQ(1, b.size());
+        EXPECT_EQ(2, b.total_size());
+
+        HELPER_ASSERT_SUCCESS(b.grow(&r1, 2));
+        EXPECT_STREQ("wo", string(b.bytes(), b.size()).c_str());
+    }
+
+    // Overflow when no free space.
+    if(true) {
+        SrsFastStream b(4);
+        b.set_ring(true);
+
+        MockVectorReader r0("Hello");
+        HELPER_ASSERT_SUCCESS(b.grow(&r0, 4));
+        HELPER_ASSERT_FAILED(b.grow(&r0, 5));
+    }
+}
@@ -24,4 +24,13 @@ public:
     virtual srs_error_t read(void* buf, size_t size, ssize_t* nread);
 };
 
-#endif
\ No newline at end of file
+class MockVectorReader: public MockBufferReader, public ISrsVectorReader
+{
+public:
+    MockVectorReader(const char* data);
+    virtual ~MockVectorReader();
+public:
+    virtual srs_error_t readv(const iovec *iov, int iov_size, ssize_t* nread);
+};
+
+#endif
\ No newline at end of file
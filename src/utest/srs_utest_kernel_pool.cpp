@@ -0,0 +1,145 @@
+#include <srs_utest_kernel_pool.hpp>
+#include <srs_kernel_pool.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_core_auto_free.hpp>
+#include <srs_protocol_http_conn.hpp>
+#include <srs_utest_protocol.hpp>
+
+using namespace std;
+
+class MockPooledObject
+{
+    SRS_DECLARE_POOL();
+public:
+    char data[40];
+public:
+    MockPooledObject() {
+    }
+    virtual ~MockPooledObject() {
+    }
+};
+
+SRS_IMPLEMENT_POOL(MockPooledObject);
+
+// The subclass is larger, which is allocated from heap.
+class MockPooledLargeObject : public MockPooledObject
+{
+public:
+    char more[64];
+};
+
+static SrsObjectPool* mock_pool(string name)
+{
+    vector<SrsObjectPool*>& all = SrsObjectPool::pools();
+    for (int i = 0; i < (int)all.size(); i++) {
+        if (all.at(i)->name() == name) {
+            return all.at(i);
+        }
+    }
+    return NULL;
+}
+
+VOID TEST(SrsObjectPool, ReuseObjects)
+{
+    MockPooledObject* a = new MockPooledObject();
+    SrsObjectPool* pool = mock_pool("MockPooledObject");
+    ASSERT_TRUE(pool != NULL);
+    EXPECT_EQ(sizeof(MockPooledObject), pool->size());
+    EXPECT_EQ(1, pool->used());
+
+    int cached = pool->cached();
+    srs_freep(a);
+    EXPECT_EQ(0, pool->used());
+    EXPECT_EQ(cached + 1, pool->cached());
+
+    // The freed object is reused.
+    uint64_t reuses = pool->nn_reuses();
+    MockPooledObject* b = new MockPooledObject();
+    EXPECT_EQ(reuses + 1, pool->nn_reuses());
+    EXPECT_EQ(cached, pool->cached());
+
+    // The larger object is never pooled, even freed by the base.
+    MockPooledObject* c = new MockPooledLargeObject();
+    EXPECT_EQ(1, pool->used());
+    srs_freep(c);
+    EXPECT_EQ(cached, pool->cached());
+
+    srs_freep(b);
+    EXPECT_EQ(0, pool->used());
+
+    // The free objects are returned to heap when disabled.
+    SrsObjectPool::set_enabled(false);
+    EXPECT_EQ(0, pool->cached());
+    MockPooledObject* d = new MockPooledObject();
+    srs_freep(d);
+    EXPECT_EQ(0, pool->cached());
+    SrsObjectPool::set_enabled(true);
+}
+
+VOID TEST(SrsArena, AllocAndReset)
+{
+    SrsArena arena(256);
+
+    // The buffers are aligned, and from the same block.
+    char* a = (char*)arena.alloc(10);
+    char* b = (char*)arena.alloc(20);
+    EXPECT_EQ(0, (int)((uint64_t)a % 16));
+    EXPECT_EQ(a + 16, b);
+    EXPECT_EQ(48, (int)arena.used());
+
+    // Allocate a new block if full, and the large buffer uses its own block.
+    uint64_t blocks = SrsArena::nn_blocks();
+    arena.alloc(240);
+    EXPECT_EQ(blocks + 1, SrsArena::nn_blocks());
+    arena.alloc(1024);
+    EXPECT_EQ(blocks + 2, SrsArena::nn_blocks());
+
+    // The first block is kept when reset.
+    arena.reset();
+    EXPECT_EQ(0, (int)arena.used());
+    EXPECT_EQ(a, (char*)arena.alloc(100));
+    EXPECT_EQ(blocks + 2, SrsArena::nn_blocks());
+}
+
+VOID TEST(SrsArena, ReadBodyOfMessage)
+{
+    srs_error_t err;
+
+    SrsArena arena;
+    SrsHttpParser hp;
+    HELPER_EXPECT_SUCCESS(hp.initialize(HTTP_RESPONSE));
+    hp.set_arena(&arena);
+
+    MockBufferIO io;
+    io.append("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n0123456789");
+
+    ISrsHttpMessage* msg = NULL;
+    HELPER_EXPECT_SUCCESS(hp.parse_message(&io, &msg));
+    SrsAutoFree(ISrsHttpMessage, msg);
+
+    // The buffer to read body is allocated once from arena.
+    string body;
+    int finish = 0;
+    HELPER_EXPECT_SUCCESS(((SrsHttpMessage*)msg)->body_read_part(body, 4, finish));
+    EXPECT_EQ(SRS_HTTP_READ_CACHE_BYTES, (int)arena.used());
+    EXPECT_STREQ("0123456789", body.c_str());
+
+    body = "";
+    HELPER_EXPECT_SUCCESS(((SrsHttpMessage*)msg)->body_read_part(body, 4, finish));
+    EXPECT_EQ(SRS_HTTP_READ_CACHE_BYTES, (int)arena.used());
+    EXPECT_EQ(1, finish);
+}
+
+VOID TEST(SrsArena, ReleaseAllBlocks)
+{
+    SrsArena arena(64);
+    uint64_t blocks = SrsArena::nn_blocks();
+
+    EXPECT_TRUE(arena.alloc(32) != NULL);
+    arena.release();
+    EXPECT_EQ(0, (int)arena.used());
+
+    // The first block is allocated again.
+    EXPECT_TRUE(arena.alloc(32) != NULL);
+    EXPECT_EQ(2, (int)(SrsArena::nn_blocks() - blocks));
+}
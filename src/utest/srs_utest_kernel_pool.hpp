@@ -0,0 +1,5 @@
+#ifndef SRS_UTEST_KERNEL_POOL_HPP
+#define SRS_UTEST_KERNEL_POOL_HPP
+#include <srs_utest_main.hpp>
+
+#endif
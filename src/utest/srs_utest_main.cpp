@@ -4,6 +4,7 @@
 #include <srs_utest_main.hpp>
 #include <srs_app_policy.hpp>
 #include <srs_app_access_log.hpp>
+#include <srs_protocol_st.hpp>
 ISrsLog* _srs_log = NULL;
 ISrsContext* _srs_context = NULL;
 SrsConfig* _srs_config = NULL;
@@ -23,6 +24,11 @@ srs_error_t prepare_main() {
         return srs_error_wrap(err, "init global");
     }
 
+    // For the tests of coroutine, the ST is only able to be initialized once.
+    if ((err = srs_st_init()) != srs_success) {
+        return srs_error_wrap(err, "init st");
+    }
+
     srs_freep(_srs_log);
     _srs_log = new MockEmptyLog(SrsLogLevelDisabled);
     